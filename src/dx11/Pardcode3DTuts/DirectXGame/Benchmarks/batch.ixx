@@ -0,0 +1,199 @@
+export module benchmarks:batch;
+import std;
+import dx3d;
+import :harness;
+
+namespace
+{
+	// Vertices and instances to transform, and the buffers the results go to, which stand
+	// in for mapped upload buffers.
+	struct BatchScene
+	{
+		dx3d::Vec3Array Points;
+		dx3d::Vec3Array Normals;
+		dx3d::Mat4 Transform;
+		dx3d::Mat3 NormalMatrix;
+		std::vector<dx3d::Mat4> World;
+		// About one in ten instances, as a FrustumCuller might list them.
+		std::vector<std::uint32_t> Visible;
+		std::vector<dx3d::Vec4> Vertices;
+		std::vector<dx3d::InstanceTransform> Instances;
+	};
+
+	auto MakeBatchScene(std::size_t count) -> std::shared_ptr<BatchScene>
+	{
+		auto random = std::mt19937{ 42 };
+		auto value = std::uniform_real_distribution<float>{ -100.0f, 100.0f };
+		auto angle = std::uniform_real_distribution<float>{ -std::numbers::pi_v<float>, std::numbers::pi_v<float> };
+		auto scale = std::uniform_real_distribution<float>{ 0.5f, 2.0f };
+		auto visible = std::bernoulli_distribution{ 0.1 };
+		auto vector = [&] { return dx3d::Vec3{ value(random), value(random), value(random) }; };
+		auto world = [&] { return dx3d::Translation(vector()) * dx3d::RotationY(angle(random)) * dx3d::RotationX(angle(random)) * dx3d::Scaling({ scale(random), scale(random), scale(random) }); };
+
+		auto scene = std::make_shared<BatchScene>();
+		scene->Points.Resize(count);
+		scene->Normals.Resize(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			scene->Points.Set(i, vector());
+			scene->Normals.Set(i, dx3d::Normalize(vector()));
+			scene->World.push_back(world());
+			if (visible(random))
+				scene->Visible.push_back(static_cast<std::uint32_t>(i));
+		}
+		// Scaled unevenly, so that the normals need renormalising.
+		scene->Transform = world();
+		scene->NormalMatrix = dx3d::NormalMatrix(scene->Transform).value();
+		scene->Vertices.resize(count);
+		scene->Instances.resize(count);
+		return scene;
+	}
+
+	auto Near(const dx3d::Vec4& a, const dx3d::Vec4& b) -> bool
+	{
+		auto near = [](float x, float y) { return std::abs(x - y) <= 1e-4f * (1.0f + std::abs(x) + std::abs(y)); };
+		return near(a.x, b.x) and near(a.y, b.y) and near(a.z, b.z) and near(a.w, b.w);
+	}
+
+	// Checks the first count results against the scalar versions, and that the
+	// sentinels after them weren't written.
+	template<typename T>
+	void CheckResults(std::string_view kernel, std::span<const T> results, std::span<const T> expected, std::size_t count, dx3d::StoreMode mode)
+	{
+		auto stores = mode == dx3d::StoreMode::Streaming ? "streaming" : "cached";
+		auto near = [](const T& a, const T& b)
+		{
+			if constexpr (std::same_as<T, dx3d::Vec4>)
+				return Near(a, b);
+			else
+				return std::ranges::equal(a.Rows, b.Rows, [](auto& x, auto& y) { return Near(x, y); });
+		};
+		for (std::size_t i = 0; i < count; ++i)
+			if (not near(results[i], expected[i]))
+				throw std::runtime_error{ std::format("Expected {} with {} stores to match the scalar version for element {} of {}", kernel, stores, i, count) };
+		for (auto i = count; i < results.size(); ++i)
+			if (not (results[i] == T{}))
+				throw std::runtime_error{ std::format("Expected {} not to write past element {}", kernel, count) };
+	}
+
+	// Sizes either side of the chunk size and of the four vectors a group, with both kinds
+	// of store, across a pool.
+	void CheckBatch()
+	{
+		auto pool = dx3d::ThreadPool{ 3 };
+		for (auto count : { std::size_t{ 13 }, dx3d::BatchGrainSize + 5, std::size_t{ 100'000 } })
+		{
+			auto scene = MakeBatchScene(count);
+			scene->Normals.Set(0, {});
+			auto expected = std::vector<dx3d::Vec4>(count);
+			auto expectedInstances = std::vector<dx3d::InstanceTransform>(count);
+			auto all = std::vector<std::uint32_t>(count);
+			std::iota(all.begin(), all.end(), 0u);
+			for (auto mode : { dx3d::StoreMode::Cached, dx3d::StoreMode::Streaming })
+			{
+				// Room for a few more than count, left zeroed.
+				auto vertices = std::vector<dx3d::Vec4>(count + 3);
+				auto instances = std::vector<dx3d::InstanceTransform>(count + 3);
+
+				dx3d::TransformPoints(scene->Transform, scene->Points, vertices, mode, pool);
+				dx3d::Scalar::TransformPoints(scene->Transform, scene->Points, expected);
+				CheckResults<dx3d::Vec4>("TransformPoints", vertices, expected, count, mode);
+
+				dx3d::TransformNormals(scene->NormalMatrix, scene->Normals, vertices, mode, pool);
+				dx3d::Scalar::TransformNormals(scene->NormalMatrix, scene->Normals, expected);
+				CheckResults<dx3d::Vec4>("TransformNormals", vertices, expected, count, mode);
+				if (vertices[0] != dx3d::Vec4{})
+					throw std::runtime_error{ "Expected a zero normal to stay zero" };
+
+				dx3d::WriteInstances(scene->World, instances, mode, pool);
+				dx3d::Scalar::WriteInstances(scene->World, all, expectedInstances);
+				CheckResults<dx3d::InstanceTransform>("WriteInstances", instances, expectedInstances, count, mode);
+
+				std::ranges::fill(instances, dx3d::InstanceTransform{});
+				dx3d::WriteInstances(scene->World, scene->Visible, instances, mode, pool);
+				dx3d::Scalar::WriteInstances(scene->World, scene->Visible, expectedInstances);
+				CheckResults<dx3d::InstanceTransform>("WriteInstances of visible objects", instances, expectedInstances, scene->Visible.size(), mode);
+			}
+		}
+
+		auto scene = MakeBatchScene(100);
+		auto tooSmall = std::vector<dx3d::Vec4>(99);
+		try
+		{
+			dx3d::TransformPoints(scene->Transform, scene->Points, tooSmall);
+		}
+		catch (const dx3d::RuntimeError&)
+		{
+			return;
+		}
+		throw std::runtime_error{ "Expected TransformPoints() to refuse an output that's too small" };
+	}
+
+	void AddModes(Bench::Runner& runner, std::string_view name, std::uint64_t bytesPerOp, std::function<void(dx3d::StoreMode, dx3d::ThreadPool&)> run)
+	{
+		static auto singleThread = dx3d::ThreadPool{ 0 };
+		auto& pool = dx3d::GetThreadPool();
+		for (auto [label, mode] : { std::pair{ "Cached", dx3d::StoreMode::Cached }, std::pair{ "Streaming", dx3d::StoreMode::Streaming } })
+		{
+			runner.Add(
+				std::format("{}/{}", name, label),
+				[run, mode, &pool](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+						run(mode, pool);
+				},
+				bytesPerOp);
+			runner.Add(
+				std::format("{}/{}/1Thread", name, label),
+				[run, mode](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+						run(mode, singleThread);
+				},
+				bytesPerOp);
+		}
+	}
+
+	void AddScalar(Bench::Runner& runner, std::string name, std::uint64_t bytesPerOp, std::function<void()> run)
+	{
+		runner.Add(
+			std::move(name),
+			[run](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					run();
+			},
+			bytesPerOp);
+	}
+}
+
+export namespace Benchmarks
+{
+	// The bytes per operation count what each kernel reads and writes, so that the
+	// results' GB/s can be compared with the machine's memory bandwidth.
+	void AddBatch(Bench::Runner& runner)
+	{
+		CheckBatch();
+
+		auto scene = MakeBatchScene(1'000'000);
+		auto count = scene->Points.Size();
+		auto vertexBytes = count * (3 * sizeof(float) + sizeof(dx3d::Vec4));
+		AddModes(runner, "dx3d::TransformPoints/1M", vertexBytes,
+			[scene](dx3d::StoreMode mode, dx3d::ThreadPool& pool) { dx3d::TransformPoints(scene->Transform, scene->Points, scene->Vertices, mode, pool); });
+		AddScalar(runner, "dx3d::Scalar::TransformPoints/1M", vertexBytes,
+			[scene] { dx3d::Scalar::TransformPoints(scene->Transform, scene->Points, scene->Vertices); });
+		AddModes(runner, "dx3d::TransformNormals/1M", vertexBytes,
+			[scene](dx3d::StoreMode mode, dx3d::ThreadPool& pool) { dx3d::TransformNormals(scene->NormalMatrix, scene->Normals, scene->Vertices, mode, pool); });
+		AddScalar(runner, "dx3d::Scalar::TransformNormals/1M", vertexBytes,
+			[scene] { dx3d::Scalar::TransformNormals(scene->NormalMatrix, scene->Normals, scene->Vertices); });
+
+		auto instanceBytes = count * (sizeof(dx3d::Mat4) + sizeof(dx3d::InstanceTransform));
+		AddModes(runner, "dx3d::WriteInstances/1M", instanceBytes,
+			[scene](dx3d::StoreMode mode, dx3d::ThreadPool& pool) { dx3d::WriteInstances(scene->World, scene->Instances, mode, pool); });
+		auto visibleBytes = scene->Visible.size() * (sizeof(std::uint32_t) + sizeof(dx3d::Mat4) + sizeof(dx3d::InstanceTransform));
+		AddModes(runner, "dx3d::WriteInstances/1M/Visible", visibleBytes,
+			[scene](dx3d::StoreMode mode, dx3d::ThreadPool& pool) { dx3d::WriteInstances(scene->World, scene->Visible, scene->Instances, mode, pool); });
+		AddScalar(runner, "dx3d::Scalar::WriteInstances/1M/Visible", visibleBytes,
+			[scene] { dx3d::Scalar::WriteInstances(scene->World, scene->Visible, scene->Instances); });
+	}
+}
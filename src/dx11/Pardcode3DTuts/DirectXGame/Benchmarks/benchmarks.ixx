@@ -0,0 +1,82 @@
+export module benchmarks;
+export import :harness;
+export import :math;
+export import :scene;
+export import :culling;
+export import :bvh;
+export import :batch;
+import std;
+
+namespace
+{
+	struct Options
+	{
+		Bench::RunnerOptions Runner;
+		std::string Format = "json";
+		std::string Output = "dx3d-benchmarks.json";
+	};
+
+	auto ParseOptions(std::span<const std::string_view> args) -> Options
+	{
+		auto options = Options{};
+		for (std::size_t i = 0; i < args.size(); ++i)
+		{
+			auto arg = args[i];
+			auto next =
+				[&]() -> std::string_view
+				{
+					if (i + 1 >= args.size())
+						throw std::runtime_error{ std::format("Missing value for {}", arg) };
+					return args[++i];
+				};
+
+			if (arg == "--filter")
+				options.Runner.Filter = next();
+			else if (arg == "--format")
+				options.Format = next();
+			else if (arg == "--out")
+				options.Output = next();
+			else if (arg == "--samples")
+				options.Runner.Samples = std::stoull(std::string{ next() });
+			else if (arg == "--min-sample-ms")
+				options.Runner.MinSampleTime = std::chrono::milliseconds{ std::stoll(std::string{ next() }) };
+			else
+				throw std::runtime_error{ std::format("Unknown argument {}", arg) };
+		}
+		if (options.Format != "json" and options.Format != "csv")
+			throw std::runtime_error{ std::format("Unknown format {}, expected json or csv", options.Format) };
+		return options;
+	}
+}
+
+export namespace Benchmarks
+{
+	// Runs the benchmarks, given the arguments after --benchmark.
+	//
+	// Benchmark mode is part of DirectXGame.exe and so builds only on Windows, with MSVC,
+	// like the rest of the project. There's no separate Linux target: the benchmarks
+	// import dx3d, a single module whose partitions include the Direct3D 11 and Win32 code. Scenes come from fixed seeds, so
+	// runs of one build are comparable. The distributions' output differs between
+	// standard libraries, so numbers from other toolchains aren't.
+	void Run(std::span<const std::string_view> args)
+	{
+		auto options = ParseOptions(args);
+
+		auto runner = Bench::Runner{ options.Runner };
+		AddMath(runner);
+		AddScene(runner);
+		AddCulling(runner);
+		AddBvh(runner);
+		AddBatch(runner);
+		auto results = runner.Run();
+
+		auto out = std::ofstream{ options.Output, std::ios::trunc };
+		if (not out)
+			throw std::runtime_error{ std::format("Failed to open {}", options.Output) };
+		if (options.Format == "csv")
+			Bench::WriteCsv(out, results);
+		else
+			Bench::WriteJson(out, results);
+		std::println(std::cerr, "Wrote {} results to {}", results.size(), options.Output);
+	}
+}
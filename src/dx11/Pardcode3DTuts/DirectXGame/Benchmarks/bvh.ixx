@@ -0,0 +1,345 @@
+export module benchmarks:bvh;
+import std;
+import dx3d;
+import :harness;
+
+namespace
+{
+	struct World
+	{
+		std::vector<dx3d::Aabb> Boxes;
+		dx3d::Frustum Frustum;
+	};
+
+	// Objects scattered over flat ground, looked across from just above it. The view
+	// reaches a kilometre, so from the middle of a world four kilometres across it takes
+	// in a few percent of the objects.
+	auto MakeWorld(std::size_t objectCount, float size, std::mt19937& random) -> World
+	{
+		auto position = std::uniform_real_distribution<float>{ -size / 2, size / 2 };
+		auto height = std::uniform_real_distribution<float>{ 0.0f, 20.0f };
+		auto extent = std::uniform_real_distribution<float>{ 0.25f, 2.5f };
+		auto world = World{};
+		world.Boxes.reserve(objectCount);
+		for (std::size_t i = 0; i < objectCount; ++i)
+			world.Boxes.push_back(dx3d::FromCenterExtents({ position(random), height(random), position(random) }, { extent(random), extent(random), extent(random) }));
+		auto view = dx3d::LookAtLH({ 0, 10, 0 }, { 0.3f, 10, 1 }, { 0, 1, 0 });
+		auto projection = dx3d::PerspectiveFovLH(std::numbers::pi_v<float> / 3, 16.0f / 9.0f, 0.1f, 1000.0f);
+		world.Frustum = dx3d::FromViewProjection(projection * view);
+		return world;
+	}
+
+	auto RandomRay(std::mt19937& random, float size) -> dx3d::Ray
+	{
+		auto position = std::uniform_real_distribution<float>{ -size / 2, size / 2 };
+		auto direction = std::uniform_real_distribution<float>{ -1.0f, 1.0f };
+		return { { position(random), 10.0f, position(random) }, dx3d::Normalize(dx3d::Vec3{ direction(random), direction(random) * 0.1f, direction(random) }) };
+	}
+
+	// A ray along the z axis that starts level with one face of box and one of its edges,
+	// so that it lies in two of the box's slab planes.
+	auto AxisRay(const dx3d::Aabb& box) -> dx3d::Ray
+	{
+		return { { box.Min.x, box.Max.y, box.Min.z - 50.0f }, { 0, 0, 1 } };
+	}
+
+	auto RandomBox(std::mt19937& random, float size, float extent) -> dx3d::Aabb
+	{
+		auto position = std::uniform_real_distribution<float>{ -size / 2, size / 2 };
+		return dx3d::FromCenterExtents({ position(random), 10.0f, position(random) }, { extent, extent, extent });
+	}
+
+	// How far inside the nearest plane the box is; negative when it's outside.
+	auto Margin(const dx3d::Frustum& frustum, const dx3d::Aabb& box) -> float
+	{
+		return std::ranges::min(frustum.Planes | std::views::transform(
+			[&](auto& plane) { return dx3d::SignedDistance(plane, dx3d::Center(box)) + dx3d::Dot(dx3d::Abs(plane.Normal), dx3d::Extents(box)); }));
+	}
+
+	// The objects still in the tree, with the boxes they were given.
+	using Objects = std::vector<std::pair<dx3d::BvhProxy, dx3d::Aabb>>;
+
+	template<std::size_t VWidth>
+	auto Sorted(const dx3d::Bvh<VWidth>& bvh, std::vector<dx3d::BvhProxy> proxies, std::string_view query) -> std::vector<dx3d::BvhProxy>
+	{
+		std::ranges::sort(proxies);
+		if (std::ranges::adjacent_find(proxies) != proxies.end())
+			throw std::runtime_error{ std::format("Expected Bvh{} {} queries to find each object once", VWidth, query) };
+		for (auto proxy : proxies)
+			if (not bvh.Contains(proxy))
+				throw std::runtime_error{ std::format("Expected Bvh{} {} queries to find only objects in the tree", VWidth, query) };
+		return proxies;
+	}
+
+	// Checks each kind of query against testing every object. Frustum queries can only
+	// disagree about boxes that touch a plane, where rounding differs, and rays about
+	// where exactly they hit.
+	template<std::size_t VWidth>
+	void CheckQueries(const dx3d::Bvh<VWidth>& bvh, const Objects& objects, const dx3d::Frustum& frustum, float size, std::mt19937& random)
+	{
+		if (bvh.Size() != objects.size())
+			throw std::runtime_error{ std::format("Expected Bvh{} to hold {} objects, not {}", VWidth, objects.size(), bvh.Size()) };
+		for (auto& [proxy, box] : objects)
+			if (bvh.GetBounds(proxy) != box)
+				throw std::runtime_error{ std::format("Expected Bvh{} to keep each object's bounds", VWidth) };
+
+		auto found = std::vector<dx3d::BvhProxy>{};
+		bvh.Query(frustum, [&](dx3d::BvhProxy proxy) { found.push_back(proxy); });
+		auto visible = Sorted(bvh, std::move(found), "frustum");
+		auto expected = std::vector<dx3d::BvhProxy>{};
+		for (auto& [proxy, box] : objects)
+			if (dx3d::Intersects(frustum, box))
+				expected.push_back(proxy);
+		std::ranges::sort(expected);
+		auto differences = std::vector<dx3d::BvhProxy>{};
+		std::ranges::set_symmetric_difference(visible, expected, std::back_inserter(differences));
+		for (auto proxy : differences)
+			if (std::abs(Margin(frustum, bvh.GetBounds(proxy))) > 1e-3f)
+				throw std::runtime_error{ std::format("Expected Bvh{} frustum queries to match Intersects() for object {}", VWidth, std::to_underlying(proxy)) };
+		if (expected.empty() or expected.size() == objects.size())
+			throw std::runtime_error{ "Expected the test world to have some objects inside the frustum and some outside" };
+
+		for (std::size_t i = 0; i < 100; ++i)
+		{
+			auto box = RandomBox(random, size, 10.0f);
+			found.clear();
+			bvh.Query(box, [&](dx3d::BvhProxy proxy) { found.push_back(proxy); });
+			auto touching = Sorted(bvh, std::move(found), "box");
+			expected.clear();
+			for (auto& [proxy, bounds] : objects)
+				if (dx3d::Intersects(box, bounds))
+					expected.push_back(proxy);
+			std::ranges::sort(expected);
+			if (touching != expected)
+				throw std::runtime_error{ std::format("Expected Bvh{} box queries to find the objects touching the box", VWidth) };
+
+			// Every fourth ray is axis aligned, through the planes of some object's box.
+			auto ray = i % 4 == 0 ? AxisRay(objects[i * 37 % objects.size()].second) : RandomRay(random, size);
+			auto nearest = std::numeric_limits<float>::infinity();
+			bvh.Raycast(ray, 100.0f, [&](dx3d::BvhProxy, float distance) { return nearest = std::min(nearest, distance); });
+			auto expectedNearest = std::numeric_limits<float>::infinity();
+			for (auto& [proxy, bounds] : objects)
+				if (auto distance = dx3d::HitDistance(ray, bounds, 100.0f))
+					expectedNearest = std::min(expectedNearest, *distance);
+			if (std::isinf(nearest) != std::isinf(expectedNearest) or std::abs(nearest - expectedNearest) > 1e-3f * (1.0f + expectedNearest))
+				throw std::runtime_error{ std::format("Expected Bvh{} to find the nearest hit at {}, not {}", VWidth, expectedNearest, nearest) };
+			if (i % 4 == 0 and std::isinf(nearest))
+				throw std::runtime_error{ std::format("Expected Bvh{} to hit a box with a ray through its planes", VWidth) };
+		}
+	}
+
+	// Raycasts that stop at once, from inside boxes that overlap so that several are hit at
+	// distance 0, and along an axis through the planes of the only box it hits.
+	template<std::size_t VWidth>
+	void CheckRaycastEdges()
+	{
+		auto bvh = dx3d::Bvh<VWidth>{};
+		for (std::size_t i = 0; i < 3 * VWidth; ++i)
+			bvh.Insert(dx3d::FromCenterExtents({ static_cast<float>(i % 3) * 0.1f, 0, 0 }, { 1, 1, 1 }));
+		auto visits = std::size_t{ 0 };
+		bvh.Raycast(dx3d::Ray{ { 0, 0, 0 }, { 1, 0, 0 } }, 100.0f, [&](dx3d::BvhProxy, float) { ++visits; return 0.0f; });
+		if (visits != 1)
+			throw std::runtime_error{ std::format("Expected Bvh{} to stop after the visit that returned 0, not make {} visits", VWidth, visits) };
+
+		auto box = dx3d::Aabb{ { 10, 10, 5 }, { 11, 11, 6 } };
+		auto proxy = bvh.Insert(box);
+		auto hits = std::vector<std::pair<dx3d::BvhProxy, float>>{};
+		bvh.Raycast(AxisRay(box), 100.0f, [&](dx3d::BvhProxy hit, float distance) { hits.emplace_back(hit, distance); return 100.0f; });
+		if (hits.size() != 1 or hits[0].first != proxy or hits[0].second != *dx3d::HitDistance(AxisRay(box), box))
+			throw std::runtime_error{ std::format("Expected Bvh{} to hit only the box whose planes an axis aligned ray lies in, at the distance HitDistance() gives", VWidth) };
+	}
+
+	// Adds objects one at a time, then optimizes, moves, removes and adds more, checking
+	// the queries after each step, and that optimizing makes the tree cheaper.
+	template<std::size_t VWidth>
+	void CheckBvh()
+	{
+		if constexpr (dx3d::Simd::HasWidth<VWidth>)
+		{
+			CheckRaycastEdges<VWidth>();
+
+			constexpr auto Size = 400.0f;
+			auto random = std::mt19937{ 11 };
+			auto world = MakeWorld(5000, Size, random);
+			auto bvh = dx3d::Bvh<VWidth>{};
+			auto objects = Objects{};
+			for (auto& box : world.Boxes)
+				objects.emplace_back(bvh.Insert(box), box);
+			CheckQueries(bvh, objects, world.Frustum, Size, random);
+
+			auto incrementalCost = bvh.Cost();
+			bvh.Optimize();
+			if (not (bvh.Cost() < incrementalCost))
+				throw std::runtime_error{ std::format("Expected optimizing Bvh{} to lower its cost from {}", VWidth, incrementalCost) };
+			CheckQueries(bvh, objects, world.Frustum, Size, random);
+
+			auto offset = std::uniform_real_distribution<float>{ -20.0f, 20.0f };
+			for (std::size_t i = 0; i < objects.size(); i += 3)
+			{
+				auto& [proxy, box] = objects[i];
+				box = dx3d::FromCenterExtents(dx3d::Center(box) + dx3d::Vec3{ offset(random), 0, offset(random) }, dx3d::Extents(box));
+				bvh.Move(proxy, box);
+			}
+			CheckQueries(bvh, objects, world.Frustum, Size, random);
+			for (std::size_t i = objects.size(); i-- > 0;)
+				if (i % 5 == 0)
+				{
+					bvh.Remove(objects[i].first);
+					objects.erase(objects.begin() + static_cast<std::ptrdiff_t>(i));
+				}
+			for (auto& box : MakeWorld(1000, Size, random).Boxes)
+				objects.emplace_back(bvh.Insert(box), box);
+			CheckQueries(bvh, objects, world.Frustum, Size, random);
+			bvh.Optimize();
+			CheckQueries(bvh, objects, world.Frustum, Size, random);
+
+			for (auto& [proxy, box] : objects)
+				bvh.Remove(proxy);
+			if (bvh.Size() != 0 or not dx3d::IsEmpty(bvh.Bounds()))
+				throw std::runtime_error{ std::format("Expected Bvh{} to be empty once every object is removed", VWidth) };
+		}
+	}
+
+	// Does nothing for widths the build doesn't have.
+	template<std::size_t VWidth>
+	void AddQueries(Bench::Runner& runner, std::shared_ptr<const World> world, float size)
+	{
+		if constexpr (dx3d::Simd::HasWidth<VWidth>)
+		{
+			auto bvh = std::make_shared<dx3d::Bvh<VWidth>>();
+			auto proxies = std::make_shared<std::vector<dx3d::BvhProxy>>();
+			for (auto& box : world->Boxes)
+				proxies->push_back(bvh->Insert(box));
+			bvh->Rebuild();
+
+			runner.Add(
+				std::format("dx3d::Bvh{}/Frustum/1M", VWidth),
+				[world, bvh](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						auto visible = std::size_t{ 0 };
+						bvh->Query(world->Frustum, [&](dx3d::BvhProxy) { ++visible; });
+						Bench::DoNotOptimize(visible);
+					}
+				});
+
+			// A thousand rays or boxes per iteration, from random places in the world.
+			auto rays = std::make_shared<std::vector<dx3d::Ray>>();
+			auto boxes = std::make_shared<std::vector<dx3d::Aabb>>();
+			auto random = std::mt19937{ 5 };
+			for (std::size_t i = 0; i < 1000; ++i)
+			{
+				rays->push_back(RandomRay(random, size));
+				boxes->push_back(RandomBox(random, size, 5.0f));
+			}
+			runner.Add(
+				std::format("dx3d::Bvh{}/Raycast/1M/1K", VWidth),
+				[bvh, rays](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+						for (auto& ray : *rays)
+						{
+							auto nearest = 100.0f;
+							bvh->Raycast(ray, nearest, [&](dx3d::BvhProxy, float distance) { return nearest = std::min(nearest, distance); });
+							Bench::DoNotOptimize(nearest);
+						}
+				});
+			runner.Add(
+				std::format("dx3d::Bvh{}/Overlap/1M/1K", VWidth),
+				[bvh, boxes](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+						for (auto& box : *boxes)
+						{
+							auto touching = std::size_t{ 0 };
+							bvh->Query(box, [&](dx3d::BvhProxy) { ++touching; });
+							Bench::DoNotOptimize(touching);
+						}
+				});
+
+			// Nudges one object in a hundred back and forth, as moving props would, and
+			// rebuilds whatever that degrades.
+			runner.Add(
+				std::format("dx3d::Bvh{}/Move1%+Optimize/1M", VWidth),
+				[world, bvh, proxies, step = std::make_shared<std::uint64_t>()](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						auto offset = dx3d::Vec3{ (*step)++ % 2 ? -0.5f : 0.5f, 0, 0 };
+						for (std::size_t object = 0; object < proxies->size(); object += 100)
+						{
+							auto& box = world->Boxes[object];
+							bvh->Move((*proxies)[object], { box.Min + offset, box.Max + offset });
+						}
+						bvh->Optimize();
+					}
+				});
+
+			// Takes out one object in a hundred and puts it back, as streaming would.
+			runner.Add(
+				std::format("dx3d::Bvh{}/Reinsert1%+Optimize/1M", VWidth),
+				[world, bvh, proxies](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						for (std::size_t object = 50; object < proxies->size(); object += 100)
+						{
+							bvh->Remove((*proxies)[object]);
+							(*proxies)[object] = bvh->Insert(world->Boxes[object]);
+						}
+						bvh->Optimize();
+					}
+				});
+		}
+	}
+
+	void AddRebuild(Bench::Runner& runner, std::shared_ptr<const World> world)
+	{
+		auto bvh = std::make_shared<dx3d::Bvh<>>();
+		for (std::size_t i = 0; i < 100'000; ++i)
+			bvh->Insert(world->Boxes[i]);
+		runner.Add(
+			"dx3d::Bvh4/Rebuild/100K",
+			[bvh](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					bvh->Rebuild();
+			});
+	}
+
+	// The same world culled without a hierarchy, for comparison.
+	void AddFlat(Bench::Runner& runner, std::shared_ptr<const World> world)
+	{
+		auto boxes = std::make_shared<dx3d::AabbArray>();
+		boxes->Resize(world->Boxes.size());
+		for (std::size_t i = 0; i < world->Boxes.size(); ++i)
+			boxes->Set(i, world->Boxes[i]);
+		runner.Add(
+			"dx3d::FrustumCuller/World/1M",
+			[world, boxes, culler = std::make_shared<dx3d::FrustumCuller>()](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					Bench::DoNotOptimize(culler->Cull(world->Frustum, *boxes).size());
+			});
+	}
+}
+
+export namespace Benchmarks
+{
+	void AddBvh(Bench::Runner& runner)
+	{
+		CheckBvh<4>();
+		CheckBvh<8>();
+		CheckBvh<16>();
+
+		constexpr auto Size = 4000.0f;
+		auto random = std::mt19937{ 42 };
+		auto world = std::make_shared<const World>(MakeWorld(1'000'000, Size, random));
+		AddQueries<4>(runner, world, Size);
+		AddQueries<8>(runner, world, Size);
+		AddQueries<16>(runner, world, Size);
+		AddRebuild(runner, world);
+		AddFlat(runner, world);
+	}
+}
@@ -0,0 +1,152 @@
+export module benchmarks:culling;
+import std;
+import dx3d;
+import :harness;
+
+namespace
+{
+	struct CullingScene
+	{
+		dx3d::SphereArray Spheres;
+		dx3d::AabbArray Boxes;
+		dx3d::Frustum Frustum;
+	};
+
+	// Objects scattered through a cube a kilometre across, seen from its centre with a 60
+	// degree field of view, which leaves about one in ten of them visible.
+	auto MakeCullingScene(std::size_t objectCount) -> std::shared_ptr<CullingScene>
+	{
+		auto random = std::mt19937{ 42 };
+		auto position = std::uniform_real_distribution<float>{ -500.0f, 500.0f };
+		auto size = std::uniform_real_distribution<float>{ 0.5f, 5.0f };
+		auto scene = std::make_shared<CullingScene>();
+		scene->Spheres.Resize(objectCount);
+		scene->Boxes.Resize(objectCount);
+		for (std::size_t i = 0; i < objectCount; ++i)
+		{
+			auto center = dx3d::Vec3{ position(random), position(random), position(random) };
+			auto extents = dx3d::Vec3{ size(random), size(random), size(random) };
+			auto box = dx3d::FromCenterExtents(center, extents);
+			scene->Boxes.Set(i, box);
+			scene->Spheres.Set(i, dx3d::ToSphere(box));
+		}
+		auto view = dx3d::LookAtLH({ 0, 0, 0 }, { 0.3f, 0.1f, 1 }, { 0, 1, 0 });
+		auto projection = dx3d::PerspectiveFovLH(std::numbers::pi_v<float> / 3, 16.0f / 9.0f, 0.1f, 1000.0f);
+		scene->Frustum = dx3d::FromViewProjection(projection * view);
+		return scene;
+	}
+
+	// How far inside the nearest plane the bounds are; negative when they're outside.
+	auto Margin(const dx3d::Frustum& frustum, const dx3d::Sphere& sphere) -> float
+	{
+		return std::ranges::min(frustum.Planes | std::views::transform([&](auto& plane) { return dx3d::SignedDistance(plane, sphere.Center) + sphere.Radius; }));
+	}
+
+	auto Margin(const dx3d::Frustum& frustum, const dx3d::Aabb& box) -> float
+	{
+		return std::ranges::min(frustum.Planes | std::views::transform(
+			[&](auto& plane) { return dx3d::SignedDistance(plane, dx3d::Center(box)) + dx3d::Dot(dx3d::Abs(plane.Normal), dx3d::Extents(box)); }));
+	}
+
+	// Checks the SIMD culling at width VWidth against Intersects(). The two can only
+	// disagree about bounds that touch a plane, where the fused multiply-adds round
+	// differently.
+	template<std::size_t VWidth, typename TArray>
+	void CheckCulling(const dx3d::Frustum& frustum, const TArray& bounds, dx3d::ThreadPool& pool)
+	{
+		auto culler = dx3d::FrustumCuller{};
+		auto visible = culler.Cull<VWidth>(frustum, bounds, pool);
+		auto expected = std::vector<std::uint32_t>{};
+		dx3d::Scalar::Cull(frustum, bounds, expected);
+		if (not std::ranges::is_sorted(visible))
+			throw std::runtime_error{ std::format("Expected the visible indices at width {} to be in order", VWidth) };
+		auto differences = std::vector<std::uint32_t>{};
+		std::ranges::set_symmetric_difference(visible, expected, std::back_inserter(differences));
+		for (auto index : differences)
+			if (std::abs(Margin(frustum, bounds.Get(index))) > 1e-3f)
+				throw std::runtime_error{ std::format("Expected culling at width {} to match Intersects() for object {}", VWidth, index) };
+		if (expected.empty() or expected.size() == bounds.Size())
+			throw std::runtime_error{ "Expected the test scene to have some objects inside the frustum and some outside" };
+	}
+
+	// Does nothing for widths the build doesn't have.
+	template<std::size_t VWidth>
+	void CheckCullingWidth()
+	{
+		if constexpr (dx3d::Simd::HasWidth<VWidth>)
+		{
+			auto pool = dx3d::ThreadPool{ 3 };
+			// Sizes either side of the chunk and vector widths, so that the padding and the
+			// compaction between chunks are covered.
+			for (auto count : { std::size_t{ 13 }, dx3d::FrustumCuller::GrainSize + 5, std::size_t{ 100'000 } })
+			{
+				auto scene = MakeCullingScene(count);
+				// So that even the smallest scene has objects on both sides: one in front of
+				// the camera and one behind it.
+				scene->Spheres.Set(0, { { 0, 0, 10 }, 1 });
+				scene->Boxes.Set(0, dx3d::FromCenterExtents({ 0, 0, 10 }, { 1, 1, 1 }));
+				scene->Spheres.Set(1, { { 0, 0, -10 }, 1 });
+				scene->Boxes.Set(1, dx3d::FromCenterExtents({ 0, 0, -10 }, { 1, 1, 1 }));
+				CheckCulling<VWidth>(scene->Frustum, scene->Spheres, pool);
+				CheckCulling<VWidth>(scene->Frustum, scene->Boxes, pool);
+			}
+		}
+	}
+
+	template<std::size_t VWidth, typename TArray>
+	void AddCull(Bench::Runner& runner, std::string name, std::shared_ptr<CullingScene> scene, TArray CullingScene::* bounds, dx3d::ThreadPool& pool, std::uint64_t bytesPerObject)
+	{
+		auto& array = (*scene).*bounds;
+		runner.Add(
+			std::move(name),
+			[scene, &array, &pool, culler = std::make_shared<dx3d::FrustumCuller>()](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					Bench::DoNotOptimize(culler->Cull<VWidth>(scene->Frustum, array, pool).size());
+			},
+			array.Size() * bytesPerObject);
+	}
+
+	template<typename TArray>
+	void AddCullWidths(Bench::Runner& runner, std::string_view label, std::shared_ptr<CullingScene> scene, TArray CullingScene::* bounds, std::uint64_t bytesPerObject)
+	{
+		static auto singleThread = dx3d::ThreadPool{ 0 };
+		auto& pool = dx3d::GetThreadPool();
+		AddCull<4>(runner, std::format("dx3d::FrustumCuller/{}/Width4", label), scene, bounds, pool, bytesPerObject);
+		if constexpr (dx3d::Simd::HasWidth<8>)
+			AddCull<8>(runner, std::format("dx3d::FrustumCuller/{}/Width8", label), scene, bounds, pool, bytesPerObject);
+		if constexpr (dx3d::Simd::HasWidth<16>)
+			AddCull<16>(runner, std::format("dx3d::FrustumCuller/{}/Width16", label), scene, bounds, pool, bytesPerObject);
+		AddCull<dx3d::Simd::MaxWidth>(runner, std::format("dx3d::FrustumCuller/{}/Width{}/1Thread", label, dx3d::Simd::MaxWidth), scene, bounds, singleThread, bytesPerObject);
+
+		auto& array = (*scene).*bounds;
+		runner.Add(
+			std::format("dx3d::Scalar::Cull/{}", label),
+			[scene, &array, visible = std::make_shared<std::vector<std::uint32_t>>()](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					dx3d::Scalar::Cull(scene->Frustum, array, *visible);
+					Bench::DoNotOptimize(visible->size());
+				}
+			},
+			array.Size() * bytesPerObject);
+	}
+}
+
+export namespace Benchmarks
+{
+	void AddCulling(Bench::Runner& runner)
+	{
+		CheckCullingWidth<4>();
+		CheckCullingWidth<8>();
+		CheckCullingWidth<16>();
+
+		for (auto [label, count] : { std::pair{ "100K", std::size_t{ 100'000 } }, std::pair{ "1M", std::size_t{ 1'000'000 } } })
+		{
+			auto scene = MakeCullingScene(count);
+			AddCullWidths(runner, std::format("Spheres/{}", label), scene, &CullingScene::Spheres, 4 * sizeof(float));
+			AddCullWidths(runner, std::format("Aabbs/{}", label), scene, &CullingScene::Boxes, 6 * sizeof(float));
+		}
+	}
+}
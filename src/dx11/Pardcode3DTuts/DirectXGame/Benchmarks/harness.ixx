@@ -0,0 +1,168 @@
+export module benchmarks:harness;
+import std;
+
+// Forked from src/dx12/shared-benchmarks/harness.ixx, as the two solutions don't share
+// modules. This copy reports GB/s for the math and culling kernels instead of counting
+// allocations, which would need the game to replace the global operator new. Fixes to
+// the sampling belong in both.
+
+export namespace Bench
+{
+	// Keeps the optimiser from discarding a value or the work that produced it.
+	template<typename T>
+	inline void DoNotOptimize(T&& value) noexcept
+	{
+		static volatile const void* sink = nullptr;
+		sink = std::addressof(value);
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+	}
+
+	inline void ClobberMemory() noexcept
+	{
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+	}
+
+	// A benchmark body runs its operation the given number of times.
+	using Body = std::function<void(std::uint64_t iterations)>;
+
+	struct Result
+	{
+		std::string Name;
+		std::uint64_t Iterations = 0;
+		std::uint64_t Samples = 0;
+		double NsPerOpMin = 0;
+		double NsPerOpMedian = 0;
+		double NsPerOpMax = 0;
+		// Optional throughput, in bytes per operation.
+		std::uint64_t BytesPerOp = 0;
+
+		// At the median time; bytes per nanosecond are GB/s. Zero without BytesPerOp.
+		auto GigabytesPerSecond() const noexcept -> double
+		{
+			return NsPerOpMedian > 0 ? static_cast<double>(BytesPerOp) / NsPerOpMedian : 0.0;
+		}
+	};
+
+	struct RunnerOptions
+	{
+		std::string Filter;
+		std::chrono::nanoseconds MinSampleTime = std::chrono::milliseconds{ 20 };
+		std::uint64_t Samples = 10;
+	};
+
+	class Runner
+	{
+	public:
+		explicit Runner(RunnerOptions options = {})
+			: options(std::move(options))
+		{ }
+
+		void Add(this Runner& self, std::string name, Body body, std::uint64_t bytesPerOp = 0)
+		{
+			self.cases.push_back(Case{ std::move(name), std::move(body), bytesPerOp });
+		}
+
+		auto Run(this const Runner& self) -> std::vector<Result>
+		{
+			auto results = std::vector<Result>{};
+			for (const auto& benchmark : self.cases)
+			{
+				if (not self.options.Filter.empty() and not benchmark.Name.contains(self.options.Filter))
+					continue;
+				std::println(std::cerr, "Running {}...", benchmark.Name);
+				results.push_back(self.RunOne(benchmark));
+			}
+			return results;
+		}
+
+	private:
+		struct Case
+		{
+			std::string Name;
+			Body Body;
+			std::uint64_t BytesPerOp = 0;
+		};
+
+		static auto Time(const Body& body, std::uint64_t iterations) -> std::chrono::nanoseconds
+		{
+			auto start = std::chrono::steady_clock::now();
+			body(iterations);
+			ClobberMemory();
+			return std::chrono::steady_clock::now() - start;
+		}
+
+		auto RunOne(this const Runner& self, const Case& benchmark) -> Result
+		{
+			// Warm up and grow the batch until a single sample takes long enough to be
+			// well above the clock's resolution.
+			auto iterations = std::uint64_t{ 1 };
+			while (Time(benchmark.Body, iterations) < self.options.MinSampleTime and iterations < (std::uint64_t{ 1 } << 40))
+				iterations *= 2;
+
+			auto nsPerOp = std::vector<double>{};
+			nsPerOp.reserve(self.options.Samples);
+			for (std::uint64_t i = 0; i < self.options.Samples; ++i)
+			{
+				auto elapsed = Time(benchmark.Body, iterations);
+				nsPerOp.push_back(static_cast<double>(elapsed.count()) / static_cast<double>(iterations));
+			}
+			std::ranges::sort(nsPerOp);
+
+			return Result{
+				.Name = benchmark.Name,
+				.Iterations = iterations,
+				.Samples = nsPerOp.size(),
+				.NsPerOpMin = nsPerOp.front(),
+				.NsPerOpMedian = nsPerOp[nsPerOp.size() / 2],
+				.NsPerOpMax = nsPerOp.back(),
+				.BytesPerOp = benchmark.BytesPerOp
+			};
+		}
+
+		RunnerOptions options;
+		std::vector<Case> cases;
+	};
+
+	void WriteJson(std::ostream& out, std::span<const Result> results)
+	{
+		out << "{\n  \"benchmarks\": [";
+		auto separator = "";
+		for (const auto& result : results)
+		{
+			std::print(
+				out,
+				"{}\n    {{\"name\": \"{}\", \"iterations\": {}, \"samples\": {}, \"ns_per_op_min\": {:.3f}, "
+				"\"ns_per_op_median\": {:.3f}, \"ns_per_op_max\": {:.3f}, \"bytes_per_op\": {}, \"gb_per_s\": {:.3f}}}",
+				separator,
+				result.Name,
+				result.Iterations,
+				result.Samples,
+				result.NsPerOpMin,
+				result.NsPerOpMedian,
+				result.NsPerOpMax,
+				result.BytesPerOp,
+				result.GigabytesPerSecond()
+			);
+			separator = ",";
+		}
+		out << "\n  ]\n}\n";
+	}
+
+	void WriteCsv(std::ostream& out, std::span<const Result> results)
+	{
+		out << "name,iterations,samples,ns_per_op_min,ns_per_op_median,ns_per_op_max,bytes_per_op,gb_per_s\n";
+		for (const auto& result : results)
+			std::println(
+				out,
+				"{},{},{},{:.3f},{:.3f},{:.3f},{},{:.3f}",
+				result.Name,
+				result.Iterations,
+				result.Samples,
+				result.NsPerOpMin,
+				result.NsPerOpMedian,
+				result.NsPerOpMax,
+				result.BytesPerOp,
+				result.GigabytesPerSecond()
+			);
+	}
+}
@@ -0,0 +1,146 @@
+export module benchmarks:math;
+import std;
+import dx3d;
+import :harness;
+
+namespace
+{
+	// Enough values to stay in L1, cycled through so that no result is loop invariant.
+	constexpr std::size_t InputCount = 1024;
+
+	struct Inputs
+	{
+		std::vector<dx3d::Vec4> Vectors;
+		std::vector<dx3d::Mat4> Matrices;
+		std::vector<dx3d::Aabb> Boxes;
+	};
+
+	auto MakeInputs() -> Inputs
+	{
+		auto random = std::mt19937{ 42 };
+		auto value = std::uniform_real_distribution<float>{ -4.0f, 4.0f };
+		auto vector = [&] { return dx3d::Vec4{ value(random), value(random), value(random), value(random) }; };
+
+		auto inputs = Inputs{};
+		for (std::size_t i = 0; i < InputCount; ++i)
+		{
+			inputs.Vectors.push_back(vector());
+			inputs.Matrices.push_back({ { vector(), vector(), vector(), vector() } });
+			auto center = dx3d::ToVec3(vector());
+			inputs.Boxes.push_back(dx3d::FromCenterExtents(center, dx3d::Abs(dx3d::ToVec3(vector()))));
+		}
+		return inputs;
+	}
+
+	auto Near(float a, float b) -> bool
+	{
+		return std::abs(a - b) <= 1e-4f * (1.0f + std::abs(a) + std::abs(b));
+	}
+
+	auto Near(const dx3d::Vec4& a, const dx3d::Vec4& b) -> bool
+	{
+		return Near(a.x, b.x) and Near(a.y, b.y) and Near(a.z, b.z) and Near(a.w, b.w);
+	}
+
+	auto Near(const dx3d::Vec3& a, const dx3d::Vec3& b) -> bool
+	{
+		return Near(dx3d::ToVec4(a, 0), dx3d::ToVec4(b, 0));
+	}
+
+	// Checks the SIMD operations against their scalar versions, which the constant
+	// evaluated tests cover. They can differ in the last bits, from fused multiply-adds and
+	// the order of the sums.
+	void CheckSimdMatchesScalar(const Inputs& inputs)
+	{
+		for (std::size_t i = 0; i < InputCount; ++i)
+		{
+			auto& a = inputs.Vectors[i];
+			auto& b = inputs.Vectors[(i + 1) % InputCount];
+			auto& m = inputs.Matrices[i];
+			auto& n = inputs.Matrices[(i + 1) % InputCount];
+			auto product = m * n;
+			auto expectedProduct = dx3d::Scalar::Multiply(m, n);
+			auto box = dx3d::Transform(inputs.Boxes[i], m);
+			auto expectedBox = dx3d::Scalar::Transform(inputs.Boxes[i], m);
+			if (not Near(a + b, dx3d::Scalar::Add(a, b))
+				or not Near(a * b, dx3d::Scalar::Mul(a, b))
+				or not Near(a / b, dx3d::Scalar::Div(a, b))
+				or not Near(dx3d::Min(a, b), dx3d::Scalar::Min(a, b))
+				or not Near(dx3d::Max(a, b), dx3d::Scalar::Max(a, b))
+				or not Near(dx3d::Dot(a, b), dx3d::Scalar::Dot(a, b))
+				or not Near(dx3d::Normalize(a), dx3d::Scalar::Normalize(a)))
+				throw std::runtime_error{ std::format("Expected the SIMD Vec4 operations to match the scalar ones for input {}", i) };
+			if (not Near(m * a, dx3d::Scalar::Multiply(m, a))
+				or not std::ranges::equal(product.Columns, expectedProduct.Columns, [](auto& x, auto& y) { return Near(x, y); })
+				or dx3d::Transpose(m) != dx3d::Scalar::Transpose(m))
+				throw std::runtime_error{ std::format("Expected the SIMD Mat4 operations to match the scalar ones for input {}", i) };
+			if (not Near(box.Min, expectedBox.Min) or not Near(box.Max, expectedBox.Max))
+				throw std::runtime_error{ std::format("Expected the SIMD Aabb transform to match the scalar one for input {}", i) };
+		}
+	}
+
+	// Adds a SIMD benchmark and its scalar counterpart, each applying op to input i for
+	// operation i.
+	template<typename TSimd, typename TScalar>
+	void AddPair(Bench::Runner& runner, std::string_view name, std::shared_ptr<const Inputs> inputs, TSimd simd, TScalar scalar)
+	{
+		runner.Add(
+			std::format("dx3d::{}/Simd", name),
+			[inputs, simd](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					Bench::DoNotOptimize(simd(*inputs, i % InputCount));
+			});
+		runner.Add(
+			std::format("dx3d::{}/Scalar", name),
+			[inputs, scalar](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					Bench::DoNotOptimize(scalar(*inputs, i % InputCount));
+			});
+	}
+
+	auto Next(std::size_t i) -> std::size_t
+	{
+		return (i + 1) % InputCount;
+	}
+}
+
+export namespace Benchmarks
+{
+	void AddMath(Bench::Runner& runner)
+	{
+		auto inputs = std::make_shared<const Inputs>(MakeInputs());
+		CheckSimdMatchesScalar(*inputs);
+
+		AddPair(runner, "Vec4/Add", inputs,
+			[](const Inputs& in, std::size_t i) { return in.Vectors[i] + in.Vectors[Next(i)]; },
+			[](const Inputs& in, std::size_t i) { return dx3d::Scalar::Add(in.Vectors[i], in.Vectors[Next(i)]); });
+		AddPair(runner, "Vec4/Dot", inputs,
+			[](const Inputs& in, std::size_t i) { return dx3d::Dot(in.Vectors[i], in.Vectors[Next(i)]); },
+			[](const Inputs& in, std::size_t i) { return dx3d::Scalar::Dot(in.Vectors[i], in.Vectors[Next(i)]); });
+		AddPair(runner, "Vec4/Normalize", inputs,
+			[](const Inputs& in, std::size_t i) { return dx3d::Normalize(in.Vectors[i]); },
+			[](const Inputs& in, std::size_t i) { return dx3d::Scalar::Normalize(in.Vectors[i]); });
+		AddPair(runner, "Mat4/MultiplyVec4", inputs,
+			[](const Inputs& in, std::size_t i) { return in.Matrices[i] * in.Vectors[i]; },
+			[](const Inputs& in, std::size_t i) { return dx3d::Scalar::Multiply(in.Matrices[i], in.Vectors[i]); });
+		AddPair(runner, "Mat4/MultiplyMat4", inputs,
+			[](const Inputs& in, std::size_t i) { return in.Matrices[i] * in.Matrices[Next(i)]; },
+			[](const Inputs& in, std::size_t i) { return dx3d::Scalar::Multiply(in.Matrices[i], in.Matrices[Next(i)]); });
+		AddPair(runner, "Mat4/Transpose", inputs,
+			[](const Inputs& in, std::size_t i) { return dx3d::Transpose(in.Matrices[i]); },
+			[](const Inputs& in, std::size_t i) { return dx3d::Scalar::Transpose(in.Matrices[i]); });
+		AddPair(runner, "Aabb/Transform", inputs,
+			[](const Inputs& in, std::size_t i) { return dx3d::Transform(in.Boxes[i], in.Matrices[i]); },
+			[](const Inputs& in, std::size_t i) { return dx3d::Scalar::Transform(in.Boxes[i], in.Matrices[i]); });
+
+		runner.Add(
+			"dx3d::Mat4/Inverse",
+			[inputs](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					Bench::DoNotOptimize(dx3d::Inverse(inputs->Matrices[i % InputCount]));
+			});
+	}
+}
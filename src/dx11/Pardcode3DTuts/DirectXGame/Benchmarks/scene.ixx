@@ -0,0 +1,279 @@
+export module benchmarks:scene;
+import std;
+import dx3d;
+import :harness;
+
+namespace
+{
+	auto RandomLocal(std::mt19937& random) -> dx3d::Mat4
+	{
+		auto value = std::uniform_real_distribution<float>{ -1.0f, 1.0f };
+		auto axis = dx3d::Normalize(dx3d::Vec3{ value(random), value(random), value(random) + 2.0f });
+		auto translation = dx3d::Vec3{ value(random), value(random), value(random) };
+		return dx3d::Compose(translation, dx3d::FromAxisAngle(axis, value(random)), { 1, 1, 1 });
+	}
+
+	struct Scene
+	{
+		dx3d::TransformHierarchy Transforms;
+		std::vector<dx3d::TransformId> Ids;
+		// Parallel to Ids; the index of each node's parent, or npos for roots.
+		std::vector<std::size_t> Parents;
+	};
+
+	// A random forest with one root per thousand nodes, in which each node's parent is a
+	// random node from the first half of those added before it. That spreads a million
+	// nodes over about ten depths, most of them in the middle.
+	auto MakeScene(std::size_t nodeCount, std::mt19937& random) -> Scene
+	{
+		auto scene = Scene{};
+		auto roots = std::max<std::size_t>(nodeCount / 1000, 1);
+		for (std::size_t i = 0; i < nodeCount; ++i)
+		{
+			auto parent = i < roots ? std::string::npos : std::uniform_int_distribution<std::size_t>{ 0, i / 2 }(random);
+			auto parentId = parent == std::string::npos ? dx3d::TransformId::None : scene.Ids[parent];
+			scene.Ids.push_back(scene.Transforms.Add(RandomLocal(random), parentId));
+			scene.Parents.push_back(parent);
+		}
+		return scene;
+	}
+
+	// Every nth node, spread over the whole scene.
+	auto EveryNth(const Scene& scene, std::size_t n) -> std::vector<dx3d::TransformId>
+	{
+		auto ids = std::vector<dx3d::TransformId>{};
+		for (std::size_t i = 0; i < scene.Ids.size(); i += n)
+			ids.push_back(scene.Ids[i]);
+		return ids;
+	}
+
+	auto Near(const dx3d::Mat4& a, const dx3d::Mat4& b) -> bool
+	{
+		for (std::size_t column = 0; column < 4; ++column)
+			for (std::size_t row = 0; row < 4; ++row)
+			{
+				auto x = a[column].Data()[row];
+				auto y = b[column].Data()[row];
+				if (std::abs(x - y) > 1e-3f * (1.0f + std::abs(x) + std::abs(y)))
+					return false;
+			}
+		return true;
+	}
+
+	// Checks every live node's world matrix against the product of the local matrices up
+	// its chain of parents.
+	void CheckWorlds(const Scene& scene, const std::vector<bool>& removed)
+	{
+		for (std::size_t i = 0; i < scene.Ids.size(); ++i)
+		{
+			if (removed[i])
+				continue;
+			auto expected = scene.Transforms.GetLocal(scene.Ids[i]);
+			for (auto parent = scene.Parents[i]; parent != std::string::npos; parent = scene.Parents[parent])
+				expected = scene.Transforms.GetLocal(scene.Ids[parent]) * expected;
+			if (not Near(scene.Transforms.GetWorld(scene.Ids[i]), expected))
+				throw std::runtime_error{ std::format("Expected node {} to have the product of its ancestors' local matrices as its world matrix", i) };
+		}
+	}
+
+	// Checks that each live node is flagged as changed exactly when it or an ancestor moved.
+	void CheckChanged(const Scene& scene, const std::vector<bool>& removed, const std::vector<bool>& moved)
+	{
+		for (std::size_t i = 0; i < scene.Ids.size(); ++i)
+		{
+			if (removed[i])
+				continue;
+			auto expected = false;
+			for (auto node = i; node != std::string::npos and not expected; node = scene.Parents[node])
+				expected = moved[node];
+			if (scene.Transforms.WorldChanged(scene.Ids[i]) != expected)
+				throw std::runtime_error{ std::format("Expected node {} to be flagged as changed only if it or an ancestor moved", i) };
+		}
+	}
+
+	// Builds a scene, updates it from several threads, then moves, removes and adds nodes
+	// and updates it again, checking the world matrices and change flags each time. Then
+	// moves a few nodes, so that the update walks its lists rather than every node.
+	void CheckTransformHierarchy()
+	{
+		auto random = std::mt19937{ 7 };
+		auto pool = dx3d::ThreadPool{ 3 };
+		auto scene = MakeScene(20000, random);
+		auto removed = std::vector<bool>(scene.Ids.size());
+		scene.Transforms.Update(pool);
+		CheckWorlds(scene, removed);
+
+		scene.Transforms.Update(pool);
+		for (auto id : scene.Ids)
+			if (scene.Transforms.WorldChanged(id))
+				throw std::runtime_error{ "Expected an update with nothing dirty to change nothing" };
+
+		auto moved = std::vector<bool>(scene.Ids.size());
+		for (std::size_t i = 0; i < scene.Ids.size(); i += 97)
+		{
+			scene.Transforms.SetLocal(scene.Ids[i], RandomLocal(random));
+			moved[i] = true;
+		}
+		// Leaves, removed from the end so that parents go after their children.
+		auto hasChildren = std::vector<bool>(scene.Ids.size());
+		for (auto parent : scene.Parents)
+			if (parent != std::string::npos)
+				hasChildren[parent] = true;
+		for (auto i = scene.Ids.size(); i-- > 0;)
+			if (i % 13 == 0 and not hasChildren[i])
+			{
+				scene.Transforms.Remove(scene.Ids[i]);
+				removed[i] = true;
+			}
+		for (std::size_t i = 0; i < 1000; ++i)
+		{
+			auto parent = std::uniform_int_distribution<std::size_t>{ 0, scene.Ids.size() - 1 }(random);
+			if (removed[parent])
+				continue;
+			scene.Ids.push_back(scene.Transforms.Add(RandomLocal(random), scene.Ids[parent]));
+			scene.Parents.push_back(parent);
+			removed.push_back(false);
+			moved.push_back(true);
+		}
+		scene.Transforms.Update(pool);
+		CheckWorlds(scene, removed);
+		CheckChanged(scene, removed, moved);
+		for (std::size_t i = 0; i < removed.size(); ++i)
+			if (removed[i] and scene.Transforms.Contains(scene.Ids[i]))
+				throw std::runtime_error{ std::format("Expected the id of removed node {} to stay invalid after its slot is reused", i) };
+
+		moved.assign(moved.size(), false);
+		for (std::size_t i = 0; i < scene.Ids.size(); i += 997)
+		{
+			if (removed[i])
+				continue;
+			scene.Transforms.SetLocal(scene.Ids[i], RandomLocal(random));
+			moved[i] = true;
+		}
+		// The last node added, whose depth is mostly made of others added with it.
+		scene.Transforms.SetLocal(scene.Ids.back(), RandomLocal(random));
+		moved.back() = true;
+		scene.Transforms.Update(pool);
+		CheckWorlds(scene, removed);
+		CheckChanged(scene, removed, moved);
+
+		moved.assign(moved.size(), false);
+		scene.Transforms.Update(pool);
+		CheckChanged(scene, removed, moved);
+	}
+
+	// Starts loops from inside a loop on the same pool, which have to run inline rather
+	// than wait for the loop they're part of.
+	void CheckNestedParallelFor()
+	{
+		auto pool = dx3d::ThreadPool{ 3 };
+		auto counts = std::vector<std::atomic<std::uint32_t>>(64 * 64);
+		pool.ParallelFor(64, 1,
+			[&pool, &counts](std::size_t begin, std::size_t end)
+			{
+				for (auto row = begin; row < end; ++row)
+					pool.ParallelFor(64, 1,
+						[&counts, row](std::size_t columnBegin, std::size_t columnEnd)
+						{
+							for (auto column = columnBegin; column < columnEnd; ++column)
+								counts[row * 64 + column].fetch_add(1, std::memory_order_relaxed);
+						});
+			});
+		if (std::ranges::any_of(counts, [](auto& count) { return count.load() != 1; }))
+			throw std::runtime_error{ "Expected nested loops to visit every index once" };
+	}
+
+	// Throws from every chunk of a loop, which has to reach the caller once, cancel the
+	// chunks no one has started, and leave the pool able to run the next loop in parallel.
+	// Then checks that a node refused for being too deep doesn't count as its parent's child.
+	void CheckThrowingParallelFor()
+	{
+		auto pool = dx3d::ThreadPool{ 3 };
+		auto started = std::atomic<std::size_t>{ 0 };
+		auto caught = false;
+		try
+		{
+			pool.ParallelFor(1024, 1,
+				[&started](std::size_t, std::size_t)
+				{
+					started.fetch_add(1, std::memory_order_relaxed);
+					throw std::runtime_error{ "Chunk failed" };
+				});
+		}
+		catch (const std::runtime_error& ex)
+		{
+			caught = std::string_view{ ex.what() } == "Chunk failed";
+		}
+		if (not caught or started.load() > pool.ThreadCount())
+			throw std::runtime_error{ std::format("Expected a throwing loop to rethrow once and stop after at most {} chunks, it ran {}", pool.ThreadCount(), started.load()) };
+
+		auto mutex = std::mutex{};
+		auto threads = std::set<std::thread::id>{};
+		pool.ParallelFor(64, 1,
+			[&](std::size_t, std::size_t)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+				auto lock = std::scoped_lock{ mutex };
+				threads.insert(std::this_thread::get_id());
+			});
+		if (threads.size() < 2)
+			throw std::runtime_error{ "Expected the loop after a throwing one to run on several threads" };
+
+		auto transforms = dx3d::TransformHierarchy{};
+		auto chain = std::vector{ transforms.Add(dx3d::Mat4::Identity()) };
+		while (chain.size() < dx3d::TransformHierarchy::MaxDepth)
+			chain.push_back(transforms.Add(dx3d::Mat4::Identity(), chain.back()));
+		auto refused = false;
+		try
+		{
+			transforms.Add(dx3d::Mat4::Identity(), chain.back());
+		}
+		catch (const dx3d::RuntimeError&)
+		{
+			refused = true;
+		}
+		if (not refused)
+			throw std::runtime_error{ "Expected a node deeper than MaxDepth to be refused" };
+		for (auto id = chain.rbegin(); id != chain.rend(); ++id)
+			transforms.Remove(*id);
+		if (transforms.Size() != 0)
+			throw std::runtime_error{ "Expected a refused node to leave its parent removable" };
+	}
+
+	void AddUpdate(Bench::Runner& runner, std::string name, std::shared_ptr<Scene> scene, std::size_t dirtyEvery, dx3d::ThreadPool& pool)
+	{
+		runner.Add(
+			std::move(name),
+			[scene, dirty = EveryNth(*scene, dirtyEvery), &pool](std::uint64_t iterations)
+			{
+				auto local = dx3d::Translation({ 0.0f, 0.001f, 0.0f });
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					for (auto id : dirty)
+						scene->Transforms.SetLocal(id, local);
+					scene->Transforms.Update(pool);
+				}
+			});
+	}
+}
+
+export namespace Benchmarks
+{
+	void AddScene(Bench::Runner& runner)
+	{
+		CheckNestedParallelFor();
+		CheckThrowingParallelFor();
+		CheckTransformHierarchy();
+
+		auto random = std::mt19937{ 42 };
+		auto scene = std::make_shared<Scene>(MakeScene(1'000'000, random));
+		scene->Transforms.Update();
+
+		static auto singleThread = dx3d::ThreadPool{ 0 };
+		for (auto [label, dirtyEvery] : { std::pair{ "Dirty1%", 100 }, std::pair{ "Dirty100%", 1 } })
+		{
+			AddUpdate(runner, std::format("dx3d::TransformHierarchy/Update/1M/{}", label), scene, dirtyEvery, dx3d::GetThreadPool());
+			AddUpdate(runner, std::format("dx3d::TransformHierarchy/Update/1M/{}/1Thread", label), scene, dirtyEvery, singleThread);
+		}
+	}
+}
@@ -0,0 +1,476 @@
+export module dx3d:core.binarylog;
+import std;
+import :error.runtimerror;
+
+export namespace dx3d
+{
+	// A format string passed as a template argument, so that each distinct format, and in
+	// practice each call site, gets its own registration.
+	template<std::size_t N>
+	struct BinaryLogFormat
+	{
+		char Buffer[N]{};
+
+		constexpr BinaryLogFormat(const char(&format)[N]) noexcept
+		{
+			std::copy_n(format, N, Buffer);
+		}
+
+		constexpr auto ToView() const noexcept -> std::string_view
+		{
+			return { Buffer, N - 1 };
+		}
+	};
+
+	enum class BinaryArgType : std::uint8_t
+	{
+		Bool,
+		Char,
+		Int8,
+		Int16,
+		Int32,
+		Int64,
+		UInt8,
+		UInt16,
+		UInt32,
+		UInt64,
+		Float,
+		Double,
+		Pointer,
+		// A 32-bit length followed by the characters.
+		String
+	};
+
+	template<typename T>
+	constexpr auto GetBinaryArgType() noexcept -> BinaryArgType
+	{
+		using TValue = std::remove_cvref_t<T>;
+		if constexpr (std::is_enum_v<TValue>)
+			return GetBinaryArgType<std::underlying_type_t<TValue>>();
+		else if constexpr (std::same_as<TValue, bool>)
+			return BinaryArgType::Bool;
+		else if constexpr (std::same_as<TValue, char>)
+			return BinaryArgType::Char;
+		else if constexpr (std::signed_integral<TValue>)
+			return std::array{ BinaryArgType::Int8, BinaryArgType::Int16, BinaryArgType::Int32, BinaryArgType::Int64 }[std::countr_zero(sizeof(TValue))];
+		else if constexpr (std::unsigned_integral<TValue>)
+			return std::array{ BinaryArgType::UInt8, BinaryArgType::UInt16, BinaryArgType::UInt32, BinaryArgType::UInt64 }[std::countr_zero(sizeof(TValue))];
+		else if constexpr (std::same_as<TValue, float>)
+			return BinaryArgType::Float;
+		else if constexpr (std::same_as<TValue, double>)
+			return BinaryArgType::Double;
+		else if constexpr (std::convertible_to<const TValue&, std::string_view>)
+			return BinaryArgType::String;
+		else if constexpr (std::is_pointer_v<TValue>)
+			return BinaryArgType::Pointer;
+		else
+			static_assert(not std::same_as<TValue, TValue>, "Binary logging only supports arithmetic, enum, pointer and string arguments");
+	}
+
+	struct BinaryLogSite
+	{
+		std::uint8_t Level = 0;
+		std::string_view Format;
+		std::vector<BinaryArgType> ArgTypes;
+	};
+
+	// Every site registered by the process, indexed by id. Registration happens once per
+	// site and takes a lock; looking a site up afterwards is only needed the first time a
+	// writer logs from it.
+	class BinaryLogSites
+	{
+	public:
+		static auto Register(BinaryLogSite site) -> std::uint32_t
+		{
+			auto lock = std::scoped_lock{ mutex };
+			sites.push_back(std::move(site));
+			return static_cast<std::uint32_t>(sites.size() - 1);
+		}
+
+		static auto Get(std::uint32_t id) -> const BinaryLogSite&
+		{
+			auto lock = std::scoped_lock{ mutex };
+			return sites.at(id);
+		}
+
+	private:
+		static inline std::mutex mutex;
+		// A deque, so references stay valid as sites are added.
+		static inline std::deque<BinaryLogSite> sites;
+	};
+
+	// The layout of a binary log. Integers are little-endian, as written by the machine.
+	//   Header: Magic, Version, then the steady clock's period as two int64s, and the
+	//           steady clock ticks and system clock nanoseconds when the log was opened.
+	//   Site:   SiteTag, uint32 id, uint8 level, uint8 argument count, one BinaryArgType
+	//           per argument, then the format string as a uint32 length and characters.
+	//   Event:  EventTag, uint32 site id, int64 steady clock ticks, then each argument.
+	// A site is written the first time it's used, before its first event, so each log is
+	// self-contained.
+	namespace BinaryLogLayout
+	{
+		constexpr auto Magic = std::string_view{ "DX3DBLOG" };
+		constexpr std::uint32_t Version = 1;
+		constexpr std::uint8_t SiteTag = 1;
+		constexpr std::uint8_t EventTag = 2;
+	}
+
+	// Writes log events as raw argument bytes into a buffer that goes to disk in one write
+	// whenever it fills up. Formatting is left to DecodeBinaryLog(). Like the Logger that
+	// owns it, a writer must only be used from one thread.
+	class BinaryLogWriter
+	{
+	public:
+		static constexpr std::size_t MaxStringLength = 4096;
+
+		~BinaryLogWriter()
+		{
+			Flush();
+		}
+
+		explicit BinaryLogWriter(const std::filesystem::path& path, std::size_t bufferSize = 256 * 1024)
+			: file(path, std::ios::binary | std::ios::trunc)
+		{
+			if (not file)
+				throw RuntimeError{ std::format("Failed to open binary log {}", path.string()) };
+			buffer.resize(std::max(bufferSize, 2 * MaxStringLength));
+
+			using Period = std::chrono::steady_clock::period;
+			Put(BinaryLogLayout::Magic);
+			Put(BinaryLogLayout::Version);
+			Put(static_cast<std::int64_t>(Period::num));
+			Put(static_cast<std::int64_t>(Period::den));
+			Put(static_cast<std::int64_t>(std::chrono::steady_clock::now().time_since_epoch().count()));
+			Put(static_cast<std::int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count()));
+		}
+
+		BinaryLogWriter(const BinaryLogWriter&) = delete;
+		auto operator=(const BinaryLogWriter&) -> BinaryLogWriter& = delete;
+
+		template<BinaryLogFormat VFormat, std::uint8_t VLevel, typename...TArgs>
+		void Write(const TArgs&...args)
+		{
+			static const auto siteId = BinaryLogSites::Register(
+				BinaryLogSite{ VLevel, VFormat.ToView(), { GetBinaryArgType<TArgs>()... } }
+			);
+			if (siteId >= writtenSites.size() or not writtenSites[siteId])
+				WriteSite(siteId);
+
+			auto time = static_cast<std::int64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+			Reserve(sizeof(BinaryLogLayout::EventTag) + sizeof(siteId) + sizeof(time) + (EncodedSize(args) + ... + 0));
+			Put(BinaryLogLayout::EventTag);
+			Put(siteId);
+			Put(time);
+			(PutArg(args), ...);
+		}
+
+		void Flush()
+		{
+			file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(used));
+			file.flush();
+			used = 0;
+		}
+
+	private:
+		template<typename T>
+		static constexpr auto EncodedSize(const T& arg) noexcept -> std::size_t
+		{
+			if constexpr (GetBinaryArgType<T>() == BinaryArgType::String)
+				return sizeof(std::uint32_t) + std::min(std::string_view{ arg }.size(), MaxStringLength);
+			else if constexpr (GetBinaryArgType<T>() == BinaryArgType::Pointer)
+				return sizeof(std::uint64_t);
+			else
+				return sizeof(T);
+		}
+
+		template<typename T>
+		void PutArg(const T& arg)
+		{
+			if constexpr (GetBinaryArgType<T>() == BinaryArgType::String)
+			{
+				auto text = std::string_view{ arg }.substr(0, MaxStringLength);
+				Put(static_cast<std::uint32_t>(text.size()));
+				Put(text);
+			}
+			else if constexpr (GetBinaryArgType<T>() == BinaryArgType::Pointer)
+			{
+				Put(static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(arg)));
+			}
+			else
+			{
+				Put(arg);
+			}
+		}
+
+		void WriteSite(std::uint32_t siteId)
+		{
+			if (siteId >= writtenSites.size())
+				writtenSites.resize(siteId + 1);
+			writtenSites[siteId] = true;
+
+			const auto& site = BinaryLogSites::Get(siteId);
+			Reserve(sizeof(BinaryLogLayout::SiteTag) + sizeof(siteId) + 2 + site.ArgTypes.size() + sizeof(std::uint32_t) + site.Format.size());
+			Put(BinaryLogLayout::SiteTag);
+			Put(siteId);
+			Put(site.Level);
+			Put(static_cast<std::uint8_t>(site.ArgTypes.size()));
+			for (auto type : site.ArgTypes)
+				Put(type);
+			Put(static_cast<std::uint32_t>(site.Format.size()));
+			Put(site.Format);
+		}
+
+		void Reserve(std::size_t size)
+		{
+			if (used + size > buffer.size())
+				Flush();
+			if (size > buffer.size())
+				buffer.resize(size);
+		}
+
+		template<typename T>
+			requires std::is_trivially_copyable_v<T>
+		void Put(const T& value) noexcept
+		{
+			std::memcpy(buffer.data() + used, &value, sizeof(T));
+			used += sizeof(T);
+		}
+
+		void Put(std::string_view text) noexcept
+		{
+			std::memcpy(buffer.data() + used, text.data(), text.size());
+			used += text.size();
+		}
+
+		std::ofstream file;
+		std::vector<std::byte> buffer;
+		std::size_t used = 0;
+		std::vector<bool> writtenSites;
+	};
+
+	namespace BinaryLogDetail
+	{
+		using Value = std::variant<bool, char, std::int64_t, std::uint64_t, double, const void*, std::string>;
+
+		class Reader
+		{
+		public:
+			explicit Reader(std::istream& in)
+				: in(in)
+			{ }
+
+			template<typename T>
+			auto Read() -> T
+			{
+				auto value = T{};
+				in.read(reinterpret_cast<char*>(&value), sizeof(T));
+				if (not in)
+					throw RuntimeError{ "Binary log ended in the middle of a record" };
+				return value;
+			}
+
+			auto ReadString() -> std::string
+			{
+				auto text = std::string(Read<std::uint32_t>(), '\0');
+				in.read(text.data(), static_cast<std::streamsize>(text.size()));
+				if (not in)
+					throw RuntimeError{ "Binary log ended in the middle of a string" };
+				return text;
+			}
+
+			auto AtEnd() -> bool
+			{
+				return in.peek() == std::char_traits<char>::eof();
+			}
+
+		private:
+			std::istream& in;
+		};
+
+		inline auto ReadValue(Reader& reader, BinaryArgType type) -> Value
+		{
+			switch (type)
+			{
+				case BinaryArgType::Bool: return reader.Read<bool>();
+				case BinaryArgType::Char: return reader.Read<char>();
+				case BinaryArgType::Int8: return std::int64_t{ reader.Read<std::int8_t>() };
+				case BinaryArgType::Int16: return std::int64_t{ reader.Read<std::int16_t>() };
+				case BinaryArgType::Int32: return std::int64_t{ reader.Read<std::int32_t>() };
+				case BinaryArgType::Int64: return reader.Read<std::int64_t>();
+				case BinaryArgType::UInt8: return std::uint64_t{ reader.Read<std::uint8_t>() };
+				case BinaryArgType::UInt16: return std::uint64_t{ reader.Read<std::uint16_t>() };
+				case BinaryArgType::UInt32: return std::uint64_t{ reader.Read<std::uint32_t>() };
+				case BinaryArgType::UInt64: return reader.Read<std::uint64_t>();
+				case BinaryArgType::Float: return double{ reader.Read<float>() };
+				case BinaryArgType::Double: return reader.Read<double>();
+				case BinaryArgType::Pointer: return reinterpret_cast<const void*>(static_cast<std::uintptr_t>(reader.Read<std::uint64_t>()));
+				case BinaryArgType::String: return reader.ReadString();
+			}
+			throw RuntimeError{ std::format("Unknown binary log argument type {}", std::to_underlying(type)) };
+		}
+
+		// The index of the brace that closes the replacement field opened at start, counting
+		// the fields nested in its format spec, such as the width in "{:{}}".
+		inline auto FindFieldEnd(std::string_view format, std::size_t start) -> std::size_t
+		{
+			auto depth = 0;
+			for (auto i = start; i < format.size(); ++i)
+			{
+				if (format[i] == '{')
+					depth++;
+				else if (format[i] == '}' and --depth == 0)
+					return i;
+			}
+			throw RuntimeError{ std::format("Unterminated replacement field in \"{}\"", format) };
+		}
+
+		// The argument a replacement field refers to: its explicit index, or else the next one.
+		inline auto FieldIndex(std::string_view indexText, std::size_t& nextIndex, std::string_view format, std::span<const Value> values) -> std::size_t
+		{
+			auto index = nextIndex++;
+			if (not indexText.empty())
+				std::from_chars(indexText.data(), indexText.data() + indexText.size(), index);
+			if (index >= values.size())
+				throw RuntimeError{ std::format("Replacement field {} is out of range in \"{}\"", index, format) };
+			return index;
+		}
+
+		// Replaces the fields nested in a format spec, which std::format allows for the width
+		// and precision, with the integer arguments they refer to.
+		inline auto ResolveSpec(std::string_view spec, std::size_t& nextIndex, std::string_view format, std::span<const Value> values) -> std::string
+		{
+			auto resolved = std::string{};
+			for (auto i = std::size_t{ 0 }; i < spec.size(); ++i)
+			{
+				if (spec[i] != '{')
+				{
+					resolved += spec[i];
+					continue;
+				}
+				auto end = spec.find('}', i);
+				if (end == std::string_view::npos)
+					throw RuntimeError{ std::format("Unterminated replacement field in \"{}\"", format) };
+				auto index = FieldIndex(spec.substr(i + 1, end - i - 1), nextIndex, format, values);
+				std::visit(
+					[&resolved, index, format](const auto& value)
+					{
+						using T = std::remove_cvref_t<decltype(value)>;
+						if constexpr (std::same_as<T, std::int64_t> or std::same_as<T, std::uint64_t>)
+							std::format_to(std::back_inserter(resolved), "{}", value);
+						else
+							throw RuntimeError{ std::format("Replacement field {} in \"{}\" is used as a width or precision but isn't an integer", index, format) };
+					},
+					values[index]
+				);
+				i = end;
+			}
+			return resolved;
+		}
+
+		// Renders a format string against decoded values. std::format needs its argument
+		// types at compile time, so each replacement field is formatted on its own with the
+		// field's format spec.
+		inline void FormatValues(std::string& out, std::string_view format, std::span<const Value> values)
+		{
+			auto nextIndex = std::size_t{ 0 };
+			for (auto i = std::size_t{ 0 }; i < format.size(); ++i)
+			{
+				auto c = format[i];
+				if ((c == '{' or c == '}') and i + 1 < format.size() and format[i + 1] == c)
+				{
+					out += c;
+					++i;
+					continue;
+				}
+				if (c != '{')
+				{
+					out += c;
+					continue;
+				}
+
+				auto end = FindFieldEnd(format, i);
+				auto field = format.substr(i + 1, end - i - 1);
+				auto colon = field.find(':');
+				auto indexText = field.substr(0, colon);
+				auto spec = colon == std::string_view::npos ? std::string_view{} : field.substr(colon + 1);
+				// As in std::format, the field's own argument comes before any nested in its spec.
+				auto index = FieldIndex(indexText, nextIndex, format, values);
+				auto fieldFormat = std::format("{{:{}}}", ResolveSpec(spec, nextIndex, format, values));
+				std::visit(
+					[&out, &fieldFormat](const auto& value)
+					{
+						std::vformat_to(std::back_inserter(out), fieldFormat, std::make_format_args(value));
+					},
+					values[index]
+				);
+				i = end;
+			}
+		}
+	}
+
+	// Renders a binary log as text, one line per event, in the same layout as the Logger's
+	// text output with a timestamp in front. levelNames maps each site's level to its name.
+	inline void DecodeBinaryLog(std::istream& in, std::ostream& out, std::span<const std::string_view> levelNames)
+	{
+		auto reader = BinaryLogDetail::Reader{ in };
+		auto magic = std::array<char, BinaryLogLayout::Magic.size()>{};
+		for (auto& c : magic)
+			c = reader.Read<char>();
+		if (std::string_view{ magic.data(), magic.size() } != BinaryLogLayout::Magic)
+			throw RuntimeError{ "Not a binary log" };
+		if (auto version = reader.Read<std::uint32_t>(); version != BinaryLogLayout::Version)
+			throw RuntimeError{ std::format("Unsupported binary log version {}", version) };
+
+		auto periodNum = reader.Read<std::int64_t>();
+		auto periodDen = reader.Read<std::int64_t>();
+		auto steadyStart = reader.Read<std::int64_t>();
+		auto systemStart = std::chrono::sys_time<std::chrono::nanoseconds>{ std::chrono::nanoseconds{ reader.Read<std::int64_t>() } };
+		auto toTime =
+			[&](std::int64_t ticks)
+			{
+				auto elapsed = static_cast<long double>(ticks - steadyStart) * periodNum / periodDen;
+				return systemStart + std::chrono::nanoseconds{ static_cast<std::int64_t>(elapsed * 1'000'000'000) };
+			};
+
+		auto sites = std::unordered_map<std::uint32_t, BinaryLogSite>{};
+		auto formats = std::deque<std::string>{};
+		auto values = std::vector<BinaryLogDetail::Value>{};
+		auto line = std::string{};
+		while (not reader.AtEnd())
+		{
+			auto tag = reader.Read<std::uint8_t>();
+			if (tag == BinaryLogLayout::SiteTag)
+			{
+				auto id = reader.Read<std::uint32_t>();
+				auto site = BinaryLogSite{ .Level = reader.Read<std::uint8_t>() };
+				site.ArgTypes.resize(reader.Read<std::uint8_t>());
+				for (auto& type : site.ArgTypes)
+					type = reader.Read<BinaryArgType>();
+				site.Format = formats.emplace_back(reader.ReadString());
+				sites.insert_or_assign(id, std::move(site));
+			}
+			else if (tag == BinaryLogLayout::EventTag)
+			{
+				auto id = reader.Read<std::uint32_t>();
+				auto time = toTime(reader.Read<std::int64_t>());
+				auto found = sites.find(id);
+				if (found == sites.end())
+					throw RuntimeError{ std::format("Event refers to unknown site {}", id) };
+				const auto& site = found->second;
+
+				values.clear();
+				for (auto type : site.ArgTypes)
+					values.push_back(BinaryLogDetail::ReadValue(reader, type));
+				auto level = site.Level < levelNames.size() ? levelNames[site.Level] : std::string_view{ "?" };
+				line.clear();
+				std::format_to(std::back_inserter(line), "{} [DX3D {}] ", time, level);
+				BinaryLogDetail::FormatValues(line, site.Format, values);
+				out << line << '\n';
+			}
+			else
+			{
+				throw RuntimeError{ std::format("Unknown binary log record {}", tag) };
+			}
+		}
+	}
+}
@@ -1,4 +1,5 @@
 export module dx3d:core;
 export import :core.base;
 export import :core.logger;
-export import :core.common;
\ No newline at end of file
+export import :core.common;
+export import :core.threadpool;
\ No newline at end of file
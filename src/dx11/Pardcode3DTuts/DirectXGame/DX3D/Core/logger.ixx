@@ -1,8 +1,22 @@
 export module dx3d:core.logger;
 import std;
+import :core.binarylog;
+import :core.ratelimit;
 
 export namespace dx3d
 {
+	// A rate limit and the call site it applies to. Converting a RateLimit to one captures
+	// the caller's location, so the limit can come before a call's variadic arguments.
+	struct LocatedRateLimit
+	{
+		LocatedRateLimit(const RateLimit& limit, std::source_location location = std::source_location::current()) noexcept
+			: Limit(limit), Location(location)
+		{}
+
+		RateLimit Limit;
+		std::source_location Location;
+	};
+
 	class Logger
 	{
 	public:
@@ -18,45 +32,207 @@ export namespace dx3d
 		Logger(const Logger& other) = delete;
 		auto operator=(const Logger& other) -> Logger& = delete;
 
+		static constexpr auto LevelNames = std::array<std::string_view, 5>{ "DEBUG", "INFO", "WARNING", "ERROR", "CRITICAL" };
+
 		explicit Logger(LogLevel level = LogLevel::Error)
 			: minimumLogLevel(level)
 		{}
 
+		// Binary mode. The templated Debug() to Critical() overloads record their arguments'
+		// raw bytes to binaryLogPath, to be rendered later by DecodeBinaryLog(). The string_view
+		// overloads are recorded as a "{}" event with the message as its argument.
+		Logger(LogLevel level, const std::filesystem::path& binaryLogPath)
+			: minimumLogLevel(level)
+			, binaryLog(std::make_unique<BinaryLogWriter>(binaryLogPath))
+		{}
+
 		void Debug(std::string_view message)
 		{
-			if (LogLevel::Debug < minimumLogLevel)
-				return;
-			std::clog << std::format("[DX3D {}] {}\n", "DEBUG", message);
+			Write<LogLevel::Debug, "{}">(message);
 		}
 
 		void Info(std::string_view message)
 		{
-			if (LogLevel::Info < minimumLogLevel)
-				return;
-			std::clog << std::format("[DX3D {}] {}\n", "INFO", message);
+			Write<LogLevel::Info, "{}">(message);
 		}
 
 		void Warn(std::string_view message)
 		{
-			if (LogLevel::Warning < minimumLogLevel)
-				return;
-			std::clog << std::format("[DX3D {}] {}\n", "WARNING", message);
+			Write<LogLevel::Warning, "{}">(message);
 		}
 
 		void Error(std::string_view message)
 		{
-			if (LogLevel::Error < minimumLogLevel)
-				return;
-			std::clog << std::format("[DX3D {}] {}\n", "ERROR", message);
+			Write<LogLevel::Error, "{}">(message);
 		}
 
 		void Critical(std::string_view message)
 		{
-			if (LogLevel::Critical < minimumLogLevel)
+			Write<LogLevel::Critical, "{}">(message);
+		}
+
+		// Format strings are template arguments, e.g. logger.Info<"Frame {} took {}us">(frame, us),
+		// so that in binary mode each one is registered once rather than written per call.
+		template<BinaryLogFormat VFormat, typename...TArgs>
+		void Debug(const TArgs&...args)
+		{
+			Write<LogLevel::Debug, VFormat>(args...);
+		}
+
+		template<BinaryLogFormat VFormat, typename...TArgs>
+		void Info(const TArgs&...args)
+		{
+			Write<LogLevel::Info, VFormat>(args...);
+		}
+
+		template<BinaryLogFormat VFormat, typename...TArgs>
+		void Warn(const TArgs&...args)
+		{
+			Write<LogLevel::Warning, VFormat>(args...);
+		}
+
+		template<BinaryLogFormat VFormat, typename...TArgs>
+		void Error(const TArgs&...args)
+		{
+			Write<LogLevel::Error, VFormat>(args...);
+		}
+
+		template<BinaryLogFormat VFormat, typename...TArgs>
+		void Critical(const TArgs&...args)
+		{
+			Write<LogLevel::Critical, VFormat>(args...);
+		}
+
+		// Rate limited variants, for failures that can repeat every frame, e.g.
+		// logger.WarnLimited<"Draw {} failed">(RateLimit::PerInterval(1s), draw). Calls are
+		// told apart by call site, and arguments are only formatted for calls that are
+		// written. When a call is written after others from its site were suppressed, the
+		// number suppressed is appended.
+		void DebugLimited(const LocatedRateLimit& limit, std::string_view message)
+		{
+			WriteLimited<LogLevel::Debug, "{}">(limit, message);
+		}
+
+		void InfoLimited(const LocatedRateLimit& limit, std::string_view message)
+		{
+			WriteLimited<LogLevel::Info, "{}">(limit, message);
+		}
+
+		void WarnLimited(const LocatedRateLimit& limit, std::string_view message)
+		{
+			WriteLimited<LogLevel::Warning, "{}">(limit, message);
+		}
+
+		void ErrorLimited(const LocatedRateLimit& limit, std::string_view message)
+		{
+			WriteLimited<LogLevel::Error, "{}">(limit, message);
+		}
+
+		void CriticalLimited(const LocatedRateLimit& limit, std::string_view message)
+		{
+			WriteLimited<LogLevel::Critical, "{}">(limit, message);
+		}
+
+		template<BinaryLogFormat VFormat, typename...TArgs>
+		void DebugLimited(const LocatedRateLimit& limit, const TArgs&...args)
+		{
+			WriteLimited<LogLevel::Debug, VFormat>(limit, args...);
+		}
+
+		template<BinaryLogFormat VFormat, typename...TArgs>
+		void InfoLimited(const LocatedRateLimit& limit, const TArgs&...args)
+		{
+			WriteLimited<LogLevel::Info, VFormat>(limit, args...);
+		}
+
+		template<BinaryLogFormat VFormat, typename...TArgs>
+		void WarnLimited(const LocatedRateLimit& limit, const TArgs&...args)
+		{
+			WriteLimited<LogLevel::Warning, VFormat>(limit, args...);
+		}
+
+		template<BinaryLogFormat VFormat, typename...TArgs>
+		void ErrorLimited(const LocatedRateLimit& limit, const TArgs&...args)
+		{
+			WriteLimited<LogLevel::Error, VFormat>(limit, args...);
+		}
+
+		template<BinaryLogFormat VFormat, typename...TArgs>
+		void CriticalLimited(const LocatedRateLimit& limit, const TArgs&...args)
+		{
+			WriteLimited<LogLevel::Critical, VFormat>(limit, args...);
+		}
+
+		// Writes a summary line for every site with suppressed calls that haven't been
+		// reported yet, so that repeats from a site that has gone quiet are still counted.
+		// The summaries are warnings; below the minimum level the counts are kept instead.
+		void ReportSuppressed()
+		{
+			if (LogLevel::Warning < minimumLogLevel)
 				return;
-			std::clog << std::format("[DX3D {}] {}\n", "CRITICAL", message);
+			RateLimitSites::Get().ForEachSuppressed(
+				[this](std::string_view file, std::uint32_t line, std::uint64_t suppressed)
+				{
+					Write<LogLevel::Warning, "Suppressed {} repeats from {}:{}">(suppressed, file, line);
+				});
 		}
+
+		void Flush()
+		{
+			if (binaryLog)
+				binaryLog->Flush();
+			else
+				std::clog.flush();
+		}
+
+		static void DecodeBinaryLog(std::istream& in, std::ostream& out)
+		{
+			dx3d::DecodeBinaryLog(in, out, LevelNames);
+		}
+
 	private:
+		template<LogLevel VLevel, BinaryLogFormat VFormat, typename...TArgs>
+		void Write(const TArgs&...args)
+		{
+			if (VLevel < minimumLogLevel)
+				return;
+			if (binaryLog)
+			{
+				binaryLog->Write<VFormat, static_cast<std::uint8_t>(VLevel)>(args...);
+				return;
+			}
+			static constexpr auto message = std::format_string<const TArgs&...>{ VFormat.Buffer };
+			std::clog << std::format("[DX3D {}] {}\n", LevelNames[std::to_underlying(VLevel)], std::format(message, args...));
+		}
+
+		// VFormat with the number of suppressed calls appended as one more argument, so
+		// that in binary mode it's registered as a site of its own.
+		template<BinaryLogFormat VFormat>
+		static constexpr auto WithSuppressedCount() noexcept
+		{
+			constexpr auto format = VFormat.ToView();
+			constexpr auto suffix = std::string_view{ " (suppressed {} repeats)" };
+			char buffer[format.size() + suffix.size() + 1]{};
+			std::ranges::copy(suffix, std::ranges::copy(format, buffer).out);
+			return BinaryLogFormat{ buffer };
+		}
+
+		template<LogLevel VLevel, BinaryLogFormat VFormat, typename...TArgs>
+		void WriteLimited(const LocatedRateLimit& limit, const TArgs&...args)
+		{
+			if (VLevel < minimumLogLevel)
+				return;
+			auto site = RateLimitSites::Get().Find(limit.Location);
+			auto suppressed = site ? RateLimitSites::Check(*site, limit.Limit) : std::optional<std::uint64_t>{ 0 };
+			if (not suppressed)
+				return;
+			if (*suppressed == 0)
+				Write<VLevel, VFormat>(args...);
+			else
+				Write<VLevel, WithSuppressedCount<VFormat>()>(args..., *suppressed);
+		}
+
 		LogLevel minimumLogLevel;
+		std::unique_ptr<BinaryLogWriter> binaryLog;
 	};
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,160 @@
+export module dx3d:core.threadpool;
+import std;
+
+export namespace dx3d
+{
+	// A fixed set of worker threads for data parallel loops over the scene. Workers sleep
+	// between loops; the calling thread takes chunks too, so a pool with no workers runs
+	// everything inline.
+	class ThreadPool
+	{
+	public:
+		// One thread per core, counting the caller.
+		ThreadPool()
+			: ThreadPool(std::max(std::thread::hardware_concurrency(), 1u) - 1)
+		{}
+
+		explicit ThreadPool(std::size_t workerCount)
+		{
+			workers.reserve(workerCount);
+			for (std::size_t i = 0; i < workerCount; ++i)
+				workers.emplace_back([this](std::stop_token stop) { WorkerLoop(stop); });
+		}
+
+		~ThreadPool()
+		{
+			for (auto& worker : workers)
+				worker.request_stop();
+			wake.notify_all();
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+
+		// How many threads run a loop, counting the caller.
+		auto ThreadCount() const noexcept -> std::size_t
+		{
+			return workers.size() + 1;
+		}
+
+		// Calls fn(begin, end) for chunks of at most grainSize covering [0, count), across
+		// the pool and the calling thread, and returns once every chunk has run. Loops that
+		// fit in one chunk run inline without waking anyone. Concurrent calls take turns.
+		// A loop started from inside one of the same pool's loops runs inline too, as its
+		// chunks would otherwise wait on the loop that's running them. If fn throws, chunks
+		// nobody has started yet are skipped, and the first exception is rethrown here once
+		// every thread has left the loop.
+		template<typename TFn>
+		void ParallelFor(this ThreadPool& self, std::size_t count, std::size_t grainSize, TFn&& fn)
+		{
+			grainSize = std::max<std::size_t>(grainSize, 1);
+			if (count <= grainSize or self.workers.empty() or runningPool == &self)
+			{
+				if (count > 0)
+					fn(std::size_t{ 0 }, count);
+				return;
+			}
+
+			auto loopLock = std::scoped_lock{ self.loopMutex };
+			auto job = Job{
+				.Run = [](void* context, std::size_t begin, std::size_t end) { (*static_cast<std::remove_reference_t<TFn>*>(context))(begin, end); },
+				.Context = std::addressof(fn),
+				.Count = count,
+				.GrainSize = grainSize
+			};
+			{
+				auto lock = std::scoped_lock{ self.mutex };
+				self.job = &job;
+				++self.generation;
+			}
+			self.wake.notify_all();
+			self.RunChunks(job);
+
+			// No worker can pick the job up once it's cleared; wait for the ones that did.
+			{
+				auto lock = std::unique_lock{ self.mutex };
+				self.job = nullptr;
+				self.idle.wait(lock, [&] { return self.busyWorkers == 0; });
+			}
+			if (job.Error)
+				std::rethrow_exception(job.Error);
+		}
+
+	private:
+		struct Job
+		{
+			void (*Run)(void* context, std::size_t begin, std::size_t end);
+			void* Context;
+			std::size_t Count;
+			std::size_t GrainSize;
+			std::atomic<std::size_t> Next = 0;
+			// Set by the first chunk to throw, and read once every thread has left the job.
+			std::atomic<bool> Failed = false;
+			std::exception_ptr Error;
+		};
+
+		// Never throws, so that a worker can't be taken down by fn and the caller always
+		// gets to wait for the workers before its Job goes out of scope.
+		void RunChunks(this const ThreadPool& self, Job& job) noexcept
+		{
+			auto outer = std::exchange(runningPool, &self);
+			try
+			{
+				for (;;)
+				{
+					auto begin = job.Next.fetch_add(job.GrainSize, std::memory_order_relaxed);
+					if (begin >= job.Count)
+						break;
+					job.Run(job.Context, begin, std::min(begin + job.GrainSize, job.Count));
+				}
+			}
+			catch (...)
+			{
+				if (not job.Failed.exchange(true, std::memory_order_relaxed))
+					job.Error = std::current_exception();
+				job.Next.store(job.Count, std::memory_order_relaxed);
+			}
+			runningPool = outer;
+		}
+
+		void WorkerLoop(this ThreadPool& self, std::stop_token stop)
+		{
+			auto lock = std::unique_lock{ self.mutex };
+			auto joined = std::uint64_t{ 0 };
+			for (;;)
+			{
+				// A worker joins each job once; the one it last ran may still be published.
+				if (not self.wake.wait(lock, stop, [&] { return self.job and self.generation != joined; }))
+					return;
+				auto* job = self.job;
+				joined = self.generation;
+				++self.busyWorkers;
+				lock.unlock();
+				self.RunChunks(*job);
+				lock.lock();
+				if (--self.busyWorkers == 0)
+					self.idle.notify_one();
+			}
+		}
+
+		// The pool whose loop this thread is running chunks of, if any.
+		static inline thread_local const ThreadPool* runningPool = nullptr;
+
+		std::mutex loopMutex;
+		std::mutex mutex;
+		std::condition_variable_any wake;
+		std::condition_variable idle;
+		Job* job = nullptr;
+		std::uint64_t generation = 0;
+		std::size_t busyWorkers = 0;
+		// Last, so that the workers are joined before the state they use goes away.
+		std::vector<std::jthread> workers;
+	};
+
+	// The pool the engine's systems share.
+	inline auto GetThreadPool() -> ThreadPool&
+	{
+		static auto pool = ThreadPool{};
+		return pool;
+	}
+}
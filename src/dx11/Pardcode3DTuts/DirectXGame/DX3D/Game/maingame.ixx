@@ -6,6 +6,7 @@ import :window;
 import :graphics;
 import :game.display;
 import :math;
+import :scene;
 
 export namespace dx3d
 {
@@ -13,6 +14,8 @@ export namespace dx3d
 	{
 		Rect WindowSize{ 1280, 720 };
 		Logger::LogLevel LogLevel = Logger::LogLevel::Info;
+		// Logs in binary to this file instead of as text to std::clog. See Logger::DecodeBinaryLog().
+		std::optional<std::filesystem::path> BinaryLogPath = std::nullopt;
 	};
 	class Game : public Base
 	{
@@ -24,7 +27,9 @@ export namespace dx3d
 
 		Game(const GameDesc& desc)
 			: Base({
-				.Logger = *(new Logger{desc.LogLevel})
+				.Logger = desc.BinaryLogPath
+					? *(new Logger{desc.LogLevel, *desc.BinaryLogPath})
+					: *(new Logger{desc.LogLevel})
 				})
 			, loggerPtr{ &logger }
 		{
@@ -62,15 +67,21 @@ export namespace dx3d
 				OnInternalUpdate();
 			}
 		}
+
+		auto GetTransforms() noexcept -> TransformHierarchy&
+		{
+			return transforms;
+		}
 	private:
 		void OnInternalUpdate()
 		{
-			graphicsEngine->Render(display->GetSwapChain());
+			graphicsEngine->Render(display->GetSwapChain(), transforms);
 		}
 	private:
 		std::unique_ptr<Logger> loggerPtr;
 		std::unique_ptr<GraphicsEngine> graphicsEngine;
 		std::unique_ptr<Display> display;
+		TransformHierarchy transforms;
 		bool isRunning = true;
 	};
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -4,6 +4,7 @@ import :core;
 import :graphics.graphicsdevice;
 import :graphics.devicecontext;
 import :graphics.swapchain;
+import :scene;
 
 export namespace dx3d
 {
@@ -29,8 +30,10 @@ export namespace dx3d
 		{
 			return *graphicsDevice;
 		}
-		void Render(SwapChain& swapChain)
+		// Brings the scene's world transforms up to date for the frame, then draws it.
+		void Render(SwapChain& swapChain, TransformHierarchy& transforms)
 		{
+			transforms.Update();
 			deferredDeviceContext->ClearAndSetBackBuffer(swapChain, {1,0,0,1});
 			graphicsDevice->ExecuteCommandLists(*deferredDeviceContext);
 			swapChain.Present();
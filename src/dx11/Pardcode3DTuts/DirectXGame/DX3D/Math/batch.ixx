@@ -0,0 +1,290 @@
+export module dx3d:math.batch;
+import std;
+import :core.threadpool;
+import :error.runtimerror;
+import :math.simd;
+import :math.vec;
+import :math.mat;
+
+export namespace dx3d
+{
+	namespace Detail
+	{
+		// Columns of floats of the same length, each padded with zeros to a multiple of the
+		// widest vector, so that the objects at the end can be loaded as a whole vector.
+		template<std::size_t VColumns>
+		class FloatColumns
+		{
+		public:
+			static constexpr std::size_t Padding = 16;
+			static_assert(Padding % Simd::MaxWidth == 0);
+
+			auto Size(this const FloatColumns& self) noexcept -> std::size_t
+			{
+				return self.size;
+			}
+
+			void Resize(this FloatColumns& self, std::size_t size)
+			{
+				auto padded = (size + Padding - 1) / Padding * Padding;
+				for (auto& column : self.columns)
+				{
+					column.resize(padded);
+					std::ranges::fill(column.begin() + static_cast<std::ptrdiff_t>(size), column.end(), 0.0f);
+				}
+				self.size = size;
+			}
+
+			auto Column(this auto& self, std::size_t column) noexcept
+			{
+				return self.columns[column].data();
+			}
+
+		private:
+			std::array<std::vector<float>, VColumns> columns;
+			std::size_t size = 0;
+		};
+	}
+
+	// Positions or normals as a structure of arrays, for transforming many at a time.
+	class Vec3Array
+	{
+	public:
+		auto Size(this const Vec3Array& self) noexcept -> std::size_t { return self.columns.Size(); }
+		void Resize(this Vec3Array& self, std::size_t size) { self.columns.Resize(size); }
+
+		void PushBack(this Vec3Array& self, const Vec3& v)
+		{
+			self.Resize(self.Size() + 1);
+			self.Set(self.Size() - 1, v);
+		}
+
+		void Set(this Vec3Array& self, std::size_t index, const Vec3& v)
+		{
+			self.columns.Column(0)[index] = v.x;
+			self.columns.Column(1)[index] = v.y;
+			self.columns.Column(2)[index] = v.z;
+		}
+
+		auto Get(this const Vec3Array& self, std::size_t index) -> Vec3
+		{
+			return { self.X()[index], self.Y()[index], self.Z()[index] };
+		}
+
+		auto X(this const Vec3Array& self) noexcept -> const float* { return self.columns.Column(0); }
+		auto Y(this const Vec3Array& self) noexcept -> const float* { return self.columns.Column(1); }
+		auto Z(this const Vec3Array& self) noexcept -> const float* { return self.columns.Column(2); }
+
+	private:
+		Detail::FloatColumns<3> columns;
+	};
+
+	// The top three rows of an affine world matrix, which is all of it a vertex shader
+	// needs. In HLSL that's float4 Rows[3], and a position p with p.w = 1 goes to
+	// float3(dot(Rows[0], p), dot(Rows[1], p), dot(Rows[2], p)). A quarter smaller than
+	// the whole Mat4.
+	struct InstanceTransform
+	{
+		std::array<Vec4, 3> Rows;
+
+		constexpr auto operator==(const InstanceTransform&) const noexcept -> bool = default;
+	};
+
+	static_assert(sizeof(InstanceTransform) == 48 and alignof(InstanceTransform) == 16);
+
+	constexpr auto ToInstanceTransform(const Mat4& world) noexcept -> InstanceTransform
+	{
+		return { {
+			Vec4{ world[0].x, world[1].x, world[2].x, world[3].x },
+			Vec4{ world[0].y, world[1].y, world[2].y, world[3].y },
+			Vec4{ world[0].z, world[1].z, world[2].z, world[3].z }
+		} };
+	}
+
+	// How the batch transforms write their output. Streaming stores go past the caches,
+	// which suits memory that the CPU only writes, such as a mapped D3D11_USAGE_DYNAMIC
+	// buffer: they don't read each line in before overwriting it, and don't evict
+	// anything the frame still needs. They're slower when the output is read back soon.
+	enum class StoreMode
+	{
+		Cached,
+		Streaming
+	};
+
+	// Vectors or instances per chunk when a batch transform runs across the pool. A
+	// multiple of four, so that only the last chunk has a partial group.
+	constexpr std::size_t BatchGrainSize = 16384;
+
+	namespace Detail
+	{
+		template<StoreMode VMode>
+		inline void Put(Vec4& out, Simd::Float4 v) noexcept
+		{
+			if constexpr (VMode == StoreMode::Streaming)
+				Simd::StoreStream(&out.x, v);
+			else
+				Simd::Store(&out.x, v);
+		}
+
+		// Transforms four vectors by the matrix with the given columns, reading them as
+		// columns of x, y and z and writing one vector per lane with w in the last lane.
+		// Four at a time is what a 4x4 transpose turns back into Vec4s, and four Vec4s
+		// fill a cache line; the loop is bound by memory rather than arithmetic anyway.
+		template<StoreMode VMode, bool VNormalize>
+		void TransformVectors(const std::array<Vec4, 4>& m, float w, const Vec3Array& in, Vec4* out, std::size_t begin, std::size_t end) noexcept
+		{
+			auto m00 = Simd::Splat(m[0].x), m01 = Simd::Splat(m[0].y), m02 = Simd::Splat(m[0].z);
+			auto m10 = Simd::Splat(m[1].x), m11 = Simd::Splat(m[1].y), m12 = Simd::Splat(m[1].z);
+			auto m20 = Simd::Splat(m[2].x), m21 = Simd::Splat(m[2].y), m22 = Simd::Splat(m[2].z);
+			auto m30 = Simd::Splat(m[3].x), m31 = Simd::Splat(m[3].y), m32 = Simd::Splat(m[3].z);
+			auto lastLane = Simd::Splat(w);
+			auto transform =
+				[&](std::size_t i)
+				{
+					auto x = Simd::Load(in.X() + i);
+					auto y = Simd::Load(in.Y() + i);
+					auto z = Simd::Load(in.Z() + i);
+					auto rx = Simd::MulAdd(m00, x, Simd::MulAdd(m10, y, Simd::MulAdd(m20, z, m30)));
+					auto ry = Simd::MulAdd(m01, x, Simd::MulAdd(m11, y, Simd::MulAdd(m21, z, m31)));
+					auto rz = Simd::MulAdd(m02, x, Simd::MulAdd(m12, y, Simd::MulAdd(m22, z, m32)));
+					if constexpr (VNormalize)
+					{
+						// The smallest normal float keeps zero vectors at zero rather than NaN.
+						auto lengthSquared = Simd::MulAdd(rx, rx, Simd::MulAdd(ry, ry, Simd::Mul(rz, rz)));
+						auto length = Simd::Sqrt(Simd::Max(lengthSquared, Simd::Splat(std::numeric_limits<float>::min())));
+						auto scale = Simd::Div(Simd::Splat(1.0f), length);
+						rx = Simd::Mul(rx, scale);
+						ry = Simd::Mul(ry, scale);
+						rz = Simd::Mul(rz, scale);
+					}
+					auto rw = lastLane;
+					Simd::Transpose(rx, ry, rz, rw);
+					return std::array{ rx, ry, rz, rw };
+				};
+
+			auto i = begin;
+			for (; end - i >= 4; i += 4)
+			{
+				auto vectors = transform(i);
+				for (std::size_t lane = 0; lane < 4; ++lane)
+					Put<VMode>(out[i + lane], vectors[lane]);
+			}
+			// The columns are padded, so the last group can be read whole, but only its
+			// vectors are written.
+			if (i < end)
+			{
+				auto vectors = transform(i);
+				for (std::size_t lane = 0; lane < end - i; ++lane)
+					Put<StoreMode::Cached>(out[i + lane], vectors[lane]);
+			}
+		}
+
+		template<StoreMode VMode, typename TIndex>
+		void WriteInstanceTransforms(std::span<const Mat4> world, TIndex index, InstanceTransform* out, std::size_t begin, std::size_t end) noexcept
+		{
+			for (auto i = begin; i < end; ++i)
+			{
+				auto& m = world[index(i)];
+				auto r0 = Load(m[0]);
+				auto r1 = Load(m[1]);
+				auto r2 = Load(m[2]);
+				auto r3 = Load(m[3]);
+				Simd::Transpose(r0, r1, r2, r3);
+				Put<VMode>(out[i].Rows[0], r0);
+				Put<VMode>(out[i].Rows[1], r1);
+				Put<VMode>(out[i].Rows[2], r2);
+			}
+		}
+
+		// Runs run(mode, begin, end) over chunks of [0, count) across the pool, with the
+		// mode as a std::integral_constant so that the kernels are compiled for each. Each
+		// chunk fences its streaming stores, so that they're all done when this returns.
+		template<typename TRun>
+		void RunBatch(std::size_t count, StoreMode mode, ThreadPool& pool, TRun run)
+		{
+			pool.ParallelFor(count, BatchGrainSize,
+				[&](std::size_t begin, std::size_t end)
+				{
+					if (mode == StoreMode::Streaming)
+					{
+						run(std::integral_constant<StoreMode, StoreMode::Streaming>{}, begin, end);
+						Simd::StreamFence();
+					}
+					else
+						run(std::integral_constant<StoreMode, StoreMode::Cached>{}, begin, end);
+				});
+		}
+
+		inline void CheckOutputSize(std::size_t count, std::size_t outputSize)
+		{
+			if (outputSize < count)
+				throw RuntimeError{ std::format("Expected room for {} results, but the output only has {}", count, outputSize) };
+		}
+	}
+
+	// Writes m times each of the points, as a Vec4 with w = 1, to out[i]. Four points at a
+	// time, in chunks across the pool.
+	inline void TransformPoints(const Mat4& m, const Vec3Array& points, std::span<Vec4> out, StoreMode mode = StoreMode::Cached, ThreadPool& pool = GetThreadPool())
+	{
+		Detail::CheckOutputSize(points.Size(), out.size());
+		auto columns = std::array{ m[0], m[1], m[2], m[3] };
+		Detail::RunBatch(points.Size(), mode, pool,
+			[&](auto store, std::size_t begin, std::size_t end) { Detail::TransformVectors<decltype(store)::value, false>(columns, 1.0f, points, out.data(), begin, end); });
+	}
+
+	// Writes normalMatrix (see NormalMatrix()) times each of the normals, renormalised and
+	// with w = 0, to out[i]. Zero normals stay zero.
+	inline void TransformNormals(const Mat3& normalMatrix, const Vec3Array& normals, std::span<Vec4> out, StoreMode mode = StoreMode::Cached, ThreadPool& pool = GetThreadPool())
+	{
+		Detail::CheckOutputSize(normals.Size(), out.size());
+		auto columns = std::array{ normalMatrix[0], normalMatrix[1], normalMatrix[2], Vec4{} };
+		Detail::RunBatch(normals.Size(), mode, pool,
+			[&](auto store, std::size_t begin, std::size_t end) { Detail::TransformVectors<decltype(store)::value, true>(columns, 0.0f, normals, out.data(), begin, end); });
+	}
+
+	// Writes the InstanceTransform of world[i] to out[i].
+	inline void WriteInstances(std::span<const Mat4> world, std::span<InstanceTransform> out, StoreMode mode = StoreMode::Cached, ThreadPool& pool = GetThreadPool())
+	{
+		Detail::CheckOutputSize(world.size(), out.size());
+		Detail::RunBatch(world.size(), mode, pool,
+			[&](auto store, std::size_t begin, std::size_t end) { Detail::WriteInstanceTransforms<decltype(store)::value>(world, std::identity{}, out.data(), begin, end); });
+	}
+
+	// Writes the InstanceTransform of world[indices[i]] to out[i], such as for the objects
+	// a FrustumCuller found visible. The indices aren't checked.
+	inline void WriteInstances(std::span<const Mat4> world, std::span<const std::uint32_t> indices, std::span<InstanceTransform> out, StoreMode mode = StoreMode::Cached, ThreadPool& pool = GetThreadPool())
+	{
+		Detail::CheckOutputSize(indices.size(), out.size());
+		Detail::RunBatch(indices.size(), mode, pool,
+			[&](auto store, std::size_t begin, std::size_t end)
+			{
+				Detail::WriteInstanceTransforms<decltype(store)::value>(world, [&](std::size_t i) { return indices[i]; }, out.data(), begin, end);
+			});
+	}
+
+	// The references for the batch transforms, one at a time.
+	namespace Scalar
+	{
+		inline void TransformPoints(const Mat4& m, const Vec3Array& points, std::span<Vec4> out)
+		{
+			for (std::size_t i = 0; i < points.Size(); ++i)
+				out[i] = ToVec4(TransformPoint(m, points.Get(i)), 1.0f);
+		}
+
+		inline void TransformNormals(const Mat3& normalMatrix, const Vec3Array& normals, std::span<Vec4> out)
+		{
+			for (std::size_t i = 0; i < normals.Size(); ++i)
+				out[i] = ToVec4(Normalize(normalMatrix * normals.Get(i)), 0.0f);
+		}
+
+		inline void WriteInstances(std::span<const Mat4> world, std::span<const std::uint32_t> indices, std::span<InstanceTransform> out)
+		{
+			for (std::size_t i = 0; i < indices.size(); ++i)
+				out[i] = ToInstanceTransform(world[indices[i]]);
+		}
+	}
+
+	static_assert(ToInstanceTransform(Translation({ 1, 2, 3 })).Rows[0] == Vec4{ 1, 0, 0, 1 });
+	static_assert(ToInstanceTransform(Translation({ 1, 2, 3 })).Rows[2] == Vec4{ 0, 0, 1, 3 });
+	static_assert(ToInstanceTransform(Scaling({ 2, 3, 4 })).Rows[1] == Vec4{ 0, 3, 0, 0 });
+}
@@ -0,0 +1,208 @@
+export module dx3d:math.bounds;
+import std;
+import :math.simd;
+import :math.vec;
+import :math.mat;
+
+export namespace dx3d
+{
+	// An axis aligned box. Empty by default, with Min above Max, so that merging points
+	// into it grows it from nothing.
+	struct Aabb
+	{
+		Vec3 Min{ std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		Vec3 Max{ std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+
+		constexpr auto operator==(const Aabb&) const noexcept -> bool = default;
+	};
+
+	struct Sphere
+	{
+		Vec3 Center;
+		float Radius = 0;
+
+		constexpr auto operator==(const Sphere&) const noexcept -> bool = default;
+	};
+
+	static_assert(sizeof(Sphere) == 16);
+
+	// Distances along a ray are in multiples of Direction, which needn't be unit length.
+	struct Ray
+	{
+		Vec3 Origin;
+		Vec3 Direction{ 0, 0, 1 };
+	};
+
+	constexpr auto PointAt(const Ray& ray, float distance) noexcept -> Vec3
+	{
+		return ray.Origin + ray.Direction * distance;
+	}
+
+	constexpr auto FromCenterExtents(const Vec3& center, const Vec3& extents) noexcept -> Aabb
+	{
+		return { center - extents, center + extents };
+	}
+
+	constexpr auto IsEmpty(const Aabb& box) noexcept -> bool
+	{
+		return box.Min.x > box.Max.x or box.Min.y > box.Max.y or box.Min.z > box.Max.z;
+	}
+
+	constexpr auto Center(const Aabb& box) noexcept -> Vec3 { return (box.Min + box.Max) * 0.5f; }
+
+	// Half the size along each axis.
+	constexpr auto Extents(const Aabb& box) noexcept -> Vec3 { return (box.Max - box.Min) * 0.5f; }
+
+	constexpr auto SurfaceArea(const Aabb& box) noexcept -> float
+	{
+		if (IsEmpty(box))
+			return 0;
+		auto size = box.Max - box.Min;
+		return 2 * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	constexpr auto Merge(const Aabb& a, const Aabb& b) noexcept -> Aabb { return { Min(a.Min, b.Min), Max(a.Max, b.Max) }; }
+	constexpr auto Merge(const Aabb& box, const Vec3& point) noexcept -> Aabb { return { Min(box.Min, point), Max(box.Max, point) }; }
+
+	constexpr auto FromPoints(std::span<const Vec3> points) noexcept -> Aabb
+	{
+		auto box = Aabb{};
+		for (auto& point : points)
+			box = Merge(box, point);
+		return box;
+	}
+
+	constexpr auto Contains(const Aabb& box, const Vec3& point) noexcept -> bool
+	{
+		return box.Min.x <= point.x and point.x <= box.Max.x
+			and box.Min.y <= point.y and point.y <= box.Max.y
+			and box.Min.z <= point.z and point.z <= box.Max.z;
+	}
+
+	constexpr auto Contains(const Aabb& outer, const Aabb& inner) noexcept -> bool
+	{
+		return Contains(outer, inner.Min) and Contains(outer, inner.Max);
+	}
+
+	// Touching counts.
+	constexpr auto Intersects(const Aabb& a, const Aabb& b) noexcept -> bool
+	{
+		return a.Min.x <= b.Max.x and b.Min.x <= a.Max.x
+			and a.Min.y <= b.Max.y and b.Min.y <= a.Max.y
+			and a.Min.z <= b.Max.z and b.Min.z <= a.Max.z;
+	}
+
+	// How far along the ray it enters the box, or 0 if it starts inside, if that's no
+	// further than maxDistance (the slab test).
+	constexpr auto HitDistance(const Ray& ray, const Aabb& box, float maxDistance = std::numeric_limits<float>::infinity()) noexcept -> std::optional<float>
+	{
+		auto component = [](const Vec3& v, std::size_t axis) { return axis == 0 ? v.x : axis == 1 ? v.y : v.z; };
+		auto near = 0.0f;
+		auto far = maxDistance;
+		for (std::size_t axis = 0; axis < 3; ++axis)
+		{
+			auto origin = component(ray.Origin, axis);
+			auto direction = component(ray.Direction, axis);
+			auto min = component(box.Min, axis);
+			auto max = component(box.Max, axis);
+			if (direction == 0.0f)
+			{
+				// Parallel to the slab, so either always inside it or never.
+				if (origin < min or max < origin)
+					return std::nullopt;
+				continue;
+			}
+			auto t0 = (min - origin) / direction;
+			auto t1 = (max - origin) / direction;
+			near = std::max(near, std::min(t0, t1));
+			far = std::min(far, std::max(t0, t1));
+		}
+		return near <= far ? std::optional{ near } : std::nullopt;
+	}
+
+	namespace Scalar
+	{
+		constexpr auto Transform(const Aabb& box, const Mat4& m) noexcept -> Aabb
+		{
+			auto extents = Extents(box);
+			auto transformedExtents = Abs(ToVec3(m[0])) * extents.x + Abs(ToVec3(m[1])) * extents.y + Abs(ToVec3(m[2])) * extents.z;
+			return FromCenterExtents(TransformPoint(m, Center(box)), transformedExtents);
+		}
+	}
+
+	// The box around box after m, by transforming its centre and then its extents by the
+	// absolute values of m (Arvo's method), rather than all eight corners.
+	constexpr auto Transform(const Aabb& box, const Mat4& m) noexcept -> Aabb
+	{
+		if (IsEmpty(box))
+			return box;
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Transform(box, m);
+		auto center = Center(box);
+		auto extents = Extents(box);
+		auto c0 = Detail::Load(m[0]);
+		auto c1 = Detail::Load(m[1]);
+		auto c2 = Detail::Load(m[2]);
+		auto newCenter = Simd::MulAdd(c0, Simd::Splat(center.x), Detail::Load(m[3]));
+		newCenter = Simd::MulAdd(c1, Simd::Splat(center.y), newCenter);
+		newCenter = Simd::MulAdd(c2, Simd::Splat(center.z), newCenter);
+		auto newExtents = Simd::Mul(Simd::Abs(c0), Simd::Splat(extents.x));
+		newExtents = Simd::MulAdd(Simd::Abs(c1), Simd::Splat(extents.y), newExtents);
+		newExtents = Simd::MulAdd(Simd::Abs(c2), Simd::Splat(extents.z), newExtents);
+		auto min = Detail::ToVec4(Simd::Sub(newCenter, newExtents));
+		auto max = Detail::ToVec4(Simd::Add(newCenter, newExtents));
+		return { ToVec3(min), ToVec3(max) };
+	}
+
+	constexpr auto Contains(const Sphere& sphere, const Vec3& point) noexcept -> bool
+	{
+		return LengthSquared(point - sphere.Center) <= sphere.Radius * sphere.Radius;
+	}
+
+	constexpr auto Intersects(const Sphere& a, const Sphere& b) noexcept -> bool
+	{
+		auto radii = a.Radius + b.Radius;
+		return LengthSquared(a.Center - b.Center) <= radii * radii;
+	}
+
+	constexpr auto Intersects(const Sphere& sphere, const Aabb& box) noexcept -> bool
+	{
+		auto closest = Min(Max(sphere.Center, box.Min), box.Max);
+		return Contains(sphere, closest);
+	}
+
+	// Scales the radius by the largest axis scale in m, so non-uniform scaling gives a
+	// sphere that's larger than it needs to be rather than one that's too small.
+	constexpr auto Transform(const Sphere& sphere, const Mat4& m) noexcept -> Sphere
+	{
+		auto scaleSquared = std::max({ LengthSquared(ToVec3(m[0])), LengthSquared(ToVec3(m[1])), LengthSquared(ToVec3(m[2])) });
+		return { TransformPoint(m, sphere.Center), sphere.Radius * Detail::Sqrt(scaleSquared) };
+	}
+
+	// The sphere through the box's corners.
+	constexpr auto ToSphere(const Aabb& box) noexcept -> Sphere
+	{
+		return { Center(box), Length(Extents(box)) };
+	}
+
+	constexpr auto ToAabb(const Sphere& sphere) noexcept -> Aabb
+	{
+		return FromCenterExtents(sphere.Center, { sphere.Radius, sphere.Radius, sphere.Radius });
+	}
+
+	static_assert(IsEmpty(Aabb{}) and SurfaceArea(Aabb{}) == 0);
+	static_assert(Merge(Merge(Aabb{}, Vec3{ 1, 2, 3 }), Vec3{ -1, 0, 5 }) == Aabb{ { -1, 0, 3 }, { 1, 2, 5 } });
+	static_assert(SurfaceArea(Aabb{ { 0, 0, 0 }, { 1, 2, 3 } }) == 22.0f);
+	static_assert(Intersects(Aabb{ { 0, 0, 0 }, { 1, 1, 1 } }, Aabb{ { 1, 1, 1 }, { 2, 2, 2 } }));
+	static_assert(not Intersects(Aabb{ { 0, 0, 0 }, { 1, 1, 1 } }, Aabb{ { 1, 1, 1.5f }, { 2, 2, 2 } }));
+	static_assert(Transform(Aabb{ { -1, -1, -1 }, { 1, 1, 1 } }, Translation({ 1, 2, 3 }) * Scaling({ 2, 1, 1 })) == Aabb{ { -1, 1, 2 }, { 3, 3, 4 } });
+	static_assert(Transform(Aabb{ { 0, 0, 0 }, { 2, 1, 1 } }, Mat4{ { Vec4{ 0, 1, 0, 0 }, Vec4{ -1, 0, 0, 0 }, Vec4{ 0, 0, 1, 0 }, Vec4{ 0, 0, 0, 1 } } }) == Aabb{ { -1, 0, 0 }, { 0, 2, 1 } });
+	static_assert(Intersects(Sphere{ { 0, 0, 0 }, 1 }, Aabb{ { 1, 0, 0 }, { 2, 1, 1 } }));
+	static_assert(HitDistance(Ray{ { 0, 0, -5 }, { 0, 0, 1 } }, Aabb{ { -1, -1, -1 }, { 1, 1, 1 } }) == 4.0f);
+	static_assert(HitDistance(Ray{ { 0, 0, 0 }, { 1, 2, 3 } }, Aabb{ { -1, -1, -1 }, { 1, 1, 1 } }) == 0.0f);
+	static_assert(not HitDistance(Ray{ { 0, 0, -5 }, { 0, 0, 1 } }, Aabb{ { -1, -1, -1 }, { 1, 1, 1 } }, 3.0f));
+	static_assert(not HitDistance(Ray{ { 0, 2, -5 }, { 0, 0, 1 } }, Aabb{ { -1, -1, -1 }, { 1, 1, 1 } }));
+	static_assert(not HitDistance(Ray{ { 0, 0, 5 }, { 0, 0, 1 } }, Aabb{ { -1, -1, -1 }, { 1, 1, 1 } }));
+	static_assert(not Intersects(Sphere{ { 0, 0, 0 }, 1 }, Aabb{ { 1, 1, 0 }, { 2, 2, 1 } }));
+	static_assert(Transform(Sphere{ { 1, 0, 0 }, 1 }, Scaling({ 1, 3, 2 })) == Sphere{ { 1, 0, 0 }, 3 });
+}
@@ -0,0 +1,81 @@
+export module dx3d:math.frustum;
+import std;
+import :math.vec;
+import :math.mat;
+import :math.bounds;
+
+export namespace dx3d
+{
+	// The points p with Dot(Normal, p) + Distance >= 0 are on the inside. Normal is unit
+	// length, so that's also the signed distance to the plane.
+	struct Plane
+	{
+		Vec3 Normal;
+		float Distance = 0;
+
+		constexpr auto operator==(const Plane&) const noexcept -> bool = default;
+	};
+
+	constexpr auto SignedDistance(const Plane& plane, const Vec3& point) noexcept -> float
+	{
+		return Dot(plane.Normal, point) + plane.Distance;
+	}
+
+	constexpr auto Normalize(const Plane& plane) noexcept -> Plane
+	{
+		auto length = Length(plane.Normal);
+		return length > 0.0f ? Plane{ plane.Normal / length, plane.Distance / length } : plane;
+	}
+
+	// Left, right, bottom, top, near and far, facing inwards.
+	struct Frustum
+	{
+		std::array<Plane, 6> Planes;
+	};
+
+	// The frustum of a view-projection matrix, in the space the matrix transforms from, for
+	// D3D's clip space of -w <= x, y <= w and 0 <= z <= w (Gribb and Hartmann).
+	constexpr auto FromViewProjection(const Mat4& viewProjection) noexcept -> Frustum
+	{
+		auto plane = [](const Vec4& v) { return Normalize(Plane{ ToVec3(v), v.w }); };
+		// The rows of the matrix are the columns of its transpose.
+		auto rows = Transpose(viewProjection);
+		auto &x = rows[0], &y = rows[1], &z = rows[2], &w = rows[3];
+		return { { plane(w + x), plane(w - x), plane(w + y), plane(w - y), plane(z), plane(w - z) } };
+	}
+
+	// Conservative: a sphere outside the frustum near one of its corners may still count
+	// as intersecting it. That's the usual trade for culling, which only needs to reject.
+	constexpr auto Intersects(const Frustum& frustum, const Sphere& sphere) noexcept -> bool
+	{
+		for (auto& plane : frustum.Planes)
+			if (SignedDistance(plane, sphere.Center) < -sphere.Radius)
+				return false;
+		return true;
+	}
+
+	// Conservative in the same way.
+	constexpr auto Intersects(const Frustum& frustum, const Aabb& box) noexcept -> bool
+	{
+		auto center = Center(box);
+		auto extents = Extents(box);
+		for (auto& plane : frustum.Planes)
+			if (SignedDistance(plane, center) < -Dot(Abs(plane.Normal), extents))
+				return false;
+		return true;
+	}
+}
+
+namespace
+{
+	// The box from x = -2 to 2, y = -1 to 1 and z = 1 to 11.
+	constexpr auto TestFrustum = dx3d::FromViewProjection(dx3d::OrthographicLH(4, 2, 1, 11));
+	static_assert(TestFrustum.Planes[0] == dx3d::Plane{ { 1, 0, 0 }, 2 });
+	static_assert(TestFrustum.Planes[4] == dx3d::Plane{ { 0, 0, 1 }, -1 });
+	static_assert(dx3d::Intersects(TestFrustum, dx3d::Sphere{ { 0, 0, 5 }, 0.5f }));
+	static_assert(dx3d::Intersects(TestFrustum, dx3d::Sphere{ { 2.4f, 0, 5 }, 0.5f }));
+	static_assert(not dx3d::Intersects(TestFrustum, dx3d::Sphere{ { 2.6f, 0, 5 }, 0.5f }));
+	static_assert(not dx3d::Intersects(TestFrustum, dx3d::Sphere{ { 0, 0, 12 }, 0.5f }));
+	static_assert(dx3d::Intersects(TestFrustum, dx3d::Aabb{ { 1.5f, 0.5f, 0 }, { 3, 3, 2 } }));
+	static_assert(not dx3d::Intersects(TestFrustum, dx3d::Aabb{ { -1, -1, -3 }, { 1, 1, 0.5f } }));
+}
@@ -0,0 +1,340 @@
+export module dx3d:math.mat;
+import std;
+import :math.simd;
+import :math.vec;
+
+export namespace dx3d
+{
+	// Matrices are column major and used with column vectors, so v' = M * v and the
+	// transform applied first is the rightmost. That's how HLSL packs a float4x4 in a
+	// constant buffer by default and how mul(M, v) reads it, so a Mat4 is copied into a
+	// cbuffer as it is, without transposing.
+	struct Mat4
+	{
+		std::array<Vec4, 4> Columns{ Vec4{ 1, 0, 0, 0 }, Vec4{ 0, 1, 0, 0 }, Vec4{ 0, 0, 1, 0 }, Vec4{ 0, 0, 0, 1 } };
+
+		static constexpr auto Identity() noexcept -> Mat4
+		{
+			return {};
+		}
+
+		constexpr auto operator[](this auto&& self, std::size_t column) noexcept -> auto&
+		{
+			return self.Columns[column];
+		}
+
+		constexpr auto Data() const noexcept -> const float*
+		{
+			return Columns[0].Data();
+		}
+
+		constexpr auto operator==(const Mat4&) const noexcept -> bool = default;
+	};
+
+	// A float3x3 in a constant buffer takes three registers, with the fourth lane of each
+	// left unused, so that's how it's stored here too: Columns[i].w is always zero.
+	struct Mat3
+	{
+		std::array<Vec4, 3> Columns{ Vec4{ 1, 0, 0, 0 }, Vec4{ 0, 1, 0, 0 }, Vec4{ 0, 0, 1, 0 } };
+
+		static constexpr auto Identity() noexcept -> Mat3
+		{
+			return {};
+		}
+
+		constexpr auto operator[](this auto&& self, std::size_t column) noexcept -> auto&
+		{
+			return self.Columns[column];
+		}
+
+		constexpr auto Data() const noexcept -> const float*
+		{
+			return Columns[0].Data();
+		}
+
+		constexpr auto operator==(const Mat3&) const noexcept -> bool = default;
+	};
+
+	static_assert(sizeof(Mat4) == 64 and alignof(Mat4) == 16);
+	static_assert(sizeof(Mat3) == 48);
+
+	namespace Scalar
+	{
+		constexpr auto Multiply(const Mat4& m, const Vec4& v) noexcept -> Vec4
+		{
+			return {
+				m[0].x * v.x + m[1].x * v.y + m[2].x * v.z + m[3].x * v.w,
+				m[0].y * v.x + m[1].y * v.y + m[2].y * v.z + m[3].y * v.w,
+				m[0].z * v.x + m[1].z * v.y + m[2].z * v.z + m[3].z * v.w,
+				m[0].w * v.x + m[1].w * v.y + m[2].w * v.z + m[3].w * v.w
+			};
+		}
+
+		constexpr auto Multiply(const Mat4& a, const Mat4& b) noexcept -> Mat4
+		{
+			return { { Multiply(a, b[0]), Multiply(a, b[1]), Multiply(a, b[2]), Multiply(a, b[3]) } };
+		}
+
+		constexpr auto Transpose(const Mat4& m) noexcept -> Mat4
+		{
+			return { {
+				Vec4{ m[0].x, m[1].x, m[2].x, m[3].x },
+				Vec4{ m[0].y, m[1].y, m[2].y, m[3].y },
+				Vec4{ m[0].z, m[1].z, m[2].z, m[3].z },
+				Vec4{ m[0].w, m[1].w, m[2].w, m[3].w }
+			} };
+		}
+	}
+
+	constexpr auto operator*(const Mat4& m, const Vec4& v) noexcept -> Vec4
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Multiply(m, v);
+		auto lanes = Detail::Load(v);
+		auto result = Simd::Mul(Detail::Load(m[0]), Simd::Broadcast<0>(lanes));
+		result = Simd::MulAdd(Detail::Load(m[1]), Simd::Broadcast<1>(lanes), result);
+		result = Simd::MulAdd(Detail::Load(m[2]), Simd::Broadcast<2>(lanes), result);
+		result = Simd::MulAdd(Detail::Load(m[3]), Simd::Broadcast<3>(lanes), result);
+		return Detail::ToVec4(result);
+	}
+
+	constexpr auto operator*(const Mat4& a, const Mat4& b) noexcept -> Mat4
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Multiply(a, b);
+		auto a0 = Detail::Load(a[0]);
+		auto a1 = Detail::Load(a[1]);
+		auto a2 = Detail::Load(a[2]);
+		auto a3 = Detail::Load(a[3]);
+		auto column =
+			[&](const Vec4& v)
+			{
+				auto lanes = Detail::Load(v);
+				auto sum = Simd::Mul(a0, Simd::Broadcast<0>(lanes));
+				sum = Simd::MulAdd(a1, Simd::Broadcast<1>(lanes), sum);
+				sum = Simd::MulAdd(a2, Simd::Broadcast<2>(lanes), sum);
+				return Detail::ToVec4(Simd::MulAdd(a3, Simd::Broadcast<3>(lanes), sum));
+			};
+		return { { column(b[0]), column(b[1]), column(b[2]), column(b[3]) } };
+	}
+
+	constexpr auto operator*=(Mat4& a, const Mat4& b) noexcept -> Mat4& { return a = a * b; }
+
+	constexpr auto Transpose(const Mat4& m) noexcept -> Mat4
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Transpose(m);
+		auto c0 = Detail::Load(m[0]);
+		auto c1 = Detail::Load(m[1]);
+		auto c2 = Detail::Load(m[2]);
+		auto c3 = Detail::Load(m[3]);
+		Simd::Transpose(c0, c1, c2, c3);
+		return { { Detail::ToVec4(c0), Detail::ToVec4(c1), Detail::ToVec4(c2), Detail::ToVec4(c3) } };
+	}
+
+	// For affine transforms; there's no divide by w.
+	constexpr auto TransformPoint(const Mat4& m, const Vec3& point) noexcept -> Vec3 { return ToVec3(m * ToVec4(point, 1.0f)); }
+	constexpr auto TransformVector(const Mat4& m, const Vec3& vector) noexcept -> Vec3 { return ToVec3(m * ToVec4(vector, 0.0f)); }
+
+	constexpr auto Determinant(const Mat4& m) noexcept -> float
+	{
+		auto s0 = m[0].x * m[1].y - m[1].x * m[0].y;
+		auto s1 = m[0].x * m[2].y - m[2].x * m[0].y;
+		auto s2 = m[0].x * m[3].y - m[3].x * m[0].y;
+		auto s3 = m[1].x * m[2].y - m[2].x * m[1].y;
+		auto s4 = m[1].x * m[3].y - m[3].x * m[1].y;
+		auto s5 = m[2].x * m[3].y - m[3].x * m[2].y;
+		auto c5 = m[2].z * m[3].w - m[3].z * m[2].w;
+		auto c4 = m[1].z * m[3].w - m[3].z * m[1].w;
+		auto c3 = m[1].z * m[2].w - m[2].z * m[1].w;
+		auto c2 = m[0].z * m[3].w - m[3].z * m[0].w;
+		auto c1 = m[0].z * m[2].w - m[2].z * m[0].w;
+		auto c0 = m[0].z * m[1].w - m[1].z * m[0].w;
+		return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	}
+
+	// Empty if m is singular. Uses the 2x2 sub-determinants of the top and bottom two rows.
+	constexpr auto Inverse(const Mat4& m) noexcept -> std::optional<Mat4>
+	{
+		auto s0 = m[0].x * m[1].y - m[1].x * m[0].y;
+		auto s1 = m[0].x * m[2].y - m[2].x * m[0].y;
+		auto s2 = m[0].x * m[3].y - m[3].x * m[0].y;
+		auto s3 = m[1].x * m[2].y - m[2].x * m[1].y;
+		auto s4 = m[1].x * m[3].y - m[3].x * m[1].y;
+		auto s5 = m[2].x * m[3].y - m[3].x * m[2].y;
+		auto c5 = m[2].z * m[3].w - m[3].z * m[2].w;
+		auto c4 = m[1].z * m[3].w - m[3].z * m[1].w;
+		auto c3 = m[1].z * m[2].w - m[2].z * m[1].w;
+		auto c2 = m[0].z * m[3].w - m[3].z * m[0].w;
+		auto c1 = m[0].z * m[2].w - m[2].z * m[0].w;
+		auto c0 = m[0].z * m[1].w - m[1].z * m[0].w;
+		auto determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+		if (determinant == 0.0f)
+			return std::nullopt;
+		auto scale = 1.0f / determinant;
+
+		// The transposed cofactors, each built from one s and one c term.
+		auto inverse = Mat4{};
+		inverse[0].x = (m[1].y * c5 - m[2].y * c4 + m[3].y * c3) * scale;
+		inverse[1].x = (-m[1].x * c5 + m[2].x * c4 - m[3].x * c3) * scale;
+		inverse[2].x = (m[1].w * s5 - m[2].w * s4 + m[3].w * s3) * scale;
+		inverse[3].x = (-m[1].z * s5 + m[2].z * s4 - m[3].z * s3) * scale;
+
+		inverse[0].y = (-m[0].y * c5 + m[2].y * c2 - m[3].y * c1) * scale;
+		inverse[1].y = (m[0].x * c5 - m[2].x * c2 + m[3].x * c1) * scale;
+		inverse[2].y = (-m[0].w * s5 + m[2].w * s2 - m[3].w * s1) * scale;
+		inverse[3].y = (m[0].z * s5 - m[2].z * s2 + m[3].z * s1) * scale;
+
+		inverse[0].z = (m[0].y * c4 - m[1].y * c2 + m[3].y * c0) * scale;
+		inverse[1].z = (-m[0].x * c4 + m[1].x * c2 - m[3].x * c0) * scale;
+		inverse[2].z = (m[0].w * s4 - m[1].w * s2 + m[3].w * s0) * scale;
+		inverse[3].z = (-m[0].z * s4 + m[1].z * s2 - m[3].z * s0) * scale;
+
+		inverse[0].w = (-m[0].y * c3 + m[1].y * c1 - m[2].y * c0) * scale;
+		inverse[1].w = (m[0].x * c3 - m[1].x * c1 + m[2].x * c0) * scale;
+		inverse[2].w = (-m[0].w * s3 + m[1].w * s1 - m[2].w * s0) * scale;
+		inverse[3].w = (m[0].z * s3 - m[1].z * s1 + m[2].z * s0) * scale;
+		return inverse;
+	}
+
+	constexpr auto Translation(const Vec3& offset) noexcept -> Mat4
+	{
+		auto m = Mat4{};
+		m[3] = ToVec4(offset, 1.0f);
+		return m;
+	}
+
+	constexpr auto Scaling(const Vec3& scale) noexcept -> Mat4
+	{
+		return { { Vec4{ scale.x, 0, 0, 0 }, Vec4{ 0, scale.y, 0, 0 }, Vec4{ 0, 0, scale.z, 0 }, Vec4{ 0, 0, 0, 1 } } };
+	}
+
+	// Rotations are clockwise when looking down the axis towards the origin in D3D's left
+	// handed space, as with DirectXMath.
+	inline auto RotationX(float radians) noexcept -> Mat4
+	{
+		auto c = std::cos(radians);
+		auto s = std::sin(radians);
+		return { { Vec4{ 1, 0, 0, 0 }, Vec4{ 0, c, s, 0 }, Vec4{ 0, -s, c, 0 }, Vec4{ 0, 0, 0, 1 } } };
+	}
+
+	inline auto RotationY(float radians) noexcept -> Mat4
+	{
+		auto c = std::cos(radians);
+		auto s = std::sin(radians);
+		return { { Vec4{ c, 0, -s, 0 }, Vec4{ 0, 1, 0, 0 }, Vec4{ s, 0, c, 0 }, Vec4{ 0, 0, 0, 1 } } };
+	}
+
+	inline auto RotationZ(float radians) noexcept -> Mat4
+	{
+		auto c = std::cos(radians);
+		auto s = std::sin(radians);
+		return { { Vec4{ c, s, 0, 0 }, Vec4{ -s, c, 0, 0 }, Vec4{ 0, 0, 1, 0 }, Vec4{ 0, 0, 0, 1 } } };
+	}
+
+	// A left handed view matrix, looking along +z.
+	constexpr auto LookAtLH(const Vec3& eye, const Vec3& target, const Vec3& up) noexcept -> Mat4
+	{
+		auto zAxis = Normalize(target - eye);
+		auto xAxis = Normalize(Cross(up, zAxis));
+		auto yAxis = Cross(zAxis, xAxis);
+		return { {
+			Vec4{ xAxis.x, yAxis.x, zAxis.x, 0 },
+			Vec4{ xAxis.y, yAxis.y, zAxis.y, 0 },
+			Vec4{ xAxis.z, yAxis.z, zAxis.z, 0 },
+			Vec4{ -Dot(xAxis, eye), -Dot(yAxis, eye), -Dot(zAxis, eye), 1 }
+		} };
+	}
+
+	// Maps depth from nearZ to farZ onto 0 to 1, as D3D expects.
+	inline auto PerspectiveFovLH(float fovYRadians, float aspectRatio, float nearZ, float farZ) noexcept -> Mat4
+	{
+		auto yScale = 1.0f / std::tan(fovYRadians * 0.5f);
+		auto xScale = yScale / aspectRatio;
+		auto range = farZ / (farZ - nearZ);
+		return { { Vec4{ xScale, 0, 0, 0 }, Vec4{ 0, yScale, 0, 0 }, Vec4{ 0, 0, range, 1 }, Vec4{ 0, 0, -nearZ * range, 0 } } };
+	}
+
+	constexpr auto OrthographicLH(float width, float height, float nearZ, float farZ) noexcept -> Mat4
+	{
+		auto range = 1.0f / (farZ - nearZ);
+		return { { Vec4{ 2.0f / width, 0, 0, 0 }, Vec4{ 0, 2.0f / height, 0, 0 }, Vec4{ 0, 0, range, 0 }, Vec4{ 0, 0, -nearZ * range, 1 } } };
+	}
+
+	// Mat3
+
+	constexpr auto operator*(const Mat3& m, const Vec3& v) noexcept -> Vec3
+	{
+		return ToVec3(m[0]) * v.x + ToVec3(m[1]) * v.y + ToVec3(m[2]) * v.z;
+	}
+
+	constexpr auto operator*(const Mat3& a, const Mat3& b) noexcept -> Mat3
+	{
+		return { { ToVec4(a * ToVec3(b[0]), 0), ToVec4(a * ToVec3(b[1]), 0), ToVec4(a * ToVec3(b[2]), 0) } };
+	}
+
+	constexpr auto Transpose(const Mat3& m) noexcept -> Mat3
+	{
+		return { { Vec4{ m[0].x, m[1].x, m[2].x, 0 }, Vec4{ m[0].y, m[1].y, m[2].y, 0 }, Vec4{ m[0].z, m[1].z, m[2].z, 0 } } };
+	}
+
+	constexpr auto Determinant(const Mat3& m) noexcept -> float
+	{
+		return Dot(ToVec3(m[0]), Cross(ToVec3(m[1]), ToVec3(m[2])));
+	}
+
+	// Empty if m is singular.
+	constexpr auto Inverse(const Mat3& m) noexcept -> std::optional<Mat3>
+	{
+		auto a = ToVec3(m[0]);
+		auto b = ToVec3(m[1]);
+		auto c = ToVec3(m[2]);
+		auto bc = Cross(b, c);
+		auto determinant = Dot(a, bc);
+		if (determinant == 0.0f)
+			return std::nullopt;
+		auto scale = 1.0f / determinant;
+		// The rows of the inverse are the cross products of pairs of columns.
+		return Transpose(Mat3{ { ToVec4(bc * scale, 0), ToVec4(Cross(c, a) * scale, 0), ToVec4(Cross(a, b) * scale, 0) } });
+	}
+
+	// The upper left 3x3 of m.
+	constexpr auto ToMat3(const Mat4& m) noexcept -> Mat3
+	{
+		return { { ToVec4(ToVec3(m[0]), 0), ToVec4(ToVec3(m[1]), 0), ToVec4(ToVec3(m[2]), 0) } };
+	}
+
+	// Transforms normals by m, the inverse transpose of its upper left 3x3. Empty if that's
+	// singular.
+	constexpr auto NormalMatrix(const Mat4& m) noexcept -> std::optional<Mat3>
+	{
+		return Inverse(ToMat3(m)).transform([](const Mat3& inverse) { return Transpose(inverse); });
+	}
+
+	static_assert(Translation({ 1, 2, 3 }) * Vec4{ 1, 1, 1, 1 } == Vec4{ 2, 3, 4, 1 });
+	static_assert(Translation({ 1, 2, 3 }) * Scaling({ 2, 2, 2 }) * Vec4{ 1, 1, 1, 1 } == Vec4{ 3, 4, 5, 1 });
+	static_assert(Scaling({ 2, 2, 2 }) * Translation({ 1, 2, 3 }) * Vec4{ 1, 1, 1, 1 } == Vec4{ 4, 6, 8, 1 });
+	static_assert(Transpose(Transpose(Translation({ 1, 2, 3 }))) == Translation({ 1, 2, 3 }));
+	static_assert(Inverse(Translation({ 1, 2, 3 }) * Scaling({ 2, 4, 8 })) == Scaling({ 0.5f, 0.25f, 0.125f }) * Translation({ -1, -2, -3 }));
+	static_assert(not Inverse(Scaling({ 1, 0, 1 })));
+	static_assert(Determinant(Scaling({ 2, 3, 4 })) == 24.0f);
+	static_assert(Inverse(ToMat3(Scaling({ 2, 4, 8 }))) == ToMat3(Scaling({ 0.5f, 0.25f, 0.125f })));
+	static_assert(TransformPoint(LookAtLH({ 0, 0, -5 }, { 0, 0, 0 }, { 0, 1, 0 }), { 1, 2, 0 }) == Vec3{ 1, 2, 5 });
+	static_assert(TransformVector(Translation({ 1, 2, 3 }), { 1, 0, 0 }) == Vec3{ 1, 0, 0 });
+}
+
+namespace
+{
+	// Packs the same as the HLSL
+	//   cbuffer Constants { float4x4 World; float3 Color; float Alpha; float2 Uv; float4 Tint; };
+	// in which Tint doesn't fit after Uv, so starts a new register.
+	struct ExampleConstants
+	{
+		dx3d::Mat4 World;
+		dx3d::Vec3 Color;
+		float Alpha;
+		dx3d::Vec2 Uv;
+		dx3d::Vec4 Tint;
+	};
+	static_assert(sizeof(ExampleConstants) == 112);
+}
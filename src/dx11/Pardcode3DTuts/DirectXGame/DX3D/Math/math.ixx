@@ -1,3 +1,9 @@
 export module dx3d:math;
+export import :math.simd;
+export import :math.vec;
+export import :math.mat;
+export import :math.quat;
+export import :math.bounds;
+export import :math.frustum;
 export import :math.rect;
-export import :math.vec4;
+export import :math.batch;
@@ -0,0 +1,130 @@
+export module dx3d:math.quat;
+import std;
+import :math.vec;
+import :math.mat;
+
+export namespace dx3d
+{
+	// A rotation, as a unit quaternion. Laid out as a float4, with the scalar part in w.
+	// Products compose the same way as matrices: (a * b) rotates by b and then by a.
+	// Normalising, dot products and blending go through Vec4, so they use SIMD; the
+	// product and rotating a vector need more shuffling than they save and stay scalar.
+	struct alignas(16) Quat
+	{
+		float x{};
+		float y{};
+		float z{};
+		float w{ 1 };
+
+		static constexpr auto Identity() noexcept -> Quat
+		{
+			return {};
+		}
+
+		constexpr auto operator==(const Quat&) const noexcept -> bool = default;
+	};
+
+	static_assert(sizeof(Quat) == 16);
+
+	namespace Detail
+	{
+		constexpr auto ToVec4(const Quat& q) noexcept -> Vec4 { return { q.x, q.y, q.z, q.w }; }
+		constexpr auto ToQuat(const Vec4& v) noexcept -> Quat { return { v.x, v.y, v.z, v.w }; }
+	}
+
+	// axis must be normalised.
+	inline auto FromAxisAngle(const Vec3& axis, float radians) noexcept -> Quat
+	{
+		auto s = std::sin(radians * 0.5f);
+		return { axis.x * s, axis.y * s, axis.z * s, std::cos(radians * 0.5f) };
+	}
+
+	constexpr auto operator*(const Quat& a, const Quat& b) noexcept -> Quat
+	{
+		return {
+			a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+			a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+			a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+			a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z
+		};
+	}
+
+	constexpr auto operator*=(Quat& a, const Quat& b) noexcept -> Quat& { return a = a * b; }
+
+	constexpr auto Dot(const Quat& a, const Quat& b) noexcept -> float { return Dot(Detail::ToVec4(a), Detail::ToVec4(b)); }
+	constexpr auto Conjugate(const Quat& q) noexcept -> Quat { return { -q.x, -q.y, -q.z, q.w }; }
+	constexpr auto Normalize(const Quat& q) noexcept -> Quat { return Detail::ToQuat(Normalize(Detail::ToVec4(q))); }
+
+	// The conjugate for unit quaternions; this also handles ones that have drifted.
+	constexpr auto Inverse(const Quat& q) noexcept -> Quat
+	{
+		auto conjugate = Detail::ToVec4(Conjugate(q));
+		return Detail::ToQuat(conjugate / Dot(q, q));
+	}
+
+	constexpr auto Rotate(const Quat& q, const Vec3& v) noexcept -> Vec3
+	{
+		auto axis = Vec3{ q.x, q.y, q.z };
+		auto t = Cross(axis, v) * 2.0f;
+		return v + t * q.w + Cross(axis, t);
+	}
+
+	// Normalised linear blend along the shorter arc. Close enough to Slerp() for small
+	// angles, such as between animation keys, and much cheaper.
+	constexpr auto Nlerp(const Quat& a, const Quat& b, float t) noexcept -> Quat
+	{
+		auto to = Detail::ToVec4(b);
+		if (Dot(a, b) < 0.0f)
+			to = -to;
+		return Detail::ToQuat(Normalize(Lerp(Detail::ToVec4(a), to, t)));
+	}
+
+	inline auto Slerp(const Quat& a, const Quat& b, float t) noexcept -> Quat
+	{
+		auto to = Detail::ToVec4(b);
+		auto cosAngle = Dot(a, b);
+		if (cosAngle < 0.0f)
+		{
+			to = -to;
+			cosAngle = -cosAngle;
+		}
+		// Nearly parallel, where sin(angle) loses precision.
+		if (cosAngle > 0.9995f)
+			return Nlerp(a, Detail::ToQuat(to), t);
+		auto angle = std::acos(cosAngle);
+		auto sinAngle = std::sin(angle);
+		auto from = Detail::ToVec4(a) * (std::sin((1.0f - t) * angle) / sinAngle);
+		return Detail::ToQuat(from + to * (std::sin(t * angle) / sinAngle));
+	}
+
+	constexpr auto ToMat3(const Quat& q) noexcept -> Mat3
+	{
+		auto xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		auto xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		auto wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+		return { {
+			Vec4{ 1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0 },
+			Vec4{ 2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0 },
+			Vec4{ 2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0 }
+		} };
+	}
+
+	constexpr auto Rotation(const Quat& q) noexcept -> Mat4
+	{
+		auto m = ToMat3(q);
+		return { { m[0], m[1], m[2], Vec4{ 0, 0, 0, 1 } } };
+	}
+
+	// Scales, then rotates, then translates.
+	constexpr auto Compose(const Vec3& translation, const Quat& rotation, const Vec3& scale) noexcept -> Mat4
+	{
+		auto m = ToMat3(rotation);
+		return { { m[0] * scale.x, m[1] * scale.y, m[2] * scale.z, ToVec4(translation, 1.0f) } };
+	}
+
+	static_assert(Rotation(Quat::Identity()) == Mat4::Identity());
+	static_assert(Rotate(Quat{ 0, 0, 1, 0 }, Vec3{ 1, 2, 3 }) == Vec3{ -1, -2, 3 });
+	static_assert(Rotate(Quat{ 1, 0, 0, 0 } * Quat{ 0, 1, 0, 0 }, Vec3{ 1, 2, 3 }) == Vec3{ -1, -2, 3 });
+	static_assert(Conjugate(Quat{ 1, 2, 3, 4 }) * Quat{ 1, 2, 3, 4 } == Quat{ 0, 0, 0, 30 });
+	static_assert(Compose({ 1, 2, 3 }, Quat::Identity(), { 2, 2, 2 }) == Translation({ 1, 2, 3 }) * Scaling({ 2, 2, 2 }));
+}
@@ -0,0 +1,351 @@
+module;
+
+// Define DX3D_MATH_SCALAR to build the math without SIMD.
+#if not defined(DX3D_MATH_SCALAR)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#if defined(__AVX512F__)
+#define DX3D_MATH_AVX512
+#endif
+#define DX3D_MATH_AVX2
+#define DX3D_MATH_SSE
+// /arch:AVX2 implies FMA on MSVC; GCC and Clang want -mfma as well.
+#if defined(__FMA__) || defined(_MSC_VER)
+#define DX3D_MATH_FMA
+#endif
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DX3D_MATH_SSE
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DX3D_MATH_NEON
+#endif
+#endif
+
+export module dx3d:math.simd;
+import std;
+
+// A thin layer over four float lanes, so that the math above it is written once for
+// SSE, AVX2 (which adds fused multiply-add) and NEON. The scalar build keeps the same
+// interface over a plain array. Loops over arrays of floats can also use eight lanes
+// with AVX2 and sixteen with AVX-512, through Wide<>.
+export namespace dx3d::Simd
+{
+	enum class Level
+	{
+		Scalar,
+		Sse2,
+		Avx2,
+		Neon,
+		Avx512
+	};
+
+	// The instruction set the math was built for.
+	constexpr auto ActiveLevel =
+#if defined(DX3D_MATH_AVX512)
+		Level::Avx512;
+#elif defined(DX3D_MATH_AVX2)
+		Level::Avx2;
+#elif defined(DX3D_MATH_SSE)
+		Level::Sse2;
+#elif defined(DX3D_MATH_NEON)
+		Level::Neon;
+#else
+		Level::Scalar;
+#endif
+
+	constexpr auto Enabled = ActiveLevel != Level::Scalar;
+
+#if defined(DX3D_MATH_SSE)
+	using Float4 = __m128;
+
+	inline auto Load(const float* values) noexcept -> Float4 { return _mm_loadu_ps(values); }
+	inline void Store(float* values, Float4 v) noexcept { _mm_storeu_ps(values, v); }
+	// A store that bypasses the caches, for memory that won't be read back soon, such as a
+	// mapped upload buffer. values must be 16 byte aligned. Streamed stores aren't ordered
+	// with other stores; StreamFence() orders them before the ones after it.
+	inline void StoreStream(float* values, Float4 v) noexcept { _mm_stream_ps(values, v); }
+	inline void StreamFence() noexcept { _mm_sfence(); }
+	inline auto Set(float x, float y, float z, float w) noexcept -> Float4 { return _mm_setr_ps(x, y, z, w); }
+	inline auto Splat(float value) noexcept -> Float4 { return _mm_set1_ps(value); }
+	inline auto Add(Float4 a, Float4 b) noexcept -> Float4 { return _mm_add_ps(a, b); }
+	inline auto Sub(Float4 a, Float4 b) noexcept -> Float4 { return _mm_sub_ps(a, b); }
+	inline auto Mul(Float4 a, Float4 b) noexcept -> Float4 { return _mm_mul_ps(a, b); }
+	inline auto Div(Float4 a, Float4 b) noexcept -> Float4 { return _mm_div_ps(a, b); }
+	inline auto Min(Float4 a, Float4 b) noexcept -> Float4 { return _mm_min_ps(a, b); }
+	inline auto Max(Float4 a, Float4 b) noexcept -> Float4 { return _mm_max_ps(a, b); }
+	inline auto Sqrt(Float4 v) noexcept -> Float4 { return _mm_sqrt_ps(v); }
+	inline auto Abs(Float4 v) noexcept -> Float4 { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+
+	// a * b + c
+	inline auto MulAdd(Float4 a, Float4 b, Float4 c) noexcept -> Float4
+	{
+#if defined(DX3D_MATH_FMA)
+		return _mm_fmadd_ps(a, b, c);
+#else
+		return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+	}
+
+	// Lane VLane of v in every lane.
+	template<int VLane>
+	inline auto Broadcast(Float4 v) noexcept -> Float4 { return _mm_shuffle_ps(v, v, _MM_SHUFFLE(VLane, VLane, VLane, VLane)); }
+
+	inline auto GetX(Float4 v) noexcept -> float { return _mm_cvtss_f32(v); }
+
+	inline auto Dot4(Float4 a, Float4 b) noexcept -> float
+	{
+		auto products = _mm_mul_ps(a, b);
+		auto sums = _mm_add_ps(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1)));
+		sums = _mm_add_ps(sums, _mm_shuffle_ps(sums, sums, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtss_f32(sums);
+	}
+
+	inline void Transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3) noexcept
+	{
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	}
+
+	// Bit i set where lane i of a is less than lane i of b.
+	inline auto LessThanMask(Float4 a, Float4 b) noexcept -> std::uint32_t { return static_cast<std::uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(a, b))); }
+
+#if defined(DX3D_MATH_AVX2)
+	using Float8 = __m256;
+
+	inline auto Add(Float8 a, Float8 b) noexcept -> Float8 { return _mm256_add_ps(a, b); }
+	inline auto Sub(Float8 a, Float8 b) noexcept -> Float8 { return _mm256_sub_ps(a, b); }
+	inline auto Mul(Float8 a, Float8 b) noexcept -> Float8 { return _mm256_mul_ps(a, b); }
+	inline auto Min(Float8 a, Float8 b) noexcept -> Float8 { return _mm256_min_ps(a, b); }
+	inline auto Max(Float8 a, Float8 b) noexcept -> Float8 { return _mm256_max_ps(a, b); }
+	inline auto Abs(Float8 v) noexcept -> Float8 { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v); }
+	inline auto LessThanMask(Float8 a, Float8 b) noexcept -> std::uint32_t { return static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ))); }
+
+	inline auto MulAdd(Float8 a, Float8 b, Float8 c) noexcept -> Float8
+	{
+#if defined(DX3D_MATH_FMA)
+		return _mm256_fmadd_ps(a, b, c);
+#else
+		return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+	}
+#endif
+
+#if defined(DX3D_MATH_AVX512)
+	using Float16 = __m512;
+
+	inline auto Add(Float16 a, Float16 b) noexcept -> Float16 { return _mm512_add_ps(a, b); }
+	inline auto Sub(Float16 a, Float16 b) noexcept -> Float16 { return _mm512_sub_ps(a, b); }
+	inline auto Mul(Float16 a, Float16 b) noexcept -> Float16 { return _mm512_mul_ps(a, b); }
+	inline auto Min(Float16 a, Float16 b) noexcept -> Float16 { return _mm512_min_ps(a, b); }
+	inline auto Max(Float16 a, Float16 b) noexcept -> Float16 { return _mm512_max_ps(a, b); }
+	inline auto Abs(Float16 v) noexcept -> Float16 { return _mm512_abs_ps(v); }
+	inline auto MulAdd(Float16 a, Float16 b, Float16 c) noexcept -> Float16 { return _mm512_fmadd_ps(a, b, c); }
+	inline auto LessThanMask(Float16 a, Float16 b) noexcept -> std::uint32_t { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+#endif
+#elif defined(DX3D_MATH_NEON)
+	using Float4 = float32x4_t;
+
+	inline auto Load(const float* values) noexcept -> Float4 { return vld1q_f32(values); }
+	inline void Store(float* values, Float4 v) noexcept { vst1q_f32(values, v); }
+	// NEON has no streaming store for a single register; these are ordinary stores.
+	inline void StoreStream(float* values, Float4 v) noexcept { vst1q_f32(values, v); }
+	inline void StreamFence() noexcept {}
+	inline auto Set(float x, float y, float z, float w) noexcept -> Float4
+	{
+		auto values = std::array{ x, y, z, w };
+		return vld1q_f32(values.data());
+	}
+	inline auto Splat(float value) noexcept -> Float4 { return vdupq_n_f32(value); }
+	inline auto Add(Float4 a, Float4 b) noexcept -> Float4 { return vaddq_f32(a, b); }
+	inline auto Sub(Float4 a, Float4 b) noexcept -> Float4 { return vsubq_f32(a, b); }
+	inline auto Mul(Float4 a, Float4 b) noexcept -> Float4 { return vmulq_f32(a, b); }
+	inline auto Div(Float4 a, Float4 b) noexcept -> Float4 { return vdivq_f32(a, b); }
+	inline auto Min(Float4 a, Float4 b) noexcept -> Float4 { return vminq_f32(a, b); }
+	inline auto Max(Float4 a, Float4 b) noexcept -> Float4 { return vmaxq_f32(a, b); }
+	inline auto Sqrt(Float4 v) noexcept -> Float4 { return vsqrtq_f32(v); }
+	inline auto Abs(Float4 v) noexcept -> Float4 { return vabsq_f32(v); }
+	inline auto MulAdd(Float4 a, Float4 b, Float4 c) noexcept -> Float4 { return vfmaq_f32(c, a, b); }
+
+	template<int VLane>
+	inline auto Broadcast(Float4 v) noexcept -> Float4 { return vdupq_laneq_f32(v, VLane); }
+
+	inline auto GetX(Float4 v) noexcept -> float { return vgetq_lane_f32(v, 0); }
+
+	inline auto Dot4(Float4 a, Float4 b) noexcept -> float { return vaddvq_f32(vmulq_f32(a, b)); }
+
+	inline void Transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3) noexcept
+	{
+		auto even = vzipq_f32(r0, r2);
+		auto odd = vzipq_f32(r1, r3);
+		auto low = vzipq_f32(even.val[0], odd.val[0]);
+		auto high = vzipq_f32(even.val[1], odd.val[1]);
+		r0 = low.val[0];
+		r1 = low.val[1];
+		r2 = high.val[0];
+		r3 = high.val[1];
+	}
+
+	inline auto LessThanMask(Float4 a, Float4 b) noexcept -> std::uint32_t
+	{
+		auto bits = vshrq_n_u32(vcltq_f32(a, b), 31);
+		auto shifts = std::array<std::int32_t, 4>{ 0, 1, 2, 3 };
+		return vaddvq_u32(vshlq_u32(bits, vld1q_s32(shifts.data())));
+	}
+#else
+	struct Float4
+	{
+		std::array<float, 4> Lanes{};
+	};
+
+	namespace Detail
+	{
+		template<typename TFn>
+		constexpr auto Map(Float4 a, Float4 b, TFn fn) noexcept -> Float4
+		{
+			return { { fn(a.Lanes[0], b.Lanes[0]), fn(a.Lanes[1], b.Lanes[1]), fn(a.Lanes[2], b.Lanes[2]), fn(a.Lanes[3], b.Lanes[3]) } };
+		}
+	}
+
+	inline auto Load(const float* values) noexcept -> Float4 { return { { values[0], values[1], values[2], values[3] } }; }
+	inline void Store(float* values, Float4 v) noexcept { std::ranges::copy(v.Lanes, values); }
+	inline void StoreStream(float* values, Float4 v) noexcept { std::ranges::copy(v.Lanes, values); }
+	inline void StreamFence() noexcept {}
+	inline auto Set(float x, float y, float z, float w) noexcept -> Float4 { return { { x, y, z, w } }; }
+	inline auto Splat(float value) noexcept -> Float4 { return { { value, value, value, value } }; }
+	inline auto Add(Float4 a, Float4 b) noexcept -> Float4 { return Detail::Map(a, b, std::plus{}); }
+	inline auto Sub(Float4 a, Float4 b) noexcept -> Float4 { return Detail::Map(a, b, std::minus{}); }
+	inline auto Mul(Float4 a, Float4 b) noexcept -> Float4 { return Detail::Map(a, b, std::multiplies{}); }
+	inline auto Div(Float4 a, Float4 b) noexcept -> Float4 { return Detail::Map(a, b, std::divides{}); }
+	inline auto Min(Float4 a, Float4 b) noexcept -> Float4 { return Detail::Map(a, b, [](float x, float y) { return y < x ? y : x; }); }
+	inline auto Max(Float4 a, Float4 b) noexcept -> Float4 { return Detail::Map(a, b, [](float x, float y) { return x < y ? y : x; }); }
+	inline auto Sqrt(Float4 v) noexcept -> Float4 { return Detail::Map(v, v, [](float x, float) { return std::sqrt(x); }); }
+	inline auto Abs(Float4 v) noexcept -> Float4 { return Detail::Map(v, v, [](float x, float) { return std::abs(x); }); }
+	inline auto MulAdd(Float4 a, Float4 b, Float4 c) noexcept -> Float4 { return Add(Mul(a, b), c); }
+
+	template<int VLane>
+	inline auto Broadcast(Float4 v) noexcept -> Float4 { return Splat(v.Lanes[VLane]); }
+
+	inline auto GetX(Float4 v) noexcept -> float { return v.Lanes[0]; }
+
+	inline auto Dot4(Float4 a, Float4 b) noexcept -> float
+	{
+		return (a.Lanes[0] * b.Lanes[0] + a.Lanes[1] * b.Lanes[1]) + (a.Lanes[2] * b.Lanes[2] + a.Lanes[3] * b.Lanes[3]);
+	}
+
+	inline void Transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3) noexcept
+	{
+		std::swap(r0.Lanes[1], r1.Lanes[0]);
+		std::swap(r0.Lanes[2], r2.Lanes[0]);
+		std::swap(r0.Lanes[3], r3.Lanes[0]);
+		std::swap(r1.Lanes[2], r2.Lanes[1]);
+		std::swap(r1.Lanes[3], r3.Lanes[1]);
+		std::swap(r2.Lanes[3], r3.Lanes[2]);
+	}
+
+	inline auto LessThanMask(Float4 a, Float4 b) noexcept -> std::uint32_t
+	{
+		auto mask = std::uint32_t{ 0 };
+		for (std::size_t lane = 0; lane < 4; ++lane)
+			mask |= (a.Lanes[lane] < b.Lanes[lane] ? 1u : 0u) << lane;
+		return mask;
+	}
+#endif
+
+	// Vectors of VWidth lanes, for the widths this build has: 4 always, 8 with AVX2 and
+	// 16 with AVX-512. Each has the arithmetic above and LessThanMask().
+	template<std::size_t VWidth>
+	constexpr auto HasWidth =
+		VWidth == 4
+#if defined(DX3D_MATH_AVX2)
+		or VWidth == 8
+#endif
+#if defined(DX3D_MATH_AVX512)
+		or VWidth == 16
+#endif
+		;
+
+	// The widest of them.
+	constexpr std::size_t MaxWidth = HasWidth<16> ? 16 : HasWidth<8> ? 8 : 4;
+
+	namespace Detail
+	{
+		template<std::size_t VWidth>
+		struct WideOf;
+
+		template<>
+		struct WideOf<4>
+		{
+			using Type = Float4;
+		};
+
+#if defined(DX3D_MATH_AVX2)
+		template<>
+		struct WideOf<8>
+		{
+			using Type = Float8;
+		};
+#endif
+
+#if defined(DX3D_MATH_AVX512)
+		template<>
+		struct WideOf<16>
+		{
+			using Type = Float16;
+		};
+#endif
+	}
+
+	template<std::size_t VWidth>
+		requires HasWidth<VWidth>
+	using Wide = typename Detail::WideOf<VWidth>::Type;
+
+	// Reads VWidth floats, which needn't be aligned.
+	template<std::size_t VWidth>
+		requires HasWidth<VWidth>
+	inline auto LoadWide(const float* values) noexcept -> Wide<VWidth>
+	{
+#if defined(DX3D_MATH_AVX512)
+		if constexpr (VWidth == 16)
+			return _mm512_loadu_ps(values);
+#endif
+#if defined(DX3D_MATH_AVX2)
+		if constexpr (VWidth == 8)
+			return _mm256_loadu_ps(values);
+#endif
+		if constexpr (VWidth == 4)
+			return Load(values);
+	}
+
+	// Writes VWidth floats, which needn't be aligned.
+	template<std::size_t VWidth>
+		requires HasWidth<VWidth>
+	inline void StoreWide(float* values, Wide<VWidth> v) noexcept
+	{
+#if defined(DX3D_MATH_AVX512)
+		if constexpr (VWidth == 16)
+			_mm512_storeu_ps(values, v);
+#endif
+#if defined(DX3D_MATH_AVX2)
+		if constexpr (VWidth == 8)
+			_mm256_storeu_ps(values, v);
+#endif
+		if constexpr (VWidth == 4)
+			Store(values, v);
+	}
+
+	template<std::size_t VWidth>
+		requires HasWidth<VWidth>
+	inline auto SplatWide(float value) noexcept -> Wide<VWidth>
+	{
+#if defined(DX3D_MATH_AVX512)
+		if constexpr (VWidth == 16)
+			return _mm512_set1_ps(value);
+#endif
+#if defined(DX3D_MATH_AVX2)
+		if constexpr (VWidth == 8)
+			return _mm256_set1_ps(value);
+#endif
+		if constexpr (VWidth == 4)
+			return Splat(value);
+	}
+}
@@ -0,0 +1,256 @@
+export module dx3d:math.vec;
+import std;
+import :math.simd;
+
+export namespace dx3d
+{
+	// Vectors are laid out as HLSL's float2, float3 and float4, so they can be copied into
+	// constant buffers as they are. Vec4 is 16 byte aligned, which also starts it on a new
+	// register when it follows a Vec3 or a Vec2, as HLSL would. HLSL doesn't let a float2
+	// or float3 straddle a 16 byte boundary either, which alignment can't express; lay out
+	// cbuffer structs so that they don't.
+	struct Vec2
+	{
+		float x{};
+		float y{};
+		constexpr auto Data() const noexcept -> const float*
+		{
+			return &x;
+		}
+		constexpr auto operator==(const Vec2&) const noexcept -> bool = default;
+	};
+
+	struct Vec3
+	{
+		float x{};
+		float y{};
+		float z{};
+		constexpr auto Data() const noexcept -> const float*
+		{
+			return &x;
+		}
+		constexpr auto operator==(const Vec3&) const noexcept -> bool = default;
+	};
+
+	struct alignas(16) Vec4
+	{
+		float x{};
+		float y{};
+		float z{};
+		float w{};
+		constexpr auto Data() const noexcept -> const float*
+		{
+			return &x;
+		}
+		constexpr auto operator==(const Vec4&) const noexcept -> bool = default;
+	};
+
+	static_assert(sizeof(Vec2) == 8 and sizeof(Vec3) == 12 and sizeof(Vec4) == 16);
+
+	namespace Detail
+	{
+		// std::sqrt() isn't constexpr yet. Newton's method converges in a handful of
+		// iterations from a power of two estimate.
+		constexpr auto Sqrt(float value) noexcept -> float
+		{
+			if (not std::is_constant_evaluated())
+				return std::sqrt(value);
+			if (value <= 0.0f or value == std::numeric_limits<float>::infinity())
+				return value == 0.0f or value == std::numeric_limits<float>::infinity() ? value : std::numeric_limits<float>::quiet_NaN();
+			auto estimate = static_cast<double>(value) >= 1.0 ? static_cast<double>(value) : 1.0;
+			for (auto i = 0; i < 64; ++i)
+			{
+				auto next = 0.5 * (estimate + static_cast<double>(value) / estimate);
+				if (next == estimate)
+					break;
+				estimate = next;
+			}
+			return static_cast<float>(estimate);
+		}
+
+		inline auto Load(const Vec4& v) noexcept -> Simd::Float4
+		{
+			return Simd::Load(v.Data());
+		}
+
+		inline auto ToVec4(Simd::Float4 v) noexcept -> Vec4
+		{
+			auto result = Vec4{};
+			Simd::Store(&result.x, v);
+			return result;
+		}
+	}
+
+	// The portable versions of the operations that also have SIMD versions. They're used in
+	// constant evaluation and when DX3D_MATH_SCALAR is defined, and are what the SIMD
+	// versions are checked and benchmarked against.
+	namespace Scalar
+	{
+		constexpr auto Add(const Vec4& a, const Vec4& b) noexcept -> Vec4 { return { a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w }; }
+		constexpr auto Sub(const Vec4& a, const Vec4& b) noexcept -> Vec4 { return { a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w }; }
+		constexpr auto Mul(const Vec4& a, const Vec4& b) noexcept -> Vec4 { return { a.x * b.x, a.y * b.y, a.z * b.z, a.w * b.w }; }
+		constexpr auto Div(const Vec4& a, const Vec4& b) noexcept -> Vec4 { return { a.x / b.x, a.y / b.y, a.z / b.z, a.w / b.w }; }
+		constexpr auto Min(const Vec4& a, const Vec4& b) noexcept -> Vec4 { return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z), std::min(a.w, b.w) }; }
+		constexpr auto Max(const Vec4& a, const Vec4& b) noexcept -> Vec4 { return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z), std::max(a.w, b.w) }; }
+		constexpr auto Dot(const Vec4& a, const Vec4& b) noexcept -> float { return (a.x * b.x + a.y * b.y) + (a.z * b.z + a.w * b.w); }
+
+		constexpr auto Normalize(const Vec4& v) noexcept -> Vec4
+		{
+			auto length = Detail::Sqrt(Dot(v, v));
+			return length > 0.0f ? Vec4{ v.x / length, v.y / length, v.z / length, v.w / length } : Vec4{};
+		}
+	}
+
+	// Vec2
+
+	constexpr auto operator+(const Vec2& a, const Vec2& b) noexcept -> Vec2 { return { a.x + b.x, a.y + b.y }; }
+	constexpr auto operator-(const Vec2& a, const Vec2& b) noexcept -> Vec2 { return { a.x - b.x, a.y - b.y }; }
+	constexpr auto operator*(const Vec2& a, const Vec2& b) noexcept -> Vec2 { return { a.x * b.x, a.y * b.y }; }
+	constexpr auto operator/(const Vec2& a, const Vec2& b) noexcept -> Vec2 { return { a.x / b.x, a.y / b.y }; }
+	constexpr auto operator*(const Vec2& v, float s) noexcept -> Vec2 { return { v.x * s, v.y * s }; }
+	constexpr auto operator*(float s, const Vec2& v) noexcept -> Vec2 { return v * s; }
+	constexpr auto operator/(const Vec2& v, float s) noexcept -> Vec2 { return { v.x / s, v.y / s }; }
+	constexpr auto operator-(const Vec2& v) noexcept -> Vec2 { return { -v.x, -v.y }; }
+	constexpr auto operator+=(Vec2& a, const Vec2& b) noexcept -> Vec2& { return a = a + b; }
+	constexpr auto operator-=(Vec2& a, const Vec2& b) noexcept -> Vec2& { return a = a - b; }
+	constexpr auto operator*=(Vec2& v, float s) noexcept -> Vec2& { return v = v * s; }
+
+	constexpr auto Dot(const Vec2& a, const Vec2& b) noexcept -> float { return a.x * b.x + a.y * b.y; }
+	constexpr auto Min(const Vec2& a, const Vec2& b) noexcept -> Vec2 { return { std::min(a.x, b.x), std::min(a.y, b.y) }; }
+	constexpr auto Max(const Vec2& a, const Vec2& b) noexcept -> Vec2 { return { std::max(a.x, b.x), std::max(a.y, b.y) }; }
+
+	// Vec3. Twelve bytes doesn't fill a register, so these are left to the compiler, which
+	// vectorises them where the surrounding code lets it.
+
+	constexpr auto operator+(const Vec3& a, const Vec3& b) noexcept -> Vec3 { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	constexpr auto operator-(const Vec3& a, const Vec3& b) noexcept -> Vec3 { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	constexpr auto operator*(const Vec3& a, const Vec3& b) noexcept -> Vec3 { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+	constexpr auto operator/(const Vec3& a, const Vec3& b) noexcept -> Vec3 { return { a.x / b.x, a.y / b.y, a.z / b.z }; }
+	constexpr auto operator*(const Vec3& v, float s) noexcept -> Vec3 { return { v.x * s, v.y * s, v.z * s }; }
+	constexpr auto operator*(float s, const Vec3& v) noexcept -> Vec3 { return v * s; }
+	constexpr auto operator/(const Vec3& v, float s) noexcept -> Vec3 { return { v.x / s, v.y / s, v.z / s }; }
+	constexpr auto operator-(const Vec3& v) noexcept -> Vec3 { return { -v.x, -v.y, -v.z }; }
+	constexpr auto operator+=(Vec3& a, const Vec3& b) noexcept -> Vec3& { return a = a + b; }
+	constexpr auto operator-=(Vec3& a, const Vec3& b) noexcept -> Vec3& { return a = a - b; }
+	constexpr auto operator*=(Vec3& v, float s) noexcept -> Vec3& { return v = v * s; }
+
+	constexpr auto Dot(const Vec3& a, const Vec3& b) noexcept -> float { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	constexpr auto Min(const Vec3& a, const Vec3& b) noexcept -> Vec3 { return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) }; }
+	constexpr auto Max(const Vec3& a, const Vec3& b) noexcept -> Vec3 { return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) }; }
+	constexpr auto Abs(const Vec3& v) noexcept -> Vec3 { return { v.x < 0 ? -v.x : v.x, v.y < 0 ? -v.y : v.y, v.z < 0 ? -v.z : v.z }; }
+
+	constexpr auto Cross(const Vec3& a, const Vec3& b) noexcept -> Vec3
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	// Vec4
+
+	constexpr auto operator+(const Vec4& a, const Vec4& b) noexcept -> Vec4
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Add(a, b);
+		return Detail::ToVec4(Simd::Add(Detail::Load(a), Detail::Load(b)));
+	}
+
+	constexpr auto operator-(const Vec4& a, const Vec4& b) noexcept -> Vec4
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Sub(a, b);
+		return Detail::ToVec4(Simd::Sub(Detail::Load(a), Detail::Load(b)));
+	}
+
+	constexpr auto operator*(const Vec4& a, const Vec4& b) noexcept -> Vec4
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Mul(a, b);
+		return Detail::ToVec4(Simd::Mul(Detail::Load(a), Detail::Load(b)));
+	}
+
+	constexpr auto operator/(const Vec4& a, const Vec4& b) noexcept -> Vec4
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Div(a, b);
+		return Detail::ToVec4(Simd::Div(Detail::Load(a), Detail::Load(b)));
+	}
+
+	constexpr auto operator*(const Vec4& v, float s) noexcept -> Vec4 { return v * Vec4{ s, s, s, s }; }
+	constexpr auto operator*(float s, const Vec4& v) noexcept -> Vec4 { return v * s; }
+	constexpr auto operator/(const Vec4& v, float s) noexcept -> Vec4 { return v / Vec4{ s, s, s, s }; }
+	constexpr auto operator-(const Vec4& v) noexcept -> Vec4 { return Vec4{} - v; }
+	constexpr auto operator+=(Vec4& a, const Vec4& b) noexcept -> Vec4& { return a = a + b; }
+	constexpr auto operator-=(Vec4& a, const Vec4& b) noexcept -> Vec4& { return a = a - b; }
+	constexpr auto operator*=(Vec4& v, float s) noexcept -> Vec4& { return v = v * s; }
+
+	constexpr auto Min(const Vec4& a, const Vec4& b) noexcept -> Vec4
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Min(a, b);
+		return Detail::ToVec4(Simd::Min(Detail::Load(a), Detail::Load(b)));
+	}
+
+	constexpr auto Max(const Vec4& a, const Vec4& b) noexcept -> Vec4
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Max(a, b);
+		return Detail::ToVec4(Simd::Max(Detail::Load(a), Detail::Load(b)));
+	}
+
+	constexpr auto Dot(const Vec4& a, const Vec4& b) noexcept -> float
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Dot(a, b);
+		return Simd::Dot4(Detail::Load(a), Detail::Load(b));
+	}
+
+	constexpr auto Normalize(const Vec4& v) noexcept -> Vec4
+	{
+		if (std::is_constant_evaluated() or not Simd::Enabled)
+			return Scalar::Normalize(v);
+		auto lanes = Detail::Load(v);
+		auto lengthSquared = Simd::Dot4(lanes, lanes);
+		if (not (lengthSquared > 0.0f))
+			return {};
+		return Detail::ToVec4(Simd::Div(lanes, Simd::Sqrt(Simd::Splat(lengthSquared))));
+	}
+
+	// Shared by all three
+
+	template<typename TVec>
+	concept Vector = std::same_as<TVec, Vec2> or std::same_as<TVec, Vec3> or std::same_as<TVec, Vec4>;
+
+	template<Vector TVec>
+	constexpr auto LengthSquared(const TVec& v) noexcept -> float { return Dot(v, v); }
+
+	template<Vector TVec>
+	constexpr auto Length(const TVec& v) noexcept -> float { return Detail::Sqrt(Dot(v, v)); }
+
+	template<Vector TVec>
+	constexpr auto Distance(const TVec& a, const TVec& b) noexcept -> float { return Length(a - b); }
+
+	// The zero vector for the zero vector.
+	template<Vector TVec>
+		requires (not std::same_as<TVec, Vec4>)
+	constexpr auto Normalize(const TVec& v) noexcept -> TVec
+	{
+		auto length = Length(v);
+		return length > 0.0f ? v / length : TVec{};
+	}
+
+	template<Vector TVec>
+	constexpr auto Lerp(const TVec& a, const TVec& b, float t) noexcept -> TVec { return a + (b - a) * t; }
+
+	// Widening and narrowing, as HLSL's float4(v, w) and v.xyz.
+	constexpr auto ToVec4(const Vec3& v, float w) noexcept -> Vec4 { return { v.x, v.y, v.z, w }; }
+	constexpr auto ToVec3(const Vec4& v) noexcept -> Vec3 { return { v.x, v.y, v.z }; }
+
+	static_assert(Vec4{ 1, 2, 3, 4 } + Vec4{ 4, 3, 2, 1 } == Vec4{ 5, 5, 5, 5 });
+	static_assert(Vec4{ 1, 2, 3, 4 } * 2.0f - Vec4{ 1, 1, 1, 1 } == Vec4{ 1, 3, 5, 7 });
+	static_assert(Dot(Vec4{ 1, 2, 3, 4 }, Vec4{ 1, 1, 1, 1 }) == 10.0f);
+	static_assert(Cross(Vec3{ 1, 0, 0 }, Vec3{ 0, 1, 0 }) == Vec3{ 0, 0, 1 });
+	static_assert(Length(Vec3{ 3, 4, 12 }) == 13.0f);
+	static_assert(Normalize(Vec2{ 0, 5 }) == Vec2{ 0, 1 });
+	static_assert(Normalize(Vec4{}) == Vec4{});
+	static_assert(Lerp(Vec3{ 0, 0, 0 }, Vec3{ 2, 4, 8 }, 0.5f) == Vec3{ 1, 2, 4 });
+	static_assert(Min(Vec4{ 1, 5, 3, 7 }, Vec4{ 4, 2, 6, 0 }) == Vec4{ 1, 2, 3, 0 });
+}
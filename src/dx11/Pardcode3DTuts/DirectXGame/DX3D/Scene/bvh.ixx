@@ -0,0 +1,710 @@
+export module dx3d:scene.bvh;
+import std;
+import :error.runtimerror;
+import :math;
+import :scene.culling;
+
+export namespace dx3d
+{
+	// An object in a Bvh.
+	enum class BvhProxy : std::uint32_t
+	{
+		None = 0xFFFFFFFF
+	};
+
+	namespace Detail
+	{
+		// The nodes still to visit in a walk down a tree. Kept on the stack unless the tree
+		// is deeper than a balanced one of any size would be.
+		template<typename T>
+		class TraversalStack
+		{
+		public:
+			void Push(this TraversalStack& self, const T& value)
+			{
+				if (self.size < self.local.size())
+					self.local[self.size] = value;
+				else
+					self.spill.push_back(value);
+				++self.size;
+			}
+
+			auto Pop(this TraversalStack& self) -> T
+			{
+				--self.size;
+				if (self.size < self.local.size())
+					return self.local[self.size];
+				auto value = self.spill.back();
+				self.spill.pop_back();
+				return value;
+			}
+
+			auto Empty(this const TraversalStack& self) noexcept -> bool
+			{
+				return self.size == 0;
+			}
+
+		private:
+			std::array<T, 64> local;
+			std::vector<T> spill;
+			std::size_t size = 0;
+		};
+	}
+
+	// A bounding volume hierarchy over boxes that can be added, moved and removed at any
+	// time. Each node has up to VWidth children whose bounds are stored as a structure of
+	// arrays, so that a query tests all of them at once and a node is a couple of cache
+	// lines. Changes only refit the nodes above them, which lets the tree degrade as
+	// objects move; Optimize() rebuilds the subtrees that have grown too much since they
+	// were built, splitting them by the surface area heuristic (SAH). Queries don't change
+	// the tree, so any number can run at once, but not while it's being changed.
+	template<std::size_t VWidth = 4>
+		requires Simd::HasWidth<VWidth>
+	class Bvh
+	{
+	public:
+		static constexpr std::size_t Arity = VWidth;
+		static constexpr std::size_t MaxObjects = std::size_t{ 1 } << 31;
+		// How many times its surface area when it was built a node can grow to before
+		// Optimize() rebuilds it.
+		static constexpr float MaxGrowth = 2.0f;
+
+		auto Insert(this Bvh& self, const Aabb& bounds, std::uint32_t userData = 0) -> BvhProxy
+		{
+			auto leaf = self.AllocateLeaf();
+			self.leaves[leaf].Bounds = bounds;
+			self.leaves[leaf].UserData = userData;
+
+			// Down the children whose bounds grow least, to the first node with room. A full
+			// node whose best child is an object gets a new node in its place holding both.
+			auto node = Root;
+			while (self.nodes[node].Count == VWidth)
+			{
+				auto slot = self.BestChild(node, bounds);
+				auto child = self.nodes[node].Children[slot];
+				if (child & LeafBit)
+				{
+					auto pair = self.AllocateNode();
+					self.SetChild(pair, 0, child, self.ChildBounds(node, slot));
+					self.SetChild(pair, 1, leaf | LeafBit, bounds);
+					self.nodes[pair].Count = 2;
+					auto pairBounds = self.NodeBounds(pair);
+					self.nodes[pair].BuiltArea = SurfaceArea(pairBounds);
+					self.SetChild(node, slot, pair, pairBounds);
+					self.Refit(node);
+					++self.size;
+					return static_cast<BvhProxy>(leaf);
+				}
+				node = child;
+			}
+			self.SetChild(node, self.nodes[node].Count++, leaf | LeafBit, bounds);
+			self.Refit(node);
+			++self.size;
+			return static_cast<BvhProxy>(leaf);
+		}
+
+		void Remove(this Bvh& self, BvhProxy proxy)
+		{
+			self.CheckAlive(proxy);
+			auto leaf = std::to_underlying(proxy);
+			auto node = self.leaves[leaf].Node;
+			self.RemoveChild(node, self.leaves[leaf].Slot);
+			self.leaves[leaf].Node = NoNode;
+			self.freeLeaves.push_back(leaf);
+			--self.size;
+
+			// Nodes other than the root have at least two children, so one left with a single
+			// child is replaced by it.
+			if (node != Root and self.nodes[node].Count == 1)
+			{
+				auto parent = self.nodes[node].Parent;
+				self.SetChild(parent, self.nodes[node].Slot, self.nodes[node].Children[0], self.ChildBounds(node, 0));
+				self.FreeNode(node);
+				node = parent;
+			}
+			self.Refit(node);
+		}
+
+		// Refits the nodes above the object, as far up as their bounds change.
+		void Move(this Bvh& self, BvhProxy proxy, const Aabb& bounds)
+		{
+			self.CheckAlive(proxy);
+			auto& leaf = self.leaves[std::to_underlying(proxy)];
+			leaf.Bounds = bounds;
+			self.SetChildBounds(leaf.Node, leaf.Slot, bounds);
+			self.Refit(leaf.Node);
+		}
+
+		auto GetBounds(this const Bvh& self, BvhProxy proxy) -> const Aabb&
+		{
+			self.CheckAlive(proxy);
+			return self.leaves[std::to_underlying(proxy)].Bounds;
+		}
+
+		auto GetUserData(this const Bvh& self, BvhProxy proxy) -> std::uint32_t
+		{
+			self.CheckAlive(proxy);
+			return self.leaves[std::to_underlying(proxy)].UserData;
+		}
+
+		auto Contains(this const Bvh& self, BvhProxy proxy) noexcept -> bool
+		{
+			auto leaf = std::to_underlying(proxy);
+			return leaf < self.leaves.size() and self.leaves[leaf].Node != NoNode;
+		}
+
+		auto Size(this const Bvh& self) noexcept -> std::size_t
+		{
+			return self.size;
+		}
+
+		auto Bounds(this const Bvh& self) noexcept -> Aabb
+		{
+			return self.NodeBounds(Root);
+		}
+
+		// The sum of the nodes' surface areas over the root's: how many nodes a random ray
+		// through the root can expect to visit, which is what the SAH keeps low.
+		auto Cost(this const Bvh& self) noexcept -> float
+		{
+			auto rootArea = SurfaceArea(self.Bounds());
+			if (rootArea == 0.0f)
+				return 0.0f;
+			auto area = 0.0;
+			for (std::uint32_t node = 0; node < self.nodes.size(); ++node)
+				if (not (self.nodes[node].Flags & Free))
+					area += SurfaceArea(self.NodeBounds(node));
+			return static_cast<float>(area / rootArea);
+		}
+
+		// Rebuilds the subtrees that have grown more than MaxGrowth since they were built.
+		// Only touches those, so it's cheap enough to call every frame.
+		void Optimize(this Bvh& self)
+		{
+			auto degraded = std::exchange(self.degraded, {});
+			for (auto node : degraded)
+			{
+				// Either rebuilt already as part of an ancestor, or freed.
+				if (not (self.nodes[node].Flags & Degraded))
+					continue;
+				// A degraded ancestor will be rebuilt instead, which covers this one.
+				auto covered = false;
+				for (auto parent = self.nodes[node].Parent; parent != NoNode and not covered; parent = self.nodes[parent].Parent)
+					covered = self.nodes[parent].Flags & Degraded;
+				if (not covered)
+					self.RebuildSubtree(node);
+			}
+		}
+
+		// Rebuilds the whole tree, as after adding a world's worth of objects at once.
+		void Rebuild(this Bvh& self)
+		{
+			self.RebuildSubtree(Root);
+			self.degraded.clear();
+		}
+
+		// Calls visit(proxy) for each object whose bounds aren't entirely outside the
+		// frustum, by the same conservative test as Intersects(). Subtrees entirely inside
+		// it are visited without testing anything below them.
+		template<typename TVisit>
+		void Query(this const Bvh& self, const Frustum& frustum, TVisit&& visit)
+		{
+			auto planes = Detail::FrustumLanes<VWidth>{ frustum };
+			auto zero = Simd::SplatWide<VWidth>(0.0f);
+			auto half = Simd::SplatWide<VWidth>(0.5f);
+			auto stack = Detail::TraversalStack<std::uint32_t>{};
+			stack.Push(Root);
+			while (not stack.Empty())
+			{
+				auto entry = stack.Pop();
+				auto& node = self.nodes[entry & ~InsideBit];
+				auto visible = ValidMask(node.Count);
+				auto crossing = std::uint32_t{ 0 };
+				if (not (entry & InsideBit))
+				{
+					auto minX = Simd::LoadWide<VWidth>(node.MinX.data());
+					auto minY = Simd::LoadWide<VWidth>(node.MinY.data());
+					auto minZ = Simd::LoadWide<VWidth>(node.MinZ.data());
+					auto maxX = Simd::LoadWide<VWidth>(node.MaxX.data());
+					auto maxY = Simd::LoadWide<VWidth>(node.MaxY.data());
+					auto maxZ = Simd::LoadWide<VWidth>(node.MaxZ.data());
+					auto x = Simd::Mul(Simd::Add(minX, maxX), half);
+					auto y = Simd::Mul(Simd::Add(minY, maxY), half);
+					auto z = Simd::Mul(Simd::Add(minZ, maxZ), half);
+					auto ex = Simd::Mul(Simd::Sub(maxX, minX), half);
+					auto ey = Simd::Mul(Simd::Sub(maxY, minY), half);
+					auto ez = Simd::Mul(Simd::Sub(maxZ, minZ), half);
+					auto outside = std::uint32_t{ 0 };
+					for (auto& plane : planes.Planes)
+					{
+						auto distance = Simd::MulAdd(plane.X, x, Simd::MulAdd(plane.Y, y, Simd::MulAdd(plane.Z, z, plane.Distance)));
+						auto reach = Simd::MulAdd(plane.AbsX, ex, Simd::MulAdd(plane.AbsY, ey, Simd::Mul(plane.AbsZ, ez)));
+						outside |= Simd::LessThanMask(Simd::Add(distance, reach), zero);
+						crossing |= Simd::LessThanMask(Simd::Sub(distance, reach), zero);
+					}
+					visible &= ~outside;
+				}
+				for (; visible; visible &= visible - 1)
+				{
+					auto slot = std::countr_zero(visible);
+					auto child = node.Children[slot];
+					if (child & LeafBit)
+						visit(static_cast<BvhProxy>(child & ~LeafBit));
+					else
+						stack.Push(crossing >> slot & 1 ? child : child | InsideBit);
+				}
+			}
+		}
+
+		// Calls visit(proxy) for each object whose bounds touch box.
+		template<typename TVisit>
+		void Query(this const Bvh& self, const Aabb& box, TVisit&& visit)
+		{
+			auto boxMinX = Simd::SplatWide<VWidth>(box.Min.x);
+			auto boxMinY = Simd::SplatWide<VWidth>(box.Min.y);
+			auto boxMinZ = Simd::SplatWide<VWidth>(box.Min.z);
+			auto boxMaxX = Simd::SplatWide<VWidth>(box.Max.x);
+			auto boxMaxY = Simd::SplatWide<VWidth>(box.Max.y);
+			auto boxMaxZ = Simd::SplatWide<VWidth>(box.Max.z);
+			auto stack = Detail::TraversalStack<std::uint32_t>{};
+			stack.Push(Root);
+			while (not stack.Empty())
+			{
+				auto& node = self.nodes[stack.Pop()];
+				auto apart = Simd::LessThanMask(Simd::LoadWide<VWidth>(node.MaxX.data()), boxMinX)
+					| Simd::LessThanMask(Simd::LoadWide<VWidth>(node.MaxY.data()), boxMinY)
+					| Simd::LessThanMask(Simd::LoadWide<VWidth>(node.MaxZ.data()), boxMinZ)
+					| Simd::LessThanMask(boxMaxX, Simd::LoadWide<VWidth>(node.MinX.data()))
+					| Simd::LessThanMask(boxMaxY, Simd::LoadWide<VWidth>(node.MinY.data()))
+					| Simd::LessThanMask(boxMaxZ, Simd::LoadWide<VWidth>(node.MinZ.data()));
+				for (auto touching = ValidMask(node.Count) & ~apart; touching; touching &= touching - 1)
+				{
+					auto child = node.Children[std::countr_zero(touching)];
+					if (child & LeafBit)
+						visit(static_cast<BvhProxy>(child & ~LeafBit));
+					else
+						stack.Push(child);
+				}
+			}
+		}
+
+		// Calls visit(proxy, distance) for the objects whose bounds the ray enters within
+		// maxDistance, with the distance it enters them at, nearest first as far as the
+		// tree can tell. visit returns how far to keep looking: the distance of a hit it
+		// found, to find the nearest; maxDistance, to find them all; or 0 (or less) to stop.
+		template<typename TVisit>
+		void Raycast(this const Bvh& self, const Ray& ray, float maxDistance, TVisit&& visit)
+		{
+			struct Entry
+			{
+				std::uint32_t Child;
+				float Distance;
+			};
+
+			struct Axis
+			{
+				Simd::Wide<VWidth> Origin;
+				Simd::Wide<VWidth> Inverse;
+				// The ray doesn't move along the axis, so as in HitDistance() it's inside a slab
+				// everywhere or nowhere. The slab test would give 0 * inf = NaN for an origin on
+				// one of the slab's planes.
+				bool Parallel;
+			};
+
+			auto makeAxis = [](float origin, float direction)
+			{
+				return Axis{ Simd::SplatWide<VWidth>(origin), Simd::SplatWide<VWidth>(1.0f / direction), direction == 0.0f };
+			};
+			auto axes = std::array{ makeAxis(ray.Origin.x, ray.Direction.x), makeAxis(ray.Origin.y, ray.Direction.y), makeAxis(ray.Origin.z, ray.Direction.z) };
+			auto stack = Detail::TraversalStack<Entry>{};
+			stack.Push({ Root, 0.0f });
+			while (not stack.Empty())
+			{
+				auto entry = stack.Pop();
+				if (entry.Distance > maxDistance)
+					continue;
+				if (entry.Child & LeafBit)
+				{
+					auto keepLooking = static_cast<float>(visit(static_cast<BvhProxy>(entry.Child & ~LeafBit), entry.Distance));
+					if (keepLooking <= 0.0f)
+						return;
+					maxDistance = std::min(maxDistance, keepLooking);
+					continue;
+				}
+
+				auto& node = self.nodes[entry.Child];
+				auto near = Simd::SplatWide<VWidth>(0.0f);
+				auto far = Simd::SplatWide<VWidth>(maxDistance);
+				auto outside = std::uint32_t{ 0 };
+				auto clip =
+					[&](const Axis& axis, const float* mins, const float* maxs)
+					{
+						auto min = Simd::LoadWide<VWidth>(mins);
+						auto max = Simd::LoadWide<VWidth>(maxs);
+						if (axis.Parallel)
+						{
+							outside |= Simd::LessThanMask(axis.Origin, min) | Simd::LessThanMask(max, axis.Origin);
+							return;
+						}
+						auto t0 = Simd::Mul(Simd::Sub(min, axis.Origin), axis.Inverse);
+						auto t1 = Simd::Mul(Simd::Sub(max, axis.Origin), axis.Inverse);
+						near = Simd::Max(near, Simd::Min(t0, t1));
+						far = Simd::Min(far, Simd::Max(t0, t1));
+					};
+				clip(axes[0], node.MinX.data(), node.MaxX.data());
+				clip(axes[1], node.MinY.data(), node.MaxY.data());
+				clip(axes[2], node.MinZ.data(), node.MaxZ.data());
+				auto nearDistances = std::array<float, VWidth>{};
+				Simd::StoreWide<VWidth>(nearDistances.data(), near);
+
+				// Pushed furthest first, so that the nearest comes off next.
+				auto hits = std::array<Entry, VWidth>{};
+				auto hitCount = std::size_t{ 0 };
+				for (auto hit = ValidMask(node.Count) & ~outside & ~Simd::LessThanMask(far, near); hit; hit &= hit - 1)
+				{
+					auto slot = std::countr_zero(hit);
+					hits[hitCount++] = { node.Children[slot], nearDistances[slot] };
+				}
+				std::sort(hits.begin(), hits.begin() + hitCount, [](const Entry& a, const Entry& b) { return a.Distance > b.Distance; });
+				for (std::size_t i = 0; i < hitCount; ++i)
+					stack.Push(hits[i]);
+			}
+		}
+
+	private:
+		static constexpr std::uint32_t Root = 0;
+		static constexpr std::uint32_t NoNode = 0xFFFFFFFF;
+		// Set in a child that's an object, with the object's leaf below it.
+		static constexpr std::uint32_t LeafBit = 0x80000000;
+		// Set on nodes pushed by a frustum query that are entirely inside the frustum.
+		static constexpr std::uint32_t InsideBit = 0x40000000;
+
+		enum Flag : std::uint8_t
+		{
+			// On the list for Optimize() to rebuild.
+			Degraded = 1,
+			// The node is on the free list.
+			Free = 2
+		};
+
+		struct alignas(64) Node
+		{
+			// The children's bounds, a lane each. Lanes past Count are ignored.
+			std::array<float, VWidth> MinX, MinY, MinZ, MaxX, MaxY, MaxZ;
+			// Node indices, or leaf indices with LeafBit set.
+			std::array<std::uint32_t, VWidth> Children;
+			std::uint32_t Parent = NoNode;
+			// Which of the parent's children this is.
+			std::uint8_t Slot = 0;
+			std::uint8_t Count = 0;
+			std::uint8_t Flags = 0;
+			// The surface area of the node's bounds when it was built.
+			float BuiltArea = 0;
+		};
+
+		static_assert(sizeof(Node) == (VWidth == 4 ? 128 : VWidth == 8 ? 256 : 512));
+
+		struct Leaf
+		{
+			Aabb Bounds;
+			std::uint32_t UserData = 0;
+			// NoNode while the leaf is on the free list.
+			std::uint32_t Node = NoNode;
+			std::uint32_t Slot = 0;
+		};
+
+		// An object being sorted into a subtree, copied out of its leaf so that the build
+		// reads and partitions one contiguous array.
+		struct BuildObject
+		{
+			Aabb Bounds;
+			Vec3 Center;
+			// The leaf index with LeafBit set, as it goes in the node.
+			std::uint32_t Child;
+		};
+
+		static constexpr auto ValidMask(std::size_t count) noexcept -> std::uint32_t
+		{
+			return (std::uint32_t{ 1 } << count) - 1;
+		}
+
+		auto ChildBounds(this const Bvh& self, std::uint32_t node, std::size_t slot) noexcept -> Aabb
+		{
+			auto& n = self.nodes[node];
+			return { { n.MinX[slot], n.MinY[slot], n.MinZ[slot] }, { n.MaxX[slot], n.MaxY[slot], n.MaxZ[slot] } };
+		}
+
+		auto NodeBounds(this const Bvh& self, std::uint32_t node) noexcept -> Aabb
+		{
+			auto bounds = Aabb{};
+			for (std::size_t slot = 0; slot < self.nodes[node].Count; ++slot)
+				bounds = Merge(bounds, self.ChildBounds(node, slot));
+			return bounds;
+		}
+
+		void SetChildBounds(this Bvh& self, std::uint32_t node, std::size_t slot, const Aabb& bounds) noexcept
+		{
+			auto& n = self.nodes[node];
+			n.MinX[slot] = bounds.Min.x;
+			n.MinY[slot] = bounds.Min.y;
+			n.MinZ[slot] = bounds.Min.z;
+			n.MaxX[slot] = bounds.Max.x;
+			n.MaxY[slot] = bounds.Max.y;
+			n.MaxZ[slot] = bounds.Max.z;
+		}
+
+		// Also points the child back at its new place.
+		void SetChild(this Bvh& self, std::uint32_t node, std::size_t slot, std::uint32_t child, const Aabb& bounds) noexcept
+		{
+			self.nodes[node].Children[slot] = child;
+			self.SetChildBounds(node, slot, bounds);
+			if (child & LeafBit)
+			{
+				auto& leaf = self.leaves[child & ~LeafBit];
+				leaf.Node = node;
+				leaf.Slot = static_cast<std::uint32_t>(slot);
+			}
+			else
+			{
+				self.nodes[child].Parent = node;
+				self.nodes[child].Slot = static_cast<std::uint8_t>(slot);
+			}
+		}
+
+		// Moves the last child into the slot, to keep the children at the front.
+		void RemoveChild(this Bvh& self, std::uint32_t node, std::size_t slot) noexcept
+		{
+			auto last = self.nodes[node].Count - std::size_t{ 1 };
+			if (slot != last)
+				self.SetChild(node, slot, self.nodes[node].Children[last], self.ChildBounds(node, last));
+			--self.nodes[node].Count;
+		}
+
+		// The child whose surface area grows least if bounds is added to it.
+		auto BestChild(this const Bvh& self, std::uint32_t node, const Aabb& bounds) noexcept -> std::size_t
+		{
+			auto best = std::size_t{ 0 };
+			auto bestGrowth = std::numeric_limits<float>::infinity();
+			for (std::size_t slot = 0; slot < self.nodes[node].Count; ++slot)
+			{
+				auto child = self.ChildBounds(node, slot);
+				auto growth = SurfaceArea(Merge(child, bounds)) - SurfaceArea(child);
+				if (growth < bestGrowth)
+				{
+					best = slot;
+					bestGrowth = growth;
+				}
+			}
+			return best;
+		}
+
+		// Brings the bounds above node up to date with its children, stopping where they
+		// don't change, and flags the nodes that have grown too much.
+		void Refit(this Bvh& self, std::uint32_t node)
+		{
+			while (true)
+			{
+				auto bounds = self.NodeBounds(node);
+				auto& n = self.nodes[node];
+				if (not (n.Flags & Degraded) and SurfaceArea(bounds) > MaxGrowth * n.BuiltArea)
+				{
+					n.Flags |= Degraded;
+					self.degraded.push_back(node);
+				}
+				if (n.Parent == NoNode or self.ChildBounds(n.Parent, n.Slot) == bounds)
+					return;
+				self.SetChildBounds(n.Parent, n.Slot, bounds);
+				node = n.Parent;
+			}
+		}
+
+		void RebuildSubtree(this Bvh& self, std::uint32_t node)
+		{
+			// Gathers the subtree's objects and frees the nodes below it.
+			auto& objects = self.buildObjects;
+			objects.clear();
+			auto stack = Detail::TraversalStack<std::uint32_t>{};
+			stack.Push(node);
+			while (not stack.Empty())
+			{
+				auto current = stack.Pop();
+				for (std::size_t slot = 0; slot < self.nodes[current].Count; ++slot)
+				{
+					auto child = self.nodes[current].Children[slot];
+					if (child & LeafBit)
+					{
+						auto& bounds = self.leaves[child & ~LeafBit].Bounds;
+						objects.push_back({ bounds, Center(bounds), child });
+					}
+					else
+						stack.Push(child);
+				}
+				if (current != node)
+					self.FreeNode(current);
+			}
+			self.Build(node, objects);
+		}
+
+		// Makes node the root of a subtree over the objects, in up to VWidth groups split
+		// by the SAH, and returns its bounds.
+		auto Build(this Bvh& self, std::uint32_t node, std::span<BuildObject> objects) -> Aabb
+		{
+			auto groups = std::array<std::span<BuildObject>, VWidth>{};
+			auto groupCount = std::size_t{ 0 };
+			if (objects.size() <= VWidth)
+			{
+				for (auto& object : objects)
+					groups[groupCount++] = { &object, 1 };
+			}
+			else
+			{
+				// Splitting the largest group each time, which always has more than one.
+				groups[groupCount++] = objects;
+				while (groupCount < VWidth)
+				{
+					auto largest = std::ranges::max_element(groups.begin(), groups.begin() + groupCount, {}, [](auto group) { return group.size(); });
+					auto group = *largest;
+					auto split = SplitSah(group);
+					*largest = group.first(split);
+					groups[groupCount++] = group.subspan(split);
+				}
+			}
+
+			auto bounds = Aabb{};
+			self.nodes[node].Count = static_cast<std::uint8_t>(groupCount);
+			for (std::size_t slot = 0; slot < groupCount; ++slot)
+			{
+				auto group = groups[slot];
+				auto child = group[0].Child;
+				auto childBounds = group[0].Bounds;
+				if (group.size() > 1)
+				{
+					child = self.AllocateNode();
+					childBounds = self.Build(child, group);
+				}
+				self.SetChild(node, slot, child, childBounds);
+				bounds = Merge(bounds, childBounds);
+			}
+			self.nodes[node].Flags &= ~Degraded;
+			self.nodes[node].BuiltArea = SurfaceArea(bounds);
+			return bounds;
+		}
+
+		// Partitions the objects in two along the axis their centres spread furthest on,
+		// at whichever of a set of evenly spaced planes gives the lowest SAH cost, and
+		// returns the size of the first part.
+		static auto SplitSah(std::span<BuildObject> objects) noexcept -> std::size_t
+		{
+			constexpr std::size_t BinCount = 16;
+			auto centers = Aabb{};
+			for (auto& object : objects)
+				centers = Merge(centers, object.Center);
+			auto spread = centers.Max - centers.Min;
+			auto axis = spread.x >= spread.y and spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+			auto component = [axis](const Vec3& v) { return axis == 0 ? v.x : axis == 1 ? v.y : v.z; };
+			// All the centres in the same place, which no plane separates.
+			if (not (component(spread) > 0.0f))
+				return objects.size() / 2;
+
+			auto min = component(centers.Min);
+			auto scale = static_cast<float>(BinCount) / component(spread);
+			auto binOf = [&](const BuildObject& object)
+			{
+				return std::min(static_cast<std::size_t>((component(object.Center) - min) * scale), BinCount - 1);
+			};
+			auto binBounds = std::array<Aabb, BinCount>{};
+			auto binCounts = std::array<std::size_t, BinCount>{};
+			for (auto& object : objects)
+			{
+				auto bin = binOf(object);
+				binBounds[bin] = Merge(binBounds[bin], object.Bounds);
+				++binCounts[bin];
+			}
+
+			// The cost of the objects from each bin up, then of those below it.
+			auto aboveCosts = std::array<float, BinCount>{};
+			auto above = Aabb{};
+			auto aboveCount = std::size_t{ 0 };
+			for (auto bin = BinCount; bin-- > 1;)
+			{
+				above = Merge(above, binBounds[bin]);
+				aboveCount += binCounts[bin];
+				aboveCosts[bin] = SurfaceArea(above) * static_cast<float>(aboveCount);
+			}
+			auto best = std::size_t{ 1 };
+			auto bestCost = std::numeric_limits<float>::infinity();
+			auto below = Aabb{};
+			auto belowCount = std::size_t{ 0 };
+			for (std::size_t bin = 1; bin < BinCount; ++bin)
+			{
+				below = Merge(below, binBounds[bin - 1]);
+				belowCount += binCounts[bin - 1];
+				auto cost = SurfaceArea(below) * static_cast<float>(belowCount) + aboveCosts[bin];
+				if (cost < bestCost)
+				{
+					best = bin;
+					bestCost = cost;
+				}
+			}
+			auto split = static_cast<std::size_t>(std::partition(objects.begin(), objects.end(), [&](const BuildObject& object) { return binOf(object) < best; }) - objects.begin());
+			return split == 0 or split == objects.size() ? objects.size() / 2 : split;
+		}
+
+		auto AllocateNode(this Bvh& self) -> std::uint32_t
+		{
+			auto node = std::uint32_t{};
+			if (not self.freeNodes.empty())
+			{
+				node = self.freeNodes.back();
+				self.freeNodes.pop_back();
+				self.nodes[node] = Node{};
+			}
+			else
+			{
+				if (self.nodes.size() == InsideBit)
+					throw RuntimeError{ std::format("A Bvh can have at most {} nodes", InsideBit) };
+				node = static_cast<std::uint32_t>(self.nodes.size());
+				self.nodes.emplace_back();
+			}
+			return node;
+		}
+
+		void FreeNode(this Bvh& self, std::uint32_t node)
+		{
+			self.nodes[node].Count = 0;
+			self.nodes[node].Flags = Free;
+			self.nodes[node].Parent = NoNode;
+			self.freeNodes.push_back(node);
+		}
+
+		auto AllocateLeaf(this Bvh& self) -> std::uint32_t
+		{
+			if (not self.freeLeaves.empty())
+			{
+				auto leaf = self.freeLeaves.back();
+				self.freeLeaves.pop_back();
+				return leaf;
+			}
+			if (self.leaves.size() == MaxObjects)
+				throw RuntimeError{ std::format("A Bvh can hold at most {} objects", MaxObjects) };
+			self.leaves.emplace_back();
+			return static_cast<std::uint32_t>(self.leaves.size() - 1);
+		}
+
+		void CheckAlive(this const Bvh& self, BvhProxy proxy)
+		{
+			if (not self.Contains(proxy))
+				throw RuntimeError{ std::format("Bvh proxy {:#x} doesn't exist", std::to_underlying(proxy)) };
+		}
+
+		// The root is always node 0, even when the tree is empty.
+		std::vector<Node> nodes = std::vector<Node>(1);
+		std::vector<std::uint32_t> freeNodes;
+		std::vector<Leaf> leaves;
+		std::vector<std::uint32_t> freeLeaves;
+		std::vector<std::uint32_t> degraded;
+		// Scratch space for rebuilding, kept to save allocating it each time.
+		std::vector<BuildObject> buildObjects;
+		std::size_t size = 0;
+	};
+}
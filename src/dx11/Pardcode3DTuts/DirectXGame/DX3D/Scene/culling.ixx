@@ -0,0 +1,270 @@
+export module dx3d:scene.culling;
+import std;
+import :core.threadpool;
+import :math;
+
+export namespace dx3d
+{
+	// Bounding spheres as a structure of arrays, for culling many at a time.
+	class SphereArray
+	{
+	public:
+		auto Size(this const SphereArray& self) noexcept -> std::size_t { return self.columns.Size(); }
+		void Resize(this SphereArray& self, std::size_t size) { self.columns.Resize(size); }
+
+		void PushBack(this SphereArray& self, const Sphere& sphere)
+		{
+			self.Resize(self.Size() + 1);
+			self.Set(self.Size() - 1, sphere);
+		}
+
+		void Set(this SphereArray& self, std::size_t index, const Sphere& sphere)
+		{
+			self.columns.Column(0)[index] = sphere.Center.x;
+			self.columns.Column(1)[index] = sphere.Center.y;
+			self.columns.Column(2)[index] = sphere.Center.z;
+			self.columns.Column(3)[index] = sphere.Radius;
+		}
+
+		auto Get(this const SphereArray& self, std::size_t index) -> Sphere
+		{
+			return { { self.CenterX()[index], self.CenterY()[index], self.CenterZ()[index] }, self.Radius()[index] };
+		}
+
+		auto CenterX(this const SphereArray& self) noexcept -> const float* { return self.columns.Column(0); }
+		auto CenterY(this const SphereArray& self) noexcept -> const float* { return self.columns.Column(1); }
+		auto CenterZ(this const SphereArray& self) noexcept -> const float* { return self.columns.Column(2); }
+		auto Radius(this const SphereArray& self) noexcept -> const float* { return self.columns.Column(3); }
+
+	private:
+		Detail::FloatColumns<4> columns;
+	};
+
+	// Bounding boxes as a structure of arrays of centres and extents, which is what the
+	// plane tests use.
+	class AabbArray
+	{
+	public:
+		auto Size(this const AabbArray& self) noexcept -> std::size_t { return self.columns.Size(); }
+		void Resize(this AabbArray& self, std::size_t size) { self.columns.Resize(size); }
+
+		void PushBack(this AabbArray& self, const Aabb& box)
+		{
+			self.Resize(self.Size() + 1);
+			self.Set(self.Size() - 1, box);
+		}
+
+		void Set(this AabbArray& self, std::size_t index, const Aabb& box)
+		{
+			auto center = Center(box);
+			auto extents = Extents(box);
+			self.columns.Column(0)[index] = center.x;
+			self.columns.Column(1)[index] = center.y;
+			self.columns.Column(2)[index] = center.z;
+			self.columns.Column(3)[index] = extents.x;
+			self.columns.Column(4)[index] = extents.y;
+			self.columns.Column(5)[index] = extents.z;
+		}
+
+		auto Get(this const AabbArray& self, std::size_t index) -> Aabb
+		{
+			return FromCenterExtents(
+				{ self.CenterX()[index], self.CenterY()[index], self.CenterZ()[index] },
+				{ self.ExtentX()[index], self.ExtentY()[index], self.ExtentZ()[index] });
+		}
+
+		auto CenterX(this const AabbArray& self) noexcept -> const float* { return self.columns.Column(0); }
+		auto CenterY(this const AabbArray& self) noexcept -> const float* { return self.columns.Column(1); }
+		auto CenterZ(this const AabbArray& self) noexcept -> const float* { return self.columns.Column(2); }
+		auto ExtentX(this const AabbArray& self) noexcept -> const float* { return self.columns.Column(3); }
+		auto ExtentY(this const AabbArray& self) noexcept -> const float* { return self.columns.Column(4); }
+		auto ExtentZ(this const AabbArray& self) noexcept -> const float* { return self.columns.Column(5); }
+
+	private:
+		Detail::FloatColumns<6> columns;
+	};
+
+	namespace Detail
+	{
+		// Each plane's components in every lane, loaded once per chunk.
+		template<std::size_t VWidth>
+		struct FrustumLanes
+		{
+			explicit FrustumLanes(const Frustum& frustum) noexcept
+			{
+				for (std::size_t i = 0; i < frustum.Planes.size(); ++i)
+				{
+					auto& plane = frustum.Planes[i];
+					Planes[i] = {
+						Simd::SplatWide<VWidth>(plane.Normal.x),
+						Simd::SplatWide<VWidth>(plane.Normal.y),
+						Simd::SplatWide<VWidth>(plane.Normal.z),
+						Simd::SplatWide<VWidth>(plane.Distance),
+						Simd::SplatWide<VWidth>(std::abs(plane.Normal.x)),
+						Simd::SplatWide<VWidth>(std::abs(plane.Normal.y)),
+						Simd::SplatWide<VWidth>(std::abs(plane.Normal.z))
+					};
+				}
+			}
+
+			struct PlaneLanes
+			{
+				Simd::Wide<VWidth> X, Y, Z, Distance, AbsX, AbsY, AbsZ;
+			};
+
+			std::array<PlaneLanes, 6> Planes;
+		};
+
+		// Writes the index of each object in [begin, end) for which outsideMask(base)
+		// doesn't set the bit, VWidth objects at a time, and returns how many it wrote.
+		// Every lane's index is stored and the count only advanced past the visible ones,
+		// as whether a group has any visible objects is too random for a branch on it to
+		// predict. Lanes past end aren't stored, so nothing is written past out[end - begin).
+		template<std::size_t VWidth, typename TOutside>
+		auto CompactVisible(std::size_t begin, std::size_t end, std::uint32_t* out, TOutside outsideMask) noexcept -> std::size_t
+		{
+			auto written = std::size_t{ 0 };
+			auto compact = [&](std::size_t base, std::uint32_t visible, std::size_t lanes)
+			{
+				for (std::size_t lane = 0; lane < lanes; ++lane)
+				{
+					out[written] = static_cast<std::uint32_t>(base + lane);
+					written += (visible >> lane) & 1;
+				}
+			};
+			auto base = begin;
+			for (; end - base >= VWidth; base += VWidth)
+				compact(base, ~outsideMask(base), VWidth);
+			if (base < end)
+				compact(base, ~outsideMask(base), end - base);
+			return written;
+		}
+
+		template<std::size_t VWidth>
+		auto CullSpheres(const FrustumLanes<VWidth>& frustum, const SphereArray& spheres, std::size_t begin, std::size_t end, std::uint32_t* out) noexcept -> std::size_t
+		{
+			auto zero = Simd::SplatWide<VWidth>(0.0f);
+			return CompactVisible<VWidth>(begin, end, out,
+				[&](std::size_t base)
+				{
+					auto x = Simd::LoadWide<VWidth>(spheres.CenterX() + base);
+					auto y = Simd::LoadWide<VWidth>(spheres.CenterY() + base);
+					auto z = Simd::LoadWide<VWidth>(spheres.CenterZ() + base);
+					auto radius = Simd::LoadWide<VWidth>(spheres.Radius() + base);
+					// The distance to the nearest plane, so that there's one comparison
+					// rather than one per plane.
+					auto nearest = Simd::SplatWide<VWidth>(std::numeric_limits<float>::infinity());
+					for (auto& plane : frustum.Planes)
+						nearest = Simd::Min(nearest, Simd::MulAdd(plane.X, x, Simd::MulAdd(plane.Y, y, Simd::MulAdd(plane.Z, z, plane.Distance))));
+					return Simd::LessThanMask(Simd::Add(nearest, radius), zero);
+				});
+		}
+
+		template<std::size_t VWidth>
+		auto CullAabbs(const FrustumLanes<VWidth>& frustum, const AabbArray& boxes, std::size_t begin, std::size_t end, std::uint32_t* out) noexcept -> std::size_t
+		{
+			auto zero = Simd::SplatWide<VWidth>(0.0f);
+			return CompactVisible<VWidth>(begin, end, out,
+				[&](std::size_t base)
+				{
+					auto x = Simd::LoadWide<VWidth>(boxes.CenterX() + base);
+					auto y = Simd::LoadWide<VWidth>(boxes.CenterY() + base);
+					auto z = Simd::LoadWide<VWidth>(boxes.CenterZ() + base);
+					auto ex = Simd::LoadWide<VWidth>(boxes.ExtentX() + base);
+					auto ey = Simd::LoadWide<VWidth>(boxes.ExtentY() + base);
+					auto ez = Simd::LoadWide<VWidth>(boxes.ExtentZ() + base);
+					auto nearest = Simd::SplatWide<VWidth>(std::numeric_limits<float>::infinity());
+					for (auto& plane : frustum.Planes)
+					{
+						auto distance = Simd::MulAdd(plane.X, x, Simd::MulAdd(plane.Y, y, Simd::MulAdd(plane.Z, z, plane.Distance)));
+						// How far the box reaches towards the plane's inside from its centre.
+						auto reach = Simd::MulAdd(plane.AbsX, ex, Simd::MulAdd(plane.AbsY, ey, Simd::Mul(plane.AbsZ, ez)));
+						nearest = Simd::Min(nearest, Simd::Add(distance, reach));
+					}
+					return Simd::LessThanMask(nearest, zero);
+				});
+		}
+	}
+
+	// Tests arrays of bounds against a frustum, VWidth objects at a time and in chunks
+	// across the thread pool, and lists the indices of those that aren't entirely outside
+	// it in order. Keeps its buffers between calls, so that culling doesn't allocate once
+	// they've grown to the size of the scene.
+	class FrustumCuller
+	{
+	public:
+		// Objects per chunk. A multiple of every vector width.
+		static constexpr std::size_t GrainSize = 16384;
+
+		// The indices stay valid until the next call.
+		template<std::size_t VWidth = Simd::MaxWidth>
+		auto Cull(this FrustumCuller& self, const Frustum& frustum, const SphereArray& spheres, ThreadPool& pool = GetThreadPool()) -> std::span<const std::uint32_t>
+		{
+			auto lanes = Detail::FrustumLanes<VWidth>{ frustum };
+			return self.Run(spheres.Size(), pool,
+				[&](std::size_t begin, std::size_t end, std::uint32_t* out) { return Detail::CullSpheres<VWidth>(lanes, spheres, begin, end, out); });
+		}
+
+		template<std::size_t VWidth = Simd::MaxWidth>
+		auto Cull(this FrustumCuller& self, const Frustum& frustum, const AabbArray& boxes, ThreadPool& pool = GetThreadPool()) -> std::span<const std::uint32_t>
+		{
+			auto lanes = Detail::FrustumLanes<VWidth>{ frustum };
+			return self.Run(boxes.Size(), pool,
+				[&](std::size_t begin, std::size_t end, std::uint32_t* out) { return Detail::CullAabbs<VWidth>(lanes, boxes, begin, end, out); });
+		}
+
+	private:
+		// Each chunk writes its visible indices where its objects' indices start, then
+		// they're moved down to follow on from the chunks before.
+		template<typename TCullChunk>
+		auto Run(this FrustumCuller& self, std::size_t count, ThreadPool& pool, TCullChunk cullChunk) -> std::span<const std::uint32_t>
+		{
+			if (count > self.capacity)
+			{
+				self.indices = std::make_unique_for_overwrite<std::uint32_t[]>(count);
+				self.capacity = count;
+			}
+			self.chunkCounts.resize((count + GrainSize - 1) / GrainSize);
+			auto* indices = self.indices.get();
+			pool.ParallelFor(count, GrainSize,
+				[&](std::size_t begin, std::size_t end)
+				{
+					self.chunkCounts[begin / GrainSize] = cullChunk(begin, end, indices + begin);
+				});
+
+			auto visible = std::size_t{ 0 };
+			for (std::size_t chunk = 0; chunk < self.chunkCounts.size(); ++chunk)
+			{
+				auto* first = indices + chunk * GrainSize;
+				if (first != indices + visible)
+					std::copy_n(first, self.chunkCounts[chunk], indices + visible);
+				visible += self.chunkCounts[chunk];
+			}
+			return { indices, visible };
+		}
+
+		std::unique_ptr<std::uint32_t[]> indices;
+		std::size_t capacity = 0;
+		std::vector<std::size_t> chunkCounts;
+	};
+
+	// The reference for the SIMD culling, one object at a time with Intersects().
+	namespace Scalar
+	{
+		inline void Cull(const Frustum& frustum, const SphereArray& spheres, std::vector<std::uint32_t>& visible)
+		{
+			visible.clear();
+			for (std::size_t i = 0; i < spheres.Size(); ++i)
+				if (Intersects(frustum, spheres.Get(i)))
+					visible.push_back(static_cast<std::uint32_t>(i));
+		}
+
+		inline void Cull(const Frustum& frustum, const AabbArray& boxes, std::vector<std::uint32_t>& visible)
+		{
+			visible.clear();
+			for (std::size_t i = 0; i < boxes.Size(); ++i)
+				if (Intersects(frustum, boxes.Get(i)))
+					visible.push_back(static_cast<std::uint32_t>(i));
+		}
+	}
+}
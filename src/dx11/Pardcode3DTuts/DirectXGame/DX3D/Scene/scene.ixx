@@ -0,0 +1,4 @@
+export module dx3d:scene;
+export import :scene.transforms;
+export import :scene.culling;
+export import :scene.bvh;
@@ -0,0 +1,384 @@
+export module dx3d:scene.transforms;
+import std;
+import :core.threadpool;
+import :error.runtimerror;
+import :math;
+
+export namespace dx3d
+{
+	// A node's slot generation in the top 32 bits, then its depth in a byte and its slot in
+	// that depth's arrays. The generation changes when a node is removed, so an id that
+	// outlives its node is refused rather than aliasing whichever node takes its slot next.
+	enum class TransformId : std::uint64_t
+	{
+		None = 0xFFFFFFFFFFFFFFFF
+	};
+
+	// The scene's transform hierarchy. Nodes are grouped by depth, each depth a set of
+	// parallel arrays, so that updating world matrices is a linear pass per depth that
+	// only reads the depth above it. That makes each depth one parallel loop, and skips
+	// nodes whose local matrix and ancestors haven't changed since the last Update().
+	// Depths where only a few nodes need updating are walked from lists of those nodes
+	// instead, so that a sparse update doesn't cost a pass over the whole scene.
+	class TransformHierarchy
+	{
+	public:
+		static constexpr std::size_t MaxDepth = 255;
+		static constexpr std::size_t MaxNodesPerDepth = std::size_t{ 1 } << 24;
+		// Nodes per chunk when updating a depth in parallel.
+		static constexpr std::size_t GrainSize = 4096;
+		// A depth is updated from its lists while they hold fewer than one in this many of
+		// its slots. Walking them is random access and single threaded, where the full pass
+		// is linear and parallel, so they only win when they're short.
+		static constexpr std::size_t SparseFraction = 16;
+
+		auto Add(this TransformHierarchy& self, const Mat4& local, TransformId parent = TransformId::None) -> TransformId
+		{
+			auto depth = std::size_t{ 0 };
+			auto parentSlot = NoSlot;
+			if (parent != TransformId::None)
+			{
+				self.CheckAlive(parent);
+				depth = DepthOf(parent) + 1;
+				parentSlot = SlotOf(parent);
+				if (depth >= MaxDepth)
+					throw RuntimeError{ std::format("Transform hierarchies can be at most {} deep", MaxDepth) };
+			}
+			if (depth == self.levels.size())
+				self.levels.emplace_back();
+
+			// Checked before anything changes, so that a refused node leaves the hierarchy as it was.
+			auto& level = self.levels[depth];
+			if (level.FreeSlots.empty() and level.Flags.size() == MaxNodesPerDepth)
+				throw RuntimeError{ std::format("Transform hierarchies can have at most {} nodes at each depth", MaxNodesPerDepth) };
+			auto slot = std::uint32_t{};
+			if (not level.FreeSlots.empty())
+			{
+				slot = level.FreeSlots.back();
+				level.FreeSlots.pop_back();
+				level.Local[slot] = local;
+				level.Parent[slot] = parentSlot;
+				level.ChildCount[slot] = 0;
+				level.FirstChild[slot] = NoSlot;
+				level.ChangedIn[slot] = 0;
+				level.Flags[slot] = Dirty;
+			}
+			else
+			{
+				slot = static_cast<std::uint32_t>(level.Flags.size());
+				level.Local.push_back(local);
+				level.World.push_back(local);
+				level.Parent.push_back(parentSlot);
+				level.ChildCount.push_back(0);
+				level.FirstChild.push_back(NoSlot);
+				level.NextSibling.push_back(NoSlot);
+				level.PrevSibling.push_back(NoSlot);
+				level.Generation.push_back(0);
+				level.ChangedIn.push_back(0);
+				level.Flags.push_back(Dirty);
+			}
+			if (depth > 0)
+			{
+				auto& parentLevel = self.levels[depth - 1];
+				++parentLevel.ChildCount[parentSlot];
+				auto next = parentLevel.FirstChild[parentSlot];
+				level.PrevSibling[slot] = NoSlot;
+				level.NextSibling[slot] = next;
+				if (next != NoSlot)
+					level.PrevSibling[next] = slot;
+				parentLevel.FirstChild[parentSlot] = slot;
+			}
+			++level.DirtyCount;
+			level.DirtySlots.push_back(slot);
+			++self.size;
+			return MakeId(depth, slot, level.Generation[slot]);
+		}
+
+		// Children have to be removed before their parents.
+		void Remove(this TransformHierarchy& self, TransformId id)
+		{
+			self.CheckAlive(id);
+			auto depth = DepthOf(id);
+			auto slot = SlotOf(id);
+			auto& level = self.levels[depth];
+			if (level.ChildCount[slot] != 0)
+				throw RuntimeError{ "Can't remove a transform that still has children" };
+			if (level.Flags[slot] & Dirty)
+				--level.DirtyCount;
+			if (depth > 0)
+			{
+				auto& parentLevel = self.levels[depth - 1];
+				--parentLevel.ChildCount[level.Parent[slot]];
+				auto previous = level.PrevSibling[slot];
+				auto next = level.NextSibling[slot];
+				if (previous != NoSlot)
+					level.NextSibling[previous] = next;
+				else
+					parentLevel.FirstChild[level.Parent[slot]] = next;
+				if (next != NoSlot)
+					level.PrevSibling[next] = previous;
+			}
+			++level.Generation[slot];
+			level.Flags[slot] = Free;
+			level.FreeSlots.push_back(slot);
+			--self.size;
+		}
+
+		void SetLocal(this TransformHierarchy& self, TransformId id, const Mat4& local)
+		{
+			self.CheckAlive(id);
+			auto& level = self.levels[DepthOf(id)];
+			auto slot = SlotOf(id);
+			level.Local[slot] = local;
+			if (not (level.Flags[slot] & Dirty))
+			{
+				level.Flags[slot] |= Dirty;
+				++level.DirtyCount;
+				level.DirtySlots.push_back(slot);
+			}
+		}
+
+		auto GetLocal(this const TransformHierarchy& self, TransformId id) -> const Mat4&
+		{
+			self.CheckAlive(id);
+			return self.levels[DepthOf(id)].Local[SlotOf(id)];
+		}
+
+		// As of the last Update().
+		auto GetWorld(this const TransformHierarchy& self, TransformId id) -> const Mat4&
+		{
+			self.CheckAlive(id);
+			return self.levels[DepthOf(id)].World[SlotOf(id)];
+		}
+
+		// Whether the last Update() changed the node's world matrix.
+		auto WorldChanged(this const TransformHierarchy& self, TransformId id) -> bool
+		{
+			self.CheckAlive(id);
+			return self.levels[DepthOf(id)].ChangedIn[SlotOf(id)] == self.epoch;
+		}
+
+		auto Contains(this const TransformHierarchy& self, TransformId id) noexcept -> bool
+		{
+			if (id == TransformId::None or DepthOf(id) >= self.levels.size())
+				return false;
+			auto& level = self.levels[DepthOf(id)];
+			auto slot = SlotOf(id);
+			return slot < level.Flags.size() and not (level.Flags[slot] & Free) and level.Generation[slot] == GenerationOf(id);
+		}
+
+		auto Size(this const TransformHierarchy& self) noexcept -> std::size_t
+		{
+			return self.size;
+		}
+
+		auto Depth(this const TransformHierarchy& self) noexcept -> std::size_t
+		{
+			return self.levels.size();
+		}
+
+		// Recomputes the world matrices of nodes that were added or given a new local
+		// matrix since the last Update(), and of all their descendants. One depth at a
+		// time, each either from its lists or across the pool.
+		void Update(this TransformHierarchy& self, ThreadPool& pool = GetThreadPool())
+		{
+			// Nodes record the update that last changed them, so nothing has to be cleared
+			// between updates, except on the rare wrap of the counter.
+			if (++self.epoch == 0)
+			{
+				for (auto& level : self.levels)
+					std::ranges::fill(level.ChangedIn, 0);
+				self.epoch = 1;
+			}
+
+			for (std::size_t depth = 0; depth < self.levels.size(); ++depth)
+			{
+				auto& level = self.levels[depth];
+				auto* parent = depth > 0 ? &self.levels[depth - 1] : nullptr;
+				if (level.DirtyCount == 0 and not (parent and parent->ChangedCount > 0))
+				{
+					level.DirtySlots.clear();
+					level.ChangedSlots.clear();
+					level.ChangedCount = 0;
+					level.ChangedListed = true;
+					continue;
+				}
+
+				if (IsSparse(level, parent))
+				{
+					UpdateSparse(level, parent, self.epoch);
+					continue;
+				}
+
+				auto changedCount = std::atomic<std::size_t>{ 0 };
+				pool.ParallelFor(level.Flags.size(), GrainSize,
+					[&level, parent, epoch = self.epoch, &changedCount](std::size_t begin, std::size_t end)
+					{
+						auto changed = parent ? UpdateChildren(level, *parent, epoch, begin, end) : UpdateRoots(level, epoch, begin, end);
+						changedCount.fetch_add(changed, std::memory_order_relaxed);
+					});
+				level.DirtyCount = 0;
+				level.DirtySlots.clear();
+				level.ChangedSlots.clear();
+				level.ChangedCount = changedCount.load(std::memory_order_relaxed);
+				// The full pass doesn't list what it changed, so the depth below can't use
+				// its lists unless nothing did.
+				level.ChangedListed = level.ChangedCount == 0;
+			}
+		}
+
+	private:
+		static constexpr std::uint32_t NoSlot = 0xFFFFFFFF;
+
+		enum Flag : std::uint8_t
+		{
+			// The local matrix changed since the last update.
+			Dirty = 1,
+			// The slot is on the free list.
+			Free = 2
+		};
+
+		// The nodes at one depth.
+		struct Level
+		{
+			std::vector<Mat4> Local;
+			std::vector<Mat4> World;
+			// Slots in the depth above.
+			std::vector<std::uint32_t> Parent;
+			std::vector<std::uint32_t> ChildCount;
+			// Each node's children, as a list through the depth below's sibling links.
+			std::vector<std::uint32_t> FirstChild;
+			std::vector<std::uint32_t> NextSibling;
+			std::vector<std::uint32_t> PrevSibling;
+			// Bumped when the slot is freed, to tell its ids apart from its next node's.
+			std::vector<std::uint32_t> Generation;
+			// The update that last changed the node's world matrix.
+			std::vector<std::uint32_t> ChangedIn;
+			std::vector<std::uint8_t> Flags;
+			std::vector<std::uint32_t> FreeSlots;
+			// Slots made dirty since the last update. Slots removed since stay listed, and
+			// a removed slot that's reused can be listed twice.
+			std::vector<std::uint32_t> DirtySlots;
+			// The slots the current update changed, if ChangedListed.
+			std::vector<std::uint32_t> ChangedSlots;
+			std::size_t DirtyCount = 0;
+			// How many nodes the current update changed.
+			std::size_t ChangedCount = 0;
+			bool ChangedListed = true;
+		};
+
+		// Whether the nodes to update at this depth are few enough, and known, to be walked
+		// from the lists: the dirty nodes and the children of the parents that changed.
+		static auto IsSparse(const Level& level, const Level* parent) noexcept -> bool
+		{
+			auto work = level.DirtySlots.size();
+			if (parent and parent->ChangedCount > 0)
+			{
+				if (not parent->ChangedListed)
+					return false;
+				for (auto parentSlot : parent->ChangedSlots)
+					work += parent->ChildCount[parentSlot];
+			}
+			return work * SparseFraction <= level.Flags.size();
+		}
+
+		static void UpdateSparse(Level& level, const Level* parent, std::uint32_t epoch)
+		{
+			level.ChangedSlots.clear();
+			auto update = [&level, parent, epoch](std::uint32_t slot)
+			{
+				// Dirty nodes come first, so a dirty child of a changed parent is skipped the
+				// second time round.
+				if ((level.Flags[slot] & Free) or level.ChangedIn[slot] == epoch)
+					return;
+				level.World[slot] = parent ? parent->World[level.Parent[slot]] * level.Local[slot] : level.Local[slot];
+				level.Flags[slot] = 0;
+				level.ChangedIn[slot] = epoch;
+				level.ChangedSlots.push_back(slot);
+			};
+			for (auto slot : level.DirtySlots)
+				if (level.Flags[slot] & Dirty)
+					update(slot);
+			if (parent)
+				for (auto parentSlot : parent->ChangedSlots)
+					for (auto slot = parent->FirstChild[parentSlot]; slot != NoSlot; slot = level.NextSibling[slot])
+						update(slot);
+			level.DirtyCount = 0;
+			level.DirtySlots.clear();
+			level.ChangedCount = level.ChangedSlots.size();
+			level.ChangedListed = true;
+		}
+
+		static auto UpdateRoots(Level& level, std::uint32_t epoch, std::size_t begin, std::size_t end) noexcept -> std::size_t
+		{
+			auto changedCount = std::size_t{ 0 };
+			for (auto slot = begin; slot < end; ++slot)
+			{
+				auto flags = level.Flags[slot];
+				auto changed = (flags & (Dirty | Free)) == Dirty;
+				if (changed)
+				{
+					level.World[slot] = level.Local[slot];
+					level.ChangedIn[slot] = epoch;
+				}
+				level.Flags[slot] = static_cast<std::uint8_t>(flags & Free);
+				changedCount += changed;
+			}
+			return changedCount;
+		}
+
+		static auto UpdateChildren(Level& level, const Level& parent, std::uint32_t epoch, std::size_t begin, std::size_t end) noexcept -> std::size_t
+		{
+			auto changedCount = std::size_t{ 0 };
+			for (auto slot = begin; slot < end; ++slot)
+			{
+				auto flags = level.Flags[slot];
+				auto changed = false;
+				if (not (flags & Free))
+				{
+					auto parentSlot = level.Parent[slot];
+					changed = (flags & Dirty) or parent.ChangedIn[parentSlot] == epoch;
+					if (changed)
+					{
+						level.World[slot] = parent.World[parentSlot] * level.Local[slot];
+						level.ChangedIn[slot] = epoch;
+					}
+				}
+				level.Flags[slot] = static_cast<std::uint8_t>(flags & Free);
+				changedCount += changed;
+			}
+			return changedCount;
+		}
+
+		static constexpr auto MakeId(std::size_t depth, std::uint32_t slot, std::uint32_t generation) noexcept -> TransformId
+		{
+			return static_cast<TransformId>(std::uint64_t{ generation } << 32 | std::uint64_t{ depth } << 24 | slot);
+		}
+
+		static constexpr auto DepthOf(TransformId id) noexcept -> std::size_t
+		{
+			return (std::to_underlying(id) >> 24) & 0xFF;
+		}
+
+		static constexpr auto SlotOf(TransformId id) noexcept -> std::uint32_t
+		{
+			return static_cast<std::uint32_t>(std::to_underlying(id) & (MaxNodesPerDepth - 1));
+		}
+
+		static constexpr auto GenerationOf(TransformId id) noexcept -> std::uint32_t
+		{
+			return static_cast<std::uint32_t>(std::to_underlying(id) >> 32);
+		}
+
+		void CheckAlive(this const TransformHierarchy& self, TransformId id)
+		{
+			if (not self.Contains(id))
+				throw RuntimeError{ std::format("Transform {:#x} doesn't exist", std::to_underlying(id)) };
+		}
+
+		std::vector<Level> levels;
+		std::size_t size = 0;
+		// Counts updates. Starts past 0, which marks nodes no update has changed yet.
+		std::uint32_t epoch = 1;
+	};
+}
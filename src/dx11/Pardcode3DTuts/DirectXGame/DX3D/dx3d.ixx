@@ -7,3 +7,4 @@ export import :graphics;
 export import :error;
 export import :com;
 export import :math;
+export import :scene;
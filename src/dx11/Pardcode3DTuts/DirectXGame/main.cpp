@@ -2,11 +2,52 @@
 
 import std;
 import dx3d;
+import benchmarks;
 
-auto main() -> int
+// Usage:
+//   DirectXGame.exe [--binary-log <file>]
+//   DirectXGame.exe --decode-log <file> [<output file>]
+//   DirectXGame.exe --benchmark [--filter <substring>] [--format json|csv] [--out <file>] [--samples <n>] [--min-sample-ms <n>]
+auto main(int argc, char* argv[]) -> int
 try
 {
-	auto game = dx3d::Game{dx3d::GameDesc{.WindowSize = {1280, 720}}};
+	auto args = std::vector<std::string_view>(argv + 1, argv + argc);
+	if (args.size() >= 2 and args[0] == "--decode-log")
+	{
+		auto in = std::ifstream{ std::filesystem::path{ args[1] }, std::ios::binary };
+		if (not in)
+			throw dx3d::RuntimeError{ std::format("Failed to open {}", args[1]) };
+		if (args.size() >= 3)
+		{
+			auto out = std::ofstream{ std::filesystem::path{ args[2] } };
+			if (not out.is_open())
+				throw dx3d::RuntimeError{ std::format("Failed to open {}", args[2]) };
+			dx3d::Logger::DecodeBinaryLog(in, out);
+			out.close();
+			if (not out)
+				throw dx3d::RuntimeError{ std::format("Failed to write {}", args[2]) };
+		}
+		else
+		{
+			dx3d::Logger::DecodeBinaryLog(in, std::cout);
+			std::cout.flush();
+			if (not std::cout)
+				throw dx3d::RuntimeError{ "Failed to write the decoded log" };
+		}
+		return 0;
+	}
+
+	if (not args.empty() and args[0] == "--benchmark")
+	{
+		Benchmarks::Run(std::span{ args }.subspan(1));
+		return 0;
+	}
+
+	auto desc = dx3d::GameDesc{.WindowSize = {1280, 720}};
+	if (args.size() >= 2 and args[0] == "--binary-log")
+		desc.BinaryLogPath = std::filesystem::path{ args[1] };
+
+	auto game = dx3d::Game{desc};
 	game.Run();
 	return 0;
 }
@@ -13,8 +13,12 @@ export namespace Approach2
 	class D3D12xApp
 	{
 	public:
-		D3D12xApp()
+		D3D12xApp(App::LoopMode loopMode = App::LoopMode::Continuous, App::FrameTimerDesc frameTiming = {})
+			: FrameLoopMode(loopMode), FrameTiming(frameTiming)
 		{
+			// Only App::D3D12App has a render thread to hand the frame to.
+			if (loopMode == App::LoopMode::RenderThread)
+				throw Error::RuntimeError{ "Approach2 doesn't support LoopMode::RenderThread" };
 			window.Initialise();
 			InitialiseD3D12();
 		}
@@ -29,8 +33,29 @@ export namespace Approach2
 			// Application idle processing goes here
 		}
 
+		void OnUpdate(this auto& self, std::chrono::nanoseconds step)
+		{
+			// Fixed-timestep simulation goes here
+		}
+
+		void OnRender(this auto& self, double alpha)
+		{
+			self.OnIdle();
+		}
+
+		void Present(this auto& self, std::uint32_t syncInterval = 1, std::uint32_t flags = 0)
+		{
+			auto hr = Com::HResult{ self.SwapChain->Present(syncInterval, flags) };
+			if (not hr)
+				throw Error::ComError(hr, "Failed to present swap chain");
+			self.PresentCount++;
+		}
+
 		auto MainLoop(this auto&& self) -> Win32::LRESULT
 		{
+			if (self.FrameLoopMode == App::LoopMode::EventDriven)
+				return self.EventDrivenLoop();
+
 			auto msg = Win32::MSG{};
 			while (msg.message != Win32::Messages::Quit)
 			{
@@ -46,11 +71,48 @@ export namespace Approach2
 			}
 			return msg.wParam;
 		}
+	private:
+		// The same loop App::D3D12App runs, over this app's own swap chain and fence.
+		auto EventDrivenLoop(this auto& self) -> Win32::LRESULT
+		{
+			auto frameFenceValues = std::vector<std::uint64_t>(self.SwapChainBufferCount);
+			return App::RunEventDrivenLoop(
+				self.FrameTiming,
+				frameFenceValues,
+				[&self]
+				{
+					return App::FrameSync{
+						.FrameLatencyWaitable = self.FrameLatencyWaitable.get(),
+						.Fence = self.Fence.get(),
+						.FenceEvent = self.FrameFenceEvent.GetHandle()
+					};
+				},
+				[&self](const App::FrameTick& tick)
+				{
+					auto presents = self.PresentCount;
+					for (std::uint32_t i = 0; i < tick.Updates; ++i)
+						self.OnUpdate(self.FrameTiming.UpdateStep);
+					self.OnRender(tick.Alpha);
+
+					self.currentFence++;
+					auto hr = Com::HResult{ self.CommandQueue->Signal(self.Fence.get(), self.currentFence) };
+					if (not hr)
+						throw Error::ComError(hr, "Failed to signal command queue");
+					return App::FrameResult{ .Presented = self.PresentCount != presents, .FenceValue = self.currentFence };
+				});
+		}
+
 	private:
 		using Window = Common::AppWindow<D3D12xApp>;
 		Window window{ this, 800, 600 };
 
 	private:
+		App::LoopMode FrameLoopMode = App::LoopMode::Continuous;
+		App::FrameTimerDesc FrameTiming{};
+		Raii::HandleUniquePtr FrameLatencyWaitable;
+		Async::AutoResetEvent FrameFenceEvent;
+		std::uint64_t PresentCount = 0;
+
 		bool Msaa4xState = false;
 		DXGI::DXGI_FORMAT BackBufferFormat = DXGI::DXGI_FORMAT::DXGI_FORMAT_R8G8B8A8_UNORM;
 
@@ -103,7 +165,11 @@ export namespace Approach2
 
 		auto CreateSwapChain(this auto& self) -> decltype(auto)
 		{
+			self.FrameLatencyWaitable.reset();
 			self.SwapChain.reset();
+			auto flags = static_cast<std::uint32_t>(DXGI::DXGI_SWAP_CHAIN_FLAG::DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH);
+			if (self.FrameLoopMode == App::LoopMode::EventDriven)
+				flags |= DXGI::DXGI_SWAP_CHAIN_FLAG::DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 			auto swapChainDesc = DXGI::DXGI_SWAP_CHAIN_DESC{
 				.BufferDesc{
 					.Width = self.window.GetWidth(),
@@ -125,7 +191,7 @@ export namespace Approach2
 				.OutputWindow = self.window.GetHandle(),
 				.Windowed = true,
 				.SwapEffect = DXGI::DXGI_SWAP_EFFECT::DXGI_SWAP_EFFECT_FLIP_DISCARD,
-				.Flags = DXGI::DXGI_SWAP_CHAIN_FLAG::DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH
+				.Flags = flags
 			};
 			auto hr = Com::HResult{
 				self.DxgiFactory->CreateSwapChain(
@@ -136,6 +202,18 @@ export namespace Approach2
 			if (not hr)
 				throw Error::ComError(hr, "Failed to create DXGI Swap Chain");
 
+			if (self.FrameLoopMode == App::LoopMode::EventDriven)
+			{
+				auto swapChain2 = Com::Ptr<DXGI::IDXGISwapChain2>{};
+				hr = self.SwapChain->QueryInterface(swapChain2.GetUuid(), swapChain2.AddressOf());
+				if (not hr)
+					throw Error::ComError(hr, "Failed to query IDXGISwapChain2");
+				hr = swapChain2->SetMaximumFrameLatency(1);
+				if (not hr)
+					throw Error::ComError(hr, "Failed to set maximum frame latency");
+				self.FrameLatencyWaitable = Raii::HandleUniquePtr{ swapChain2->GetFrameLatencyWaitableObject() };
+			}
+
 			return self;
 		}
 
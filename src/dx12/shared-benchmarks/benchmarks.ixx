@@ -0,0 +1,7 @@
+export module benchmarks;
+export import :harness;
+export import :primitives;
+export import :threading;
+export import :dispatch;
+export import :callables;
+export import :logging;
@@ -0,0 +1,181 @@
+export module benchmarks:callables;
+import std;
+import shared;
+import :harness;
+
+namespace
+{
+	using Message = App::Win32Message<Win32::Messages::Size>;
+
+	// Larger than MSVC's std::function small buffer, so std::function has to allocate.
+	struct LargeCapture
+	{
+		std::array<std::uint64_t, 6> Values{ 1, 2, 3, 4, 5, 6 };
+	};
+
+	// Counts how many times the callable it's moved into is destroyed.
+	struct CountsDestruction
+	{
+		CountsDestruction(int& destroyed) noexcept
+			: Destroyed(&destroyed)
+		{ }
+
+		CountsDestruction(CountsDestruction&& other) noexcept
+			: Destroyed(std::exchange(other.Destroyed, nullptr))
+		{ }
+
+		~CountsDestruction()
+		{
+			if (Destroyed)
+				++*Destroyed;
+		}
+
+		void operator()() const { }
+
+		int* Destroyed;
+	};
+
+	void CheckInplaceFunction()
+	{
+		auto function = Util::InplaceFunction<int(int)>{ [](int x) { return x * 2; } };
+		auto moved = std::move(function);
+		if (function or not moved or moved(21) != 42)
+			throw std::runtime_error{ "Expected a moved InplaceFunction to take the callable" };
+
+		auto destroyed = 0;
+		auto counted = Util::InplaceFunction<void()>{ CountsDestruction{ destroyed } };
+		auto target = Util::InplaceFunction<void()>{ std::move(counted) };
+		target();
+		target.reset();
+		if (target or destroyed != 1)
+			throw std::runtime_error{ std::format("Expected reset to destroy the callable once, it was destroyed {} times", destroyed) };
+
+		moved = nullptr;
+		if (moved)
+			throw std::runtime_error{ "Expected assigning null to empty the InplaceFunction" };
+		try
+		{
+			moved(1);
+			throw std::runtime_error{ "Expected calling an empty InplaceFunction to throw" };
+		}
+		catch (const std::bad_function_call&)
+		{ }
+	}
+
+	void CheckHandlerList()
+	{
+		using Handlers = Util::HandlerList<void(int), 4>;
+		auto order = std::vector<int>{};
+		auto handlers = Handlers{};
+		auto ids = std::array<Handlers::SubscriptionId, 3>{};
+		ids[0] = handlers.Subscribe([&order](int value) { order.push_back(value); });
+		// Removes itself and the handler after it, which mustn't then be called.
+		ids[1] = handlers.Subscribe(
+			[&order, &handlers, &ids](int value)
+			{
+				order.push_back(value + 1);
+				handlers.Unsubscribe(ids[1]);
+				handlers.Unsubscribe(ids[2]);
+			});
+		ids[2] = handlers.Subscribe([&order](int value) { order.push_back(value + 2); });
+
+		handlers(10);
+		handlers(20);
+		if (order != std::vector{ 10, 11, 20 } or handlers.Size() != 1)
+			throw std::runtime_error{ "Expected handlers in slot order, without those unsubscribed during the notification" };
+
+		// The freed slots are reused once the notification is over.
+		if (handlers.Subscribe([](int) { }) != ids[1])
+			throw std::runtime_error{ "Expected an unsubscribed slot to be reused" };
+		for (auto i = handlers.Size(); i < 4; ++i)
+			handlers.Subscribe([](int) { });
+		try
+		{
+			handlers.Subscribe([](int) { });
+			throw std::runtime_error{ "Expected subscribing to a full HandlerList to throw" };
+		}
+		catch (const Error::RuntimeError&)
+		{ }
+	}
+
+	template<typename TFunction>
+	void AddCallable(Bench::Runner& runner, std::string_view name)
+	{
+		runner.Add(
+			std::format("{}/Call", name),
+			[](std::uint64_t iterations)
+			{
+				auto total = Win32::LRESULT{};
+				auto function = TFunction{ [&total](const Message& msg) { return total += static_cast<Win32::LRESULT>(msg.wParam); } };
+				auto msg = Message{ nullptr, 1, 0 };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					Bench::DoNotOptimize(msg);
+					Bench::DoNotOptimize(function(msg));
+				}
+			});
+
+		runner.Add(
+			std::format("{}/AssignLargeAndCall", name),
+			[](std::uint64_t iterations)
+			{
+				auto function = TFunction{};
+				auto msg = Message{ nullptr, 1, 0 };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					function = [capture = LargeCapture{}](const Message& msg)
+						{
+							return static_cast<Win32::LRESULT>(capture.Values[msg.wParam]);
+						};
+					Bench::DoNotOptimize(function(msg));
+				}
+			});
+	}
+}
+
+export namespace Benchmarks
+{
+	void AddCallables(Bench::Runner& runner)
+	{
+		CheckInplaceFunction();
+		CheckHandlerList();
+
+		AddCallable<std::function<Win32::LRESULT(const Message&)>>(runner, "std::function");
+		AddCallable<Util::InplaceFunction<Win32::LRESULT(const Message&), 64>>(runner, "Util::InplaceFunction");
+
+		runner.Add(
+			"Util::HandlerList/Notify4",
+			[](std::uint64_t iterations)
+			{
+				auto total = std::uint64_t{};
+				auto handlers = Util::HandlerList<void(const Message&)>{};
+				for (int i = 0; i < 4; ++i)
+					handlers.Subscribe([&total](const Message& msg) { total += msg.wParam; });
+				auto msg = Message{ nullptr, 1, 0 };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					Bench::DoNotOptimize(msg);
+					handlers(msg);
+				}
+				Bench::DoNotOptimize(total);
+			});
+
+		runner.Add(
+			"std::vector<std::function>/Notify4",
+			[](std::uint64_t iterations)
+			{
+				auto total = std::uint64_t{};
+				auto handlers = std::vector<std::function<void(const Message&)>>{};
+				for (int i = 0; i < 4; ++i)
+					handlers.push_back([&total](const Message& msg) { total += msg.wParam; });
+				auto msg = Message{ nullptr, 1, 0 };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					Bench::DoNotOptimize(msg);
+					for (const auto& handler : handlers)
+						handler(msg);
+				}
+				Bench::DoNotOptimize(total);
+			});
+	}
+}
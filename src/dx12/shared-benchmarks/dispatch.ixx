@@ -0,0 +1,117 @@
+export module benchmarks:dispatch;
+import std;
+import shared;
+import :harness;
+
+namespace
+{
+	constexpr auto SyntheticMessageIds =
+		[] {
+			auto ids = std::array<std::uint32_t, 256>{};
+			for (std::uint32_t i = 0; i < ids.size(); ++i)
+				ids[i] = 0x400 + i * 3;
+			return ids;
+		}();
+
+	// Handles every fourth synthetic message.
+	struct SyntheticWindow
+	{
+		template<Win32::DWORD VMessageId> requires (VMessageId % 4 == 0)
+		auto OnMessage(App::Win32Message<VMessageId> msg) -> Win32::LRESULT
+		{
+			return Total += VMessageId + static_cast<Win32::LRESULT>(msg.wParam);
+		}
+
+		Win32::LRESULT Total = 0;
+	};
+
+	struct TypicalWindow
+	{
+		auto OnMessage(App::Win32Message<Win32::Messages::Size> msg) -> Win32::LRESULT
+		{
+			return Total += static_cast<Win32::LRESULT>(msg.lParam);
+		}
+
+		auto OnMessage(App::Win32Message<Win32::Messages::Paint>) -> Win32::LRESULT
+		{
+			return ++Total;
+		}
+
+		auto OnMessage(App::Win32Message<Win32::Messages::KeyUp> msg) -> Win32::LRESULT
+		{
+			return Total += static_cast<Win32::LRESULT>(msg.wParam);
+		}
+
+		Win32::LRESULT Total = 0;
+	};
+
+	// The linear fold WindowedApp::HandleMessage used before the dispatch table.
+	template<auto VMessages, typename TWindow>
+	auto FoldDispatch(TWindow& window, unsigned msgType, Win32::WPARAM wParam, Win32::LPARAM lParam) -> std::optional<Win32::LRESULT>
+	{
+		return [&]<std::size_t...Is>(std::index_sequence<Is...>) -> std::optional<Win32::LRESULT>
+		{
+			auto result = Win32::LRESULT{};
+			bool handled = (... or
+				[&]<typename TMsg = App::Win32Message<VMessages[Is]>>
+				{
+					if constexpr (App::Handles<TWindow, TMsg>)
+						return TMsg::uMsg == msgType ? (result = window.OnMessage(TMsg{ nullptr, wParam, lParam }), true) : false;
+					return false;
+				}());
+			return handled ? std::optional{ result } : std::nullopt;
+		}(std::make_index_sequence<VMessages.size()>());
+	}
+
+	// A stream of ids drawn from the set, with a quarter of them unknown to it.
+	template<auto VMessages>
+	auto MakeMessageStream() -> std::vector<unsigned>
+	{
+		auto random = std::mt19937{ 42 };
+		auto pick = std::uniform_int_distribution<std::size_t>{ 0, VMessages.size() - 1 };
+		auto stream = std::vector<unsigned>(4096);
+		for (std::size_t i = 0; i < stream.size(); ++i)
+			stream[i] = i % 4 == 3
+				? 0x7000 + static_cast<unsigned>(i)
+				: static_cast<unsigned>(VMessages[pick(random)]);
+		return stream;
+	}
+
+	template<auto VMessages, typename TWindow>
+	void AddDispatchPair(Bench::Runner& runner, std::string_view name)
+	{
+		runner.Add(
+			std::format("App::HandleMessage/{}/Fold", name),
+			[stream = MakeMessageStream<VMessages>()](std::uint64_t iterations)
+			{
+				auto window = TWindow{};
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto result = FoldDispatch<VMessages>(window, stream[i & (stream.size() - 1)], 1, 2);
+					Bench::DoNotOptimize(result);
+				}
+			});
+
+		runner.Add(
+			std::format("App::HandleMessage/{}/PerfectHash", name),
+			[stream = MakeMessageStream<VMessages>()](std::uint64_t iterations)
+			{
+				using Dispatcher = App::MessageDispatcher<TWindow, VMessages>;
+				auto window = TWindow{};
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto result = Dispatcher::Dispatch(window, nullptr, stream[i & (stream.size() - 1)], 1, 2);
+					Bench::DoNotOptimize(result);
+				}
+			});
+	}
+}
+
+export namespace Benchmarks
+{
+	void AddDispatch(Bench::Runner& runner)
+	{
+		AddDispatchPair<App::HandledMessages, TypicalWindow>(runner, "HandledMessages");
+		AddDispatchPair<SyntheticMessageIds, SyntheticWindow>(runner, "Synthetic256");
+	}
+}
@@ -0,0 +1,130 @@
+export module benchmarks:logging;
+import std;
+import shared;
+import :harness;
+
+namespace
+{
+	// Counts what it's given, so the benchmarks measure the backend rather than the console.
+	class CountingSink : public Log::Sink
+	{
+	public:
+		CountingSink(std::atomic<std::uint64_t>& lines)
+			: lines(lines)
+		{ }
+
+		void Write(std::string_view text) override
+		{
+			lines.fetch_add(std::ranges::count(text, '\n'), std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<std::uint64_t>& lines;
+	};
+
+	auto MakeBackend(Log::OverflowPolicy overflow, std::atomic<std::uint64_t>& lines) -> std::unique_ptr<Log::AsyncBackend>
+	{
+		auto sinks = std::vector<std::unique_ptr<Log::Sink>>{};
+		sinks.push_back(std::make_unique<CountingSink>(lines));
+		return std::make_unique<Log::AsyncBackend>(Log::AsyncBackendDesc{ .Overflow = overflow }, std::move(sinks));
+	}
+
+	void CheckTimestampCache()
+	{
+		auto cache = Log::TimestampCache{};
+		auto now = std::chrono::system_clock::now();
+		for (auto offset : { std::chrono::nanoseconds{ 0 }, std::chrono::nanoseconds{ 1'500 }, std::chrono::nanoseconds{ 2'000'000'000 } })
+		{
+			auto time = now + std::chrono::duration_cast<std::chrono::system_clock::duration>(offset);
+			if (cache.Format(time) != std::format("{}", time))
+				throw std::runtime_error{ std::format("Expected the cached timestamp {} to match {}", cache.Format(time), time) };
+		}
+	}
+
+	// Each operation is one message logged from one of threadCount threads. Checks that every
+	// message logged under the Block policy reaches the sink.
+	void LogFromThreads(std::uint64_t iterations, std::size_t threadCount, Log::OverflowPolicy overflow)
+	{
+		auto lines = std::atomic<std::uint64_t>{};
+		auto backend = MakeBackend(overflow, lines);
+		auto previous = Log::SetBackend(backend.get());
+		{
+			auto threads = std::vector<std::jthread>{};
+			for (std::size_t thread = 0; thread < threadCount; ++thread)
+				threads.emplace_back(
+					[count = iterations / threadCount + (thread < iterations % threadCount ? 1 : 0)]
+					{
+						for (std::uint64_t i = 0; i < count; ++i)
+							Log::Info("Frame {} took {}us", i, 16'667);
+					});
+		}
+		backend->Flush();
+		Log::SetBackend(previous);
+
+		auto expected = overflow == Log::OverflowPolicy::Block ? iterations : iterations - backend->GetDroppedCount();
+		if (lines.load() < expected)
+			throw std::runtime_error{ std::format("Expected {} log lines but the sink got {}", expected, lines.load()) };
+	}
+}
+
+export namespace Benchmarks
+{
+	void AddLogging(Bench::Runner& runner)
+	{
+		CheckTimestampCache();
+
+		runner.Add(
+			"Log::AsyncBackend/Info/1Thread/Block",
+			[](std::uint64_t iterations) { LogFromThreads(iterations, 1, Log::OverflowPolicy::Block); });
+		runner.Add(
+			"Log::AsyncBackend/Info/4Threads/Block",
+			[](std::uint64_t iterations) { LogFromThreads(iterations, 4, Log::OverflowPolicy::Block); });
+		runner.Add(
+			"Log::AsyncBackend/Info/4Threads/Drop",
+			[](std::uint64_t iterations) { LogFromThreads(iterations, 4, Log::OverflowPolicy::Drop); });
+
+		// Each operation is one call from a site limited to one in every 1000 calls, which
+		// is checked against what reaches the sink.
+		runner.Add(
+			"Log::WarnLimited/EveryN1000",
+			[](std::uint64_t iterations)
+			{
+				auto lines = std::atomic<std::uint64_t>{};
+				auto backend = MakeBackend(Log::OverflowPolicy::Block, lines);
+				auto previous = Log::SetBackend(backend.get());
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					Log::WarnLimited(Log::RateLimit{ .EveryN = 1000 }, "Frame {} failed", i);
+				backend->Flush();
+				Log::SetBackend(previous);
+
+				// The site's call count carries over between samples, so allow for one either way.
+				auto expected = iterations / 1000;
+				if (lines.load() + 1 < expected or lines.load() > expected + 1)
+					throw std::runtime_error{ std::format("Expected about {} log lines but the sink got {}", expected, lines.load()) };
+			});
+
+		runner.Add(
+			"Log::TimestampCache/Format",
+			[](std::uint64_t iterations)
+			{
+				auto cache = Log::TimestampCache{};
+				auto time = std::chrono::system_clock::now();
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					time += std::chrono::microseconds{ 1 };
+					Bench::DoNotOptimize(cache.Format(time));
+				}
+			});
+		runner.Add(
+			"std::format/system_clock",
+			[](std::uint64_t iterations)
+			{
+				auto time = std::chrono::system_clock::now();
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					time += std::chrono::microseconds{ 1 };
+					Bench::DoNotOptimize(std::format("{}", time));
+				}
+			});
+	}
+}
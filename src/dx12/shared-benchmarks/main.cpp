@@ -0,0 +1,89 @@
+import std;
+import benchmarks;
+
+// Counts every allocation, so that benchmarks can report allocations per operation.
+// The array and sized forms forward to these by default.
+auto operator new(std::size_t size) -> void*
+{
+	Bench::Allocations.fetch_add(1, std::memory_order_relaxed);
+	if (auto memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+namespace
+{
+	struct Options
+	{
+		Bench::RunnerOptions Runner;
+		std::string Format = "json";
+		std::string Output = "shared-benchmarks.json";
+	};
+
+	auto ParseOptions(std::span<char*> args) -> Options
+	{
+		auto options = Options{};
+		for (std::size_t i = 1; i < args.size(); ++i)
+		{
+			auto arg = std::string_view{ args[i] };
+			auto next =
+				[&]() -> std::string_view
+				{
+					if (i + 1 >= args.size())
+						throw std::runtime_error{ std::format("Missing value for {}", arg) };
+					return args[++i];
+				};
+
+			if (arg == "--filter")
+				options.Runner.Filter = next();
+			else if (arg == "--format")
+				options.Format = next();
+			else if (arg == "--out")
+				options.Output = next();
+			else if (arg == "--samples")
+				options.Runner.Samples = std::stoull(std::string{ next() });
+			else if (arg == "--min-sample-ms")
+				options.Runner.MinSampleTime = std::chrono::milliseconds{ std::stoll(std::string{ next() }) };
+			else
+				throw std::runtime_error{ std::format("Unknown argument {}", arg) };
+		}
+		if (options.Format != "json" and options.Format != "csv")
+			throw std::runtime_error{ std::format("Unknown format {}, expected json or csv", options.Format) };
+		return options;
+	}
+}
+
+auto main(int argc, char** argv) -> int
+try
+{
+	auto options = ParseOptions(std::span{ argv, static_cast<std::size_t>(argc) });
+
+	auto runner = Bench::Runner{ options.Runner };
+	Benchmarks::AddPrimitives(runner);
+	Benchmarks::AddThreading(runner);
+	Benchmarks::AddDispatch(runner);
+	Benchmarks::AddCallables(runner);
+	Benchmarks::AddLogging(runner);
+	auto results = runner.Run();
+
+	// Results go to a file rather than stdout, as some benchmarks log to stdout.
+	auto out = std::ofstream{ options.Output, std::ios::trunc };
+	if (not out)
+		throw std::runtime_error{ std::format("Failed to open {}", options.Output) };
+	if (options.Format == "csv")
+		Bench::WriteCsv(out, results);
+	else
+		Bench::WriteJson(out, results);
+	std::println(std::cerr, "Wrote {} results to {}", results.size(), options.Output);
+	return 0;
+}
+catch (const std::exception& ex)
+{
+	std::println(std::cerr, "{}", ex.what());
+	return 1;
+}
@@ -0,0 +1,1074 @@
+export module benchmarks:primitives;
+import std;
+import shared;
+import :harness;
+
+namespace
+{
+	// Stands in for a real COM object so that Com::Ptr can be measured without a device.
+	struct FakeComObject
+	{
+		auto AddRef() noexcept -> unsigned long
+		{
+			return ++refCount;
+		}
+
+		auto Release() noexcept -> unsigned long
+		{
+			return --refCount;
+		}
+
+		std::atomic<unsigned long> refCount = 1;
+	};
+
+	// A function that only uses the device, taking it the two ways it can.
+	auto UseDeviceByValue(Com::Ptr<FakeComObject> device) noexcept -> FakeComObject*
+	{
+		return device.Get();
+	}
+
+	auto UseDeviceByRef(Com::Ref<FakeComObject> device) noexcept -> FakeComObject*
+	{
+		return device.Get();
+	}
+
+	// One thread per core, or at least four, all passing the same device around, as the
+	// render and loader threads do.
+	auto ContendingThreads() -> std::size_t
+	{
+		return std::max<std::size_t>(std::thread::hardware_concurrency(), 4);
+	}
+
+	template<typename TPass>
+	void ShareDevice(std::uint64_t iterations, TPass pass)
+	{
+		auto object = FakeComObject{};
+		auto device = Com::Ptr<FakeComObject>{ &object };
+		{
+			auto threadCount = ContendingThreads();
+			auto threads = std::vector<std::jthread>{};
+			for (std::size_t thread = 0; thread < threadCount; ++thread)
+				threads.emplace_back(
+					[&device, pass, count = iterations / threadCount + (thread < iterations % threadCount ? 1 : 0)]
+					{
+						for (std::uint64_t i = 0; i < count; ++i)
+							Bench::DoNotOptimize(pass(device));
+					});
+		}
+		device.detach();
+	}
+
+	// Checks that copies are counted when counting is on, and that borrowing isn't.
+	void CheckRefCounts()
+	{
+		if constexpr (Com::RefCountingEnabled)
+		{
+			auto object = FakeComObject{};
+			auto device = Com::Ptr<FakeComObject>{ &object };
+			auto before = Com::GetRefCounts<FakeComObject>();
+			UseDeviceByValue(device);
+			UseDeviceByRef(device);
+			auto after = Com::GetRefCounts<FakeComObject>();
+			if (after.AddRefs - before.AddRefs != 1 or after.Releases - before.Releases != 1)
+				throw std::runtime_error{ std::format("Expected one AddRef() and one Release(), got {} and {}", after.AddRefs - before.AddRefs, after.Releases - before.Releases) };
+			device.detach();
+		}
+	}
+
+	auto MakeNarrow(std::size_t length) -> std::string
+	{
+		auto text = std::string{};
+		for (std::size_t i = 0; i < length; ++i)
+			text.push_back(static_cast<char>('a' + i % 26));
+		return text;
+	}
+
+	auto MakeWide(std::size_t length) -> std::wstring
+	{
+		auto text = std::wstring{};
+		for (std::size_t i = 0; i < length; ++i)
+			text.push_back(static_cast<wchar_t>(L'a' + i % 26));
+		return text;
+	}
+
+	// Mostly ASCII, like a path or debug name, with a two, three and four byte character
+	// every 16 characters.
+	auto MakeMixedWide(std::size_t length) -> std::wstring
+	{
+		auto text = std::wstring{};
+		for (std::size_t i = 0; i < length; ++i)
+		{
+			if (i % 16 == 15)
+				text.append(i % 48 == 15 ? L"\u00E9" : i % 48 == 31 ? L"\u20AC" : L"\U0001F600");
+			else
+				text.push_back(static_cast<wchar_t>(L'a' + i % 26));
+		}
+		return text;
+	}
+
+	constexpr auto StringSizes = std::array<std::size_t, 4>{ 8, 64, 1024, 16384 };
+	// E_FAIL
+	constexpr auto FailedHResult = static_cast<Win32::HRESULT>(0x80004005);
+
+	// An independent, deliberately simple decoder to check the transcoder against: the
+	// code points of in, or the offset of its first ill-formed or truncated sequence.
+	auto ReferenceDecodeUtf8(std::string_view in) -> std::pair<std::u32string, std::size_t>
+	{
+		auto codePoints = std::u32string{};
+		for (std::size_t i = 0; i < in.size();)
+		{
+			auto lead = static_cast<std::uint8_t>(in[i]);
+			auto length = lead < 0x80 ? 1u : (lead >> 5) == 0x6 ? 2u : (lead >> 4) == 0xE ? 3u : (lead >> 3) == 0x1E ? 4u : 0u;
+			if (length == 0 or i + length > in.size())
+				return { codePoints, i };
+			auto codePoint = static_cast<char32_t>(length == 1 ? lead : lead & (0x7F >> length));
+			for (std::size_t j = 1; j < length; ++j)
+			{
+				auto next = static_cast<std::uint8_t>(in[i + j]);
+				if ((next & 0xC0) != 0x80)
+					return { codePoints, i };
+				codePoint = codePoint << 6 | (next & 0x3F);
+			}
+			constexpr auto minimums = std::array<char32_t, 5>{ 0, 0, 0x80, 0x800, 0x10000 };
+			if (codePoint < minimums[length] or codePoint > 0x10FFFF or (codePoint >= 0xD800 and codePoint <= 0xDFFF))
+				return { codePoints, i };
+			codePoints.push_back(codePoint);
+			i += length;
+		}
+		return { codePoints, in.size() };
+	}
+
+	// Random text with long runs of ASCII, to exercise the SIMD blocks, broken up by
+	// characters of every length.
+	auto MakeRandomText(std::mt19937& random) -> std::u32string
+	{
+		auto text = std::u32string{};
+		auto length = std::uniform_int_distribution<std::size_t>{ 0, 200 }(random);
+		while (text.size() < length)
+		{
+			switch (random() % 5)
+			{
+				case 0:
+				case 1:
+					for (auto run = random() % 70; run > 0; --run)
+						text.push_back(static_cast<char32_t>(random() % 0x80));
+					break;
+				case 2:
+					text.push_back(static_cast<char32_t>(0x80 + random() % (0x800 - 0x80)));
+					break;
+				case 3:
+				{
+					auto codePoint = static_cast<char32_t>(0x800 + random() % (0x10000 - 0x800));
+					text.push_back(codePoint >= 0xD800 and codePoint <= 0xDFFF ? U'\uFFFD' : codePoint);
+					break;
+				}
+				default:
+					text.push_back(static_cast<char32_t>(0x10000 + random() % (0x110000 - 0x10000)));
+					break;
+			}
+		}
+		return text;
+	}
+
+	// Round trips random valid text through both directions, then corrupts it and checks
+	// that the transcoder stops where the reference decoder does. Ill-formed UTF-16 can
+	// only be a lone surrogate, so that side is checked by replacement instead.
+	void CheckUtfTranscoder()
+	{
+		auto random = std::mt19937{ 20240601 };
+		for (std::size_t iteration = 0; iteration < 20000; ++iteration)
+		{
+			auto text = MakeRandomText(random);
+			auto utf8 = std::string{};
+			auto utf16 = std::u16string{};
+			for (auto codePoint : text)
+			{
+				auto encoded = std::array<char, 4>{};
+				utf8.append(encoded.data(), Strings::Utf::Detail::Utf8Length(codePoint));
+				Strings::Utf::Detail::EncodeUtf8(codePoint, utf8.data() + utf8.size() - Strings::Utf::Detail::Utf8Length(codePoint));
+				auto units = std::array<char16_t, 2>{};
+				Strings::Utf::Detail::EncodeUtf16(codePoint, units.data());
+				utf16.append(units.data(), Strings::Utf::Detail::Utf16Length(codePoint));
+			}
+
+			auto wide = std::u16string(Strings::Utf::MaxUtf16Length(utf8.size()), u'\0');
+			auto result = Strings::Utf::Utf8ToUtf16(utf8, std::span{ wide });
+			if (not result or std::u16string_view{ wide.data(), result.Written } != utf16)
+				throw std::runtime_error{ std::format("Expected valid UTF-8 to be widened (iteration {})", iteration) };
+
+			auto narrow = std::string(Strings::Utf::MaxUtf8Length(utf16.size()), '\0');
+			result = Strings::Utf::Utf16ToUtf8(std::u16string_view{ utf16 }, std::span{ narrow });
+			if (not result or std::string_view{ narrow.data(), result.Written } != utf8)
+				throw std::runtime_error{ std::format("Expected valid UTF-16 to be narrowed (iteration {})", iteration) };
+
+			if (utf8.empty())
+				continue;
+			for (auto flips = 1 + random() % 3; flips > 0; --flips)
+				utf8[random() % utf8.size()] ^= static_cast<char>(1u << (random() % 8));
+			auto [codePoints, invalidAt] = ReferenceDecodeUtf8(utf8);
+			result = Strings::Utf::Utf8ToUtf16(utf8, std::span{ wide });
+			auto expected = Strings::Utf::Status::Ok;
+			if (invalidAt != utf8.size())
+				expected = Strings::Utf::Detail::DecodeUtf8(utf8, invalidAt).Code;
+			if (result.Code != expected or result.Read != invalidAt)
+				throw std::runtime_error{ std::format("Expected corrupted UTF-8 to stop at {}, not {} (iteration {})", invalidAt, result.Read, iteration) };
+
+			// With replacement, the output is always well formed.
+			result = Strings::Utf::Utf8ToUtf16(utf8, std::span{ wide }, Strings::Utf::OnInvalid::Replace);
+			auto roundTrip = std::string(Strings::Utf::MaxUtf8Length(result.Written), '\0');
+			if (not result or not Strings::Utf::Utf16ToUtf8(std::u16string_view{ wide.data(), result.Written }, std::span{ roundTrip }))
+				throw std::runtime_error{ std::format("Expected replaced UTF-8 to be well formed (iteration {})", iteration) };
+
+			// Streamed in random chunks, the output is the same as converting it in one go.
+			auto stream = Strings::Utf::Utf8ToUtf16Stream<char16_t>{};
+			auto streamed = std::u16string(wide.size(), u'\0');
+			auto streamedLength = std::size_t{};
+			for (auto rest = std::string_view{ utf8 }; not rest.empty();)
+			{
+				auto chunk = rest.substr(0, random() % 9);
+				auto chunkResult = stream.Convert(chunk, std::span{ streamed }.subspan(streamedLength));
+				streamedLength += chunkResult.Written;
+				rest.remove_prefix(chunkResult.Read);
+			}
+			streamedLength += stream.Finish(std::span{ streamed }.subspan(streamedLength)).Written;
+			if (std::u16string_view{ streamed.data(), streamedLength } != std::u16string_view{ wide.data(), result.Written })
+				throw std::runtime_error{ std::format("Expected streamed UTF-8 to convert as if it were whole (iteration {})", iteration) };
+
+			utf16[random() % utf16.size()] = static_cast<char16_t>(0xD800 + random() % 0x800);
+			narrow.resize(Strings::Utf::MaxUtf8Length(utf16.size()));
+			result = Strings::Utf::Utf16ToUtf8(std::u16string_view{ utf16 }, std::span{ narrow }, Strings::Utf::OnInvalid::Replace);
+			if (not result or ReferenceDecodeUtf8({ narrow.data(), result.Written }).second != result.Written)
+				throw std::runtime_error{ std::format("Expected replaced UTF-16 to be well formed (iteration {})", iteration) };
+		}
+	}
+
+	// Converts a resource name and a long path with every allocation-free overload, and
+	// checks that none of them allocated.
+	void CheckAllocationFreeConversion()
+	{
+		auto name = std::wstring{ L"Textures/Brick_\u00E9\u20AC\U0001F600_Albedo" };
+		auto path = MakeMixedWide(4096);
+		auto expectedName = Strings::ConvertString(name);
+		auto expectedPath = Strings::ConvertString(path);
+		auto mismatches = std::vector<std::string_view>{};
+		mismatches.reserve(8);
+
+		auto allocationsBefore = Bench::Allocations.load(std::memory_order_relaxed);
+		auto narrow = std::array<char, 64>{};
+		auto result = Strings::ConvertString(name, std::span<char>{ narrow });
+		if (not result or std::string_view{ narrow.data(), result.Written } != expectedName)
+			mismatches.push_back("span");
+
+		auto inplace = Strings::InplaceString<char, 64>{};
+		auto inplaceWide = Strings::InplaceString<wchar_t, 64>{};
+		if (not Strings::ConvertString(name, inplace) or inplace != expectedName
+			or not Strings::ConvertString(expectedName, inplaceWide) or inplaceWide != name)
+			mismatches.push_back("InplaceString");
+
+		auto storage = std::array<std::byte, 32768>{};
+		auto pool = std::pmr::monotonic_buffer_resource{ storage.data(), storage.size(), std::pmr::null_memory_resource() };
+		if (std::string_view{ Strings::ConvertString(path, &pool) } != expectedPath
+			or std::wstring_view{ Strings::ConvertString(expectedPath, &pool) } != path)
+			mismatches.push_back("pmr");
+
+		// The long path again, in chunks that split characters, into a small buffer that's
+		// compared as it fills.
+		auto stream = Strings::Utf::Utf8ToUtf16Stream<wchar_t>{};
+		auto chunkOut = std::array<wchar_t, 64>{};
+		auto streamed = std::size_t{};
+		auto streamMatches = true;
+		for (auto rest = std::string_view{ expectedPath }; not rest.empty();)
+		{
+			auto chunk = rest.substr(0, 37);
+			auto chunkResult = stream.Convert(chunk, std::span<wchar_t>{ chunkOut });
+			streamMatches = streamMatches and std::wstring_view{ chunkOut.data(), chunkResult.Written } == std::wstring_view{ path }.substr(streamed, chunkResult.Written);
+			streamed += chunkResult.Written;
+			rest.remove_prefix(chunkResult.Read);
+		}
+		if (not streamMatches or streamed != path.size())
+			mismatches.push_back("stream");
+
+		auto formatted = std::array<char, 64>{};
+		auto formattedEnd = std::format_to_n(formatted.data(), formatted.size(), "{}", Strings::Narrowed{ name });
+		if (std::string_view{ formatted.data(), formattedEnd.out } != expectedName)
+			mismatches.push_back("Narrowed");
+
+		auto allocations = Bench::Allocations.load(std::memory_order_relaxed) - allocationsBefore;
+		if (not mismatches.empty())
+			throw std::runtime_error{ std::format("Expected the {} conversion to match ConvertString", mismatches.front()) };
+		if (allocations != 0)
+			throw std::runtime_error{ std::format("Expected allocation-free conversions not to allocate, but they made {} allocations", allocations) };
+	}
+
+	// Hammers a cache backed by the stand-in table from several threads, and checks that
+	// every code ends up cached, that no code is translated more than once per thread and
+	// that hits don't allocate.
+	void CheckErrorCodeCache()
+	{
+		static auto translations = std::atomic<std::uint64_t>{};
+		auto cache = Error::ErrorCodeCache{
+			[](Error::ErrorCode errorCode)
+			{
+				translations.fetch_add(1, std::memory_order_relaxed);
+				return Error::TranslateStandInErrorCode(errorCode);
+			} };
+		translations = 0;
+		// Each thread records its first failure, to be thrown once they've all been joined.
+		auto failures = std::array<std::string, 4>{};
+		{
+			auto threads = std::vector<std::jthread>{};
+			for (std::size_t thread = 0; thread < failures.size(); ++thread)
+				threads.emplace_back(
+					[&cache, &failure = failures[thread]]
+					{
+						try
+						{
+							for (std::size_t i = 0; i < 1000; ++i)
+							{
+								auto code = Error::StandInErrorMessages[i % Error::StandInErrorMessages.size()].Code;
+								if (cache.Lookup(code) != Error::FindStandInErrorMessage(code))
+								{
+									failure = std::format("Expected the cached message for {:#x} to match the stand-in table", code);
+									return;
+								}
+							}
+						}
+						catch (const std::exception& ex)
+						{
+							failure = ex.what();
+						}
+					});
+		}
+		for (auto& failure : failures)
+			if (not failure.empty())
+				throw std::runtime_error{ failure };
+		if (cache.Size() != Error::StandInErrorMessages.size())
+			throw std::runtime_error{ std::format("Expected {} cached codes, got {}", Error::StandInErrorMessages.size(), cache.Size()) };
+
+		auto allocationsBefore = Bench::Allocations.load(std::memory_order_relaxed);
+		for (auto& entry : Error::StandInErrorMessages)
+			Bench::DoNotOptimize(cache.Lookup(entry.Code));
+		if (Bench::Allocations.load(std::memory_order_relaxed) != allocationsBefore)
+			throw std::runtime_error{ "Expected cached lookups not to allocate" };
+		// Threads racing on a miss may each translate it, but only the first result is kept.
+		if (translations < Error::StandInErrorMessages.size() or translations > Error::StandInErrorMessages.size() * failures.size())
+			throw std::runtime_error{ std::format("Unexpected number of translations: {}", translations.load()) };
+	}
+
+	// Names of the kind looked up by string at runtime: command line switches and config keys.
+	using SettingNames = Strings::FixedStringTable<
+		"width", "height", "fullscreen", "vsync", "adapter", "debug-layer", "gpu-validation", "frame-count",
+		"msaa", "hdr", "log-level", "log-file", "profile", "warp", "present-mode", "shader-path">;
+
+	// Resource names of the kind passed to SetName(), sharing long prefixes as real ones do.
+	auto MakeResourceNames(std::size_t count) -> std::vector<std::string>
+	{
+		auto names = std::vector<std::string>{};
+		names.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+			names.push_back(std::format("Scene/Materials/Texture{}/Mip{}", i / 8, i % 8));
+		return names;
+	}
+
+	// Interns overlapping sets of names from several threads, checking that each name
+	// gets a single id and that every id views the name it was given for.
+	void CheckInternPool()
+	{
+		auto pool = Strings::InternPool<char>{};
+		auto names = MakeResourceNames(4096);
+		auto ids = std::vector<std::vector<Strings::InternId>>(4);
+		// Each thread records its first failure, to be thrown once they've all been joined.
+		auto failures = std::array<std::string, 4>{};
+		{
+			auto threads = std::vector<std::jthread>{};
+			for (std::size_t thread = 0; thread < failures.size(); ++thread)
+				threads.emplace_back(
+					[&pool, &names, &ids = ids[thread], &failure = failures[thread], thread]
+					{
+						try
+						{
+							for (std::size_t i = 0; i < names.size(); ++i)
+							{
+								auto& name = names[(i + thread * 1024) % names.size()];
+								ids.push_back(pool.Intern(name));
+								if (pool.ToView(ids.back()) != name)
+								{
+									failure = std::format("Expected the interned view of {} to match it", name);
+									return;
+								}
+							}
+						}
+						catch (const std::exception& ex)
+						{
+							failure = ex.what();
+						}
+					});
+		}
+		for (auto& failure : failures)
+			if (not failure.empty())
+				throw std::runtime_error{ failure };
+		if (pool.Size() != names.size() + 1)
+			throw std::runtime_error{ std::format("Expected {} interned names, got {}", names.size() + 1, pool.Size()) };
+		for (std::size_t thread = 1; thread < 4; ++thread)
+			for (std::size_t i = 0; i < names.size(); ++i)
+				if (ids[thread][i] != ids[0][(i + thread * 1024) % names.size()])
+					throw std::runtime_error{ std::format("Expected one id for {}", names[(i + thread * 1024) % names.size()]) };
+		if (pool.Intern("") != Strings::InternId::Empty or not pool.ToView(Strings::InternId::Empty).empty() or pool.Find("Missing"))
+			throw std::runtime_error{ "Expected only the empty string to have the empty id" };
+	}
+
+	// Checks that equal strings share an id wherever they came from, that views survive the
+	// pool growing, and that a full pool refuses new strings without using up an id.
+	void CheckInternPoolLimits()
+	{
+		auto pool = Strings::InternPool<char>{};
+		auto first = std::string{ "Scene/Materials/Texture0" };
+		auto id = pool.Intern(first);
+		auto view = pool.ToView(id);
+		if (pool.Intern(std::string_view{ "Scene/Materials/Texture0/Mip0" }.substr(0, first.size())) != id)
+			throw std::runtime_error{ "Expected equal strings to get the same id" };
+		first.assign(first.size(), '?');
+		for (auto& name : MakeResourceNames(8192))
+			pool.Intern(name);
+		if (pool.ToView(id).data() != view.data() or view != "Scene/Materials/Texture0" or view.data()[view.size()] != '\0')
+			throw std::runtime_error{ "Expected a view to outlive the pool growing" };
+
+		auto full = Strings::InternPool<char, 3>{};
+		auto a = full.Intern("A");
+		auto b = full.Intern("B");
+		auto refused = false;
+		try
+		{
+			full.Intern("C");
+		}
+		catch (const std::length_error&)
+		{
+			refused = true;
+		}
+		if (not refused or full.Size() != 3 or full.Find("C"))
+			throw std::runtime_error{ "Expected a full pool to refuse a new string and not keep it" };
+		if (full.Intern("A") != a or full.Intern("B") != b or full.ToView(b) != "B")
+			throw std::runtime_error{ "Expected a full pool to still find the strings it has" };
+	}
+
+	// Every key, each followed by a near miss, so that half of the lookups fail.
+	auto MakeSettingQueries() -> std::vector<std::string>
+	{
+		auto queries = std::vector<std::string>{};
+		for (auto key : SettingNames::Keys)
+		{
+			queries.emplace_back(key);
+			queries.emplace_back(std::string{ key } + "s");
+		}
+		return queries;
+	}
+}
+
+export namespace Benchmarks
+{
+	void AddComPtr(Bench::Runner& runner)
+	{
+		runner.Add(
+			"Com::Ptr/Copy",
+			[](std::uint64_t iterations)
+			{
+				auto object = FakeComObject{};
+				auto ptr = Com::Ptr<FakeComObject>{ &object };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto copy = ptr;
+					Bench::DoNotOptimize(copy);
+				}
+				ptr.detach();
+			});
+
+		runner.Add(
+			"Com::Ptr/Move",
+			[](std::uint64_t iterations)
+			{
+				auto object = FakeComObject{};
+				auto ptr = Com::Ptr<FakeComObject>{ &object };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto moved = std::move(ptr);
+					Bench::DoNotOptimize(moved);
+					ptr = std::move(moved);
+				}
+				ptr.detach();
+			});
+
+		runner.Add(
+			"Com::Ptr/Reset",
+			[](std::uint64_t iterations)
+			{
+				auto object = FakeComObject{};
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					object.AddRef();
+					auto ptr = Com::Ptr<FakeComObject>{ &object };
+					Bench::DoNotOptimize(ptr);
+					ptr.reset();
+				}
+			});
+
+		CheckRefCounts();
+
+		runner.Add(
+			"Com::Ptr/PassByValue",
+			[](std::uint64_t iterations)
+			{
+				auto object = FakeComObject{};
+				auto device = Com::Ptr<FakeComObject>{ &object };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					Bench::DoNotOptimize(UseDeviceByValue(device));
+				device.detach();
+			});
+
+		runner.Add(
+			"Com::Ref/Pass",
+			[](std::uint64_t iterations)
+			{
+				auto object = FakeComObject{};
+				auto device = Com::Ptr<FakeComObject>{ &object };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					Bench::DoNotOptimize(UseDeviceByRef(device));
+				device.detach();
+			});
+
+		// Every thread's AddRef()s and Release()s land on the one shared count, so its cache
+		// line bounces between cores.
+		runner.Add(
+			"Com::Ptr/PassByValue/SharedDevice",
+			[](std::uint64_t iterations)
+			{
+				ShareDevice(iterations, [](const Com::Ptr<FakeComObject>& device) { return UseDeviceByValue(device); });
+			});
+
+		runner.Add(
+			"Com::Ref/Pass/SharedDevice",
+			[](std::uint64_t iterations)
+			{
+				ShareDevice(iterations, [](const Com::Ptr<FakeComObject>& device) { return UseDeviceByRef(device); });
+			});
+	}
+
+	void AddHResult(Bench::Runner& runner)
+	{
+		runner.Add(
+			"Com::HResult/Check",
+			[](std::uint64_t iterations)
+			{
+				auto codes = std::array<Win32::HRESULT, 4>{ 0, 1, FailedHResult, 0 };
+				auto failures = std::uint64_t{};
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					Bench::DoNotOptimize(codes);
+					auto hr = Com::HResult{ codes[i & 3] };
+					if (not hr)
+						failures++;
+				}
+				Bench::DoNotOptimize(failures);
+			});
+
+		runner.Add(
+			"Com::CheckHr/Success",
+			[](std::uint64_t iterations)
+			{
+				auto hr = Win32::HRESULT{ 0 };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					Bench::DoNotOptimize(hr);
+					Com::CheckHr(hr);
+				}
+			});
+	}
+
+	void AddStrings(Bench::Runner& runner)
+	{
+		CheckUtfTranscoder();
+		CheckAllocationFreeConversion();
+
+		for (auto size : StringSizes)
+		{
+			runner.Add(
+				std::format("Strings::ConvertString/Narrow/Span/{}", size),
+				[wide = MakeWide(size), buffer = std::vector<char>(Strings::Utf::MaxUtf8Length(size))](std::uint64_t iterations) mutable
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						auto result = Strings::ConvertString(wide, std::span{ buffer });
+						Bench::DoNotOptimize(result);
+						Bench::DoNotOptimize(buffer);
+					}
+				},
+				size * sizeof(wchar_t));
+
+			runner.Add(
+				std::format("Strings::ConvertString/Narrow/{}", size),
+				[wide = MakeWide(size)](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						auto narrow = Strings::ConvertString(wide);
+						Bench::DoNotOptimize(narrow);
+					}
+				},
+				size * sizeof(wchar_t));
+
+			runner.Add(
+				std::format("Strings::ConvertString/Widen/{}", size),
+				[narrow = MakeNarrow(size)](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						auto wide = Strings::ConvertString(narrow);
+						Bench::DoNotOptimize(wide);
+					}
+				},
+				size);
+
+			// The two pass Win32 conversions ConvertString used to make.
+			runner.Add(
+				std::format("Win32::WideCharToMultiByte/{}", size),
+				[wide = MakeWide(size)](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						auto length = Win32::WideCharToMultiByte(Win32::CodePages::Utf8, Win32::WideCharOptions::NoBestFitChars, wide.data(), static_cast<int>(wide.size()), nullptr, 0, nullptr, nullptr);
+						auto narrow = std::string(length, '\0');
+						Win32::WideCharToMultiByte(Win32::CodePages::Utf8, Win32::WideCharOptions::NoBestFitChars, wide.data(), static_cast<int>(wide.size()), narrow.data(), length, nullptr, nullptr);
+						Bench::DoNotOptimize(narrow);
+					}
+				},
+				size * sizeof(wchar_t));
+
+			runner.Add(
+				std::format("Win32::MultiByteToWideChar/{}", size),
+				[narrow = MakeNarrow(size)](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						auto length = Win32::MultiByteToWideChar(Win32::CodePages::Utf8, 0, narrow.data(), static_cast<int>(narrow.size()), nullptr, 0);
+						auto wide = std::wstring(length, L'\0');
+						Win32::MultiByteToWideChar(Win32::CodePages::Utf8, 0, narrow.data(), static_cast<int>(narrow.size()), wide.data(), length);
+						Bench::DoNotOptimize(wide);
+					}
+				},
+				size);
+		}
+
+		for (auto size : { std::size_t{ 64 }, std::size_t{ 16384 } })
+		{
+			runner.Add(
+				std::format("Strings::ConvertString/Narrow/Mixed/{}", size),
+				[wide = MakeMixedWide(size)](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						auto narrow = Strings::ConvertString(wide);
+						Bench::DoNotOptimize(narrow);
+					}
+				},
+				MakeMixedWide(size).size() * sizeof(wchar_t));
+
+			runner.Add(
+				std::format("Strings::ConvertString/Widen/Mixed/{}", size),
+				[narrow = Strings::ConvertString(MakeMixedWide(size))](std::uint64_t iterations)
+				{
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						auto wide = Strings::ConvertString(narrow);
+						Bench::DoNotOptimize(wide);
+					}
+				},
+				Strings::ConvertString(MakeMixedWide(size)).size());
+		}
+
+		runner.Add(
+			"Strings::ConvertString/Narrow/Inplace/64",
+			[wide = MakeMixedWide(64)](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto narrow = Strings::InplaceString<char, 256>{};
+					Strings::ConvertString(wide, narrow);
+					Bench::DoNotOptimize(narrow);
+				}
+			});
+
+		runner.Add(
+			"Strings::ConvertString/Narrow/Pmr/1024",
+			[wide = MakeMixedWide(1024)](std::uint64_t iterations)
+			{
+				auto storage = std::vector<std::byte>(Strings::Utf::MaxUtf8Length(wide.size()) + 64);
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto pool = std::pmr::monotonic_buffer_resource{ storage.data(), storage.size(), std::pmr::null_memory_resource() };
+					auto narrow = Strings::ConvertString(wide, &pool);
+					Bench::DoNotOptimize(narrow);
+				}
+			});
+
+		runner.Add(
+			"Strings::FixedString/Concat",
+			[](std::uint64_t iterations)
+			{
+				auto first = Strings::FixedString{ "Failed to create " };
+				auto second = Strings::FixedString{ "the swap chain" };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					Bench::DoNotOptimize(first);
+					Bench::DoNotOptimize(second);
+					auto joined = first + second + ".";
+					Bench::DoNotOptimize(joined);
+				}
+			});
+
+		runner.Add(
+			"Strings::FixedStringTable/Find",
+			[queries = MakeSettingQueries()](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto id = SettingNames::Find(queries[i % queries.size()]);
+					Bench::DoNotOptimize(id);
+				}
+			});
+
+		runner.Add(
+			"std::unordered_map<std::string>/find",
+			[queries = MakeSettingQueries()](std::uint64_t iterations)
+			{
+				auto ids = std::unordered_map<std::string, std::size_t>{};
+				for (std::size_t id = 0; id < SettingNames::Size; ++id)
+					ids.emplace(SettingNames::Keys[id], id);
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto entry = ids.find(queries[i % queries.size()]);
+					auto id = entry != ids.end() ? entry->second : SettingNames::NotFound;
+					Bench::DoNotOptimize(id);
+				}
+			});
+
+		CheckInternPool();
+		CheckInternPoolLimits();
+
+		runner.Add(
+			"Strings::InternPool/Intern/Hit",
+			[names = MakeResourceNames(1024)](std::uint64_t iterations)
+			{
+				auto pool = Strings::InternPool<char>{};
+				for (auto& name : names)
+					pool.Intern(name);
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto id = pool.Intern(names[i % names.size()]);
+					Bench::DoNotOptimize(id);
+				}
+			});
+
+		runner.Add(
+			"Strings::InternPool/Intern/Hit/4Threads",
+			[names = MakeResourceNames(1024)](std::uint64_t iterations)
+			{
+				auto pool = Strings::InternPool<char>{};
+				for (auto& name : names)
+					pool.Intern(name);
+				auto threads = std::vector<std::jthread>{};
+				for (std::size_t thread = 0; thread < 4; ++thread)
+					threads.emplace_back(
+						[&pool, &names, thread, count = iterations / 4 + (thread < iterations % 4 ? 1 : 0)]
+						{
+							for (std::uint64_t i = 0; i < count; ++i)
+							{
+								auto id = pool.Intern(names[(i + thread * 256) % names.size()]);
+								Bench::DoNotOptimize(id);
+							}
+						});
+			});
+
+		// Every name is new to the pool, so this includes copying it into the arena and the
+		// pool's construction and destruction, once per 64K names.
+		runner.Add(
+			"Strings::InternPool/Intern/New/4Threads",
+			[names = MakeResourceNames(64 * 1024)](std::uint64_t iterations)
+			{
+				for (std::uint64_t done = 0; done < iterations;)
+				{
+					auto batch = std::min<std::uint64_t>(iterations - done, names.size());
+					auto pool = Strings::InternPool<char>{};
+					{
+						auto threads = std::vector<std::jthread>{};
+						for (std::size_t thread = 0; thread < 4; ++thread)
+							threads.emplace_back(
+								[&pool, &names, thread, batch]
+								{
+									for (auto i = thread; i < batch; i += 4)
+									{
+										auto id = pool.Intern(names[i]);
+										Bench::DoNotOptimize(id);
+									}
+								});
+					}
+					done += batch;
+				}
+			});
+
+		runner.Add(
+			"Strings::InternPool/ToView",
+			[names = MakeResourceNames(1024)](std::uint64_t iterations)
+			{
+				auto pool = Strings::InternPool<char>{};
+				auto ids = std::vector<Strings::InternId>{};
+				for (auto& name : names)
+					ids.push_back(pool.Intern(name));
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto name = pool.ToView(ids[i % ids.size()]);
+					Bench::DoNotOptimize(name);
+				}
+			});
+
+		// Names that differ only near the end, which is the worst case for string compares and
+		// the usual one for paths.
+		runner.Add(
+			"std::string/Equal",
+			[names = MakeResourceNames(1024)](std::uint64_t iterations)
+			{
+				auto copies = names;
+				auto equal = std::size_t{ 0 };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					equal += names[i % names.size()] == copies[(i + i / names.size()) % copies.size()];
+				Bench::DoNotOptimize(equal);
+			});
+
+		runner.Add(
+			"Strings::InternId/Equal",
+			[names = MakeResourceNames(1024)](std::uint64_t iterations)
+			{
+				auto pool = Strings::InternPool<char>{};
+				auto ids = std::vector<Strings::InternId>{};
+				for (auto& name : names)
+					ids.push_back(pool.Intern(name));
+				auto equal = std::size_t{ 0 };
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					equal += ids[i % ids.size()] == ids[(i + i / ids.size()) % ids.size()];
+				Bench::DoNotOptimize(equal);
+			});
+	}
+
+	void AddLog(Bench::Runner& runner)
+	{
+		// Measures the full path, including the console write. Run with stdout
+		// redirected to a file or NUL to take the console itself out of the picture.
+		runner.Add(
+			"Log::Info",
+			[](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					Log::Info("Frame {} took {}us", i, 16'667);
+			});
+	}
+
+	void AddErrors(Bench::Runner& runner)
+	{
+		CheckErrorCodeCache();
+
+		// FormatMessageA and two allocations for every error, as before the cache.
+		runner.Add(
+			"Error::TranslateSystemErrorCode",
+			[](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto message = Error::TranslateSystemErrorCode(FailedHResult);
+					Bench::DoNotOptimize(message);
+				}
+			});
+
+		runner.Add(
+			"Error::LookupErrorMessage/Cached",
+			[](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto message = Error::LookupErrorMessage(FailedHResult);
+					Bench::DoNotOptimize(message);
+				}
+			});
+
+		// A device removed cascade: the same code looked up from several threads at once.
+		runner.Add(
+			"Error::LookupErrorMessage/Cached/4Threads",
+			[](std::uint64_t iterations)
+			{
+				auto threads = std::vector<std::jthread>{};
+				for (std::size_t thread = 0; thread < 4; ++thread)
+					threads.emplace_back(
+						[count = iterations / 4 + (thread < iterations % 4 ? 1 : 0)]
+						{
+							for (std::uint64_t i = 0; i < count; ++i)
+							{
+								auto message = Error::LookupErrorMessage(static_cast<Win32::DWORD>(DXGI::Error::DeviceRemoved));
+								Bench::DoNotOptimize(message);
+							}
+						});
+			});
+
+		runner.Add(
+			"Error::ComError/Construct",
+			[](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto error = Error::ComError(FailedHResult, "Failed to create device");
+					Bench::DoNotOptimize(error);
+				}
+			});
+
+		// What every throw used to cost: the stacktrace symbolised and the message formatted
+		// in the constructor.
+		runner.Add(
+			"Error::ComError/ThrowCatch/Eager",
+			[](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					try
+					{
+						throw std::runtime_error{ std::format("HRESULT error (code {}): {}\nStacktrace:\n{}", FailedHResult, Error::TranslateErrorCode(FailedHResult), std::stacktrace::current()) };
+					}
+					catch (const std::runtime_error& error)
+					{
+						Bench::DoNotOptimize(error);
+					}
+				}
+			});
+
+		for (auto depth : { std::size_t{ 0 }, std::size_t{ 16 }, std::size_t{ 64 } })
+		{
+			runner.Add(
+				std::format("Error::ComError/ThrowCatch/Depth{}", depth),
+				[depth](std::uint64_t iterations)
+				{
+					auto previous = Error::GetStacktraceDepth();
+					Error::SetStacktraceDepth(depth);
+					for (std::uint64_t i = 0; i < iterations; ++i)
+					{
+						try
+						{
+							throw Error::ComError(FailedHResult, "Failed to create device");
+						}
+						catch (const Error::ComError& error)
+						{
+							Bench::DoNotOptimize(error);
+						}
+					}
+					Error::SetStacktraceDepth(previous);
+				});
+		}
+
+		// The deferred cost, paid once by errors that do get printed.
+		runner.Add(
+			"Error::ComError/ThrowCatchWhat/Depth64",
+			[](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					try
+					{
+						throw Error::ComError(FailedHResult, "Failed to create device");
+					}
+					catch (const Error::ComError& error)
+					{
+						Bench::DoNotOptimize(error.what());
+					}
+				}
+			});
+
+		// The same failures reported as values, to compare with the throw/catch cost above,
+		// and the success paths of both.
+		runner.Add(
+			"Com::Expected/Failure",
+			[](std::uint64_t iterations)
+			{
+				auto failures = std::uint64_t{};
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto hr = Win32::HRESULT{ FailedHResult };
+					Bench::DoNotOptimize(hr);
+					auto result = Com::HResult{ hr }
+						.ToExpected(i)
+						.and_then([](std::uint64_t value) { return Com::HResult{ 0 }.ToExpected(value + 1); });
+					if (not result)
+						failures++;
+					Bench::DoNotOptimize(result);
+				}
+				Bench::DoNotOptimize(failures);
+			});
+
+		runner.Add(
+			"Com::Expected/Success",
+			[](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto hr = Win32::HRESULT{ 0 };
+					Bench::DoNotOptimize(hr);
+					auto result = Com::HResult{ hr }
+						.ToExpected(i)
+						.and_then([](std::uint64_t value) { return Com::HResult{ 0 }.ToExpected(value + 1); });
+					Bench::DoNotOptimize(result);
+				}
+			});
+
+		runner.Add(
+			"Com::HResult::ThrowIfFailed/Success",
+			[](std::uint64_t iterations)
+			{
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto hr = Win32::HRESULT{ 0 };
+					Bench::DoNotOptimize(hr);
+					Com::HResult{ hr }.ThrowIfFailed("Failed to create device");
+					Com::HResult{ 0 }.ThrowIfFailed("Failed to create device");
+				}
+			});
+	}
+
+	void AddAsync(Bench::Runner& runner)
+	{
+		// Round trip between two threads, so each operation is two signals and two wakeups.
+		runner.Add(
+			"Async::AutoResetEvent/PingPong",
+			[](std::uint64_t iterations)
+			{
+				auto ping = Async::AutoResetEvent{};
+				auto pong = Async::AutoResetEvent{};
+				auto responder = std::jthread{
+					[&ping, &pong, iterations]
+					{
+						for (std::uint64_t i = 0; i < iterations; ++i)
+						{
+							ping.Wait();
+							pong.Set();
+						}
+					}};
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					ping.Set();
+					pong.Wait();
+				}
+			});
+	}
+
+	void AddPrimitives(Bench::Runner& runner)
+	{
+		AddComPtr(runner);
+		AddHResult(runner);
+		AddStrings(runner);
+		AddLog(runner);
+		AddErrors(runner);
+		AddAsync(runner);
+	}
+}
@@ -0,0 +1,120 @@
+export module benchmarks:threading;
+import std;
+import shared;
+import :harness;
+
+namespace
+{
+	// Records a zone on a thread that exits before a second thread records another, so the
+	// second thread's buffer is likely recycled from the first. Checks that both are captured
+	// under different thread ids and written to both trace formats.
+	void CheckCpuProfiler()
+	{
+		if constexpr (not Profiling::CpuProfilingEnabled)
+			return;
+
+		static constexpr char firstName[] = "CheckCpuProfiler/First";
+		static constexpr char secondName[] = "CheckCpuProfiler/Second";
+		auto events = std::vector<Profiling::CapturedEvent>{};
+		for (auto name : { firstName, secondName })
+		{
+			std::jthread{ [name] { auto zone = Profiling::Zone{ name }; } }.join();
+			Profiling::Drain(events);
+		}
+
+		auto threadIdOf =
+			[&events](const char* name)
+			{
+				auto found = std::ranges::find(events, name, [](const Profiling::CapturedEvent& event) { return event.Event.Name; });
+				if (found == events.end())
+					throw std::runtime_error{ std::format("Expected a zone named {}", name) };
+				return found->ThreadId;
+			};
+		if (threadIdOf(firstName) == threadIdOf(secondName))
+			throw std::runtime_error{ "Expected a recycled thread buffer to get a new thread id" };
+
+		auto chrome = std::ostringstream{};
+		Profiling::WriteChromeTrace(chrome, events);
+		if (not chrome.str().starts_with("{\"traceEvents\":[") or not chrome.str().contains(secondName))
+			throw std::runtime_error{ "Expected the Chrome trace to contain the recorded zones" };
+		auto binary = std::ostringstream{};
+		Profiling::WriteBinaryTrace(binary, events);
+		if (not binary.str().starts_with("SPRF") or not binary.str().contains(firstName))
+			throw std::runtime_error{ "Expected the binary trace to contain the recorded zones" };
+	}
+}
+
+export namespace Benchmarks
+{
+	void AddThreading(Bench::Runner& runner)
+	{
+		CheckCpuProfiler();
+
+		runner.Add(
+			"Async::SpscQueue/Throughput",
+			[](std::uint64_t iterations)
+			{
+				auto queue = std::make_unique<Async::SpscQueue<std::uint64_t, 1024>>();
+				auto consumer = std::jthread{
+					[&queue, iterations]
+					{
+						auto expected = std::uint64_t{};
+						auto value = std::uint64_t{};
+						while (expected < iterations)
+						{
+							if (not queue->TryPop(value))
+								continue;
+							if (value != expected++)
+								throw std::runtime_error{ "SpscQueue delivered values out of order" };
+						}
+					}};
+				for (std::uint64_t i = 0; i < iterations; ++i)
+					while (not queue->TryPush(i));
+			});
+
+		// Drives the render thread handoff with a synthetic message source instead of a window.
+		// Each operation is one input event delivered to the render thread, with a resize
+		// every 64 events. Checks that input arrives in order and that resizes are coalesced
+		// to the latest size.
+		runner.Add(
+			"App::RenderThread/SyntheticMessages",
+			[](std::uint64_t iterations)
+			{
+				auto renderThread = std::make_unique<App::RenderThread>();
+				auto received = std::atomic<std::uint64_t>{};
+				auto lastWidth = 0u;
+				renderThread->Start(
+					[&received, &lastWidth](std::span<const App::RenderEvent> events, std::optional<App::Dimensions> resize)
+					{
+						if (resize)
+						{
+							if (resize->Width <= lastWidth)
+								throw std::runtime_error{ "Expected resizes to only move forward" };
+							lastWidth = resize->Width;
+						}
+						for (const auto& event : events)
+						{
+							auto expected = received.load(std::memory_order_relaxed);
+							if (event.wParam != expected)
+								throw std::runtime_error{ std::format("Expected event {} but got {}", expected, event.wParam) };
+							received.store(expected + 1, std::memory_order_release);
+						}
+						return std::chrono::nanoseconds{ std::chrono::milliseconds{ 1 } };
+					});
+
+				for (std::uint64_t i = 0; i < iterations; ++i)
+				{
+					auto event = App::RenderEvent{ Win32::Messages::KeyUp, static_cast<Win32::WPARAM>(i), 0 };
+					while (not renderThread->Post(event))
+						std::this_thread::yield();
+					if (i % 64 == 0)
+						renderThread->Resize(App::Dimensions{ static_cast<unsigned>(i / 64 + 1), 1 });
+				}
+				while (received.load(std::memory_order_acquire) < iterations)
+					std::this_thread::yield();
+
+				renderThread->RequestStop();
+				renderThread->Join();
+			});
+	}
+}
@@ -5,6 +5,11 @@ import :win32;
 import :com;
 import :error;
 import :async;
+import :raii;
+import :profiling;
+import :app.framestatistics;
+import :app.frameloop;
+import :app.renderthread;
 
 export namespace App
 {
@@ -13,7 +18,10 @@ export namespace App
 	public:
 		virtual ~D3D12App()
 		{
+			renderThread.Stop();
 			FlushCommandQueue();
+			if (dumpFrameStatisticsOnExit)
+				frameStatistics.Dump();
 		}
 
 		D3D12App(std::uint32_t width, std::uint32_t height)
@@ -22,9 +30,15 @@ export namespace App
 
 		auto MainLoop(this auto&& self) -> Win32::LRESULT
 		{
+			if (self.loopMode == LoopMode::EventDriven)
+				return self.EventDrivenLoop();
+			if (self.loopMode == LoopMode::RenderThread)
+				return self.RenderThreadLoop();
+
 			auto msg = Win32::MSG{};
 			while (msg.message != Win32::Messages::Quit)
 			{
+				auto zone = Profiling::Zone{ "D3D12App::MainLoop" };
 				if (Win32::PeekMessageW(&msg, nullptr, 0, 0, Win32::PeekMessageOptions::Remove))
 				{
 					Win32::TranslateMessage(&msg);
@@ -32,7 +46,12 @@ export namespace App
 				}
 				else
 				{
-					self.OnIdle();
+					auto idleZone = Profiling::Zone{ "D3D12App::OnIdle" };
+					{
+						auto timer = self.frameStatistics.Time(FrameMetric::CpuFrame);
+						self.OnIdle();
+					}
+					self.frameStatistics.EndFrame();
 				}
 			}
 			return msg.wParam;
@@ -43,6 +62,156 @@ export namespace App
 			// Default idle processing does nothing.
 		}
 
+		// Called zero or more times per frame in the event-driven loop, once per fixed step.
+		void OnUpdate(this auto& self, std::chrono::nanoseconds step)
+		{
+			// Default update processing does nothing.
+		}
+
+		// Called once per frame in the event-driven loop. alpha is how far between the last
+		// update and the next the frame is, for interpolating between simulation states.
+		void OnRender(this auto& self, double alpha)
+		{
+			self.OnIdle();
+		}
+
+		// Runs a frame whenever RunEventDrivenLoop() says one is due.
+		auto EventDrivenLoop(this auto& self) -> Win32::LRESULT
+		{
+			return RunEventDrivenLoop(
+				self.frameTimerDesc,
+				self.frameFenceValues,
+				[&self]
+				{
+					return FrameSync{
+						.FrameLatencyWaitable = self.frameLatencyWaitable.get(),
+						.Fence = self.fence.get(),
+						.FenceEvent = self.frameFenceEvent.GetHandle()
+					};
+				},
+				[&self](const FrameTick& tick)
+				{
+					auto presents = self.presentCount;
+					{
+						auto zone = Profiling::Zone{ "D3D12App::Frame" };
+						auto cpuTimer = self.frameStatistics.Time(FrameMetric::CpuFrame);
+						for (std::uint32_t i = 0; i < tick.Updates; ++i)
+							self.OnUpdate(self.frameTimerDesc.UpdateStep);
+						self.OnRender(tick.Alpha);
+					}
+					self.frameStatistics.EndFrame();
+					return FrameResult{ .Presented = self.presentCount != presents, .FenceValue = self.Signal() };
+				});
+		}
+
+		// Called on the render thread, in order, for each input message forwarded to it.
+		void OnRenderThreadEvent(this auto& self, const RenderEvent& event)
+		{
+			// Default forwarded message processing does nothing.
+		}
+
+		// Runs frames on a dedicated render thread, while this thread blocks in GetMessageW
+		// and forwards input and resizes through HandleMessage().
+		auto RenderThreadLoop(this auto& self) -> Win32::LRESULT
+		{
+			auto hwnd = self.GetHandle();
+			self.renderThread.Start(
+				[&self, hwnd, timer = FrameTimer{ self.frameTimerDesc }](
+					std::span<const RenderEvent> events,
+					std::optional<Dimensions> resize
+				) mutable -> std::chrono::nanoseconds
+				{
+					try
+					{
+						if (resize and resize->Width > 0 and resize->Height > 0)
+							self.Resize(resize->Width, resize->Height);
+						for (const auto& event : events)
+							self.OnRenderThreadEvent(event);
+
+						if (auto untilFrame = timer.TimeUntilNextFrame(); untilFrame > std::chrono::nanoseconds::zero())
+							return untilFrame;
+						{
+							auto zone = Profiling::Zone{ "D3D12App::Frame" };
+							auto cpuTimer = self.frameStatistics.Time(FrameMetric::CpuFrame);
+							auto tick = timer.Tick();
+							for (std::uint32_t i = 0; i < tick.Updates; ++i)
+								self.OnUpdate(timer.GetDesc().UpdateStep);
+							self.OnRender(tick.Alpha);
+						}
+						self.frameStatistics.EndFrame();
+						return timer.TimeUntilNextFrame();
+					}
+					catch (...)
+					{
+						// Closing the window ends the message loop below, which rethrows this from Join().
+						Win32::PostMessageW(hwnd, Win32::Messages::Close, 0, 0);
+						throw;
+					}
+				});
+
+			auto msg = Win32::MSG{};
+			while (Win32::GetMessageW(&msg, nullptr, 0, 0) > 0)
+			{
+				Win32::TranslateMessage(&msg);
+				Win32::DispatchMessageW(&msg);
+			}
+			self.renderThread.RequestStop();
+			self.renderThread.Join();
+			return msg.wParam;
+		}
+
+		// When rendering on a dedicated thread, forwards what it needs before the usual dispatch.
+		auto HandleMessage(
+			this auto&& self,
+			Win32::HWND hwnd,
+			unsigned msgType,
+			Win32::WPARAM wParam,
+			Win32::LPARAM lParam
+		) -> Win32::LRESULT
+		{
+			if (self.renderThread.IsRunning())
+			{
+				if (msgType == Win32::Messages::Size and wParam != Win32::SizingType::Minimized)
+				{
+					self.renderThread.Resize(Dimensions{ Win32::LoWord(lParam), Win32::HiWord(lParam) });
+				}
+				else if (IsInputMessage(msgType))
+				{
+					self.renderThread.Post(RenderEvent{ msgType, wParam, lParam });
+				}
+				else if (msgType == Win32::Messages::Close or msgType == Win32::Messages::Destroy)
+				{
+					// The window has to outlive the render thread's last present.
+					self.renderThread.RequestStop();
+					self.renderThread.WaitWhilePumping();
+				}
+			}
+			return self.WindowedApp::HandleMessage(hwnd, msgType, wParam, lParam);
+		}
+
+		// Resizes the swap chain and everything sized to it, once the GPU is idle.
+		void Resize(this auto& self, std::uint32_t width, std::uint32_t height)
+		{
+			self.FlushCommandQueue();
+			self.renderTargets.clear();
+			self.depthStencilBuffer.reset();
+			auto hr = Com::HResult{
+				self.swapChain->ResizeBuffers(
+					self.swapChainBufferCount,
+					width,
+					height,
+					self.backBufferFormat,
+					self.swapChainFlags
+				) };
+			if (not hr)
+				throw Error::ComError(hr, "Failed to resize swap chain buffers");
+			self.width = width;
+			self.height = height;
+			self.CreateRenderTargetViews()
+				.CreateDepthStencilView(width, height)
+				.SetViewportAndScissorRect(width, height);
+		}
+
 		auto AsD3D12App(this D3D12App& self) -> D3D12App&
 		{
 			return self;
@@ -61,6 +230,7 @@ export namespace App
 		*/
 		void InitialiseD3D12(this auto& self)
 		{
+			auto zone = Profiling::Zone{ "D3D12App::InitialiseD3D12" };
 			auto [width, height] = self.GetDimensions();
 			self.InitDxInfrastructure()
 				.InitDescriptorSizes()
@@ -121,22 +291,71 @@ export namespace App
 			return self;
 		}
 
-		void FlushCommandQueue(this auto& self)
+		// The Try variants below report failures, such as DXGI::Error::DeviceRemoved, as
+		// values for per-frame paths that want to handle them without exceptions. The
+		// throwing versions are the same calls unwrapped. The per-frame ones are noexcept,
+		// so with SHARED_NO_EXCEPTIONS a frame that stays on them can't throw.
+
+		// Advances the fence and signals it on the queue. Returns the signalled value.
+		auto TrySignal(this auto& self) noexcept -> Com::Expected<std::uint64_t>
 		{
-			// Advance the fence value to mark commands up to this fence point.
 			self.currentFence++;
-			auto hr = Com::HResult{ self.commandQueue->Signal(self.fence.get(), self.currentFence) };
-			if (not hr)
-				throw Error::ComError(hr, "Failed to signal command queue");
-			// Wait until the GPU has completed commands up to this fence point.
-			if (self.fence->GetCompletedValue() < self.currentFence)
-			{
-				auto eventHandle = Async::ManualResetEvent{};
-				hr = self.fence->SetEventOnCompletion(self.currentFence, eventHandle.GetHandle());
-				if (not hr)
-					throw Error::ComError(hr, "Failed to set fence event");
-				eventHandle.Wait();
-			}
+			return Com::HResult{ self.commandQueue->Signal(self.fence.get(), self.currentFence) }.ToExpected(self.currentFence);
+		}
+
+		auto Signal(this auto& self) -> std::uint64_t
+		{
+			return Com::Unwrap(self.TrySignal(), "Failed to signal command queue");
+		}
+
+		auto TryFlushCommandQueue(this auto& self) noexcept -> Com::Expected<>
+		{
+			auto zone = Profiling::Zone{ "D3D12App::FlushCommandQueue" };
+			auto timer = self.frameStatistics.Time(FrameMetric::FlushCommandQueue);
+			// Advance the fence value to mark commands up to this fence point, then wait
+			// until the GPU has completed commands up to it.
+			return self.TrySignal().and_then(
+				[&self](std::uint64_t fenceValue) -> Com::Expected<>
+				{
+					if (self.fence->GetCompletedValue() >= fenceValue)
+						return {};
+					// Uses an event made up front, as creating one here could throw.
+					return Com::HResult{ self.fence->SetEventOnCompletion(fenceValue, self.flushEvent.GetHandle()) }.AndThen(
+						[&self]
+						{
+							auto waitTimer = self.frameStatistics.Time(FrameMetric::GpuWait);
+							if (Win32::WaitForSingleObject(self.flushEvent.GetHandle(), Win32::Infinite) == Win32::WaitResult::Failed)
+								return Com::Expected<>{ std::unexpected{ Com::LastError() } };
+							return Com::Expected<>{};
+						});
+				});
+		}
+
+		void FlushCommandQueue(this auto& self)
+		{
+			Com::Unwrap(self.TryFlushCommandQueue(), "Failed to flush command queue");
+		}
+
+		// On success, holds the success code, which may be DXGI::Status::Occluded.
+		auto TryPresent(this auto& self, std::uint32_t syncInterval = 1, std::uint32_t flags = 0) noexcept -> Com::Expected<Com::HResult>
+		{
+			auto timer = self.frameStatistics.Time(FrameMetric::Present);
+			auto hr = Com::HResult{ self.swapChain->Present(syncInterval, flags) };
+			// An occluded window succeeds without presenting, which wouldn't release the
+			// frame latency waitable the event-driven loop then waits on.
+			if (hr == Win32::HrOk)
+				self.presentCount++;
+			return hr.ToExpected(hr);
+		}
+
+		void Present(this auto& self, std::uint32_t syncInterval = 1, std::uint32_t flags = 0)
+		{
+			Com::Unwrap(self.TryPresent(syncInterval, flags), "Failed to present swap chain");
+		}
+
+		auto GetFrameStatistics(this const auto& self) noexcept -> const FrameStatistics&
+		{
+			return self.frameStatistics;
 		}
 
 		auto InitDescriptorSizes(this auto& self) -> decltype(auto)
@@ -147,48 +366,71 @@ export namespace App
 			return self;
 		}
 
-		auto CreateCommandObjects(this auto& self) -> decltype(auto)
+		auto TryCreateCommandQueue(this auto& self) -> Com::Expected<>
 		{
 			auto queueDesc = D3D12::D3D12_COMMAND_QUEUE_DESC{
 				.Type = D3D12::D3D12_COMMAND_LIST_TYPE::D3D12_COMMAND_LIST_TYPE_DIRECT,
 				.Flags = D3D12::D3D12_COMMAND_QUEUE_FLAGS::D3D12_COMMAND_QUEUE_FLAG_NONE,
 			};
-			auto hr = Com::HResult{
+			return Com::HResult{
 				self.d3d12Device->CreateCommandQueue(
 					&queueDesc,
 					self.commandQueue.GetUuid(),
 					std::out_ptr(self.commandQueue)
-				) };
-			if (not hr)
-				throw Error::ComError(hr, "Failed to create D3D12 Command Queue");
+				) }.ToExpected();
+		}
 
-			hr = self.d3d12Device->CreateCommandAllocator(
-				D3D12::D3D12_COMMAND_LIST_TYPE::D3D12_COMMAND_LIST_TYPE_DIRECT,
-				self.commandAllocator.GetUuid(),
-				std::out_ptr(self.commandAllocator)
-			);
-			if (not hr)
-				throw Error::ComError(hr, "Failed to create D3D12 Command Allocator");
+		auto TryCreateCommandAllocator(this auto& self) -> Com::Expected<>
+		{
+			return Com::HResult{
+				self.d3d12Device->CreateCommandAllocator(
+					D3D12::D3D12_COMMAND_LIST_TYPE::D3D12_COMMAND_LIST_TYPE_DIRECT,
+					self.commandAllocator.GetUuid(),
+					std::out_ptr(self.commandAllocator)
+				) }.ToExpected();
+		}
 
-			hr = self.d3d12Device->CreateCommandList(
-				0,
-				D3D12::D3D12_COMMAND_LIST_TYPE::D3D12_COMMAND_LIST_TYPE_DIRECT,
-				self.commandAllocator.get(),
-				nullptr,
-				self.commandList.GetUuid(),
-				std::out_ptr(self.commandList)
-			);
-			if (not hr)
-				throw Error::ComError(hr, "Failed to create D3D12 Command List");
-			// Needs to be Close()d before we can call Reset() on it later.
-			self.commandList->Close();
+		auto TryCreateCommandList(this auto& self) -> Com::Expected<>
+		{
+			return Com::HResult{
+				self.d3d12Device->CreateCommandList(
+					0,
+					D3D12::D3D12_COMMAND_LIST_TYPE::D3D12_COMMAND_LIST_TYPE_DIRECT,
+					self.commandAllocator.get(),
+					nullptr,
+					self.commandList.GetUuid(),
+					std::out_ptr(self.commandList)
+				) }
+				.AndThen(
+					[&self]
+					{
+						// Needs to be Close()d before we can call Reset() on it later.
+						return Com::HResult{ self.commandList->Close() };
+					});
+		}
+
+		auto TryCreateCommandObjects(this auto& self) -> Com::Expected<>
+		{
+			return self.TryCreateCommandQueue()
+				.and_then([&self] { return self.TryCreateCommandAllocator(); })
+				.and_then([&self] { return self.TryCreateCommandList(); });
+		}
 
+		auto CreateCommandObjects(this auto& self) -> decltype(auto)
+		{
+			Com::Unwrap(self.TryCreateCommandQueue(), "Failed to create D3D12 command queue");
+			Com::Unwrap(self.TryCreateCommandAllocator(), "Failed to create D3D12 command allocator");
+			Com::Unwrap(self.TryCreateCommandList(), "Failed to create D3D12 command list");
 			return self;
 		}
 
-		auto CreateSwapChain(this auto& self, std::uint32_t width, std::uint32_t height) -> decltype(auto)
+		auto TryCreateSwapChain(this auto& self, std::uint32_t width, std::uint32_t height) -> Com::Expected<>
 		{
+			self.frameLatencyWaitable.reset();
 			self.swapChain.reset();
+			auto flags = static_cast<std::uint32_t>(DXGI::DXGI_SWAP_CHAIN_FLAG::DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH);
+			if (self.loopMode == LoopMode::EventDriven)
+				flags |= DXGI::DXGI_SWAP_CHAIN_FLAG::DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 			auto swapChainDesc = DXGI::DXGI_SWAP_CHAIN_DESC{
 				.BufferDesc{
 					.Width = width,
@@ -210,17 +452,32 @@ export namespace App
 				.OutputWindow = self.GetHandle(),
 				.Windowed = true,
 				.SwapEffect = DXGI::DXGI_SWAP_EFFECT::DXGI_SWAP_EFFECT_FLIP_DISCARD,
-				.Flags = DXGI::DXGI_SWAP_CHAIN_FLAG::DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH
+				.Flags = flags
 			};
+			self.swapChainFlags = flags;
 			auto hr = Com::HResult{
 				self.dxgiFactory->CreateSwapChain(
 					self.commandQueue.get(),
 					&swapChainDesc,
 					std::out_ptr(self.swapChain)
 				) };
+			if (not hr or self.loopMode != LoopMode::EventDriven)
+				return hr.ToExpected();
+
+			auto swapChain2 = Com::Ptr<DXGI::IDXGISwapChain2>{};
+			hr = self.swapChain->QueryInterface(swapChain2.GetUuid(), swapChain2.AddressOf());
 			if (not hr)
-				throw Error::ComError(hr, "Failed to create DXGI Swap Chain");
+				return std::unexpected{ hr };
+			hr = swapChain2->SetMaximumFrameLatency(1);
+			if (not hr)
+				return std::unexpected{ hr };
+			self.frameLatencyWaitable = Raii::HandleUniquePtr{ swapChain2->GetFrameLatencyWaitableObject() };
+			return {};
+		}
 
+		auto CreateSwapChain(this auto& self, std::uint32_t width, std::uint32_t height) -> decltype(auto)
+		{
+			Com::Unwrap(self.TryCreateSwapChain(width, height), "Failed to create DXGI Swap Chain");
 			return self;
 		}
 
@@ -367,6 +624,17 @@ export namespace App
 		Com::Ptr<D3D12::ID3D12Resource> swapChainBuffer[swapChainBufferCount];
 		std::vector<Com::Ptr<D3D12::ID3D12Resource>> renderTargets;
 
+		// Set before InitialiseD3D12(), as the event-driven loop needs a waitable swap chain.
+		LoopMode loopMode = LoopMode::Continuous;
+		FrameTimerDesc frameTimerDesc{};
+		Raii::HandleUniquePtr frameLatencyWaitable;
+		Async::AutoResetEvent frameFenceEvent;
+		Async::AutoResetEvent flushEvent;
+		std::array<std::uint64_t, swapChainBufferCount> frameFenceValues{};
+		std::uint64_t presentCount = 0;
+		std::uint32_t swapChainFlags = 0;
+		RenderThread renderThread;
+
 		// RTV = Render Target View
 		// DSV = Depth Stencil View
 		// render target view descriptor size
@@ -379,6 +647,18 @@ export namespace App
 
 		D3D12::D3D12_VIEWPORT viewport{};
 		D3D12::D3D12_RECT scissorRect{};
+
+		// Frame, GPU wait, flush and present times, fed by the loops and helpers above.
+		FrameStatistics frameStatistics;
+		// Apps that want the summary logged when they're destroyed set this.
+		bool dumpFrameStatisticsOnExit = false;
 #pragma endregion
 	};
 }
+
+namespace
+{
+	static_assert(noexcept(std::declval<App::D3D12App&>().TrySignal()));
+	static_assert(noexcept(std::declval<App::D3D12App&>().TryFlushCommandQueue()));
+	static_assert(noexcept(std::declval<App::D3D12App&>().TryPresent()));
+}
@@ -0,0 +1,134 @@
+export module shared:app.dispatch;
+import std;
+import :win32;
+import :util;
+import :util.perfecthash;
+import :app.common;
+
+namespace App::Detail
+{
+	template<auto VKeys>
+	constexpr auto ToMessageIds() noexcept -> std::array<std::uint32_t, VKeys.size()>
+	{
+		auto ids = std::array<std::uint32_t, VKeys.size()>{};
+		for (std::size_t i = 0; i < VKeys.size(); ++i)
+			ids[i] = static_cast<std::uint32_t>(VKeys[i]);
+		return ids;
+	}
+}
+
+export namespace App
+{
+	// Perfect hash over a fixed set of message ids, built at compile time.
+	template<auto VKeys>
+	using MessageHashTable = Util::PerfectHashTable<Detail::ToMessageIds<VKeys>(), Util::Mix32>;
+
+	template<typename TWindow>
+	using MessageHandler = auto(*)(TWindow&, Win32::HWND, Win32::WPARAM, Win32::LPARAM) -> Win32::LRESULT;
+
+	template<typename TWindow, Win32::DWORD VMessageId>
+	constexpr auto MakeMessageHandler() noexcept -> MessageHandler<TWindow>
+	{
+		using TMsg = Win32Message<VMessageId>;
+		if constexpr (Handles<TWindow, TMsg>)
+			return [](TWindow& window, Win32::HWND hwnd, Win32::WPARAM wParam, Win32::LPARAM lParam) -> Win32::LRESULT
+				{
+					return window.OnMessage(TMsg{ hwnd, wParam, lParam });
+				};
+		else
+			return nullptr;
+	}
+
+	// Routes a message to TWindow's OnMessage() overload for it in constant time, using a
+	// per-window table of handlers laid out by MessageHashTable. Slots for messages TWindow
+	// doesn't handle are left empty.
+	template<typename TWindow, auto VMessages = HandledMessages>
+	struct MessageDispatcher
+	{
+		using Table = MessageHashTable<VMessages>;
+
+		static constexpr auto Handlers =
+			[]<std::size_t...Is>(std::index_sequence<Is...>)
+			{
+				auto handlers = std::array<MessageHandler<TWindow>, Table::SlotCount>{};
+				((handlers[Table::Slot(static_cast<std::uint32_t>(VMessages[Is]))] = MakeMessageHandler<TWindow, VMessages[Is]>()), ...);
+				return handlers;
+			}(std::make_index_sequence<VMessages.size()>());
+
+		// Empty if TWindow doesn't handle msgType.
+		static constexpr auto Dispatch(
+			TWindow& window,
+			Win32::HWND hwnd,
+			unsigned msgType,
+			Win32::WPARAM wParam,
+			Win32::LPARAM lParam
+		) -> std::optional<Win32::LRESULT>
+		{
+			auto slot = Table::Find(msgType);
+			if (slot == Table::SlotCount or not Handlers[slot])
+				return std::nullopt;
+			return Handlers[slot](window, hwnd, wParam, lParam);
+		}
+	};
+}
+
+namespace
+{
+	struct TestWindow
+	{
+		constexpr auto OnMessage(App::Win32Message<Win32::Messages::Size> msg) -> Win32::LRESULT
+		{
+			return static_cast<Win32::LRESULT>(msg.wParam) + 1;
+		}
+
+		constexpr auto OnMessage(App::Win32Message<Win32::Messages::Paint>) -> Win32::LRESULT
+		{
+			return 2;
+		}
+	};
+
+	constexpr auto ManyMessageIds =
+		[] {
+			auto ids = std::array<std::uint32_t, 256>{};
+			for (std::uint32_t i = 0; i < ids.size(); ++i)
+				ids[i] = 0x400 + i * 3;
+			return ids;
+		}();
+
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			using Table = App::MessageHashTable<App::HandledMessages>;
+			auto seen = std::array<bool, Table::SlotCount>{};
+			for (auto message : App::HandledMessages)
+			{
+				auto slot = Table::Find(message);
+				if (slot == Table::SlotCount or seen[slot])
+					throw std::exception{ "Expected every handled message to have its own slot" };
+				seen[slot] = true;
+			}
+			if (Table::Find(Win32::Messages::MouseMove) != Table::SlotCount)
+				throw std::exception{ "Expected an unhandled message not to be found" };
+			if (Table::Find(Table::EmptyKey) != Table::SlotCount)
+				throw std::exception{ "Expected the empty key not to be found in a free slot" };
+		},
+		[] {
+			using Table = App::MessageHashTable<ManyMessageIds>;
+			for (auto id : ManyMessageIds)
+				if (Table::Find(id) == Table::SlotCount)
+					throw std::exception{ "Expected every id in a large set to be found" };
+			for (std::uint32_t id = 0x401; id < 0x400 + 256 * 3; id += 3)
+				if (Table::Find(id) != Table::SlotCount)
+					throw std::exception{ "Expected ids outside a large set not to be found" };
+		},
+		[] {
+			using Dispatcher = App::MessageDispatcher<TestWindow>;
+			auto window = TestWindow{};
+			if (Dispatcher::Dispatch(window, nullptr, Win32::Messages::Size, 41, 0) != 42)
+				throw std::exception{ "Expected Size to be dispatched" };
+			if (Dispatcher::Dispatch(window, nullptr, Win32::Messages::Paint, 0, 0) != 2)
+				throw std::exception{ "Expected Paint to be dispatched" };
+			if (Dispatcher::Dispatch(window, nullptr, Win32::Messages::KeyUp, 0, 0))
+				throw std::exception{ "Expected KeyUp not to be dispatched" };
+		}
+	};
+}
@@ -0,0 +1,342 @@
+export module shared:app.frameloop;
+import std;
+import :win32;
+import :error;
+import :raii;
+import :util;
+import :com;
+
+export namespace App
+{
+	enum class LoopMode
+	{
+		// Spins on PeekMessageW and calls OnIdle whenever the queue is empty.
+		Continuous,
+		// Runs fixed-timestep updates and an interpolated render per frame, and
+		// sleeps until a message, the swap chain or the GPU needs attention.
+		EventDriven,
+		// Runs the EventDriven frame on a dedicated thread. The window's thread only
+		// pumps messages and forwards input, resizes and shutdown to it.
+		RenderThread
+	};
+
+	template<typename T>
+	concept FrameClock = requires(const T& clock)
+	{
+		{ clock.Now() } -> std::same_as<std::chrono::nanoseconds>;
+	};
+
+	struct SteadyFrameClock
+	{
+		auto Now(this const SteadyFrameClock&) noexcept -> std::chrono::nanoseconds
+		{
+			return std::chrono::steady_clock::now().time_since_epoch();
+		}
+	};
+
+	struct FrameTimerDesc
+	{
+		std::chrono::nanoseconds UpdateStep = std::chrono::nanoseconds{ 1'000'000'000 / 60 };
+		// The shortest time between two frames. Zero leaves the frame rate uncapped.
+		std::chrono::nanoseconds MinFrameTime = std::chrono::nanoseconds::zero();
+		// Bounds the catch-up after a stall, so that one slow frame can't cause
+		// a run of slower and slower frames.
+		std::uint32_t MaxUpdatesPerFrame = 5;
+	};
+
+	struct FrameTick
+	{
+		std::uint32_t Updates = 0;
+		// Fraction of an update step between the last update and now, in [0, 1].
+		double Alpha = 0;
+		std::chrono::nanoseconds Elapsed{};
+	};
+
+	// The timing policy for the event-driven loop, kept apart from any Win32 waiting
+	// so that it can be driven by a fake clock.
+	template<FrameClock TClock>
+	class BasicFrameTimer
+	{
+	public:
+		constexpr BasicFrameTimer(FrameTimerDesc desc = {}, TClock clock = {}) noexcept
+			: desc(desc), clock(clock), lastFrame(clock.Now())
+		{ }
+
+		// Zero once the next frame is due.
+		constexpr auto TimeUntilNextFrame(this const BasicFrameTimer& self) noexcept -> std::chrono::nanoseconds
+		{
+			auto due = self.lastFrame + self.desc.MinFrameTime;
+			auto now = self.clock.Now();
+			return due > now ? due - now : std::chrono::nanoseconds::zero();
+		}
+
+		// Starts a frame, consuming the time since the last one in whole update steps.
+		constexpr auto Tick(this BasicFrameTimer& self) noexcept -> FrameTick
+		{
+			auto now = self.clock.Now();
+			auto elapsed = now - self.lastFrame;
+			self.lastFrame = now;
+			self.accumulator = std::min(self.accumulator + elapsed, self.desc.UpdateStep * self.desc.MaxUpdatesPerFrame);
+			auto updates = static_cast<std::uint32_t>(self.accumulator / self.desc.UpdateStep);
+			self.accumulator -= self.desc.UpdateStep * updates;
+			return FrameTick{
+				.Updates = updates,
+				.Alpha = static_cast<double>(self.accumulator.count()) / static_cast<double>(self.desc.UpdateStep.count()),
+				.Elapsed = elapsed
+			};
+		}
+
+		// Drops any accumulated time, e.g. after being minimised, so the
+		// simulation doesn't try to catch up on time it wasn't running.
+		constexpr void Reset(this BasicFrameTimer& self) noexcept
+		{
+			self.lastFrame = self.clock.Now();
+			self.accumulator = std::chrono::nanoseconds::zero();
+		}
+
+		constexpr auto GetDesc(this const BasicFrameTimer& self) noexcept -> const FrameTimerDesc&
+		{
+			return self.desc;
+		}
+
+	private:
+		FrameTimerDesc desc;
+		TClock clock;
+		std::chrono::nanoseconds lastFrame;
+		std::chrono::nanoseconds accumulator = std::chrono::nanoseconds::zero();
+	};
+
+	using FrameTimer = BasicFrameTimer<SteadyFrameClock>;
+
+	enum class WakeReason
+	{
+		Message,
+		Handle,
+		Timeout
+	};
+
+	struct Wake
+	{
+		WakeReason Reason = WakeReason::Timeout;
+		// The index of the signalled handle when Reason is Handle.
+		std::size_t Index = 0;
+	};
+
+	// Dispatches every pending message for the thread. Returns the exit code once WM_QUIT is seen.
+	inline auto PumpMessages() -> std::optional<Win32::LRESULT>
+	{
+		auto msg = Win32::MSG{};
+		while (Win32::PeekMessageW(&msg, nullptr, 0, 0, Win32::PeekMessageOptions::Remove))
+		{
+			if (msg.message == Win32::Messages::Quit)
+				return static_cast<Win32::LRESULT>(msg.wParam);
+			Win32::TranslateMessage(&msg);
+			Win32::DispatchMessageW(&msg);
+		}
+		return std::nullopt;
+	}
+
+	// Sleeps in a single MsgWaitForMultipleObjectsEx call on the thread's message queue,
+	// the given handles and a high resolution waitable timer for the timeout. The timer
+	// avoids the default ~15ms granularity of the wait's own timeout.
+	class FrameWaiter
+	{
+	public:
+		auto Wait(
+			this FrameWaiter& self,
+			std::span<const Win32::HANDLE> handles,
+			std::optional<std::chrono::nanoseconds> timeout = std::nullopt
+		) -> Wake
+		{
+			if (handles.size() + 1 >= Win32::MaximumWaitObjects)
+				throw Error::RuntimeError{ std::format("Cannot wait on {} handles", handles.size()) };
+
+			auto waitHandles = std::array<Win32::HANDLE, Win32::MaximumWaitObjects>{};
+			std::ranges::copy(handles, waitHandles.begin());
+			auto count = static_cast<Win32::DWORD>(handles.size());
+			auto milliseconds = Win32::DWORD{ Win32::Infinite };
+			if (timeout and *timeout <= std::chrono::nanoseconds::zero())
+			{
+				milliseconds = 0;
+			}
+			else if (timeout)
+			{
+				// Negative due times are relative, in 100ns units.
+				auto dueTime = Win32::LARGE_INTEGER{ .QuadPart = -std::max<long long>(timeout->count() / 100, 1) };
+				if (not Win32::SetWaitableTimer(self.timer.get(), &dueTime, 0, nullptr, nullptr, false))
+					throw Error::Win32Error{ Win32::GetLastError(), "Failed to set frame timer" };
+				waitHandles[count++] = self.timer.get();
+			}
+
+			auto result = Win32::MsgWaitForMultipleObjectsEx(
+				count,
+				waitHandles.data(),
+				milliseconds,
+				Win32::QueueStatus::AllInput,
+				Win32::MsgWaitOptions::InputAvailable
+			);
+			if (result == Win32::WaitResult::Timeout)
+				return Wake{ WakeReason::Timeout };
+			if (result == Win32::WaitResult::Failed)
+				throw Error::Win32Error{ Win32::GetLastError(), "Failed to wait for messages or frame events" };
+
+			auto index = static_cast<std::size_t>(result - Win32::WaitResult::Signaled);
+			if (index < handles.size())
+				return Wake{ WakeReason::Handle, index };
+			if (index == count)
+				return Wake{ WakeReason::Message };
+			if (index < count)
+				return Wake{ WakeReason::Timeout };
+			throw Error::RuntimeError{ std::format("Unexpected wait result {}", result) };
+		}
+
+	private:
+		static auto CreateTimer() -> Raii::HandleUniquePtr
+		{
+			auto handle = Win32::CreateWaitableTimerExW(
+				nullptr,
+				nullptr,
+				Win32::WaitableTimerOptions::HighResolution,
+				Win32::WaitableTimerOptions::AllAccess
+			);
+			if (not handle)
+				throw Error::Win32Error{ Win32::GetLastError(), "Failed to create high resolution frame timer" };
+			return Raii::HandleUniquePtr{ handle };
+		}
+
+		Raii::HandleUniquePtr timer = CreateTimer();
+	};
+
+	// What the event-driven loop waits on before it starts a frame.
+	struct FrameSync
+	{
+		// The swap chain's frame latency waitable, or null if it doesn't have one.
+		Win32::HANDLE FrameLatencyWaitable = nullptr;
+		// Signalled on the queue after each frame.
+		D3D12::ID3D12Fence* Fence = nullptr;
+		// Set to be signalled when the fence reaches a frame's value.
+		Win32::HANDLE FenceEvent = nullptr;
+	};
+
+	struct FrameResult
+	{
+		// Whether the frame presented, which is what releases the frame latency waitable.
+		bool Presented = false;
+		// The fence value the queue signals once the frame's work is done.
+		std::uint64_t FenceValue = 0;
+	};
+
+	// Sleeps until there's a message to handle or a frame is due, then runs it with
+	// runFrame(FrameTick) -> FrameResult. A frame is due once the frame cap allows it,
+	// the swap chain can accept another present and the GPU has finished with the last
+	// frame that used the same back buffer. frameFenceValues holds a fence value per back
+	// buffer. sync() is asked for the handles each time round, as a resize can replace the
+	// swap chain's waitable. A frame that doesn't present releases nothing to wait on, so
+	// the next one waits for a message for up to an update step rather than spinning.
+	// Returns the exit code once WM_QUIT is seen.
+	template<typename TSync, typename TRunFrame>
+	auto RunEventDrivenLoop(const FrameTimerDesc& timing, std::span<std::uint64_t> frameFenceValues, TSync&& sync, TRunFrame&& runFrame) -> Win32::LRESULT
+	{
+		auto timer = FrameTimer{ timing };
+		auto waiter = FrameWaiter{};
+		auto swapChainReady = false;
+		auto idle = false;
+		auto frameIndex = std::uint64_t{};
+		while (true)
+		{
+			if (auto exitCode = PumpMessages())
+				return *exitCode;
+
+			auto current = FrameSync{ sync() };
+			auto handles = std::array<Win32::HANDLE, 2>{};
+			auto count = std::size_t{};
+			if (current.FrameLatencyWaitable and not swapChainReady)
+				handles[count++] = current.FrameLatencyWaitable;
+
+			auto slot = frameIndex % frameFenceValues.size();
+			if (current.Fence->GetCompletedValue() < frameFenceValues[slot])
+			{
+				auto hr = Com::HResult{ current.Fence->SetEventOnCompletion(frameFenceValues[slot], current.FenceEvent) };
+				if (not hr)
+					throw Error::ComError(hr, "Failed to set frame fence event");
+				handles[count++] = current.FenceEvent;
+			}
+
+			auto untilFrame = timer.TimeUntilNextFrame();
+			if (idle)
+				untilFrame = std::max(untilFrame, timing.UpdateStep);
+			if (count > 0 or untilFrame > std::chrono::nanoseconds::zero())
+			{
+				auto timeout = untilFrame > std::chrono::nanoseconds::zero()
+					? std::optional{ untilFrame }
+					: std::nullopt;
+				auto wake = waiter.Wait(std::span{ handles.data(), count }, timeout);
+				if (wake.Reason == WakeReason::Handle and handles[wake.Index] == current.FrameLatencyWaitable)
+					swapChainReady = true;
+				idle = false;
+				continue;
+			}
+
+			auto result = FrameResult{ runFrame(timer.Tick()) };
+			// The waitable is only released by a present, so only wait on it again after one.
+			if (result.Presented)
+				swapChainReady = false;
+			idle = not result.Presented;
+			frameFenceValues[slot] = result.FenceValue;
+			frameIndex++;
+		}
+	}
+}
+
+namespace
+{
+	// Reads the time from a value owned by the test, so the test can advance it.
+	struct FakeFrameClock
+	{
+		constexpr auto Now(this const FakeFrameClock& self) noexcept -> std::chrono::nanoseconds
+		{
+			return *self.Time;
+		}
+
+		const std::chrono::nanoseconds* Time = nullptr;
+	};
+
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			using namespace std::chrono_literals;
+			auto now = 0ns;
+			auto timer = App::BasicFrameTimer{
+				App::FrameTimerDesc{ .UpdateStep = 10ms, .MinFrameTime = 20ms },
+				FakeFrameClock{ &now }
+			};
+			if (timer.TimeUntilNextFrame() != 20ms)
+				throw std::exception{ "Expected to wait for the frame cap" };
+			now = 25ms;
+			if (timer.TimeUntilNextFrame() != 0ns)
+				throw std::exception{ "Expected the frame to be due" };
+			auto tick = timer.Tick();
+			if (tick.Updates != 2 or tick.Alpha != 0.5 or tick.Elapsed != 25ms)
+				throw std::exception{ "Expected two updates and half a step left over" };
+			now = 30ms;
+			tick = timer.Tick();
+			if (tick.Updates != 1 or tick.Alpha != 0)
+				throw std::exception{ "Expected the left over half step to complete an update" };
+		},
+		[] {
+			using namespace std::chrono_literals;
+			auto now = 0ns;
+			auto timer = App::BasicFrameTimer{
+				App::FrameTimerDesc{ .UpdateStep = 10ms, .MaxUpdatesPerFrame = 3 },
+				FakeFrameClock{ &now }
+			};
+			now = 1s;
+			if (timer.Tick().Updates != 3)
+				throw std::exception{ "Expected catch-up updates to be capped" };
+			now = 2s;
+			timer.Reset();
+			now = 2s + 5ms;
+			if (timer.Tick().Updates != 0)
+				throw std::exception{ "Expected no updates after a reset" };
+		}
+	};
+}
@@ -0,0 +1,182 @@
+export module shared:app.framestatistics;
+import std;
+import :log;
+import :util;
+import :profiling;
+
+export namespace App
+{
+	enum class FrameMetric : std::size_t
+	{
+		// Durations, in microseconds
+		CpuFrame,
+		GpuWait,
+		FlushCommandQueue,
+		Present,
+		Count
+	};
+
+	constexpr auto ToString(FrameMetric metric) noexcept -> std::string_view
+	{
+		constexpr auto names = std::array<std::string_view, std::to_underlying(FrameMetric::Count)>{
+			"CpuFrame (us)",
+			"GpuWait (us)",
+			"FlushCommandQueue (us)",
+			"Present (us)"
+		};
+		return names[std::to_underlying(metric)];
+	}
+
+	struct MetricSummary
+	{
+		std::uint64_t Count = 0;
+		std::uint64_t P50 = 0;
+		std::uint64_t P95 = 0;
+		std::uint64_t P99 = 0;
+		std::uint64_t Max = 0;
+	};
+
+	// Rolling per-frame statistics. Every sample goes into a lifetime histogram and into
+	// a window histogram that is rotated every VWindowFrames frames, so the most recent
+	// complete window is always available for tail latency queries. The histograms are
+	// kept on the heap, as at around 4KB each they'd otherwise bloat whatever owns them.
+	template<std::uint64_t VWindowFrames = 1000>
+	class BasicFrameStatistics
+	{
+	public:
+		using Histogram = Profiling::Histogram<>;
+		using Histograms = std::array<Histogram, std::to_underlying(FrameMetric::Count)>;
+
+		class ScopedTimer
+		{
+		public:
+			ScopedTimer(BasicFrameStatistics& statistics, FrameMetric metric) noexcept
+				: statistics(statistics), metric(metric)
+			{ }
+
+			~ScopedTimer()
+			{
+				auto elapsed = std::chrono::steady_clock::now() - start;
+				statistics.Record(metric, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+			}
+
+			ScopedTimer(const ScopedTimer&) = delete;
+			auto operator=(const ScopedTimer&) -> ScopedTimer& = delete;
+
+		private:
+			BasicFrameStatistics& statistics;
+			FrameMetric metric;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		};
+
+		[[nodiscard]]
+		auto Time(this BasicFrameStatistics& self, FrameMetric metric) noexcept -> ScopedTimer
+		{
+			return ScopedTimer{ self, metric };
+		}
+
+		constexpr void Record(this BasicFrameStatistics& self, FrameMetric metric, std::uint64_t value) noexcept
+		{
+			self.histograms->Window[std::to_underlying(metric)].Record(value);
+			self.histograms->Lifetime[std::to_underlying(metric)].Record(value);
+		}
+
+		// Rotates the window when it is full.
+		constexpr void EndFrame(this BasicFrameStatistics& self) noexcept
+		{
+			if (++self.frames % VWindowFrames == 0)
+			{
+				std::swap(self.histograms->LastWindow, self.histograms->Window);
+				for (auto& histogram : self.histograms->Window)
+					histogram.Reset();
+			}
+		}
+
+		// Summarises the last complete window, or the current partial window if
+		// no window has completed yet.
+		constexpr auto GetWindowSummary(this const BasicFrameStatistics& self, FrameMetric metric) noexcept -> MetricSummary
+		{
+			return Summarise(self.frames < VWindowFrames
+				? self.histograms->Window[std::to_underlying(metric)]
+				: self.histograms->LastWindow[std::to_underlying(metric)]);
+		}
+
+		constexpr auto GetLifetimeSummary(this const BasicFrameStatistics& self, FrameMetric metric) noexcept -> MetricSummary
+		{
+			return Summarise(self.histograms->Lifetime[std::to_underlying(metric)]);
+		}
+
+		constexpr auto GetFrameCount(this const BasicFrameStatistics& self) noexcept -> std::uint64_t
+		{
+			return self.frames;
+		}
+
+		void Dump(this const BasicFrameStatistics& self)
+		{
+			Log::Info("Frame statistics over {} frames:", self.frames);
+			for (std::size_t i = 0; i < std::to_underlying(FrameMetric::Count); ++i)
+			{
+				auto metric = static_cast<FrameMetric>(i);
+				auto summary = self.GetLifetimeSummary(metric);
+				if (summary.Count == 0)
+					continue;
+				Log::Info(
+					"  {:<24} n={} p50={} p95={} p99={} max={}",
+					ToString(metric),
+					summary.Count,
+					summary.P50,
+					summary.P95,
+					summary.P99,
+					summary.Max
+				);
+			}
+		}
+
+	private:
+		struct WindowedHistograms
+		{
+			Histograms Window{};
+			Histograms LastWindow{};
+			Histograms Lifetime{};
+		};
+
+		static constexpr auto Summarise(const Histogram& histogram) noexcept -> MetricSummary
+		{
+			return MetricSummary{
+				.Count = histogram.Count(),
+				.P50 = histogram.Percentile(0.50),
+				.P95 = histogram.Percentile(0.95),
+				.P99 = histogram.Percentile(0.99),
+				.Max = histogram.Max()
+			};
+		}
+
+		std::unique_ptr<WindowedHistograms> histograms = std::make_unique<WindowedHistograms>();
+		std::uint64_t frames = 0;
+	};
+
+	using FrameStatistics = BasicFrameStatistics<>;
+}
+
+namespace
+{
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			auto statistics = App::BasicFrameStatistics<4>{};
+			for (int frame = 0; frame < 6; ++frame)
+			{
+				statistics.Record(App::FrameMetric::CpuFrame, frame < 4 ? 10'000 : 1);
+				statistics.Record(App::FrameMetric::Present, frame);
+				statistics.EndFrame();
+			}
+			if (statistics.GetWindowSummary(App::FrameMetric::CpuFrame).Count != 4)
+				throw std::exception{ "Expected the last complete window to be reported" };
+			if (statistics.GetWindowSummary(App::FrameMetric::CpuFrame).Max != 10'000)
+				throw std::exception{ "Expected the window max to be 10000" };
+			if (statistics.GetLifetimeSummary(App::FrameMetric::Present).Max != 5)
+				throw std::exception{ "Expected the lifetime present max to be 5" };
+			if (statistics.GetLifetimeSummary(App::FrameMetric::CpuFrame).Count != 6)
+				throw std::exception{ "Expected every frame in the lifetime summary" };
+		}
+	};
+}
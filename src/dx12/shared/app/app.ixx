@@ -3,3 +3,7 @@ export import :app.d3d12app;
 export import :app.windowedapp;
 export import :app.windowedapp2;
 export import :app.common;
+export import :app.framestatistics;
+export import :app.frameloop;
+export import :app.renderthread;
+export import :app.dispatch;
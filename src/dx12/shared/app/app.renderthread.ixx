@@ -0,0 +1,218 @@
+export module shared:app.renderthread;
+import std;
+import :win32;
+import :error;
+import :async;
+import :util;
+import :app.common;
+import :app.frameloop;
+
+export namespace App
+{
+	// A message forwarded from the message thread to the render thread.
+	struct RenderEvent
+	{
+		unsigned Message = 0;
+		Win32::WPARAM wParam = 0;
+		Win32::LPARAM lParam = 0;
+	};
+
+	constexpr auto IsInputMessage(unsigned msgType) noexcept -> bool
+	{
+		return (msgType >= Win32::Messages::KeyFirst and msgType <= Win32::Messages::KeyLast)
+			or (msgType >= Win32::Messages::MouseFirst and msgType <= Win32::Messages::MouseLast);
+	}
+
+	// Called on the render thread with the events posted since the last call and the
+	// latest size if the window was resized. Returns how long the render thread may
+	// sleep before the next call, which is cut short by any new event or resize.
+	using RenderFrameFn = std::function<std::chrono::nanoseconds(std::span<const RenderEvent> events, std::optional<Dimensions> resize)>;
+
+	// Runs rendering on its own thread, fed by whichever thread pumps messages.
+	//
+	// Handoff protocol:
+	//   * Input is posted through a lock-free SPSC queue and delivered in order at the
+	//     start of the next frame. Input is dropped, and counted, if the queue is full.
+	//   * Resizes are coalesced; the render thread only sees the latest size, once, at
+	//     the start of a frame, so it can flush and resize its buffers between frames.
+	//     The message thread never waits for a resize to complete.
+	//   * Shutdown is requested with RequestStop(). The message thread must keep pumping
+	//     until GetStoppedHandle() is signalled (see WaitWhilePumping()), as the render
+	//     thread may be blocked on the window in Present() or ResizeBuffers(). Join() then
+	//     rethrows anything the render thread threw.
+	//
+	// Nothing here depends on a window, so a synthetic message source can drive it.
+	template<std::size_t VQueueCapacity = 1024>
+	class BasicRenderThread
+	{
+	public:
+		~BasicRenderThread()
+		{
+			Stop();
+		}
+
+		BasicRenderThread() = default;
+		BasicRenderThread(const BasicRenderThread&) = delete;
+		auto operator=(const BasicRenderThread&) -> BasicRenderThread& = delete;
+
+		void Start(this BasicRenderThread& self, RenderFrameFn frame)
+		{
+			if (self.thread.joinable())
+				throw Error::RuntimeError{ "The render thread has already been started" };
+			self.stopRequested.store(false, std::memory_order_relaxed);
+			self.pendingSize.store(NoResize, std::memory_order_relaxed);
+			self.stopped.Reset();
+			self.running = true;
+			self.thread = std::thread{ [&self, frame = std::move(frame)] { self.Run(frame); } };
+		}
+
+		// Message thread side. Returns false if the event was dropped.
+		auto Post(this BasicRenderThread& self, const RenderEvent& event) -> bool
+		{
+			if (not self.queue.TryPush(event))
+			{
+				self.dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			self.wake.Set();
+			return true;
+		}
+
+		// Message thread side. Replaces any resize the render thread hasn't picked up yet.
+		void Resize(this BasicRenderThread& self, Dimensions size)
+		{
+			self.pendingSize.store(Pack(size), std::memory_order_release);
+			self.wake.Set();
+		}
+
+		void RequestStop(this BasicRenderThread& self)
+		{
+			self.running = false;
+			self.stopRequested.store(true, std::memory_order_release);
+			self.wake.Set();
+		}
+
+		// Dispatches messages until the render thread has finished its last frame. A WM_QUIT
+		// seen while waiting is posted again so the caller's message loop still sees it.
+		void WaitWhilePumping(this BasicRenderThread& self)
+		{
+			if (not self.thread.joinable())
+				return;
+			auto waiter = FrameWaiter{};
+			auto handles = std::array{ self.stopped.GetHandle() };
+			auto exitCode = std::optional<Win32::LRESULT>{};
+			while (waiter.Wait(handles).Reason != WakeReason::Handle)
+				if (auto code = PumpMessages())
+					exitCode = code;
+			if (exitCode)
+				Win32::PostQuitMessage(static_cast<int>(*exitCode));
+		}
+
+		// Stops and joins without pumping messages or rethrowing, for destructors and unwinding.
+		void Stop(this BasicRenderThread& self) noexcept
+		{
+			self.running = false;
+			self.stopRequested.store(true, std::memory_order_release);
+			self.wake.Set();
+			if (self.thread.joinable())
+				self.thread.join();
+		}
+
+		void Join(this BasicRenderThread& self)
+		{
+			if (self.thread.joinable())
+				self.thread.join();
+			if (self.error)
+				std::rethrow_exception(std::exchange(self.error, nullptr));
+		}
+
+		// True from Start() until a stop is requested. Only meaningful on the message thread.
+		auto IsRunning(this const BasicRenderThread& self) noexcept -> bool
+		{
+			return self.running;
+		}
+
+		auto GetStoppedHandle(this const BasicRenderThread& self) noexcept -> Win32::HANDLE
+		{
+			return self.stopped.GetHandle();
+		}
+
+		auto GetDroppedCount(this const BasicRenderThread& self) noexcept -> std::uint64_t
+		{
+			return self.dropped.load(std::memory_order_relaxed);
+		}
+
+		static constexpr auto Pack(Dimensions size) noexcept -> std::uint64_t
+		{
+			return (std::uint64_t{ size.Width } << 32) | size.Height;
+		}
+
+		static constexpr auto Unpack(std::uint64_t packed) noexcept -> Dimensions
+		{
+			return Dimensions{ static_cast<unsigned>(packed >> 32), static_cast<unsigned>(packed & 0xFFFF'FFFF) };
+		}
+
+	private:
+		static constexpr auto NoResize = std::numeric_limits<std::uint64_t>::max();
+
+		void Run(this BasicRenderThread& self, const RenderFrameFn& frame)
+		{
+			try
+			{
+				auto waiter = FrameWaiter{};
+				auto events = std::vector<RenderEvent>{};
+				auto handles = std::array{ self.wake.GetHandle() };
+				while (not self.stopRequested.load(std::memory_order_acquire))
+				{
+					events.clear();
+					auto event = RenderEvent{};
+					while (self.queue.TryPop(event))
+						events.push_back(event);
+
+					auto resize = std::optional<Dimensions>{};
+					if (auto packed = self.pendingSize.exchange(NoResize, std::memory_order_acq_rel); packed != NoResize)
+						resize = Unpack(packed);
+
+					auto sleep = frame(events, resize);
+					if (sleep > std::chrono::nanoseconds::zero())
+						waiter.Wait(handles, sleep);
+				}
+			}
+			catch (...)
+			{
+				self.error = std::current_exception();
+			}
+			self.stopped.Set();
+		}
+
+		Async::SpscQueue<RenderEvent, VQueueCapacity> queue;
+		std::atomic<std::uint64_t> pendingSize = NoResize;
+		std::atomic<bool> stopRequested = false;
+		std::atomic<std::uint64_t> dropped = 0;
+		Async::AutoResetEvent wake;
+		Async::ManualResetEvent stopped;
+		std::exception_ptr error;
+		bool running = false;
+		std::thread thread;
+	};
+
+	using RenderThread = BasicRenderThread<>;
+}
+
+namespace
+{
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			auto size = App::Dimensions{ 3840, 2160 };
+			auto unpacked = App::RenderThread::Unpack(App::RenderThread::Pack(size));
+			if (unpacked.Width != size.Width or unpacked.Height != size.Height)
+				throw std::exception{ "Expected dimensions to round trip" };
+		},
+		[] {
+			if (not App::IsInputMessage(Win32::Messages::KeyUp) or not App::IsInputMessage(Win32::Messages::MouseMove))
+				throw std::exception{ "Expected keyboard and mouse messages to be input" };
+			if (App::IsInputMessage(Win32::Messages::Size) or App::IsInputMessage(Win32::Messages::Paint))
+				throw std::exception{ "Expected size and paint messages not to be input" };
+		}
+	};
+}
@@ -4,6 +4,7 @@ import :error;
 import :raii;
 import :win32;
 import :app.common;
+import :app.dispatch;
 
 export namespace App
 {
@@ -162,22 +163,12 @@ export namespace App
 			Win32::LPARAM lParam
 		) -> Win32::LRESULT
 		{
-			return [=, &self]<size_t...Is>(std::index_sequence<Is...>)
-			{
-				Win32::LRESULT result;
-				bool handled = (... or
-					[=, &self, &result]<typename TMsg = Win32Message<HandledMessages[Is]>>
-					{
-						if constexpr (Handles<std::remove_cvref_t<decltype(self)>, TMsg>)
-							return TMsg::uMsg == msgType ? (result = self.OnMessage(TMsg{ hwnd, wParam, lParam }), true) : false;
-						return false;
-					}());
-				if (handled)
-					return result;
-				return msgType == Win32::Messages::Destroy
-					? (Win32::PostQuitMessage(0), 0)
-					: Win32::DefWindowProcW(hwnd, msgType, wParam, lParam);
-			}(std::make_index_sequence<HandledMessages.size()>());
+			using Dispatcher = MessageDispatcher<std::remove_cvref_t<decltype(self)>>;
+			if (auto result = Dispatcher::Dispatch(self, hwnd, msgType, wParam, lParam))
+				return *result;
+			return msgType == Win32::Messages::Destroy
+				? (Win32::PostQuitMessage(0), 0)
+				: Win32::DefWindowProcW(hwnd, msgType, wParam, lParam);
 		}
 
 		auto GetDimensions(this const auto& self) noexcept -> Dimensions
@@ -3,13 +3,19 @@ import std;
 import :error;
 import :raii;
 import :win32;
+import :util.inplacefunction;
 import :app.common;
 import :app.windowedapp;
 
 export namespace App
 {
+	// Inline storage only, so setting or invoking a callback never allocates.
 	template<typename TMessage>
-	using Callback = std::function<auto(const TMessage&)->Win32::LRESULT>;
+	using Callback = Util::InplaceFunction<auto(const TMessage&)->Win32::LRESULT>;
+
+	// Observers that are notified of a message before its callback produces the result.
+	template<typename TMessage>
+	using SubscriberList = Util::HandlerList<void(const TMessage&)>;
 
 	constexpr auto DefaultCallback = 
 		[](const auto& msg) static -> Win32::LRESULT 
@@ -29,6 +35,19 @@ export namespace App
 
 		auto OnMessage(this WindowedApp2& self, const auto& msg) -> Win32::LRESULT
 		{
+			std::apply(
+				[&msg](auto&&... subscribers)
+				{
+					(... or [&msg, &subscribers]
+					{
+						if constexpr (std::invocable<decltype(subscribers), decltype(msg)>)
+							return (subscribers(msg), true);
+						return false;
+					}());
+				},
+				self.Subscribers
+			);
+
 			auto result = std::pair<bool, Win32::LRESULT>{};
 			std::apply(
 				[&result, &msg](auto&&... args)
@@ -56,6 +75,32 @@ export namespace App
 			DefaultCallback
 		};
 
+		std::tuple<
+			SubscriberList<Win32Message<Win32::Messages::Size>>
+		> Subscribers;
+
+		// Returns an id for Unsubscribe(). Never allocates; the number of subscribers per
+		// message type is fixed.
+		template<typename TMessage>
+		auto Subscribe(this auto& self, auto&& subscriber) -> std::size_t
+		{
+			using TList = SubscriberList<TMessage>;
+			static_assert(
+				[]<typename...TArgs>(std::type_identity<std::tuple<TArgs...>>) constexpr
+				{
+					return (... or std::same_as<TArgs, TList>);
+				}(std::type_identity<decltype(self.Subscribers)>{}),
+				"Message type not supported. Please update the Subscribers member if supporting a new message type."
+			);
+			return std::get<TList>(self.Subscribers).Subscribe(std::forward<decltype(subscriber)>(subscriber));
+		}
+
+		template<typename TMessage>
+		void Unsubscribe(this auto& self, std::size_t id) noexcept
+		{
+			std::get<SubscriberList<TMessage>>(self.Subscribers).Unsubscribe(id);
+		}
+
 		constexpr void SetCallback(this auto& self, auto&& newCallback)
 		{
 			// At first blush, this would appear to not work, but I tested 
@@ -64,7 +109,9 @@ export namespace App
 			static_assert(
 				[&newCallback]<typename...TArgs>(std::tuple<TArgs...>& allCallbacks) constexpr
 				{
-					return (... or std::assignable_from<decltype(std::get<TArgs&>(allCallbacks)), decltype(newCallback)>);
+					// std::assignable_from can't be used, as it requires a common reference
+					// and so a copyable callback type.
+					return (... or std::is_assignable_v<TArgs&, decltype(newCallback)>);
 				}(self.Callbacks),
 				"Callback type not supported. Please check your parameters and update the Callbacks member if supporting a new message type."
 			);
@@ -74,7 +121,7 @@ export namespace App
 				(... or [&oldCallback = std::get<TArgs>(allCallbacks), &newCallback] constexpr
 				{
 					// Note that you can change this to TArgs&
-					if constexpr (std::assignable_from<decltype(oldCallback), decltype(newCallback)>)
+					if constexpr (std::is_assignable_v<decltype(oldCallback), decltype(newCallback)>)
 					{
 						oldCallback = std::forward<decltype(newCallback)>(newCallback);
 						return true;
@@ -5,6 +5,7 @@ import :raii;
 import :util;
 import :concepts;
 import :strings;
+export import :async.spscqueue;
 
 export namespace Async
 {
@@ -74,7 +75,7 @@ export namespace Async
 					self.Name.data()
 				)};
 			if (not handle)
-				throw Error::Win32Error{ Win32::GetLastError(), std::format("Failed to open event with name '{}'", Strings::ConvertString(self.Name)) };
+				throw Error::Win32Error{ Win32::GetLastError(), std::format("Failed to open event with name '{}'", Strings::Narrowed{ self.Name }) };
 			return Raii::HandleUniquePtr{ handle };
 		}
 		
@@ -0,0 +1,79 @@
+export module shared:async.spscqueue;
+import std;
+
+export namespace Async
+{
+	// Bounded single-producer single-consumer ring. One thread pushes and one thread
+	// pops, without either taking a lock. VCapacity must be a power of two.
+	template<typename T, std::size_t VCapacity>
+	class SpscQueue
+	{
+		static_assert(std::has_single_bit(VCapacity), "SpscQueue capacity must be a power of two");
+
+	public:
+		static constexpr std::size_t Capacity = VCapacity;
+
+		// Returns false without blocking if the queue is full.
+		auto TryPush(this SpscQueue& self, const T& value) noexcept(std::is_nothrow_copy_assignable_v<T>) -> bool
+		{
+			auto head = self.head.load(std::memory_order_relaxed);
+			if (head - self.cachedTail >= Capacity)
+			{
+				self.cachedTail = self.tail.load(std::memory_order_acquire);
+				if (head - self.cachedTail >= Capacity)
+					return false;
+			}
+			self.values[head & (Capacity - 1)] = value;
+			self.head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Like TryPush(), but lets fill() write the value into its slot, so that large values
+		// don't need to be built elsewhere and copied. fill() is only called if there's room.
+		template<typename TFn>
+			requires std::invocable<TFn, T&>
+		auto TryEmplace(this SpscQueue& self, TFn&& fill) noexcept(std::is_nothrow_invocable_v<TFn, T&>) -> bool
+		{
+			auto head = self.head.load(std::memory_order_relaxed);
+			if (head - self.cachedTail >= Capacity)
+			{
+				self.cachedTail = self.tail.load(std::memory_order_acquire);
+				if (head - self.cachedTail >= Capacity)
+					return false;
+			}
+			std::invoke(std::forward<TFn>(fill), self.values[head & (Capacity - 1)]);
+			self.head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Returns false without blocking if the queue is empty.
+		auto TryPop(this SpscQueue& self, T& out) noexcept(std::is_nothrow_move_assignable_v<T>) -> bool
+		{
+			auto tail = self.tail.load(std::memory_order_relaxed);
+			if (tail == self.cachedHead)
+			{
+				self.cachedHead = self.head.load(std::memory_order_acquire);
+				if (tail == self.cachedHead)
+					return false;
+			}
+			out = std::move(self.values[tail & (Capacity - 1)]);
+			self.tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Only a snapshot when called while the other side is active.
+		auto Size(this const SpscQueue& self) noexcept -> std::size_t
+		{
+			return static_cast<std::size_t>(self.head.load(std::memory_order_acquire) - self.tail.load(std::memory_order_acquire));
+		}
+
+	private:
+		std::array<T, Capacity> values{};
+		// Each side keeps a cached copy of the other side's index so that it only
+		// touches the other side's cache line when the queue looks full or empty.
+		alignas(std::hardware_destructive_interference_size) std::atomic<std::uint64_t> head = 0;
+		std::uint64_t cachedTail = 0;
+		alignas(std::hardware_destructive_interference_size) std::atomic<std::uint64_t> tail = 0;
+		std::uint64_t cachedHead = 0;
+	};
+}
@@ -2,9 +2,18 @@ export module shared:com.hresult;
 import std;
 import :win32;
 import :error;
+import :log;
+import :util;
 
 export namespace Com
 {
+	struct HResult;
+
+	// For paths that expect some failures, such as a removed device, and would rather
+	// handle them as values than pay for exceptions.
+	template<typename T = void>
+	using Expected = std::expected<T, HResult>;
+
 	struct HResult final
 	{
 		constexpr HResult() noexcept = default;
@@ -44,6 +53,21 @@ export namespace Com
 
 		constexpr auto Failed() const noexcept -> bool { return not Succeeded(); }
 
+		// Empty if failed, so that it can be chained with std::expected's monadic operations.
+		constexpr auto ToExpected() const noexcept -> Expected<>;
+
+		template<typename T>
+		constexpr auto ToExpected(T&& value) const -> Expected<std::decay_t<T>>;
+
+		// Calls fn() only if this succeeded. fn() may return an HResult or an Expected, and
+		// either way the result is an Expected.
+		template<typename TFn>
+		constexpr auto AndThen(TFn&& fn) const;
+
+		// Calls fn(*this) only if this failed, to recover or translate the failure.
+		template<typename TFn>
+		constexpr auto OrElse(TFn&& fn) const;
+
 		void ThrowIfFailed(std::string_view msg, const std::source_location& loc = std::source_location::current()) const
 		{
 			if (Succeeded())
@@ -61,4 +85,107 @@ export namespace Com
 		if (Win32::HrFailed(hr))
 			throw Error::ComError(hr, "Expected success HRESULT", loc);
 	}
+
+	// Lifts a call returning an HResult, or anything else, into an Expected.
+	template<typename T>
+	constexpr auto ToExpected(T&& result) -> auto
+	{
+		if constexpr (std::same_as<std::remove_cvref_t<T>, HResult> or std::same_as<std::remove_cvref_t<T>, Win32::HRESULT>)
+			return HResult{ result }.ToExpected();
+		else
+			return std::forward<T>(result);
+	}
+
+	constexpr auto HResult::ToExpected() const noexcept -> Expected<>
+	{
+		if (Failed())
+			return std::unexpected{ *this };
+		return {};
+	}
+
+	template<typename T>
+	constexpr auto HResult::ToExpected(T&& value) const -> Expected<std::decay_t<T>>
+	{
+		if (Failed())
+			return std::unexpected{ *this };
+		return std::forward<T>(value);
+	}
+
+	template<typename TFn>
+	constexpr auto HResult::AndThen(TFn&& fn) const
+	{
+		return ToExpected().and_then([&fn] { return Com::ToExpected(std::invoke(std::forward<TFn>(fn))); });
+	}
+
+	template<typename TFn>
+	constexpr auto HResult::OrElse(TFn&& fn) const
+	{
+		return ToExpected().or_else([&fn](HResult hr) { return Com::ToExpected(std::invoke(std::forward<TFn>(fn), hr)); });
+	}
+
+	// The way back from an Expected to exceptions: returns the value, or throws a ComError.
+	// Builds without exceptions log the failure and terminate instead.
+	template<typename T>
+	auto Unwrap(Expected<T>&& expected, std::string_view msg, const std::source_location& loc = std::source_location::current()) -> T
+	{
+		if (not expected)
+		{
+			if constexpr (Error::ExceptionsEnabled)
+			{
+				throw Error::ComError(expected.error(), msg, loc);
+			}
+			else
+			{
+				Log::Error("{} (HRESULT {:#x}) at {}:{}", msg, static_cast<std::uint32_t>(expected.error().Get()), loc.file_name(), loc.line());
+				std::terminate();
+			}
+		}
+		if constexpr (not std::is_void_v<T>)
+			return std::move(*expected);
+	}
+
+	// The thread's last Win32 error, for Win32 calls made on Expected paths.
+	inline auto LastError() noexcept -> HResult
+	{
+		return HResult{ Win32::HResultFromWin32(Win32::GetLastError()) };
+	}
+
+	// Maps a subresource, e.g. a readback or upload buffer each frame. readRange is the
+	// part the CPU will read, or null for all of it.
+	inline auto TryMap(
+		D3D12::ID3D12Resource& resource,
+		std::uint32_t subresource = 0,
+		const D3D12::D3D12_RANGE* readRange = nullptr
+	) noexcept -> Expected<std::byte*>
+	{
+		auto mapped = static_cast<void*>(nullptr);
+		return HResult{ resource.Map(subresource, readRange, &mapped) }.ToExpected(static_cast<std::byte*>(mapped));
+	}
+}
+
+namespace
+{
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			constexpr auto failure = Com::HResult{ static_cast<Win32::HRESULT>(0x80004005) };
+			if (Com::HResult{ 0 }.ToExpected(7) != 7)
+				throw std::exception{ "Expected a success to carry its value" };
+			if (failure.ToExpected(7).error() != failure)
+				throw std::exception{ "Expected a failure to carry its HRESULT" };
+
+			auto calls = 0;
+			auto chained = Com::HResult{ 0 }
+				.AndThen([&calls] { calls++; return Com::HResult{ 0 }; })
+				.and_then([&calls] { calls++; return failure.ToExpected(); })
+				.and_then([&calls] { calls++; return Com::Expected<>{}; });
+			if (chained or chained.error() != failure or calls != 2)
+				throw std::exception{ "Expected a chain to stop at its first failure" };
+
+			auto recovered = failure.OrElse([](Com::HResult) { return Com::Expected<>{}; });
+			if (not recovered)
+				throw std::exception{ "Expected OrElse to recover from a failure" };
+		}
+	};
+
+	static_assert(noexcept(Com::TryMap(std::declval<D3D12::ID3D12Resource&>())));
 }
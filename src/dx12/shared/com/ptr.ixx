@@ -1,6 +1,7 @@
 export module shared:com.ptr;
 import std;
 import :win32;
+import :util;
 
 export namespace Com
 {
@@ -11,6 +12,104 @@ export namespace Com
 		{ t->Release() } -> std::same_as<unsigned long>;
 	};
 
+	// Counts every AddRef() and Release() made through a Ptr or Ref, per interface, to find
+	// where reference counting churns. On in debug builds; define SHARED_COM_COUNT_REFS as
+	// 0 or 1 to choose.
+	constexpr auto RefCountingEnabled =
+#if defined(SHARED_COM_COUNT_REFS)
+		SHARED_COM_COUNT_REFS != 0;
+#elif defined(NDEBUG)
+		false;
+#else
+		true;
+#endif
+
+	struct RefCounts
+	{
+		std::string_view Type;
+		std::uint64_t AddRefs = 0;
+		std::uint64_t Releases = 0;
+	};
+
+	namespace Detail
+	{
+		struct RefCounters
+		{
+			std::string_view Type;
+			std::atomic<std::uint64_t> AddRefs = 0;
+			std::atomic<std::uint64_t> Releases = 0;
+		};
+
+		struct RefCounterRegistry
+		{
+			std::mutex Mutex;
+			// A list, so that counters don't move as types are added.
+			std::list<RefCounters> Counters;
+		};
+
+		inline auto GetRefCounterRegistry() -> RefCounterRegistry&
+		{
+			static auto registry = RefCounterRegistry{};
+			return registry;
+		}
+
+		template<typename T>
+		auto RefCountersOf() -> RefCounters&
+		{
+			static auto& counters =
+				[] -> RefCounters&
+				{
+					auto& registry = GetRefCounterRegistry();
+					auto lock = std::scoped_lock{ registry.Mutex };
+					return registry.Counters.emplace_back(typeid(T).name());
+				}();
+			return counters;
+		}
+
+		template<ComLike T>
+		constexpr void AddRef(T* ptr) noexcept
+		{
+			if constexpr (RefCountingEnabled)
+				if (not std::is_constant_evaluated())
+					RefCountersOf<T>().AddRefs.fetch_add(1, std::memory_order_relaxed);
+			ptr->AddRef();
+		}
+
+		template<ComLike T>
+		constexpr void Release(T* ptr) noexcept
+		{
+			if constexpr (RefCountingEnabled)
+				if (not std::is_constant_evaluated())
+					RefCountersOf<T>().Releases.fetch_add(1, std::memory_order_relaxed);
+			ptr->Release();
+		}
+	}
+
+	// The counts for one interface so far. Always zero unless RefCountingEnabled.
+	template<ComLike T>
+	auto GetRefCounts() -> RefCounts
+	{
+		auto& counters = Detail::RefCountersOf<T>();
+		return { counters.Type, counters.AddRefs.load(std::memory_order_relaxed), counters.Releases.load(std::memory_order_relaxed) };
+	}
+
+	// The counts for every interface that's been reference counted so far, most AddRef()s first.
+	inline auto GetRefCounts() -> std::vector<RefCounts>
+	{
+		auto& registry = Detail::GetRefCounterRegistry();
+		auto counts = std::vector<RefCounts>{};
+		{
+			auto lock = std::scoped_lock{ registry.Mutex };
+			for (auto& counters : registry.Counters)
+				counts.push_back({ counters.Type, counters.AddRefs.load(std::memory_order_relaxed), counters.Releases.load(std::memory_order_relaxed) });
+		}
+		std::ranges::sort(counts, std::greater{}, &RefCounts::AddRefs);
+		return counts;
+	}
+
+	template<ComLike T>
+	class Ref;
+
 	template<ComLike T>
 	struct Ptr
 	{
@@ -23,6 +122,7 @@ export namespace Com
 
 		constexpr Ptr() = default;
 
+		// Takes ownership of typePtr's reference; doesn't AddRef().
 		constexpr Ptr(T* typePtr) noexcept
 			: ptr(typePtr)
 		{}
@@ -32,26 +132,42 @@ export namespace Com
 			: ptr(typePtr.ptr)
 		{
 			if (ptr)
-				ptr->AddRef();
+				Detail::AddRef(ptr);
+		}
+		template<ComLike U>
+			requires std::convertible_to<U*, T*>
+		constexpr Ptr(const Ptr<U>& other) noexcept
+			: ptr(other.ptr)
+		{
+			if (ptr)
+				Detail::AddRef(ptr);
 		}
 		constexpr auto operator=(this Ptr& self, const Ptr& other) noexcept -> Ptr&
 		{
-			self.reset();
-			self.ptr = other.ptr;
-			self.ptr->AddRef();
+			// AddRef() before Release(), so that assigning a Ptr to itself doesn't free the object.
+			if (other.ptr)
+				Detail::AddRef(other.ptr);
+			if (auto previous = std::exchange(self.ptr, other.ptr))
+				Detail::Release(previous);
 			return self;
 		}
 
-		// Movable
+		// Movable, which never touches the reference count.
 		constexpr Ptr(Ptr&& other) noexcept
-			: ptr(other.ptr)
-		{
-			other.ptr = nullptr;
-		}
+			: ptr(std::exchange(other.ptr, nullptr))
+		{}
+		template<ComLike U>
+			requires std::convertible_to<U*, T*>
+		constexpr Ptr(Ptr<U>&& other) noexcept
+			: ptr(std::exchange(other.ptr, nullptr))
+		{}
 		constexpr auto operator=(this Ptr& self, Ptr&& other) noexcept -> Ptr&
 		{
-			self.reset();
-			self.swap(other);
+			if (&self != &other)
+			{
+				self.reset();
+				self.swap(other);
+			}
 			return self;
 		}
 
@@ -83,7 +199,7 @@ export namespace Com
 		constexpr auto reset(this Ptr& self) noexcept -> Ptr&
 		{
 			if (self.ptr)
-				(self.ptr->Release(), self.ptr = nullptr);
+				(Detail::Release(self.ptr), self.ptr = nullptr);
 			return self;
 		}
 
@@ -109,9 +225,18 @@ export namespace Com
 			return self.ptr;
 		}
 
+		// A non-owning reference to pass to functions that only use the object.
+		constexpr auto Borrow(this const Ptr& self) noexcept -> Ref<T>
+		{
+			return Ref<T>{ self.ptr };
+		}
+
+		// As with Ref's constructor, borrowing from a temporary would dangle.
+		auto Borrow(this const Ptr&&) = delete;
+
 		constexpr auto swap(this Ptr& self, Ptr& other) noexcept -> void
 		{
-			self.ptr = std::swap(other.ptr, self.ptr);
+			std::swap(self.ptr, other.ptr);
 		}
 
 		constexpr auto AddressOf(this Ptr& self) noexcept -> void**
@@ -126,4 +251,159 @@ export namespace Com
 
 		T* ptr = nullptr;
 	};
+
+	// A borrowed COM reference: what to take for an object that's used for the duration of
+	// the call but not kept. Passing a Ptr by value costs an AddRef()/Release() pair, each
+	// an atomic read-modify-write on a count that every thread using the same device or
+	// queue contends on; a Ref is just the pointer. Unlike a raw pointer or reference, it
+	// says who owns the object, and can be turned into a Ptr with ToPtr() when the callee
+	// does need to keep it.
+	template<ComLike T>
+	class Ref
+	{
+	public:
+		constexpr Ref() noexcept = default;
+
+		constexpr Ref(std::nullptr_t) noexcept
+		{}
+
+		constexpr explicit Ref(T* ptr) noexcept
+			: ptr(ptr)
+		{}
+
+		template<ComLike U>
+			requires std::convertible_to<U*, T*>
+		constexpr Ref(const Ptr<U>& owner) noexcept
+			: ptr(owner.ptr)
+		{}
+
+		// A Ref to a temporary Ptr would outlive the object's last reference.
+		template<ComLike U>
+			requires std::convertible_to<U*, T*>
+		Ref(Ptr<U>&&) = delete;
+
+		template<ComLike U>
+			requires std::convertible_to<U*, T*>
+		constexpr Ref(Ref<U> other) noexcept
+			: ptr(other.Get())
+		{}
+
+		constexpr operator bool(this Ref self) noexcept
+		{
+			return self.ptr != nullptr;
+		}
+
+		constexpr auto operator==(this Ref self, Ref other) noexcept -> bool
+		{
+			return self.ptr == other.ptr;
+		}
+
+		constexpr auto operator->(this Ref self) noexcept -> T*
+		{
+			return self.ptr;
+		}
+
+		constexpr auto Get(this Ref self) noexcept -> T*
+		{
+			return self.ptr;
+		}
+
+		// A new owning reference to the object.
+		constexpr auto ToPtr(this Ref self) noexcept -> Ptr<T>
+		{
+			if (self.ptr)
+				Detail::AddRef(self.ptr);
+			return Ptr<T>{ self.ptr };
+		}
+
+	private:
+		T* ptr = nullptr;
+	};
+}
+
+namespace
+{
+	struct TestComObject
+	{
+		constexpr auto AddRef() noexcept -> unsigned long { return ++RefCount; }
+		constexpr auto Release() noexcept -> unsigned long { return --RefCount; }
+
+		unsigned long RefCount = 1;
+	};
+
+	struct TestDerivedComObject : TestComObject
+	{};
+
+	template<typename P>
+	concept CanBorrow = requires(P&& p) { std::forward<P>(p).Borrow(); };
+
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			auto object = TestComObject{};
+			auto ptr = Com::Ptr<TestComObject>{ &object };
+			auto empty = Com::Ptr<TestComObject>{};
+			ptr = empty;
+			if (ptr or object.RefCount != 0)
+				throw std::exception{ "Expected assigning an empty Ptr to release the object" };
+			empty = ptr;
+			if (empty)
+				throw std::exception{ "Expected assigning an empty Ptr to an empty Ptr to leave it empty" };
+		},
+		[] {
+			auto object = TestComObject{};
+			auto ptr = Com::Ptr<TestComObject>{ &object };
+			auto& alias = ptr;
+			ptr = alias;
+			ptr = std::move(alias);
+			if (ptr.Get() != &object or object.RefCount != 1)
+				throw std::exception{ "Expected assigning a Ptr to itself to leave it unchanged" };
+			ptr.detach();
+		},
+		[] {
+			auto object = TestComObject{};
+			auto ptr = Com::Ptr<TestComObject>{ &object };
+			{
+				auto copy = ptr;
+				auto other = Com::Ptr<TestComObject>{};
+				other = copy;
+				if (object.RefCount != 3)
+					throw std::exception{ "Expected each copy to AddRef()" };
+			}
+			if (object.RefCount != 1)
+				throw std::exception{ "Expected each copy to Release() when it's destroyed" };
+			ptr.detach();
+		},
+		[] {
+			auto object = TestDerivedComObject{};
+			auto derived = Com::Ptr<TestDerivedComObject>{ &object };
+			{
+				auto copy = Com::Ptr<TestComObject>{ derived };
+				if (object.RefCount != 2)
+					throw std::exception{ "Expected a converting copy to AddRef()" };
+			}
+			auto base = Com::Ptr<TestComObject>{ std::move(derived) };
+			if (derived or base.Get() != &object or object.RefCount != 1)
+				throw std::exception{ "Expected a converting move not to touch the reference count" };
+			auto owned = base.Borrow().ToPtr();
+			if (owned.Get() != &object or object.RefCount != 2)
+				throw std::exception{ "Expected ToPtr() to take a reference of its own" };
+			owned.reset();
+			base.detach();
+		},
+		[] {
+			auto object = TestComObject{};
+			auto ptr = Com::Ptr<TestComObject>{ &object };
+			auto use = [](Com::Ref<TestComObject> ref) { return ref->RefCount; };
+			if (use(ptr) != 1 or use(ptr.Borrow()) != 1 or Com::Ref<TestComObject>{} or not Com::Ref<TestComObject>{ ptr })
+				throw std::exception{ "Expected borrowing not to touch the reference count" };
+			ptr.detach();
+		}
+	};
+
+	static_assert(not std::constructible_from<Com::Ref<TestComObject>, Com::Ptr<TestComObject>&&>);
+	static_assert(not CanBorrow<Com::Ptr<TestComObject>>);
+	static_assert(CanBorrow<Com::Ptr<TestComObject>&>);
+	static_assert(CanBorrow<const Com::Ptr<TestComObject>&>);
+	static_assert(std::constructible_from<Com::Ref<TestComObject>, const Com::Ptr<TestDerivedComObject>&>);
+	static_assert(not std::constructible_from<Com::Ptr<TestDerivedComObject>, const Com::Ptr<TestComObject>&>);
 }
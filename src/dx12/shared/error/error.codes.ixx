@@ -0,0 +1,116 @@
+export module shared:error.codes;
+import std;
+import :util;
+
+// The parts of error code translation that don't need Win32, so that they can be
+// built and tested anywhere. :error.translation adds the system translator.
+export namespace Error
+{
+	// A Win32 error code or an HRESULT's bits.
+	using ErrorCode = std::uint32_t;
+	using ErrorCodeTranslator = auto(*)(ErrorCode errorCode) -> std::string;
+
+	struct StandInErrorMessage
+	{
+		ErrorCode Code = 0;
+		std::string_view Message;
+	};
+
+	// The system's messages for the codes this codebase commonly runs into, for where
+	// FormatMessageA isn't available, such as tests on other platforms.
+	constexpr auto StandInErrorMessages = std::array{
+		StandInErrorMessage{ 2, "The system cannot find the file specified.\r\n" },
+		StandInErrorMessage{ 5, "Access is denied.\r\n" },
+		StandInErrorMessage{ 6, "The handle is invalid.\r\n" },
+		StandInErrorMessage{ 87, "The parameter is incorrect.\r\n" },
+		StandInErrorMessage{ 0x80004001, "Not implemented\r\n" },
+		StandInErrorMessage{ 0x80004002, "No such interface supported\r\n" },
+		StandInErrorMessage{ 0x80004003, "Invalid pointer\r\n" },
+		StandInErrorMessage{ 0x80004004, "Operation aborted\r\n" },
+		StandInErrorMessage{ 0x80004005, "Unspecified error\r\n" },
+		StandInErrorMessage{ 0x8000FFFF, "Catastrophic failure\r\n" },
+		StandInErrorMessage{ 0x80070005, "Access is denied.\r\n" },
+		StandInErrorMessage{ 0x8007000E, "Not enough memory resources are available to complete this operation.\r\n" },
+		StandInErrorMessage{ 0x80070057, "The parameter is incorrect.\r\n" },
+		StandInErrorMessage{ 0x887A0001, "The application made a call that is invalid. Either the parameters of the call or the state of some object was incorrect.\r\n" },
+		StandInErrorMessage{ 0x887A0002, "Object not found.\r\n" },
+		StandInErrorMessage{ 0x887A0005, "The GPU device instance has been suspended. Use GetDeviceRemovedReason to determine the appropriate action.\r\n" },
+		StandInErrorMessage{ 0x887A0006, "The GPU will not respond to more commands, most likely because of an invalid command passed by the calling application.\r\n" },
+		StandInErrorMessage{ 0x887A0007, "The GPU will not respond to more commands, most likely because some other application submitted invalid commands.\r\n" },
+	};
+
+	// Empty if errorCode isn't in the stand-in table.
+	constexpr auto FindStandInErrorMessage(ErrorCode errorCode) noexcept -> std::string_view
+	{
+		auto entry = std::ranges::find(StandInErrorMessages, errorCode, &StandInErrorMessage::Code);
+		return entry != StandInErrorMessages.end() ? entry->Message : std::string_view{};
+	}
+
+	auto TranslateStandInErrorCode(ErrorCode errorCode) -> std::string
+	{
+		if (errorCode == 0)
+			return {};
+		if (auto message = FindStandInErrorMessage(errorCode); not message.empty())
+			return std::string{ message };
+		return std::format("Unknown error code: {}", errorCode);
+	}
+
+	// Translates each code once and hands out views of the stored message from then on.
+	// Lookups of codes already seen take a shared lock and don't allocate; a miss is
+	// translated outside the lock, so a slow translator doesn't hold up other threads.
+	// Entries are never evicted, as a program only ever sees a handful of distinct codes,
+	// so views stay valid for as long as the cache does.
+	class ErrorCodeCache
+	{
+	public:
+		explicit ErrorCodeCache(ErrorCodeTranslator translator) noexcept
+			: translator(translator)
+		{ }
+
+		ErrorCodeCache(const ErrorCodeCache&) = delete;
+		auto operator=(const ErrorCodeCache&) -> ErrorCodeCache& = delete;
+
+		auto Lookup(this ErrorCodeCache& self, ErrorCode errorCode) -> std::string_view
+		{
+			if (errorCode == 0)
+				return {};
+			{
+				auto lock = std::shared_lock{ self.mutex };
+				if (auto entry = self.messages.find(errorCode); entry != self.messages.end())
+					return entry->second;
+			}
+			auto message = self.translator(errorCode);
+			auto lock = std::unique_lock{ self.mutex };
+			// If another thread got there first, its message is kept.
+			return self.messages.try_emplace(errorCode, std::move(message)).first->second;
+		}
+
+		auto Size(this const ErrorCodeCache& self) -> std::size_t
+		{
+			auto lock = std::shared_lock{ self.mutex };
+			return self.messages.size();
+		}
+
+	private:
+		ErrorCodeTranslator translator;
+		mutable std::shared_mutex mutex;
+		// Node based, so the stored strings don't move when the table rehashes.
+		std::unordered_map<ErrorCode, std::string> messages;
+	};
+}
+
+namespace
+{
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			if (Error::FindStandInErrorMessage(0x887A0005).find("GetDeviceRemovedReason") == std::string_view::npos)
+				throw std::exception{ "Expected DXGI_ERROR_DEVICE_REMOVED to have a stand-in message" };
+			if (not Error::FindStandInErrorMessage(0x12345678).empty())
+				throw std::exception{ "Expected an unknown code not to have a stand-in message" };
+			for (std::size_t i = 0; i < Error::StandInErrorMessages.size(); ++i)
+				for (std::size_t j = 0; j < i; ++j)
+					if (Error::StandInErrorMessages[i].Code == Error::StandInErrorMessages[j].Code)
+						throw std::exception{ "Expected stand-in codes to be unique" };
+		}
+	};
+}
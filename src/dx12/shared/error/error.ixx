@@ -1,77 +1,145 @@
 export module shared:error;
 import std;
 import :win32;
+export import :error.translation;
 
 export namespace Error
 {
-	auto TranslateErrorCode(Win32::DWORD errorCode) -> std::string
+	// Define SHARED_NO_EXCEPTIONS to make Com::Unwrap() log and terminate rather than throw.
+	// The per-frame Try paths, D3D12App's TrySignal(), TryFlushCommandQueue() and TryPresent()
+	// and Com::TryMap(), are noexcept, so a frame built on them and Unwrap() never throws.
+	// Initialisation and the rest of the module still throw on failure.
+	constexpr auto ExceptionsEnabled =
+#ifdef SHARED_NO_EXCEPTIONS
+		false;
+#else
+		true;
+#endif
+
+	// How many frames a thrown error captures. Capturing only records return addresses;
+	// resolving them to symbols is left until what() is first called. Zero disables capture.
+	namespace Detail
 	{
-		if (errorCode == 0)
-			return {};
-
-		constexpr auto options = Win32::FormatMessageOptions::AllocateBuffer 
-			| Win32::FormatMessageOptions::FromSystem 
-			| Win32::FormatMessageOptions::IgnoreInserts;
-
-		auto messageBuffer = static_cast<char*>(nullptr);
-		auto size = size_t{
-			Win32::FormatMessageA(
-				options,
-				nullptr,
-				errorCode,
-				0,
-				reinterpret_cast<char*>(&messageBuffer),
-				0,
-				nullptr
-			)};
-		if (size == 0)
-			return std::format("Unknown error code: {}", errorCode);
-
-		auto message = std::string{ messageBuffer, size };
-		Win32::LocalFree(messageBuffer);
-
-		return message;
+		inline auto StacktraceDepth = std::atomic<std::size_t>{ 64 };
 	}
 
+	inline void SetStacktraceDepth(std::size_t depth) noexcept
+	{
+		Detail::StacktraceDepth.store(depth, std::memory_order_relaxed);
+	}
+
+	inline auto GetStacktraceDepth() noexcept -> std::size_t
+	{
+		return Detail::StacktraceDepth.load(std::memory_order_relaxed);
+	}
+
+	// Meant as a default argument, so the trace starts at the caller.
+	inline auto CaptureStacktrace() -> std::stacktrace
+	{
+		auto depth = GetStacktraceDepth();
+		return depth == 0 ? std::stacktrace{} : std::stacktrace::current(1, depth);
+	}
+
+	// Base for errors that carry where they were thrown from. Building the full message,
+	// with the stacktrace's symbols and anything else expensive, is deferred until what()
+	// is first called, so that throwing stays cheap for errors that are handled without
+	// ever being printed. Copies share the formatted message.
+	class TracedError : public std::runtime_error
+	{
+	public:
+		auto what() const noexcept -> const char* override
+		{
+			try
+			{
+				std::call_once(
+					details->Once,
+					[this]
+					{
+						details->Formatted = std::format(
+							"{}\n"
+							"  at {} ({}:{})\n"
+							"Stacktrace:\n{}",
+							Describe(),
+							details->Location.function_name(),
+							details->Location.file_name(),
+							details->Location.line(),
+							details->Trace
+						);
+					});
+				return details->Formatted.c_str();
+			}
+			catch (...)
+			{
+				return std::runtime_error::what();
+			}
+		}
+
+		// The message given when the error was thrown, without any decoration.
+		auto GetMessageText(this const TracedError& self) noexcept -> std::string_view
+		{
+			return self.std::runtime_error::what();
+		}
+
+		auto GetLocation(this const TracedError& self) noexcept -> const std::source_location&
+		{
+			return self.details->Location;
+		}
+
+		auto GetStacktrace(this const TracedError& self) noexcept -> const std::stacktrace&
+		{
+			return self.details->Trace;
+		}
+
+	protected:
+		TracedError(std::string_view message, const std::source_location& loc, const std::stacktrace& trace)
+			: std::runtime_error(std::string{ message }),
+			details(std::make_shared<Details>(loc, trace))
+		{ }
+
+		// The first line of the full message.
+		virtual auto Describe() const -> std::string
+		{
+			return std::string{ GetMessageText() };
+		}
+
+	private:
+		struct Details
+		{
+			Details(const std::source_location& loc, const std::stacktrace& trace)
+				: Location(loc), Trace(trace)
+			{ }
+
+			std::source_location Location;
+			std::stacktrace Trace;
+			std::once_flag Once;
+			std::string Formatted;
+		};
+
+		std::shared_ptr<Details> details;
+	};
+
 	template<typename TDummy>
-	struct Error : std::runtime_error
+	struct Error : TracedError
 	{
 		explicit Error(
 			std::string_view message,
 			const std::source_location& loc = std::source_location::current(),
-			const std::stacktrace& trace = std::stacktrace::current()
-		) : std::runtime_error(Format(message, loc, trace))
+			const std::stacktrace& trace = CaptureStacktrace()
+		) : TracedError(message, loc, trace)
 		{ }
-
-		static auto Format(
-			std::string_view message,
-			const std::source_location& loc,
-			const std::stacktrace& stacktrace
-		) -> std::string
-		{
-			return std::format(
-				"{}\n"
-				"  at {} ({}:{})\n"
-				"Stacktrace:\n{}",
-				loc.function_name(),
-				loc.file_name(),
-				loc.line(),
-				stacktrace
-			);
-		}
 	};
 
 	using RuntimeError = Error<struct RuntimeErrorTag>;
 
-	class Win32Error : public std::runtime_error
+	class Win32Error : public TracedError
 	{
 	public:
 		explicit Win32Error(
 			Win32::DWORD errorCode,
 			std::string_view message, 
 			const std::source_location& loc = std::source_location::current(),
-			const std::stacktrace& trace = std::stacktrace::current()
-		) : m_errorCode(errorCode), std::runtime_error(Format(errorCode, message, loc, trace))
+			const std::stacktrace& trace = CaptureStacktrace()
+		) : TracedError(message, loc, trace), m_errorCode(errorCode)
 		{ }
 
 		auto GetErrorCode(this const Win32Error& self) noexcept -> Win32::DWORD
@@ -79,39 +147,25 @@ export namespace Error
 			return self.m_errorCode;
 		}
 
-	private:
-		Win32::DWORD m_errorCode;
-
-		static auto Format(
-			Win32::DWORD errorCode, 
-			std::string_view message, 
-			const std::source_location& loc, 
-			const std::stacktrace& stacktrace
-		) -> std::string
+	protected:
+		auto Describe() const -> std::string override
 		{
-			return std::format(
-				"Win32 Error (code {}): {}\n"
-				"  at {} ({}:{})\n"
-				"Stacktrace:\n{}",
-				errorCode,
-				TranslateErrorCode(errorCode),
-				loc.function_name(),
-				loc.file_name(),
-				loc.line(),
-				stacktrace
-			);
+			return std::format("{}\nWin32 Error (code {}): {}", GetMessageText(), m_errorCode, LookupErrorMessage(m_errorCode));
 		}
+
+	private:
+		Win32::DWORD m_errorCode;
 	};
 
-	class ComError : public std::runtime_error
+	class ComError : public TracedError
 	{
 	public:
 		ComError(
 			Win32::HRESULT hr,
 			std::string_view msg,
 			const std::source_location location = std::source_location::current(),
-			const std::stacktrace& trace = std::stacktrace::current()
-		) : m_hresult(hr), std::runtime_error(Format(hr, msg, location, trace))
+			const std::stacktrace& trace = CaptureStacktrace()
+		) : TracedError(msg, location, trace), m_hresult(hr)
 		{ }
 
 		auto GetHResult(this const ComError& self) noexcept -> Win32::HRESULT
@@ -119,27 +173,13 @@ export namespace Error
 			return self.m_hresult;
 		}
 
-	private:
-		static auto Format(
-			Win32::HRESULT hr,
-			std::string_view message,
-			const std::source_location& loc,
-			const std::stacktrace& stacktrace
-		) -> std::string
+	protected:
+		auto Describe() const -> std::string override
 		{
-			return std::format(
-				"HRESULT error (code {}): {}\n"
-				"  at {} ({}:{})\n"
-				"Stacktrace:\n{}",
-				hr,
-				TranslateErrorCode(hr),
-				loc.function_name(),
-				loc.file_name(),
-				loc.line(),
-				stacktrace
-			);
+			return std::format("{}\nHRESULT error (code {}): {}", GetMessageText(), m_hresult, LookupErrorMessage(m_hresult));
 		}
 
+	private:
 		Win32::HRESULT m_hresult;
 	};
 }
@@ -0,0 +1,54 @@
+export module shared:error.translation;
+import std;
+import :win32;
+export import :error.codes;
+
+export namespace Error
+{
+	// Asks the system for errorCode's message. Every call allocates twice, once in
+	// FormatMessageA and once for the returned string, so prefer LookupErrorMessage().
+	auto TranslateSystemErrorCode(ErrorCode errorCode) -> std::string
+	{
+		if (errorCode == 0)
+			return {};
+
+		constexpr auto options = Win32::FormatMessageOptions::AllocateBuffer
+			| Win32::FormatMessageOptions::FromSystem
+			| Win32::FormatMessageOptions::IgnoreInserts;
+
+		auto messageBuffer = static_cast<char*>(nullptr);
+		auto size = size_t{
+			Win32::FormatMessageA(
+				options,
+				nullptr,
+				errorCode,
+				0,
+				reinterpret_cast<char*>(&messageBuffer),
+				0,
+				nullptr
+			)};
+		if (size == 0)
+			return std::format("Unknown error code: {}", errorCode);
+
+		auto message = std::string{ messageBuffer, size };
+		Win32::LocalFree(messageBuffer);
+
+		return message;
+	}
+
+	namespace Detail
+	{
+		inline auto ErrorCodes = ErrorCodeCache{ TranslateSystemErrorCode };
+	}
+
+	// The message for errorCode. Only allocates the first time a code is seen.
+	inline auto LookupErrorMessage(ErrorCode errorCode) -> std::string_view
+	{
+		return Detail::ErrorCodes.Lookup(errorCode);
+	}
+
+	inline auto TranslateErrorCode(ErrorCode errorCode) -> std::string
+	{
+		return std::string{ LookupErrorMessage(errorCode) };
+	}
+}
@@ -0,0 +1,488 @@
+export module shared:log.async;
+import std;
+import :error;
+import :async.spscqueue;
+
+export namespace Log
+{
+	// A message formatted on the calling thread. Its timestamp is only formatted later,
+	// on the backend's thread.
+	struct Record
+	{
+		static constexpr std::size_t MaxText = 472;
+
+		std::chrono::system_clock::time_point Time{};
+		// Always a string literal or a FixedString template argument, so it never dangles.
+		std::string_view Level;
+		std::uint32_t Length = 0;
+		bool Truncated = false;
+		char Text[MaxText];
+	};
+
+	// Formats timestamps exactly as std::format formats a system_clock::time_point, but
+	// only formats the date and time of day again when the second changes.
+	class TimestampCache
+	{
+	public:
+		auto Format(this TimestampCache& self, std::chrono::system_clock::time_point time) -> std::string_view
+		{
+			auto second = std::chrono::floor<std::chrono::seconds>(time);
+			if (self.prefixLength == 0 or second != self.second)
+			{
+				self.second = second;
+				self.prefixLength = static_cast<std::size_t>(
+					std::format_to_n(self.buffer.data(), self.buffer.size(), "{:%F %T}", second).out - self.buffer.data()
+				);
+			}
+
+			auto length = self.prefixLength;
+			if constexpr (FractionalWidth > 0)
+			{
+				auto fraction = std::chrono::duration_cast<std::chrono::system_clock::duration>(time - second);
+				length = static_cast<std::size_t>(
+					std::format_to_n(
+						self.buffer.data() + length,
+						self.buffer.size() - length,
+						".{:0{}}",
+						fraction.count(),
+						FractionalWidth
+					).out - self.buffer.data()
+				);
+			}
+			return { self.buffer.data(), length };
+		}
+
+	private:
+		static constexpr auto FractionalWidth = std::chrono::hh_mm_ss<std::chrono::system_clock::duration>::fractional_width;
+
+		std::chrono::sys_seconds second{};
+		std::size_t prefixLength = 0;
+		std::array<char, 64> buffer{};
+	};
+
+	// Receives batches of complete lines from the backend's thread.
+	class Sink
+	{
+	public:
+		virtual ~Sink() = default;
+		virtual void Write(std::string_view lines) = 0;
+		virtual void Flush() { }
+	};
+
+	class ConsoleSink : public Sink
+	{
+	public:
+		void Write(std::string_view lines) override
+		{
+			std::fwrite(lines.data(), 1, lines.size(), stdout);
+		}
+
+		void Flush() override
+		{
+			std::fflush(stdout);
+		}
+	};
+
+	// Appends to Path until it would grow past MaxBytes, then shifts Path to Path.1,
+	// Path.1 to Path.2 and so on, dropping the oldest once there are MaxFiles files.
+	class RotatingFileSink : public Sink
+	{
+	public:
+		RotatingFileSink(std::filesystem::path path, std::uintmax_t maxBytes = 16 * 1024 * 1024, std::size_t maxFiles = 4)
+			: path(std::move(path)), maxBytes(maxBytes), maxFiles(std::max<std::size_t>(maxFiles, 1))
+		{
+			auto error = std::error_code{};
+			written = std::filesystem::exists(this->path, error) ? std::filesystem::file_size(this->path, error) : 0;
+			if (error)
+				written = 0;
+			Open(std::ios::app);
+		}
+
+		void Write(std::string_view lines) override
+		{
+			if (written > 0 and written + lines.size() > maxBytes)
+				Rotate();
+			file.write(lines.data(), static_cast<std::streamsize>(lines.size()));
+			written += lines.size();
+		}
+
+		void Flush() override
+		{
+			file.flush();
+		}
+
+	private:
+		void Open(std::ios::openmode mode)
+		{
+			file.open(path, std::ios::binary | std::ios::out | mode);
+			if (not file)
+				throw Error::RuntimeError{ std::format("Failed to open log file {}", path.string()) };
+		}
+
+		auto Numbered(std::size_t index) const -> std::filesystem::path
+		{
+			auto numbered = path;
+			numbered += std::format(".{}", index);
+			return numbered;
+		}
+
+		void Rotate()
+		{
+			file.close();
+			// Failing to rotate shouldn't stop logging, so errors only mean the oldest
+			// file is overwritten sooner.
+			auto error = std::error_code{};
+			if (maxFiles == 1)
+			{
+				std::filesystem::remove(path, error);
+			}
+			else
+			{
+				std::filesystem::remove(Numbered(maxFiles - 1), error);
+				for (auto i = maxFiles - 1; i > 1; --i)
+					std::filesystem::rename(Numbered(i - 1), Numbered(i), error);
+				std::filesystem::rename(path, Numbered(1), error);
+			}
+			written = 0;
+			Open(std::ios::trunc);
+		}
+
+		std::filesystem::path path;
+		std::uintmax_t maxBytes;
+		std::size_t maxFiles;
+		std::uintmax_t written = 0;
+		std::ofstream file;
+	};
+
+	enum class OverflowPolicy
+	{
+		// A message that doesn't fit in its thread's ring is dropped and counted. The
+		// backend reports how many were dropped in its next batch.
+		Drop,
+		// The logging thread waits for the backend to make room.
+		Block
+	};
+
+	struct AsyncBackendDesc
+	{
+		OverflowPolicy Overflow = OverflowPolicy::Drop;
+		// How long the backend's thread sleeps between batches when nothing wakes it.
+		std::chrono::milliseconds FlushInterval{ 10 };
+		// Bounds memory use. Threads beyond this many write straight to the sinks under a lock.
+		std::size_t MaxThreads = 64;
+	};
+
+	class AsyncBackend;
+
+	namespace Detail
+	{
+		inline auto Backend = std::atomic<AsyncBackend*>{ nullptr };
+	}
+
+	// Routes Log calls to backend, or back to synchronous console output if null.
+	// Returns the previously installed backend.
+	inline auto SetBackend(AsyncBackend* backend) noexcept -> AsyncBackend*
+	{
+		return Detail::Backend.exchange(backend, std::memory_order_acq_rel);
+	}
+
+	inline auto GetBackend() noexcept -> AsyncBackend*
+	{
+		return Detail::Backend.load(std::memory_order_acquire);
+	}
+
+	// Moves logging I/O off the calling threads. Each thread that logs is given its own
+	// lock-free ring of Records, which are formatted in place. A background thread drains
+	// every ring in batches, sorts the batch by time, formats the timestamps and hands the
+	// resulting lines to each sink in a single write.
+	//
+	// Memory is bounded by RingCapacity * sizeof(Record) * MaxThreads. A thread's ring is
+	// handed to another thread when the thread exits.
+	//
+	// Install with SetBackend(). The backend must outlive every Log call made while it
+	// is installed; it uninstalls itself and writes everything still queued when destroyed.
+	class AsyncBackend
+	{
+	public:
+		static constexpr std::size_t RingCapacity = 256;
+		// The most records written to the sinks in one go.
+		static constexpr std::size_t MaxBatch = 4 * RingCapacity;
+
+		~AsyncBackend()
+		{
+			auto installed = this;
+			Detail::Backend.compare_exchange_strong(installed, nullptr, std::memory_order_acq_rel);
+			stopRequested.store(true, std::memory_order_release);
+			wakeCondition.notify_one();
+			if (thread.joinable())
+				thread.join();
+		}
+
+		AsyncBackend(AsyncBackendDesc desc = {}, std::vector<std::unique_ptr<Sink>> sinks = MakeConsoleSinks())
+			: desc(desc), sinks(std::move(sinks))
+		{
+			thread = std::thread{ [this] { Run(); } };
+		}
+
+		AsyncBackend(const AsyncBackend&) = delete;
+		auto operator=(const AsyncBackend&) -> AsyncBackend& = delete;
+
+		template<typename...TArgs>
+		void Push(this AsyncBackend& self, std::string_view level, std::format_string<TArgs...> message, TArgs&&...args)
+		{
+			auto time = std::chrono::system_clock::now();
+			auto producer = self.AcquireProducer();
+			if (not producer)
+			{
+				self.WriteDirect(level, time, std::format(message, std::forward<TArgs>(args)...));
+				return;
+			}
+
+			auto fill =
+				[&](Record& record)
+				{
+					auto result = std::format_to_n(record.Text, Record::MaxText, message, std::forward<TArgs>(args)...);
+					record.Time = time;
+					record.Level = level;
+					record.Truncated = result.size > static_cast<std::ptrdiff_t>(Record::MaxText);
+					record.Length = static_cast<std::uint32_t>(result.out - record.Text);
+				};
+			while (not producer->Queue.TryEmplace(fill))
+			{
+				if (self.desc.Overflow == OverflowPolicy::Drop)
+				{
+					self.dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+				self.Wake();
+				std::this_thread::yield();
+			}
+			// Don't wait for the flush interval once a ring is half full.
+			if (++producer->Pushed % (RingCapacity / 2) == 0)
+				self.Wake();
+		}
+
+		// Blocks until everything logged before the call has been written and the sinks flushed.
+		void Flush(this AsyncBackend& self)
+		{
+			auto target = self.flushRequests.fetch_add(1, std::memory_order_acq_rel) + 1;
+			self.Wake();
+			for (auto flushed = self.flushed.load(std::memory_order_acquire); flushed < target; flushed = self.flushed.load(std::memory_order_acquire))
+				self.flushed.wait(flushed, std::memory_order_acquire);
+		}
+
+		// The total number of messages dropped by the Drop policy.
+		auto GetDroppedCount(this const AsyncBackend& self) noexcept -> std::uint64_t
+		{
+			return self.totalDropped.load(std::memory_order_relaxed);
+		}
+
+		static auto MakeConsoleSinks() -> std::vector<std::unique_ptr<Sink>>
+		{
+			auto sinks = std::vector<std::unique_ptr<Sink>>{};
+			sinks.push_back(std::make_unique<ConsoleSink>());
+			return sinks;
+		}
+
+	private:
+		struct Producer
+		{
+			Async::SpscQueue<Record, RingCapacity> Queue;
+			std::atomic<bool> Claimed = false;
+			// Only touched by the claiming thread.
+			std::uint64_t Pushed = 0;
+		};
+
+		// Releases the thread's ring when the thread exits. Holding a shared_ptr keeps this
+		// safe if the backend has already gone.
+		struct ThreadProducer
+		{
+			~ThreadProducer()
+			{
+				Release();
+			}
+
+			void Release()
+			{
+				if (Ring)
+					std::exchange(Ring, nullptr)->Claimed.store(false, std::memory_order_release);
+			}
+
+			std::uint64_t Backend = 0;
+			std::shared_ptr<Producer> Ring;
+		};
+
+		auto AcquireProducer(this AsyncBackend& self) -> Producer*
+		{
+			thread_local auto local = ThreadProducer{};
+			if (local.Backend == self.id)
+				return local.Ring.get();
+
+			local.Release();
+			local.Backend = self.id;
+			auto lock = std::scoped_lock{ self.producersMutex };
+			for (const auto& producer : self.producers)
+			{
+				if (not producer->Claimed.exchange(true, std::memory_order_acquire))
+				{
+					local.Ring = producer;
+					return local.Ring.get();
+				}
+			}
+			if (self.producers.size() >= self.desc.MaxThreads)
+				return nullptr;
+			local.Ring = self.producers.emplace_back(std::make_shared<Producer>());
+			local.Ring->Claimed.store(true, std::memory_order_relaxed);
+			return local.Ring.get();
+		}
+
+		void Wake(this AsyncBackend& self)
+		{
+			self.wakeRequested.store(true, std::memory_order_release);
+			self.wakeCondition.notify_one();
+		}
+
+		void WriteDirect(this AsyncBackend& self, std::string_view level, std::chrono::system_clock::time_point time, std::string_view text)
+		{
+			auto line = std::format("{} [{}] {}\n", time, level, text);
+			auto lock = std::scoped_lock{ self.sinksMutex };
+			self.WriteSinks(line, false);
+		}
+
+		void Run(this AsyncBackend& self)
+		{
+			auto stopping = false;
+			while (not stopping)
+			{
+				{
+					// A wake that lands between the check and the wait is only delayed by
+					// FlushInterval, so producers never need to take this lock.
+					auto lock = std::unique_lock{ self.wakeMutex };
+					self.wakeCondition.wait_for(
+						lock,
+						self.desc.FlushInterval,
+						[&self] { return self.wakeRequested.load(std::memory_order_acquire) or self.stopRequested.load(std::memory_order_acquire); }
+					);
+				}
+				self.wakeRequested.store(false, std::memory_order_relaxed);
+				stopping = self.stopRequested.load(std::memory_order_acquire);
+				auto flushRequests = self.flushRequests.load(std::memory_order_acquire);
+				self.Drain(flushRequests != self.flushed.load(std::memory_order_relaxed) or stopping);
+				self.flushed.store(flushRequests, std::memory_order_release);
+				self.flushed.notify_all();
+			}
+		}
+
+		// Empties every ring, one batch at a time.
+		void Drain(this AsyncBackend& self, bool flushSinks)
+		{
+			{
+				auto lock = std::scoped_lock{ self.producersMutex };
+				self.drainList.assign(self.producers.begin(), self.producers.end());
+			}
+
+			auto full = true;
+			while (full)
+			{
+				self.records.clear();
+				for (const auto& producer : self.drainList)
+				{
+					while (self.records.size() < MaxBatch)
+					{
+						if (not producer->Queue.TryPop(self.records.emplace_back()))
+						{
+							self.records.pop_back();
+							break;
+						}
+					}
+				}
+				full = self.records.size() == MaxBatch;
+				self.WriteBatch(flushSinks and not full);
+			}
+		}
+
+		void WriteBatch(this AsyncBackend& self, bool flushSinks)
+		{
+			// Rings are drained one after another, so only sorting restores the order across threads.
+			std::ranges::stable_sort(self.records, {}, &Record::Time);
+
+			self.lines.clear();
+			for (const auto& record : self.records)
+				std::format_to(
+					std::back_inserter(self.lines),
+					"{} [{}] {}{}\n",
+					self.timestamps.Format(record.Time),
+					record.Level,
+					std::string_view{ record.Text, record.Length },
+					record.Truncated ? "..." : ""
+				);
+			if (auto dropped = self.dropped.exchange(0, std::memory_order_relaxed))
+			{
+				self.totalDropped.fetch_add(dropped, std::memory_order_relaxed);
+				std::format_to(
+					std::back_inserter(self.lines),
+					"{} [Warn] {} log messages were dropped because the log queue was full\n",
+					self.timestamps.Format(std::chrono::system_clock::now()),
+					dropped
+				);
+			}
+
+			if (self.lines.empty() and not flushSinks)
+				return;
+			auto lock = std::scoped_lock{ self.sinksMutex };
+			self.WriteSinks(self.lines, flushSinks);
+		}
+
+		// Callers must hold sinksMutex. A failing sink mustn't take the process or
+		// the other sinks down with it, so its errors are swallowed.
+		void WriteSinks(this AsyncBackend& self, std::string_view lines, bool flush) noexcept
+		{
+			for (const auto& sink : self.sinks)
+			{
+				try
+				{
+					if (not lines.empty())
+						sink->Write(lines);
+					if (flush)
+						sink->Flush();
+				}
+				catch (...)
+				{
+				}
+			}
+		}
+
+		static auto NextId() noexcept -> std::uint64_t
+		{
+			static auto ids = std::atomic<std::uint64_t>{ 0 };
+			return ids.fetch_add(1, std::memory_order_relaxed) + 1;
+		}
+
+		AsyncBackendDesc desc;
+		// Distinguishes this backend from any earlier one at the same address.
+		std::uint64_t id = NextId();
+
+		std::mutex producersMutex;
+		std::vector<std::shared_ptr<Producer>> producers;
+
+		std::mutex sinksMutex;
+		std::vector<std::unique_ptr<Sink>> sinks;
+
+		std::mutex wakeMutex;
+		std::condition_variable wakeCondition;
+		std::atomic<bool> wakeRequested = false;
+		std::atomic<bool> stopRequested = false;
+		std::atomic<std::uint64_t> flushRequests = 0;
+		std::atomic<std::uint64_t> flushed = 0;
+		std::atomic<std::uint64_t> dropped = 0;
+		std::atomic<std::uint64_t> totalDropped = 0;
+
+		// Only used by the backend's thread.
+		std::vector<std::shared_ptr<Producer>> drainList;
+		std::vector<Record> records = [] { auto records = std::vector<Record>{}; records.reserve(MaxBatch); return records; }();
+		std::string lines;
+		TimestampCache timestamps;
+
+		std::thread thread;
+	};
+}
@@ -1,28 +1,331 @@
 export module shared:log;
 import std;
 import :strings;
+import :util;
+export import :log.async;
+export import :log.ratelimit;
 
 export namespace Log
 {
-	template<Strings::FixedString VLevel, typename...TArgs>
-	inline constexpr void LogMessage(std::format_string<TArgs...> message, TArgs&&...args) noexcept
+	enum class Level : std::uint8_t
 	{
-		std::println("{} [{}] {}", std::chrono::system_clock::now(), VLevel.ToView(), std::format(message, std::forward<TArgs>(args)...));
+		Trace,
+		Debug,
+		Info,
+		Warn,
+		Error,
+		Off
+	};
+
+	// Unknown level names are treated as Info.
+	constexpr auto ToLevel(std::string_view name) noexcept -> Level
+	{
+		constexpr auto names = std::array<std::string_view, 5>{ "Trace", "Debug", "Info", "Warn", "Error" };
+		auto found = std::ranges::find(names, name);
+		return found == names.end() ? Level::Info : static_cast<Level>(found - names.begin());
 	}
 
-	template<typename...TArgs>
-	inline constexpr void Info(std::format_string<TArgs...> message, TArgs&&...args) noexcept
+	// Calls below this level are compiled out. Define SHARED_LOG_MIN_LEVEL as 0 (Trace)
+	// to 5 (Off) to choose it; otherwise release builds keep Info and above.
+	constexpr auto MinLevel =
+#if defined(SHARED_LOG_MIN_LEVEL)
+		static_cast<Level>(SHARED_LOG_MIN_LEVEL);
+#elif defined(NDEBUG)
+		Level::Info;
+#else
+		Level::Trace;
+#endif
+
+	// Define SHARED_LOG_DISABLED_CATEGORIES as a comma separated list, e.g. "Render,Input",
+	// to compile out every call in those categories.
+	constexpr auto DisabledCategories = std::string_view{
+#ifdef SHARED_LOG_DISABLED_CATEGORIES
+		SHARED_LOG_DISABLED_CATEGORIES
+#endif
+	};
+
+	constexpr auto IsCategoryEnabled(std::string_view category, std::string_view disabled = DisabledCategories) noexcept -> bool
+	{
+		for (auto entry : std::views::split(disabled, ','))
+		{
+			auto name = std::string_view{ entry.begin(), entry.end() };
+			name.remove_prefix(std::min(name.find_first_not_of(' '), name.size()));
+			name.remove_suffix(name.size() - std::min(name.find_last_not_of(' ') + 1, name.size()));
+			if (name == category)
+				return false;
+		}
+		return true;
+	}
+
+	constexpr auto DefaultCategory = Strings::FixedString{ "General" };
+
+	// Filters calls that survived compilation. Raising it at runtime is cheap; lowering it
+	// below MinLevel has no effect, as those calls no longer exist.
+	namespace Detail
+	{
+		inline auto RuntimeLevel = std::atomic<Level>{ Level::Trace };
+	}
+
+	inline void SetLevel(Level level) noexcept
 	{
-		std::println("{} [Info] {}", std::chrono::system_clock::now(), std::format(message, std::forward<TArgs>(args)...));
+		Detail::RuntimeLevel.store(level, std::memory_order_relaxed);
 	}
+
+	inline auto GetLevel() noexcept -> Level
+	{
+		return Detail::RuntimeLevel.load(std::memory_order_relaxed);
+	}
+
+	// A format string that also captures where it was written, so that rate limited calls
+	// can be told apart by call site despite the variadic arguments that follow.
+	template<typename TFormat>
+	struct Located
+	{
+		template<typename T>
+			requires std::constructible_from<TFormat, const T&>
+		consteval Located(const T& format, std::source_location location = std::source_location::current())
+			: Format(format), Location(location)
+		{ }
+
+		TFormat Format;
+		std::source_location Location;
+	};
+}
+
+namespace Log::Detail
+{
+	template<Level VLevel, Strings::FixedString VCategory, Level VMinLevel>
+	constexpr auto IsEnabled = VLevel >= VMinLevel and VLevel != Level::Off and IsCategoryEnabled(VCategory.ToView());
+
+	// Arguments that are callable with no arguments are invoked for their value, and only
+	// if the message is actually written, so expensive arguments can be made lazy.
+	template<typename T>
+	struct ResolvedType : std::type_identity<T> { };
+
+	// A callable returning an rvalue reference is formatted as the value it returns,
+	// matching what Resolve() hands on.
+	template<std::invocable T>
+	struct ResolvedType<T> : std::type_identity<std::conditional_t<
+		std::is_rvalue_reference_v<std::invoke_result_t<T>>,
+		std::remove_reference_t<std::invoke_result_t<T>>,
+		std::invoke_result_t<T>
+	>> { };
+
+	template<typename T>
+	using Resolved = ResolvedType<T>::type;
+
+	template<typename T>
+	constexpr auto Resolve(T&& arg) -> decltype(auto)
+	{
+		if constexpr (std::invocable<T>)
+			return std::invoke(std::forward<T>(arg));
+		else
+			return std::forward<T>(arg);
+	}
+
 	template<typename...TArgs>
-	inline constexpr void Warn(std::format_string<TArgs...> message, TArgs&&...args) noexcept
+	using FormatString = std::format_string<Resolved<TArgs>...>;
+
+	// Accepts any format string without checking it, for calls that are compiled out.
+	struct UncheckedFormat
 	{
-		std::println("{} [Warn] {}", std::chrono::system_clock::now(), std::format(message, std::forward<TArgs>(args)...));
+		consteval UncheckedFormat(const char*) noexcept { }
+	};
+
+	// The public functions' format parameter, so that compiled out calls never check theirs.
+	template<Level VLevel, Strings::FixedString VCategory, typename...TArgs>
+	using MessageFormat = std::conditional_t<IsEnabled<VLevel, VCategory, MinLevel>, FormatString<TArgs...>, UncheckedFormat>;
+
+	template<Level VLevel, Strings::FixedString VCategory, typename...TArgs>
+	using LocatedMessageFormat = std::conditional_t<IsEnabled<VLevel, VCategory, MinLevel>, Located<FormatString<TArgs...>>, UncheckedFormat>;
+
+	// The level as written in the log, with the category appended unless it's the default.
+	template<Strings::FixedString VLevelName, Strings::FixedString VCategory>
+	constexpr auto MakeLabel() noexcept
+	{
+		if constexpr (VCategory == DefaultCategory.Buffer)
+			return VLevelName;
+		else
+			return VLevelName + "/" + VCategory;
 	}
+
+	template<Strings::FixedString VLevelName, Strings::FixedString VCategory>
+	inline constexpr auto Label = MakeLabel<VLevelName, VCategory>();
+
 	template<typename...TArgs>
-	inline constexpr void Error(std::format_string<TArgs...> message, TArgs&&...args) noexcept
+	inline void Print(std::string_view label, std::format_string<TArgs...> message, TArgs&&...args)
+	{
+		if (auto backend = GetBackend())
+			backend->Push(label, message, std::forward<TArgs>(args)...);
+		else
+			std::println("{} [{}] {}", std::chrono::system_clock::now(), label, std::format(message, std::forward<TArgs>(args)...));
+	}
+
+	template<Strings::FixedString VLevelName, Strings::FixedString VCategory, Level VMinLevel = MinLevel, typename...TArgs>
+		requires IsEnabled<ToLevel(VLevelName.ToView()), VCategory, VMinLevel>
+	inline constexpr void Write(FormatString<TArgs...> message, TArgs&&...args) noexcept
+	{
+		if (ToLevel(VLevelName.ToView()) < GetLevel())
+			return;
+		Print(Label<VLevelName, VCategory>.ToView(), message, Resolve(std::forward<TArgs>(args))...);
+	}
+
+	// Compiled out: the format string isn't checked and lazy arguments are never invoked.
+	template<Strings::FixedString VLevelName, Strings::FixedString VCategory, Level VMinLevel = MinLevel, typename...TArgs>
+		requires (not IsEnabled<ToLevel(VLevelName.ToView()), VCategory, VMinLevel>)
+	inline constexpr void Write(UncheckedFormat, TArgs&&...) noexcept
+	{
+	}
+
+	// Lazy arguments of suppressed calls aren't invoked either.
+	template<Strings::FixedString VLevelName, Strings::FixedString VCategory, typename...TArgs>
+		requires IsEnabled<ToLevel(VLevelName.ToView()), VCategory, MinLevel>
+	inline void WriteLimited(const RateLimit& limit, const Located<FormatString<TArgs...>>& message, TArgs&&...args) noexcept
+	{
+		if (ToLevel(VLevelName.ToView()) < GetLevel())
+			return;
+		auto site = RateLimitSites::Get().Find(message.Location);
+		auto suppressed = site ? RateLimitSites::Check(*site, limit) : std::optional<std::uint64_t>{ 0 };
+		if (not suppressed)
+			return;
+		if (*suppressed == 0)
+			Print(Label<VLevelName, VCategory>.ToView(), message.Format, Resolve(std::forward<TArgs>(args))...);
+		else
+			Print(
+				Label<VLevelName, VCategory>.ToView(),
+				"{} (suppressed {} repeats)",
+				std::format(message.Format, Resolve(std::forward<TArgs>(args))...),
+				*suppressed
+			);
+	}
+
+	template<Strings::FixedString VLevelName, Strings::FixedString VCategory, typename...TArgs>
+		requires (not IsEnabled<ToLevel(VLevelName.ToView()), VCategory, MinLevel>)
+	inline constexpr void WriteLimited(const RateLimit&, UncheckedFormat, TArgs&&...) noexcept
+	{
+	}
+}
+
+export namespace Log
+{
+	// Messages go to the installed AsyncBackend if there is one (see SetBackend()),
+	// otherwise they're printed synchronously. Each function takes an optional category,
+	// e.g. Log::Debug<"Render">("..."), which can be compiled out on its own.
+
+	template<Strings::FixedString VLevel, Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline constexpr void LogMessage(Detail::MessageFormat<ToLevel(VLevel.ToView()), VCategory, TArgs...> message, TArgs&&...args) noexcept
+	{
+		Detail::Write<VLevel, VCategory>(message, std::forward<TArgs>(args)...);
+	}
+
+	template<Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline constexpr void Trace(Detail::MessageFormat<Level::Trace, VCategory, TArgs...> message, TArgs&&...args) noexcept
 	{
-		std::println("{} [Error] {}", std::chrono::system_clock::now(), std::format(message, std::forward<TArgs>(args)...));
+		Detail::Write<"Trace", VCategory>(message, std::forward<TArgs>(args)...);
 	}
+	template<Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline constexpr void Debug(Detail::MessageFormat<Level::Debug, VCategory, TArgs...> message, TArgs&&...args) noexcept
+	{
+		Detail::Write<"Debug", VCategory>(message, std::forward<TArgs>(args)...);
+	}
+	template<Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline constexpr void Info(Detail::MessageFormat<Level::Info, VCategory, TArgs...> message, TArgs&&...args) noexcept
+	{
+		Detail::Write<"Info", VCategory>(message, std::forward<TArgs>(args)...);
+	}
+	template<Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline constexpr void Warn(Detail::MessageFormat<Level::Warn, VCategory, TArgs...> message, TArgs&&...args) noexcept
+	{
+		Detail::Write<"Warn", VCategory>(message, std::forward<TArgs>(args)...);
+	}
+	template<Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline constexpr void Error(Detail::MessageFormat<Level::Error, VCategory, TArgs...> message, TArgs&&...args) noexcept
+	{
+		Detail::Write<"Error", VCategory>(message, std::forward<TArgs>(args)...);
+	}
+}
+
+export namespace Log
+{
+	// Rate limited variants, for calls that may fail every frame. Calls are told apart by
+	// call site, and when a call is written after others from its site were suppressed, the
+	// number suppressed is appended, e.g. Log::WarnLimited(Log::RateLimit::PerInterval(1s), "...").
+
+	template<Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline void TraceLimited(const RateLimit& limit, Detail::LocatedMessageFormat<Level::Trace, VCategory, TArgs...> message, TArgs&&...args) noexcept
+	{
+		Detail::WriteLimited<"Trace", VCategory>(limit, message, std::forward<TArgs>(args)...);
+	}
+
+	template<Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline void DebugLimited(const RateLimit& limit, Detail::LocatedMessageFormat<Level::Debug, VCategory, TArgs...> message, TArgs&&...args) noexcept
+	{
+		Detail::WriteLimited<"Debug", VCategory>(limit, message, std::forward<TArgs>(args)...);
+	}
+
+	template<Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline void InfoLimited(const RateLimit& limit, Detail::LocatedMessageFormat<Level::Info, VCategory, TArgs...> message, TArgs&&...args) noexcept
+	{
+		Detail::WriteLimited<"Info", VCategory>(limit, message, std::forward<TArgs>(args)...);
+	}
+
+	template<Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline void WarnLimited(const RateLimit& limit, Detail::LocatedMessageFormat<Level::Warn, VCategory, TArgs...> message, TArgs&&...args) noexcept
+	{
+		Detail::WriteLimited<"Warn", VCategory>(limit, message, std::forward<TArgs>(args)...);
+	}
+
+	template<Strings::FixedString VCategory = DefaultCategory, typename...TArgs>
+	inline void ErrorLimited(const RateLimit& limit, Detail::LocatedMessageFormat<Level::Error, VCategory, TArgs...> message, TArgs&&...args) noexcept
+	{
+		Detail::WriteLimited<"Error", VCategory>(limit, message, std::forward<TArgs>(args)...);
+	}
+
+	// Writes a summary line for every site with suppressed calls that haven't been reported
+	// yet, so that repeats from a site that has gone quiet are still counted. Meant to be
+	// called periodically, e.g. once a second. The summaries are Warn messages, filtered like
+	// any other; while they're filtered out the counts are kept for a later report.
+	inline void ReportSuppressed() noexcept
+	{
+		if constexpr (Detail::IsEnabled<Level::Warn, DefaultCategory, MinLevel>)
+		{
+			if (Level::Warn < GetLevel())
+				return;
+			RateLimitSites::Get().ForEachSuppressed(
+				[](std::string_view file, std::uint32_t line, std::uint64_t suppressed)
+				{
+					Detail::Write<"Warn", DefaultCategory>("Suppressed {} repeats from {}:{}", suppressed, file, line);
+				});
+		}
+	}
+}
+
+namespace
+{
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			if (Log::ToLevel("Warn") != Log::Level::Warn or Log::ToLevel("Verbose") != Log::Level::Info)
+				throw std::exception{ "Expected level names to map to levels" };
+			if (Log::IsCategoryEnabled("Render", "Input, Render") or not Log::IsCategoryEnabled("Audio", "Input, Render"))
+				throw std::exception{ "Expected only listed categories to be disabled" };
+			if (Log::Detail::Label<"Warn", Log::DefaultCategory> != "Warn" or Log::Detail::Label<"Warn", "Render"> != "Warn/Render")
+				throw std::exception{ "Expected the category to be appended to non-default labels" };
+		},
+		[] {
+			// Elided calls must not evaluate lazy arguments. This runs at compile time, so any
+			// attempt to format or print would also fail to compile.
+			auto evaluated = false;
+			auto expensive = [&evaluated] { evaluated = true; return 42; };
+			Log::Detail::Write<"Debug", Log::DefaultCategory, Log::Level::Info>("{}", expensive);
+			Log::Detail::Write<"Info", "Test", Log::Level::Off>("{}", expensive);
+			if (evaluated)
+				throw std::exception{ "Expected a compiled out call not to evaluate its arguments" };
+		},
+		[] {
+			static_assert(std::same_as<Log::Detail::Resolved<int&>, int&>);
+			static_assert(std::same_as<Log::Detail::Resolved<decltype([] { return 1.0; })>, double>);
+			static_assert(not Log::Detail::IsEnabled<Log::Level::Debug, Log::DefaultCategory, Log::Level::Info>);
+			static_assert(Log::Detail::IsEnabled<Log::Level::Error, Log::DefaultCategory, Log::Level::Info>);
+		}
+	};
 }
@@ -0,0 +1,132 @@
+export module shared:log.ratelimit;
+import std;
+
+// Kept in step with DX3D/Core/ratelimit.ixx in the dx11 DirectXGame project, which has
+// its own copy as the two solutions don't share modules.
+
+export namespace Log
+{
+	// When a call site may log. A call is written if it's one of every EveryN calls and at
+	// least Interval has passed since the site last logged; the first call always is.
+	struct RateLimit
+	{
+		std::uint64_t EveryN = 1;
+		std::chrono::nanoseconds Interval = std::chrono::nanoseconds::zero();
+
+		static constexpr auto Once() noexcept -> RateLimit
+		{
+			return RateLimit{ .EveryN = std::numeric_limits<std::uint64_t>::max() };
+		}
+
+		static constexpr auto PerInterval(std::chrono::nanoseconds interval) noexcept -> RateLimit
+		{
+			return RateLimit{ .Interval = interval };
+		}
+	};
+
+	// Per call site state, claimed by the first call from that site.
+	struct RateLimitSite
+	{
+		std::atomic<std::uint64_t> Key = 0;
+		std::atomic<const char*> File = nullptr;
+		std::atomic<std::uint32_t> Line = 0;
+		std::atomic<std::uint64_t> Calls = 0;
+		std::atomic<std::uint64_t> Suppressed = 0;
+		// Steady clock ticks since its epoch when the site last logged.
+		std::atomic<std::chrono::steady_clock::rep> LastLogged = 0;
+	};
+
+	// A fixed size, open addressed table of sites, keyed on the source_location's file name
+	// pointer, line and column. Claiming a site is a single compare-exchange and checking one
+	// is a hash and a few relaxed atomics, so no call ever takes a lock. If the table fills
+	// up, calls from new sites are never limited rather than dropped.
+	class RateLimitSites
+	{
+	public:
+		static constexpr std::size_t Capacity = 4096;
+		static constexpr std::size_t MaxProbes = 16;
+
+		auto Find(this RateLimitSites& self, const std::source_location& location) noexcept -> RateLimitSite*
+		{
+			auto key = Key(location);
+			for (std::size_t probe = 0; probe < MaxProbes; ++probe)
+			{
+				auto& site = self.sites[(key + probe) & (Capacity - 1)];
+				auto existing = site.Key.load(std::memory_order_acquire);
+				if (existing == key)
+					return &site;
+				if (existing != 0)
+					continue;
+				if (site.Key.compare_exchange_strong(existing, key, std::memory_order_acq_rel))
+				{
+					site.Line.store(location.line(), std::memory_order_relaxed);
+					site.File.store(location.file_name(), std::memory_order_release);
+					return &site;
+				}
+				if (existing == key)
+					return &site;
+			}
+			return nullptr;
+		}
+
+		// Returns how many calls were suppressed since the site last logged, or nothing if
+		// this call should be suppressed too.
+		static auto Check(RateLimitSite& site, const RateLimit& limit) noexcept -> std::optional<std::uint64_t>
+		{
+			auto call = site.Calls.fetch_add(1, std::memory_order_relaxed);
+			if (call % std::max<std::uint64_t>(limit.EveryN, 1) != 0)
+			{
+				site.Suppressed.fetch_add(1, std::memory_order_relaxed);
+				return std::nullopt;
+			}
+			if (limit.Interval > std::chrono::nanoseconds::zero())
+			{
+				using Clock = std::chrono::steady_clock;
+				auto now = Clock::now().time_since_epoch();
+				auto last = site.LastLogged.load(std::memory_order_relaxed);
+				// Of several threads that find the interval has passed, only the one that
+				// updates LastLogged gets to log.
+				if ((call != 0 and now - Clock::duration{ last } < limit.Interval)
+					or not site.LastLogged.compare_exchange_strong(last, now.count(), std::memory_order_relaxed))
+				{
+					site.Suppressed.fetch_add(1, std::memory_order_relaxed);
+					return std::nullopt;
+				}
+			}
+			return site.Suppressed.exchange(0, std::memory_order_relaxed);
+		}
+
+		// Calls fn(file, line, suppressed) for each site with suppressed calls that haven't
+		// been reported yet, and resets their counts.
+		void ForEachSuppressed(this RateLimitSites& self, auto&& fn)
+		{
+			for (auto& site : self.sites)
+			{
+				auto file = site.File.load(std::memory_order_acquire);
+				if (not file)
+					continue;
+				if (auto suppressed = site.Suppressed.exchange(0, std::memory_order_relaxed))
+					fn(std::string_view{ file }, site.Line.load(std::memory_order_relaxed), suppressed);
+			}
+		}
+
+		// The process wide table.
+		static auto Get() noexcept -> RateLimitSites&
+		{
+			static auto sites = RateLimitSites{};
+			return sites;
+		}
+
+	private:
+		static auto Key(const std::source_location& location) noexcept -> std::uint64_t
+		{
+			auto key = std::bit_cast<std::uintptr_t>(location.file_name());
+			key ^= (std::uint64_t{ location.line() } << 32 | location.column()) * 0x9E3779B97F4A7C15ull;
+			key ^= key >> 29;
+			// Zero marks an empty site.
+			return key | 1;
+		}
+
+		std::array<RateLimitSite, Capacity> sites{};
+	};
+}
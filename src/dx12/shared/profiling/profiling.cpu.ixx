@@ -0,0 +1,437 @@
+module;
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+export module shared:profiling.cpu;
+import std;
+import :util;
+
+export namespace Profiling
+{
+	// Define SHARED_DISABLE_CPU_PROFILING to compile all zones and counters out.
+	constexpr auto CpuProfilingEnabled =
+#ifdef SHARED_DISABLE_CPU_PROFILING
+		false;
+#else
+		true;
+#endif
+
+	struct Clock
+	{
+		// Raw, monotonic ticks. Uses the TSC where available as it's roughly
+		// an order of magnitude cheaper than QueryPerformanceCounter.
+		static auto Now() noexcept -> std::uint64_t
+		{
+#if defined(_M_X64) || defined(_M_IX86)
+			return __rdtsc();
+#else
+			return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+		}
+
+		// Calibrated once against steady_clock on first use.
+		static auto TicksPerSecond() -> double
+		{
+#if defined(_M_X64) || defined(_M_IX86)
+			static const auto ticksPerSecond =
+				[] static -> double
+				{
+					auto startTime = std::chrono::steady_clock::now();
+					auto startTicks = Now();
+					std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+					auto elapsedTicks = Now() - startTicks;
+					auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime);
+					return static_cast<double>(elapsedTicks) / elapsed.count();
+				}();
+			return ticksPerSecond;
+#else
+			using Period = std::chrono::steady_clock::period;
+			return static_cast<double>(Period::den) / static_cast<double>(Period::num);
+#endif
+		}
+	};
+
+	enum class EventType : std::uint8_t
+	{
+		Zone,
+		Counter
+	};
+
+	// Names must have static storage duration; only the pointer is recorded.
+	struct Event
+	{
+		const char* Name = nullptr;
+		std::uint64_t Begin = 0;
+		// End ticks for zones, the bit pattern of a double for counters.
+		std::uint64_t Value = 0;
+		EventType Type = EventType::Zone;
+	};
+
+	struct CapturedEvent
+	{
+		Profiling::Event Event;
+		std::uint32_t ThreadId = 0;
+	};
+
+	// Single-producer single-consumer ring owned by one thread. The owning thread
+	// writes, and any one draining thread reads, without either taking a lock.
+	// Events are dropped rather than blocking when the ring is full.
+	class ThreadBuffer
+	{
+	public:
+		static constexpr std::size_t Capacity = 1 << 13;
+
+		ThreadBuffer(std::uint32_t threadId) noexcept
+			: threadId(threadId)
+		{ }
+
+		void Push(this ThreadBuffer& self, const Event& event) noexcept
+		{
+			auto head = self.head.load(std::memory_order_relaxed);
+			if (head - self.tail.load(std::memory_order_acquire) >= Capacity)
+			{
+				self.dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			self.events[head & (Capacity - 1)] = event;
+			self.head.store(head + 1, std::memory_order_release);
+		}
+
+		void Drain(this ThreadBuffer& self, std::vector<CapturedEvent>& out)
+		{
+			auto tail = self.tail.load(std::memory_order_relaxed);
+			auto head = self.head.load(std::memory_order_acquire);
+			for (; tail != head; ++tail)
+				out.push_back(CapturedEvent{ self.events[tail & (Capacity - 1)], self.threadId });
+			self.tail.store(tail, std::memory_order_release);
+		}
+
+		auto IsEmpty(this const ThreadBuffer& self) noexcept -> bool
+		{
+			return self.head.load(std::memory_order_acquire) == self.tail.load(std::memory_order_acquire);
+		}
+
+		auto GetThreadId(this const ThreadBuffer& self) noexcept -> std::uint32_t
+		{
+			return self.threadId;
+		}
+
+		// Only called on an empty buffer, before its new owner pushes anything, so drains
+		// never see the old id alongside the new owner's events.
+		void Reuse(this ThreadBuffer& self, std::uint32_t threadId) noexcept
+		{
+			self.threadId = threadId;
+		}
+
+		auto GetDroppedCount(this const ThreadBuffer& self) noexcept -> std::uint64_t
+		{
+			return self.dropped.load(std::memory_order_relaxed);
+		}
+
+		// Threads claim a buffer on first use and release it on exit, so that
+		// buffers can be recycled without ever being freed while in the registry.
+		std::atomic<bool> Owned = true;
+		ThreadBuffer* Next = nullptr;
+
+	private:
+		std::array<Event, Capacity> events{};
+		alignas(std::hardware_destructive_interference_size) std::atomic<std::uint64_t> head = 0;
+		alignas(std::hardware_destructive_interference_size) std::atomic<std::uint64_t> tail = 0;
+		std::atomic<std::uint64_t> dropped = 0;
+		std::uint32_t threadId = 0;
+	};
+
+	// Lock-free intrusive list of every thread buffer ever created.
+	class Registry
+	{
+	public:
+		~Registry()
+		{
+			auto buffer = head.load(std::memory_order_acquire);
+			while (buffer)
+				delete std::exchange(buffer, buffer->Next);
+		}
+
+		static auto Get() -> Registry&
+		{
+			static auto registry = Registry{};
+			return registry;
+		}
+
+		auto Acquire(this Registry& self) -> ThreadBuffer*
+		{
+			// Recycle a buffer from a thread that has exited, if any.
+			for (auto buffer = self.head.load(std::memory_order_acquire); buffer; buffer = buffer->Next)
+			{
+				auto owned = false;
+				if (buffer->IsEmpty() and buffer->Owned.compare_exchange_strong(owned, true, std::memory_order_acq_rel))
+				{
+					// A new id, so the trace doesn't merge this thread with the one that exited.
+					buffer->Reuse(self.nextThreadId.fetch_add(1, std::memory_order_relaxed));
+					return buffer;
+				}
+			}
+
+			auto buffer = new ThreadBuffer{ self.nextThreadId.fetch_add(1, std::memory_order_relaxed) };
+			buffer->Next = self.head.load(std::memory_order_relaxed);
+			while (not self.head.compare_exchange_weak(buffer->Next, buffer, std::memory_order_release, std::memory_order_relaxed));
+			return buffer;
+		}
+
+		template<typename TFn>
+		void ForEach(this Registry& self, TFn&& fn)
+		{
+			for (auto buffer = self.head.load(std::memory_order_acquire); buffer; buffer = buffer->Next)
+				fn(*buffer);
+		}
+
+	private:
+		std::atomic<ThreadBuffer*> head = nullptr;
+		std::atomic<std::uint32_t> nextThreadId = 1;
+	};
+
+	namespace Detail
+	{
+		struct ThreadBufferHandle
+		{
+			~ThreadBufferHandle()
+			{
+				if (Buffer)
+					Buffer->Owned.store(false, std::memory_order_release);
+			}
+
+			ThreadBuffer* Buffer = Registry::Get().Acquire();
+		};
+
+		inline auto GetThreadBuffer() -> ThreadBuffer&
+		{
+			thread_local auto handle = ThreadBufferHandle{};
+			return *handle.Buffer;
+		}
+
+		constexpr void AppendVarint(std::string& out, std::uint64_t value)
+		{
+			do
+			{
+				auto byte = static_cast<char>(value & 0x7F);
+				value >>= 7;
+				if (value)
+					byte |= 0x80;
+				out.push_back(byte);
+			} while (value);
+		}
+
+		template<typename T>
+		constexpr void AppendRaw(std::string& out, const T& value)
+		{
+			auto bytes = std::bit_cast<std::array<char, sizeof(T)>>(value);
+			out.append(bytes.data(), bytes.size());
+		}
+
+		constexpr auto EscapeJson(std::string_view name) -> std::string
+		{
+			auto escaped = std::string{};
+			for (auto c : name)
+			{
+				if (c == '"' or c == '\\')
+					escaped.push_back('\\');
+				escaped.push_back(c);
+			}
+			return escaped;
+		}
+
+		// The body of WriteBinaryTrace(), split out so that it can be tested at compile time.
+		constexpr void EncodeBinaryTrace(std::string& out, std::span<const CapturedEvent> events, double ticksPerSecond)
+		{
+			auto nameTable = std::vector<const char*>{};
+			auto nameIndices = std::vector<std::uint64_t>(events.size());
+			if consteval
+			{
+				for (std::size_t i = 0; i < events.size(); ++i)
+				{
+					auto found = std::ranges::find(nameTable, events[i].Event.Name);
+					nameIndices[i] = static_cast<std::uint64_t>(found - nameTable.begin());
+					if (found == nameTable.end())
+						nameTable.push_back(events[i].Event.Name);
+				}
+			}
+			else
+			{
+				auto names = std::unordered_map<const char*, std::uint64_t>{};
+				for (std::size_t i = 0; i < events.size(); ++i)
+				{
+					auto [found, inserted] = names.try_emplace(events[i].Event.Name, nameTable.size());
+					nameIndices[i] = found->second;
+					if (inserted)
+						nameTable.push_back(events[i].Event.Name);
+				}
+			}
+
+			out.append("SPRF");
+			AppendRaw(out, std::uint32_t{ 1 });
+			AppendRaw(out, ticksPerSecond);
+			AppendVarint(out, nameTable.size());
+			for (auto name : nameTable)
+			{
+				auto view = std::string_view{ name };
+				AppendVarint(out, view.size());
+				out.append(view);
+			}
+
+			AppendVarint(out, events.size());
+			auto previous = std::uint64_t{};
+			for (std::size_t i = 0; i < events.size(); ++i)
+			{
+				const auto& [event, threadId] = events[i];
+				out.push_back(static_cast<char>(event.Type));
+				AppendVarint(out, threadId);
+				AppendVarint(out, nameIndices[i]);
+				AppendVarint(out, event.Begin - previous);
+				AppendVarint(out, event.Type == EventType::Zone ? event.Value - event.Begin : event.Value);
+				previous = event.Begin;
+			}
+		}
+	}
+
+	template<bool VEnabled>
+	struct BasicZone
+	{
+		explicit BasicZone(const char* name = std::source_location::current().function_name()) noexcept
+			: name(name), begin(Clock::Now())
+		{ }
+
+		~BasicZone()
+		{
+			Detail::GetThreadBuffer().Push(Event{ name, begin, Clock::Now(), EventType::Zone });
+		}
+
+		BasicZone(const BasicZone&) = delete;
+		auto operator=(const BasicZone&) -> BasicZone& = delete;
+
+	private:
+		const char* name;
+		std::uint64_t begin;
+	};
+
+	template<>
+	struct BasicZone<false>
+	{
+		constexpr explicit BasicZone(const char* = nullptr) noexcept { }
+	};
+
+	// Times the enclosing scope, e.g. auto zone = Profiling::Zone{ "Render" };
+	using Zone = BasicZone<CpuProfilingEnabled>;
+
+	inline void Counter(const char* name, double value) noexcept
+	{
+		if constexpr (CpuProfilingEnabled)
+			Detail::GetThreadBuffer().Push(Event{ name, Clock::Now(), std::bit_cast<std::uint64_t>(value), EventType::Counter });
+	}
+
+	// Moves all pending events from every thread's buffer into out, sorted by start time.
+	// Only one thread should drain at a time; producers are never blocked.
+	inline void Drain(std::vector<CapturedEvent>& out)
+	{
+		auto first = out.size();
+		Registry::Get().ForEach([&out](ThreadBuffer& buffer) { buffer.Drain(out); });
+		std::sort(
+			out.begin() + first,
+			out.end(),
+			[](const CapturedEvent& a, const CapturedEvent& b) { return a.Event.Begin < b.Event.Begin; }
+		);
+	}
+
+	inline auto GetDroppedCount() -> std::uint64_t
+	{
+		auto dropped = std::uint64_t{};
+		Registry::Get().ForEach([&dropped](const ThreadBuffer& buffer) { dropped += buffer.GetDroppedCount(); });
+		return dropped;
+	}
+
+	// See https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+	// The output can be loaded in chrome://tracing or https://ui.perfetto.dev.
+	inline void WriteChromeTrace(std::ostream& out, std::span<const CapturedEvent> events)
+	{
+		auto toMicroseconds = 1'000'000.0 / Clock::TicksPerSecond();
+		auto origin = events.empty() ? 0 : events.front().Event.Begin;
+		out << "{\"traceEvents\":[";
+		auto separator = "";
+		for (const auto& [event, threadId] : events)
+		{
+			auto timestamp = static_cast<double>(event.Begin - origin) * toMicroseconds;
+			if (event.Type == EventType::Zone)
+			{
+				std::print(
+					out,
+					"{}\n{{\"name\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{}}}",
+					separator,
+					Detail::EscapeJson(event.Name),
+					timestamp,
+					static_cast<double>(event.Value - event.Begin) * toMicroseconds,
+					threadId
+				);
+			}
+			else
+			{
+				std::print(
+					out,
+					"{}\n{{\"name\":\"{}\",\"ph\":\"C\",\"ts\":{:.3f},\"pid\":1,\"tid\":{},\"args\":{{\"value\":{}}}}}",
+					separator,
+					Detail::EscapeJson(event.Name),
+					timestamp,
+					threadId,
+					std::bit_cast<double>(event.Value)
+				);
+			}
+			separator = ",";
+		}
+		out << "\n]}\n";
+	}
+
+	// Compact binary form: a header, a table of unique names and then one record per
+	// event, with LEB128 varints and start times delta-encoded against the previous event.
+	//   "SPRF" u32 version, f64 ticks per second, varint name count, (varint length, bytes)...
+	//   varint event count, (u8 type, varint thread, varint name index, varint delta, varint value)...
+	inline void WriteBinaryTrace(std::ostream& out, std::span<const CapturedEvent> events)
+	{
+		// Encoded up front so the stream sees one write rather than one per byte.
+		auto encoded = std::string{};
+		Detail::EncodeBinaryTrace(encoded, events, Clock::TicksPerSecond());
+		out.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+	}
+}
+
+namespace
+{
+	// Distinct objects, as comparing the addresses of string literals isn't a constant expression.
+	constexpr char FrameName[] = "Frame";
+	constexpr char QuotedName[] = "Say \"hi\"";
+
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			if (Profiling::Detail::EscapeJson(QuotedName) != "Say \\\"hi\\\"")
+				throw std::exception{ "Expected quotes in names to be escaped" };
+		},
+		[] {
+			using Profiling::CapturedEvent, Profiling::Event, Profiling::EventType;
+			auto events = std::array{
+				CapturedEvent{ Event{ FrameName, 100, 150, EventType::Zone }, 1 },
+				CapturedEvent{ Event{ FrameName, 300, 42, EventType::Counter }, 2 }
+			};
+			auto out = std::string{};
+			Profiling::Detail::EncodeBinaryTrace(out, events, 1.0);
+			// One name, then (type, thread, name, delta, duration or value) per event.
+			constexpr auto body = std::string_view{ "\x01\x05" "Frame" "\x02" "\x00\x01\x00\x64\x32" "\x01\x02\x00\xC8\x01\x2A", 19 };
+			if (not out.starts_with("SPRF") or out.size() != 16 + body.size() or std::string_view{ out }.substr(16) != body)
+				throw std::exception{ "Unexpected binary trace" };
+		},
+		[] {
+			auto out = std::string{};
+			Profiling::Detail::EncodeBinaryTrace(out, {}, 1.0);
+			if (out.size() != 18 or out[16] != 0 or out[17] != 0)
+				throw std::exception{ "Expected an empty trace to have no names or events" };
+		}
+	};
+}
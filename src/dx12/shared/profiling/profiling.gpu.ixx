@@ -0,0 +1,537 @@
+export module shared:profiling.gpu;
+import std;
+import :win32;
+import :com;
+import :error;
+import :util;
+
+export namespace Profiling
+{
+	// Mirrors D3D12_QUERY_DATA_PIPELINE_STATISTICS so that the profiler and
+	// any fake query sources don't need to depend on the D3D12 headers.
+	struct PipelineStatistics
+	{
+		std::uint64_t IAVertices = 0;
+		std::uint64_t IAPrimitives = 0;
+		std::uint64_t VSInvocations = 0;
+		std::uint64_t GSInvocations = 0;
+		std::uint64_t GSPrimitives = 0;
+		std::uint64_t CInvocations = 0;
+		std::uint64_t CPrimitives = 0;
+		std::uint64_t PSInvocations = 0;
+		std::uint64_t HSInvocations = 0;
+		std::uint64_t DSInvocations = 0;
+		std::uint64_t CSInvocations = 0;
+	};
+
+	// A query source owns the GPU-side query heaps and readback memory. Query
+	// indices are absolute; the profiler partitions them per frame slot.
+	// ReadTimestamps() and ReadStatistics() are only ever called for slots
+	// whose fence has already completed, so implementations must not block.
+	template<typename T>
+	concept QuerySource = requires(
+		T t,
+		std::uint32_t index,
+		std::uint32_t count,
+		std::span<std::uint64_t> timestamps,
+		std::span<PipelineStatistics> statistics
+	)
+	{
+		{ t.GetTimestampFrequency() } -> std::convertible_to<std::uint64_t>;
+		t.EndTimestamp(index);
+		t.BeginStatistics(index);
+		t.EndStatistics(index);
+		t.ResolveTimestamps(index, count);
+		t.ResolveStatistics(index, count);
+		t.ReadTimestamps(index, timestamps);
+		t.ReadStatistics(index, statistics);
+	};
+
+	template<std::size_t VHistorySize>
+	struct PassHistory
+	{
+		std::string Name;
+		std::array<double, VHistorySize> Milliseconds{};
+		std::array<PipelineStatistics, VHistorySize> Statistics{};
+		std::size_t Count = 0;
+		std::size_t Next = 0;
+
+		constexpr void Push(this PassHistory& self, double milliseconds, const PipelineStatistics& statistics) noexcept
+		{
+			self.Milliseconds[self.Next] = milliseconds;
+			self.Statistics[self.Next] = statistics;
+			self.Next = (self.Next + 1) % VHistorySize;
+			self.Count = std::min(self.Count + 1, VHistorySize);
+		}
+
+		constexpr auto Latest(this const PassHistory& self) noexcept -> double
+		{
+			return self.Count ? self.Milliseconds[(self.Next + VHistorySize - 1) % VHistorySize] : 0.0;
+		}
+
+		constexpr auto LatestStatistics(this const PassHistory& self) noexcept -> PipelineStatistics
+		{
+			return self.Count ? self.Statistics[(self.Next + VHistorySize - 1) % VHistorySize] : PipelineStatistics{};
+		}
+
+		constexpr auto Average(this const PassHistory& self) noexcept -> double
+		{
+			if (not self.Count)
+				return 0.0;
+			auto total = 0.0;
+			for (std::size_t i = 0; i < self.Count; ++i)
+				total += self.Milliseconds[i];
+			return total / static_cast<double>(self.Count);
+		}
+
+		constexpr auto Min(this const PassHistory& self) noexcept -> double
+		{
+			return self.Count ? *std::min_element(self.Milliseconds.begin(), self.Milliseconds.begin() + self.Count) : 0.0;
+		}
+
+		constexpr auto Max(this const PassHistory& self) noexcept -> double
+		{
+			return self.Count ? *std::max_element(self.Milliseconds.begin(), self.Milliseconds.begin() + self.Count) : 0.0;
+		}
+	};
+
+	struct GpuProfilerDesc
+	{
+		bool CollectStatistics = false;
+	};
+
+	// Wraps GPU passes in timestamp (and optionally pipeline statistics) queries.
+	// Each frame writes into its own slot of the query source; a slot is only read
+	// back once the fence value it was submitted with has completed, so the CPU
+	// never waits on the GPU. If all slots are still in flight, the frame simply
+	// isn't profiled.
+	template<QuerySource TSource, std::uint32_t VFramesInFlight = 3, std::uint32_t VMaxPasses = 64, std::size_t VHistorySize = 120>
+	class GpuProfiler
+	{
+	public:
+		static constexpr std::uint32_t TimestampsPerFrame = VMaxPasses * 2;
+		static constexpr std::uint32_t TimestampCount = TimestampsPerFrame * VFramesInFlight;
+		static constexpr std::uint32_t StatisticsCount = VMaxPasses * VFramesInFlight;
+		static constexpr std::uint32_t InvalidPass = std::numeric_limits<std::uint32_t>::max();
+
+		using History = PassHistory<VHistorySize>;
+
+		constexpr GpuProfiler(TSource source, GpuProfilerDesc desc = {})
+			: source(std::move(source)), desc(desc)
+		{ }
+
+		struct PassScope
+		{
+			constexpr PassScope(GpuProfiler* profiler, std::uint32_t pass) noexcept
+				: profiler(profiler), pass(pass)
+			{ }
+			constexpr ~PassScope()
+			{
+				if (profiler)
+					profiler->EndPass(pass);
+			}
+			PassScope(const PassScope&) = delete;
+			auto operator=(const PassScope&) -> PassScope& = delete;
+			auto operator=(PassScope&&) -> PassScope& = delete;
+
+			GpuProfiler* profiler = nullptr;
+			std::uint32_t pass = InvalidPass;
+		};
+
+		// Collects the results of any slots that the GPU has finished with and
+		// claims the next slot for recording, if one is free.
+		constexpr void BeginFrame(this GpuProfiler& self, std::uint64_t completedFenceValue)
+		{
+			for (auto& slot : self.slots)
+				if (slot.Pending and slot.FenceValue <= completedFenceValue)
+					self.Collect(slot);
+
+			auto& slot = self.slots[self.currentSlot];
+			self.recording = not slot.Pending;
+			if (not self.recording)
+				self.droppedFrames++;
+			else
+				slot.Passes.clear();
+		}
+
+		[[nodiscard]]
+		constexpr auto BeginPass(this GpuProfiler& self, std::string_view name) -> std::uint32_t
+		{
+			auto& slot = self.slots[self.currentSlot];
+			if (not self.recording or slot.Passes.size() >= VMaxPasses)
+				return InvalidPass;
+
+			auto pass = static_cast<std::uint32_t>(slot.Passes.size());
+			slot.Passes.push_back(self.FindOrAddHistory(name));
+			self.source.EndTimestamp(self.TimestampBase() + pass * 2);
+			if (self.desc.CollectStatistics)
+				self.source.BeginStatistics(self.StatisticsBase() + pass);
+			return pass;
+		}
+
+		constexpr void EndPass(this GpuProfiler& self, std::uint32_t pass)
+		{
+			if (pass == InvalidPass or not self.recording)
+				return;
+			if (self.desc.CollectStatistics)
+				self.source.EndStatistics(self.StatisticsBase() + pass);
+			self.source.EndTimestamp(self.TimestampBase() + pass * 2 + 1);
+		}
+
+		[[nodiscard]]
+		constexpr auto Scope(this GpuProfiler& self, std::string_view name) -> PassScope
+		{
+			return PassScope{ &self, self.BeginPass(name) };
+		}
+
+		// Records the resolve into the readback ring. Must be called on the command list
+		// that contains this frame's passes, before it is closed. submittedFenceValue
+		// is the value the queue will signal once the frame's work has completed.
+		constexpr void EndFrame(this GpuProfiler& self, std::uint64_t submittedFenceValue)
+		{
+			auto& slot = self.slots[self.currentSlot];
+			if (self.recording and not slot.Passes.empty())
+			{
+				auto count = static_cast<std::uint32_t>(slot.Passes.size());
+				self.source.ResolveTimestamps(self.TimestampBase(), count * 2);
+				if (self.desc.CollectStatistics)
+					self.source.ResolveStatistics(self.StatisticsBase(), count);
+				slot.FenceValue = submittedFenceValue;
+				slot.Pending = true;
+			}
+			self.recording = false;
+			self.currentSlot = (self.currentSlot + 1) % VFramesInFlight;
+		}
+
+		constexpr auto GetHistory(this const GpuProfiler& self, std::string_view name) noexcept -> const History*
+		{
+			for (const auto& history : self.histories)
+				if (history.Name == name)
+					return &history;
+			return nullptr;
+		}
+
+		constexpr auto GetHistories(this const GpuProfiler& self) noexcept -> std::span<const History>
+		{
+			return self.histories;
+		}
+
+		constexpr auto GetSource(this auto&& self) noexcept -> decltype(auto)
+		{
+			return std::forward_like<decltype(self)>(self.source);
+		}
+
+		constexpr auto GetDroppedFrames(this const GpuProfiler& self) noexcept -> std::uint64_t
+		{
+			return self.droppedFrames;
+		}
+
+	private:
+		struct FrameSlot
+		{
+			std::vector<std::size_t> Passes;
+			std::uint64_t FenceValue = 0;
+			bool Pending = false;
+		};
+
+		constexpr auto TimestampBase(this const GpuProfiler& self) noexcept -> std::uint32_t
+		{
+			return self.currentSlot * TimestampsPerFrame;
+		}
+
+		constexpr auto StatisticsBase(this const GpuProfiler& self) noexcept -> std::uint32_t
+		{
+			return self.currentSlot * VMaxPasses;
+		}
+
+		constexpr auto FindOrAddHistory(this GpuProfiler& self, std::string_view name) -> std::size_t
+		{
+			for (std::size_t i = 0; i < self.histories.size(); ++i)
+				if (self.histories[i].Name == name)
+					return i;
+			self.histories.push_back(History{ .Name = std::string{ name } });
+			return self.histories.size() - 1;
+		}
+
+		constexpr void Collect(this GpuProfiler& self, FrameSlot& slot)
+		{
+			auto slotIndex = static_cast<std::uint32_t>(&slot - self.slots.data());
+			auto count = static_cast<std::uint32_t>(slot.Passes.size());
+			auto timestamps = std::array<std::uint64_t, TimestampsPerFrame>{};
+			auto statistics = std::array<PipelineStatistics, VMaxPasses>{};
+			self.source.ReadTimestamps(slotIndex * TimestampsPerFrame, std::span{ timestamps }.first(count * 2));
+			if (self.desc.CollectStatistics)
+				self.source.ReadStatistics(slotIndex * VMaxPasses, std::span{ statistics }.first(count));
+
+			auto frequency = static_cast<double>(self.source.GetTimestampFrequency());
+			for (std::uint32_t pass = 0; pass < count; ++pass)
+			{
+				auto begin = timestamps[pass * 2];
+				auto end = timestamps[pass * 2 + 1];
+				// Timestamps can go backwards across power state transitions; discard those samples.
+				auto ticks = end >= begin ? end - begin : 0;
+				auto milliseconds = frequency > 0 ? static_cast<double>(ticks) * 1000.0 / frequency : 0.0;
+				self.histories[slot.Passes[pass]].Push(milliseconds, statistics[pass]);
+			}
+			slot.Pending = false;
+			slot.Passes.clear();
+		}
+
+		TSource source;
+		GpuProfilerDesc desc;
+		std::array<FrameSlot, VFramesInFlight> slots{};
+		std::vector<History> histories;
+		std::uint32_t currentSlot = 0;
+		std::uint64_t droppedFrames = 0;
+		bool recording = false;
+	};
+
+	// D3D12 implementation of QuerySource. The command list must be set
+	// each frame before any passes are recorded.
+	class D3D12QuerySource
+	{
+	public:
+		D3D12QuerySource(
+			Com::Ref<D3D12::ID3D12Device> device,
+			Com::Ref<D3D12::ID3D12CommandQueue> queue,
+			std::uint32_t timestampCount,
+			std::uint32_t statisticsCount
+		) : timestampCount(timestampCount), statisticsCount(statisticsCount)
+		{
+			auto hr = Com::HResult{ queue->GetTimestampFrequency(&frequency) };
+			if (not hr)
+				throw Error::ComError(hr, "Failed to get command queue timestamp frequency");
+
+			auto timestampHeapDesc = D3D12::D3D12_QUERY_HEAP_DESC{
+				.Type = D3D12::D3D12_QUERY_HEAP_TYPE::D3D12_QUERY_HEAP_TYPE_TIMESTAMP,
+				.Count = timestampCount,
+				.NodeMask = 0
+			};
+			hr = device->CreateQueryHeap(&timestampHeapDesc, timestampHeap.GetUuid(), std::out_ptr(timestampHeap));
+			if (not hr)
+				throw Error::ComError(hr, "Failed to create timestamp query heap");
+
+			if (statisticsCount > 0)
+			{
+				auto statisticsHeapDesc = D3D12::D3D12_QUERY_HEAP_DESC{
+					.Type = D3D12::D3D12_QUERY_HEAP_TYPE::D3D12_QUERY_HEAP_TYPE_PIPELINE_STATISTICS,
+					.Count = statisticsCount,
+					.NodeMask = 0
+				};
+				hr = device->CreateQueryHeap(&statisticsHeapDesc, statisticsHeap.GetUuid(), std::out_ptr(statisticsHeap));
+				if (not hr)
+					throw Error::ComError(hr, "Failed to create pipeline statistics query heap");
+			}
+
+			// Timestamps first, followed by the pipeline statistics.
+			auto readbackSize = StatisticsOffset() + std::uint64_t{ statisticsCount } * sizeof(D3D12::D3D12_QUERY_DATA_PIPELINE_STATISTICS);
+			auto heapProps = D3D12::CD3DX12_HEAP_PROPERTIES(D3D12::D3D12_HEAP_TYPE::D3D12_HEAP_TYPE_READBACK);
+			auto bufferDesc = D3D12::CD3DX12_RESOURCE_DESC::Buffer(readbackSize);
+			hr = device->CreateCommittedResource(
+				&heapProps,
+				D3D12::D3D12_HEAP_FLAGS::D3D12_HEAP_FLAG_NONE,
+				&bufferDesc,
+				D3D12::D3D12_RESOURCE_STATES::D3D12_RESOURCE_STATE_COPY_DEST,
+				nullptr,
+				readback.GetUuid(),
+				std::out_ptr(readback)
+			);
+			if (not hr)
+				throw Error::ComError(hr, "Failed to create query readback buffer");
+		}
+
+		void SetCommandList(this D3D12QuerySource& self, D3D12::ID3D12GraphicsCommandList* commandList) noexcept
+		{
+			self.commandList = commandList;
+		}
+
+		auto GetTimestampFrequency(this const D3D12QuerySource& self) noexcept -> std::uint64_t
+		{
+			return self.frequency;
+		}
+
+		void EndTimestamp(this D3D12QuerySource& self, std::uint32_t index)
+		{
+			self.commandList->EndQuery(self.timestampHeap.get(), D3D12::D3D12_QUERY_TYPE::D3D12_QUERY_TYPE_TIMESTAMP, index);
+		}
+
+		void BeginStatistics(this D3D12QuerySource& self, std::uint32_t index)
+		{
+			self.commandList->BeginQuery(self.statisticsHeap.get(), D3D12::D3D12_QUERY_TYPE::D3D12_QUERY_TYPE_PIPELINE_STATISTICS, index);
+		}
+
+		void EndStatistics(this D3D12QuerySource& self, std::uint32_t index)
+		{
+			self.commandList->EndQuery(self.statisticsHeap.get(), D3D12::D3D12_QUERY_TYPE::D3D12_QUERY_TYPE_PIPELINE_STATISTICS, index);
+		}
+
+		void ResolveTimestamps(this D3D12QuerySource& self, std::uint32_t index, std::uint32_t count)
+		{
+			self.commandList->ResolveQueryData(
+				self.timestampHeap.get(),
+				D3D12::D3D12_QUERY_TYPE::D3D12_QUERY_TYPE_TIMESTAMP,
+				index,
+				count,
+				self.readback.get(),
+				std::uint64_t{ index } * sizeof(std::uint64_t)
+			);
+		}
+
+		void ResolveStatistics(this D3D12QuerySource& self, std::uint32_t index, std::uint32_t count)
+		{
+			self.commandList->ResolveQueryData(
+				self.statisticsHeap.get(),
+				D3D12::D3D12_QUERY_TYPE::D3D12_QUERY_TYPE_PIPELINE_STATISTICS,
+				index,
+				count,
+				self.readback.get(),
+				self.StatisticsOffset() + std::uint64_t{ index } * sizeof(D3D12::D3D12_QUERY_DATA_PIPELINE_STATISTICS)
+			);
+		}
+
+		void ReadTimestamps(this D3D12QuerySource& self, std::uint32_t index, std::span<std::uint64_t> timestamps)
+		{
+			auto offset = std::uint64_t{ index } * sizeof(std::uint64_t);
+			self.Read(offset, std::as_writable_bytes(timestamps));
+		}
+
+		void ReadStatistics(this D3D12QuerySource& self, std::uint32_t index, std::span<PipelineStatistics> statistics)
+		{
+			static_assert(sizeof(PipelineStatistics) == sizeof(D3D12::D3D12_QUERY_DATA_PIPELINE_STATISTICS));
+			auto offset = self.StatisticsOffset() + std::uint64_t{ index } * sizeof(D3D12::D3D12_QUERY_DATA_PIPELINE_STATISTICS);
+			self.Read(offset, std::as_writable_bytes(statistics));
+		}
+
+	private:
+		auto StatisticsOffset(this const D3D12QuerySource& self) noexcept -> std::uint64_t
+		{
+			return std::uint64_t{ self.timestampCount } * sizeof(std::uint64_t);
+		}
+
+		void Read(this D3D12QuerySource& self, std::uint64_t offset, std::span<std::byte> destination)
+		{
+			if (destination.empty())
+				return;
+			auto range = D3D12::D3D12_RANGE{
+				.Begin = static_cast<std::size_t>(offset),
+				.End = static_cast<std::size_t>(offset + destination.size())
+			};
+			auto mapped = Com::Unwrap(Com::TryMap(*self.readback, 0, &range), "Failed to map query readback buffer");
+			std::memcpy(destination.data(), mapped + offset, destination.size());
+			// Nothing was written by the CPU.
+			auto written = D3D12::D3D12_RANGE{ .Begin = 0, .End = 0 };
+			self.readback->Unmap(0, &written);
+		}
+
+		std::uint64_t frequency = 0;
+		std::uint32_t timestampCount = 0;
+		std::uint32_t statisticsCount = 0;
+		Com::Ptr<D3D12::ID3D12QueryHeap> timestampHeap;
+		Com::Ptr<D3D12::ID3D12QueryHeap> statisticsHeap;
+		Com::Ptr<D3D12::ID3D12Resource> readback;
+		D3D12::ID3D12GraphicsCommandList* commandList = nullptr;
+	};
+
+	template<std::uint32_t VFramesInFlight = 3, std::uint32_t VMaxPasses = 64, std::size_t VHistorySize = 120>
+	auto MakeD3D12GpuProfiler(
+		Com::Ref<D3D12::ID3D12Device> device,
+		Com::Ref<D3D12::ID3D12CommandQueue> queue,
+		GpuProfilerDesc desc = {}
+	) -> GpuProfiler<D3D12QuerySource, VFramesInFlight, VMaxPasses, VHistorySize>
+	{
+		using ProfilerType = GpuProfiler<D3D12QuerySource, VFramesInFlight, VMaxPasses, VHistorySize>;
+		return ProfilerType{
+			D3D12QuerySource{
+				device,
+				queue,
+				ProfilerType::TimestampCount,
+				desc.CollectStatistics ? ProfilerType::StatisticsCount : 0
+			},
+			desc
+		};
+	}
+}
+
+namespace
+{
+	// Emulates a GPU that writes a fixed number of ticks per pass.
+	struct FakeQuerySource
+	{
+		static constexpr std::uint64_t TicksPerPass = 500;
+		std::array<std::uint64_t, 64> Written{};
+		std::array<std::uint64_t, 64> Resolved{};
+		std::uint64_t Clock = 0;
+		int Statistics = 0;
+
+		constexpr auto GetTimestampFrequency() const noexcept -> std::uint64_t { return 1'000'000; }
+		constexpr void EndTimestamp(std::uint32_t index) { Written[index] = (Clock += TicksPerPass); }
+		constexpr void BeginStatistics(std::uint32_t) { Statistics++; }
+		constexpr void EndStatistics(std::uint32_t) { Statistics++; }
+		constexpr void ResolveTimestamps(std::uint32_t index, std::uint32_t count)
+		{
+			std::copy_n(Written.begin() + index, count, Resolved.begin() + index);
+		}
+		constexpr void ResolveStatistics(std::uint32_t, std::uint32_t) { }
+		constexpr void ReadTimestamps(std::uint32_t index, std::span<std::uint64_t> out)
+		{
+			std::copy_n(Resolved.begin() + index, out.size(), out.begin());
+		}
+		constexpr void ReadStatistics(std::uint32_t, std::span<Profiling::PipelineStatistics> out)
+		{
+			for (auto& s : out)
+				s.VSInvocations = 3;
+		}
+	};
+
+	using FakeProfiler = Profiling::GpuProfiler<FakeQuerySource, 2, 4, 8>;
+
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			// Results only become visible once the fence has completed.
+			auto profiler = FakeProfiler{ FakeQuerySource{} };
+			profiler.BeginFrame(0);
+			{
+				auto scope = profiler.Scope("Main");
+			}
+			if (profiler.GetSource().Clock != 2 * FakeQuerySource::TicksPerPass)
+				throw std::exception{ "Expected the scope to write both of its pass's timestamps" };
+			profiler.EndFrame(1);
+			profiler.BeginFrame(0);
+			if (profiler.GetHistory("Main")->Count != 0)
+				throw std::exception{ "Expected no samples before fence completion" };
+			profiler.EndFrame(2);
+			profiler.BeginFrame(1);
+			if (profiler.GetHistory("Main")->Count != 1)
+				throw std::exception{ "Expected one sample after fence completion" };
+			if (profiler.GetHistory("Main")->Latest() != 0.5)
+				throw std::exception{ "Expected 500 ticks at 1MHz to be 0.5ms" };
+		},
+		[] {
+			// With every slot in flight, frames are skipped rather than waited on.
+			auto profiler = FakeProfiler{ FakeQuerySource{} };
+			for (std::uint64_t frame = 1; frame <= 3; ++frame)
+			{
+				profiler.BeginFrame(0);
+				profiler.EndPass(profiler.BeginPass("Main"));
+				profiler.EndFrame(frame);
+			}
+			profiler.BeginFrame(3);
+			if (profiler.GetHistory("Main")->Count != 2 or profiler.GetDroppedFrames() != 1)
+				throw std::exception{ "Expected the third frame to be skipped" };
+		},
+		[] {
+			auto profiler = FakeProfiler{ FakeQuerySource{}, { .CollectStatistics = true } };
+			profiler.BeginFrame(0);
+			profiler.EndPass(profiler.BeginPass("Shadow"));
+			profiler.EndPass(profiler.BeginPass("Main"));
+			profiler.EndFrame(1);
+			profiler.BeginFrame(1);
+			if (profiler.GetSource().Statistics != 4)
+				throw std::exception{ "Expected statistics queries around each pass" };
+			if (profiler.GetHistory("Shadow")->LatestStatistics().VSInvocations != 3)
+				throw std::exception{ "Expected statistics to be read back" };
+			if (profiler.GetHistories().size() != 2)
+				throw std::exception{ "Expected a history per pass" };
+		}
+	};
+}
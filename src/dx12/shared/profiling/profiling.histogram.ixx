@@ -0,0 +1,114 @@
+export module shared:profiling.histogram;
+import std;
+import :util;
+
+export namespace Profiling
+{
+	// Fixed-size log-linear histogram over unsigned integers, in the style of HdrHistogram.
+	// Each power of two is split into 2^VSubBucketBits linear buckets, so recording is a
+	// couple of bit operations and any percentile is within 1 / 2^VSubBucketBits of the
+	// true value, for the full range of std::uint64_t, without ever allocating.
+	template<std::size_t VSubBucketBits = 4>
+	class Histogram
+	{
+	public:
+		static constexpr std::size_t SubBucketCount = std::size_t{ 1 } << VSubBucketBits;
+		static constexpr std::size_t BucketCount = (64 - VSubBucketBits + 1) * SubBucketCount;
+
+		constexpr void Record(this Histogram& self, std::uint64_t value) noexcept
+		{
+			self.buckets[BucketIndex(value)]++;
+			self.count++;
+			self.max = std::max(self.max, value);
+		}
+
+		constexpr void Reset(this Histogram& self) noexcept
+		{
+			self = Histogram{};
+		}
+
+		// p is in the range [0, 1]. Returns the upper bound of the bucket containing the
+		// requested rank, clamped to the largest recorded value.
+		constexpr auto Percentile(this const Histogram& self, double p) noexcept -> std::uint64_t
+		{
+			if (self.count == 0)
+				return 0;
+			auto rank = static_cast<std::uint64_t>(std::clamp(p, 0.0, 1.0) * static_cast<double>(self.count));
+			rank = std::max<std::uint64_t>(rank, 1);
+			auto seen = std::uint64_t{};
+			for (std::size_t i = 0; i < BucketCount; ++i)
+			{
+				seen += self.buckets[i];
+				if (seen >= rank)
+					return std::min(BucketUpperBound(i), self.max);
+			}
+			return self.max;
+		}
+
+		constexpr auto Count(this const Histogram& self) noexcept -> std::uint64_t
+		{
+			return self.count;
+		}
+
+		constexpr auto Max(this const Histogram& self) noexcept -> std::uint64_t
+		{
+			return self.max;
+		}
+
+		static constexpr auto BucketIndex(std::uint64_t value) noexcept -> std::size_t
+		{
+			if (value < SubBucketCount)
+				return static_cast<std::size_t>(value);
+			auto shift = static_cast<std::size_t>(std::bit_width(value)) - 1 - VSubBucketBits;
+			auto subBucket = static_cast<std::size_t>(value >> shift) & (SubBucketCount - 1);
+			return (shift + 1) * SubBucketCount + subBucket;
+		}
+
+		static constexpr auto BucketUpperBound(std::size_t index) noexcept -> std::uint64_t
+		{
+			if (index < SubBucketCount)
+				return index;
+			auto shift = index / SubBucketCount - 1;
+			auto subBucket = index % SubBucketCount;
+			auto lower = std::uint64_t{ SubBucketCount + subBucket } << shift;
+			return lower + ((std::uint64_t{ 1 } << shift) - 1);
+		}
+
+	private:
+		std::array<std::uint32_t, BucketCount> buckets{};
+		std::uint64_t count = 0;
+		std::uint64_t max = 0;
+	};
+
+	static_assert(Histogram<>::BucketIndex(std::numeric_limits<std::uint64_t>::max()) == Histogram<>::BucketCount - 1);
+	static_assert(Histogram<>::BucketUpperBound(Histogram<>::BucketCount - 1) == std::numeric_limits<std::uint64_t>::max());
+}
+
+namespace
+{
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			auto histogram = Profiling::Histogram<>{};
+			for (std::uint64_t i = 1; i <= 100; ++i)
+				histogram.Record(i * 100);
+			if (histogram.Max() != 10'000 or histogram.Count() != 100)
+				throw std::exception{ "Unexpected max or count" };
+			// Within the bucket resolution of 1/16th.
+			auto p50 = histogram.Percentile(0.5);
+			if (p50 < 5000 or p50 > 5000 + 5000 / 16)
+				throw std::exception{ "p50 out of range" };
+			auto p99 = histogram.Percentile(0.99);
+			if (p99 < 9900 or p99 > 9900 + 9900 / 16)
+				throw std::exception{ "p99 out of range" };
+			if (histogram.Percentile(1.0) != 10'000)
+				throw std::exception{ "p100 should be the max" };
+		},
+		[] {
+			auto histogram = Profiling::Histogram<>{};
+			histogram.Record(3);
+			histogram.Reset();
+			if (histogram.Count() != 0 or histogram.Percentile(0.5) != 0)
+				throw std::exception{ "Expected an empty histogram after reset" };
+		}
+	};
+}
@@ -0,0 +1,4 @@
+export module shared:profiling;
+export import :profiling.cpu;
+export import :profiling.gpu;
+export import :profiling.histogram;
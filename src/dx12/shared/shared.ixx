@@ -7,6 +7,9 @@ export import :error;
 export import :strings;
 export import :log;
 export import :util;
+export import :util.inplacefunction;
+export import :util.perfecthash;
 export import :async;
 export import :raii;
 export import :concepts;
+export import :profiling;
@@ -1,81 +1,125 @@
 export module shared:strings.conversion;
 import std;
-import :win32;
-import :error;
+import :strings.utf;
+import :strings.inplace;
+
+namespace Strings::Detail
+{
+	// Below this much spare capacity, keeping it is cheaper than reallocating.
+	constexpr std::size_t MaxConversionSlack = 256;
+
+	// Makes a single pass into a buffer sized for the worst case, replacing ill-formed
+	// input with U+FFFD, as WideCharToMultiByte() and MultiByteToWideChar() did.
+	template<typename TString, typename TFrom>
+	void ConvertInto(std::basic_string_view<TFrom> from, TString& to)
+	{
+		using TTo = typename TString::value_type;
+		to.resize_and_overwrite(
+			Utf::Detail::MaxLength<TFrom, TTo>(from.size()),
+			[from](TTo* buffer, std::size_t size)
+			{
+				return Utf::Detail::Transcode(from, std::span{ buffer, size }, Utf::OnInvalid::Replace).Written;
+			});
+		// Narrowing reserves three bytes per UTF-16 unit, so mostly ASCII text would keep
+		// up to two thirds of its buffer spare. Strings from a pmr resource are left alone,
+		// as a monotonic resource would keep both buffers.
+		if constexpr (not std::same_as<typename TString::allocator_type, std::pmr::polymorphic_allocator<TTo>>)
+		{
+			if (to.capacity() - to.size() > std::max(to.size(), MaxConversionSlack))
+				to.shrink_to_fit();
+		}
+	}
+}
 
 export namespace Strings
 {
 	auto ConvertString(std::wstring_view wstr) -> std::string
 	{
-		if (wstr.empty())
-			return {};
+		auto strTo = std::string{};
+		Detail::ConvertInto(wstr, strTo);
+		return strTo;
+	}
 
-		// https://docs.microsoft.com/en-us/windows/win32/api/stringapiset/nf-stringapiset-widechartomultibyte
-		// Returns the size in bytes, this differs from MultiByteToWideChar, which returns the size in characters
-		const auto sizeInBytes = int{
-			Win32::WideCharToMultiByte(
-				Win32::CodePages::Utf8,							// CodePage
-				Win32::WideCharOptions::NoBestFitChars,			// dwFlags 
-				wstr.data(),									// lpWideCharStr
-				static_cast<int>(wstr.size()),					// cchWideChar 
-				nullptr,										// lpMultiByteStr
-				0,												// cbMultiByte
-				nullptr,										// lpDefaultChar
-				nullptr											// lpUsedDefaultChar
-			) };
-		if (sizeInBytes == 0)
-			throw Error::Win32Error{ Win32::GetLastError(), "WideCharToMultiByte() [1] failed" };
+	auto ConvertString(std::string_view str) -> std::wstring
+	{
+		auto wstrTo = std::wstring{};
+		Detail::ConvertInto(str, wstrTo);
+		return wstrTo;
+	}
 
-		auto strTo = std::string(sizeInBytes / sizeof(char), '\0');
-		const auto status = int{
-			Win32::WideCharToMultiByte(
-				Win32::CodePages::Utf8,							// CodePage
-				Win32::WideCharOptions::NoBestFitChars,			// dwFlags 
-				wstr.data(),									// lpWideCharStr
-				static_cast<int>(wstr.size()),					// cchWideChar 
-				strTo.data(),									// lpMultiByteStr
-				static_cast<int>(strTo.size() * sizeof(char)),	// cbMultiByte
-				nullptr,										// lpDefaultChar
-				nullptr											// lpUsedDefaultChar
-			) };
-		if (status == 0)
-			throw Error::Win32Error{ Win32::GetLastError(), "WideCharToMultiByte() [2] failed" };
+	// The overloads below never allocate, for hot paths such as naming resources.
 
-		return strTo;
+	// Converts into caller provided storage. If it's too small, it holds the whole
+	// characters that fitted and the result is OutputTooSmall.
+	auto ConvertString(std::wstring_view wstr, std::span<char> out) noexcept -> Utf::TranscodeResult
+	{
+		return Utf::Utf16ToUtf8(wstr, out, Utf::OnInvalid::Replace);
 	}
 
-	auto ConvertString(std::string_view str) -> std::wstring
+	auto ConvertString(std::string_view str, std::span<wchar_t> out) noexcept -> Utf::TranscodeResult
+	{
+		return Utf::Utf8ToUtf16(str, out, Utf::OnInvalid::Replace);
+	}
+
+	template<std::size_t VCapacity>
+	auto ConvertString(std::wstring_view wstr, InplaceString<char, VCapacity>& out) noexcept -> Utf::TranscodeResult
 	{
-		if (str.empty())
-			return {};
+		auto result = Utf::TranscodeResult{};
+		out.Overwrite([&](std::span<char, VCapacity> buffer) { return (result = ConvertString(wstr, buffer)).Written; });
+		return result;
+	}
 
-		// https://docs.microsoft.com/en-us/windows/win32/api/stringapiset/nf-stringapiset-multibytetowidechar
-		// Returns the size in characters, this differs from WideCharToMultiByte, which returns the size in bytes
-		const auto sizeInCharacters = int{
-			Win32::MultiByteToWideChar(
-				Win32::CodePages::Utf8,									// CodePage
-				0,											// dwFlags
-				str.data(),									// lpMultiByteStr
-				static_cast<int>(str.size() * sizeof(char)),// cbMultiByte
-				nullptr,									// lpWideCharStr
-				0											// cchWideChar
-			) };
-		if (sizeInCharacters == 0)
-			throw Error::Win32Error{ Win32::GetLastError(), "MultiByteToWideChar() [1] failed" };
+	template<std::size_t VCapacity>
+	auto ConvertString(std::string_view str, InplaceString<wchar_t, VCapacity>& out) noexcept -> Utf::TranscodeResult
+	{
+		auto result = Utf::TranscodeResult{};
+		out.Overwrite([&](std::span<wchar_t, VCapacity> buffer) { return (result = ConvertString(str, buffer)).Written; });
+		return result;
+	}
 
-		auto wstrTo = std::wstring(sizeInCharacters, '\0');
-		const auto status = int{
-			Win32::MultiByteToWideChar(
-				Win32::CodePages::Utf8,						// CodePage
-				0,											// dwFlags
-				str.data(),									// lpMultiByteStr
-				static_cast<int>(str.size() * sizeof(char)),	// cbMultiByte
-				wstrTo.data(),								// lpWideCharStr
-				static_cast<int>(wstrTo.size())				// cchWideChar
-			) };
-		if (status == 0)
-			throw Error::Win32Error{ Win32::GetLastError(), "MultiByteToWideChar() [2] failed" };
+	// Allocates from resource, such as a monotonic_buffer_resource over a stack buffer.
+	auto ConvertString(std::wstring_view wstr, std::pmr::memory_resource* resource) -> std::pmr::string
+	{
+		auto strTo = std::pmr::string{ resource };
+		Detail::ConvertInto(wstr, strTo);
+		return strTo;
+	}
 
+	auto ConvertString(std::string_view str, std::pmr::memory_resource* resource) -> std::pmr::wstring
+	{
+		auto wstrTo = std::pmr::wstring{ resource };
+		Detail::ConvertInto(str, wstrTo);
 		return wstrTo;
 	}
+
+	// Formats a wide string as UTF-8, converting it a block at a time straight into the
+	// output rather than into a temporary string first.
+	struct Narrowed
+	{
+		std::wstring_view Text;
+	};
 }
+
+template<>
+struct std::formatter<Strings::Narrowed, char>
+{
+	constexpr auto parse(std::format_parse_context& ctx) -> std::format_parse_context::iterator
+	{
+		if (ctx.begin() != ctx.end() and *ctx.begin() != '}')
+			throw std::format_error{ "Strings::Narrowed takes no format spec" };
+		return ctx.begin();
+	}
+
+	auto format(const Strings::Narrowed& narrowed, std::format_context& ctx) const -> std::format_context::iterator
+	{
+		auto out = ctx.out();
+		auto buffer = std::array<char, 256>{};
+		for (auto text = narrowed.Text; not text.empty();)
+		{
+			auto result = Strings::ConvertString(text, std::span<char>{ buffer });
+			out = std::ranges::copy(buffer.data(), buffer.data() + result.Written, out).out;
+			text.remove_prefix(result.Read);
+		}
+		return out;
+	}
+};
@@ -7,6 +7,24 @@ export namespace Strings
 	template<typename T>
 	concept ValidCharType = std::same_as<T, char> or std::same_as<T, wchar_t>;
 
+	// 64-bit FNV-1a. Wide characters are hashed a byte at a time, low byte first, so that
+	// a hash is the same whatever the platform's byte order.
+	template<ValidCharType TChar>
+	constexpr auto Fnv1a(std::basic_string_view<TChar> str) noexcept -> std::uint64_t
+	{
+		auto hash = std::uint64_t{ 0xCBF29CE484222325ull };
+		for (auto c : str)
+		{
+			auto value = static_cast<std::make_unsigned_t<TChar>>(c);
+			for (std::size_t byte = 0; byte < sizeof(TChar); ++byte)
+			{
+				hash ^= (value >> (byte * 8)) & 0xFF;
+				hash *= 0x100000001B3ull;
+			}
+		}
+		return hash;
+	}
+
 	template <ValidCharType TChar, size_t N>
 	struct FixedString
 	{
@@ -56,6 +74,10 @@ export namespace Strings
 		[[nodiscard]]
 		constexpr auto Size() const noexcept -> size_t { return N - 1; }
 
+		// Matches Fnv1a() of the same string at runtime.
+		[[nodiscard]]
+		constexpr auto Hash() const noexcept -> std::uint64_t { return Fnv1a(ToView()); }
+
 		template<ValidCharType TChar2, std::size_t N2>
 		[[nodiscard]]
 		constexpr auto operator==(const FixedString<TChar2, N2> s) const -> bool
@@ -129,4 +151,9 @@ export namespace Strings
 	using FixedStringA = FixedString<char, N>;
 
 	static_assert((FixedString{ "Hello, " } + FixedString{ "world!" }) == "Hello, world!");
+	// The published FNV-1a test vectors.
+	static_assert(FixedString{ "" }.Hash() == 0xCBF29CE484222325ull);
+	static_assert(FixedString{ "a" }.Hash() == 0xAF63DC4C8601EC8Cull);
+	static_assert(FixedString{ "foobar" }.Hash() == 0x85944171F73967E8ull);
+	static_assert(FixedString{ L"foobar" }.Hash() == Fnv1a(std::wstring_view{ L"foobar" }));
 }
@@ -0,0 +1,94 @@
+export module shared:strings.inplace;
+import std;
+import :util;
+
+export namespace Strings
+{
+	// A string with a fixed capacity, stored inline, so that building one never allocates.
+	// It's always null terminated, so Data() can be passed straight to Win32 and D3D12
+	// functions that take C strings, such as SetName().
+	template<typename TChar, std::size_t VCapacity>
+	class InplaceString
+	{
+	public:
+		using View = std::basic_string_view<TChar>;
+
+		static constexpr std::size_t Capacity = VCapacity;
+
+		constexpr InplaceString() noexcept = default;
+
+		[[nodiscard]]
+		constexpr auto Data(this const InplaceString& self) noexcept -> const TChar*
+		{
+			return self.buffer.data();
+		}
+
+		[[nodiscard]]
+		constexpr auto Size(this const InplaceString& self) noexcept -> std::size_t
+		{
+			return self.size;
+		}
+
+		[[nodiscard]]
+		constexpr auto Empty(this const InplaceString& self) noexcept -> bool
+		{
+			return self.size == 0;
+		}
+
+		[[nodiscard]]
+		constexpr auto ToView(this const InplaceString& self) noexcept -> View
+		{
+			return { self.buffer.data(), self.size };
+		}
+
+		[[nodiscard]]
+		constexpr operator View(this const InplaceString& self) noexcept
+		{
+			return self.ToView();
+		}
+
+		[[nodiscard]]
+		constexpr auto operator==(this const InplaceString& self, View other) noexcept -> bool
+		{
+			return self.ToView() == other;
+		}
+
+		// Like std::basic_string::resize_and_overwrite(): fill is given the whole buffer,
+		// and returns how much of it it used.
+		template<typename TFill>
+			requires std::is_invocable_r_v<std::size_t, TFill, std::span<TChar, VCapacity>>
+		constexpr void Overwrite(this InplaceString& self, TFill&& fill)
+		{
+			self.size = std::min(std::invoke(std::forward<TFill>(fill), std::span<TChar, VCapacity>{ self.buffer.data(), VCapacity }), VCapacity);
+			self.buffer[self.size] = TChar{};
+		}
+
+		constexpr void Clear(this InplaceString& self) noexcept
+		{
+			self.size = 0;
+			self.buffer[0] = TChar{};
+		}
+
+	private:
+		std::array<TChar, VCapacity + 1> buffer{};
+		std::size_t size = 0;
+	};
+}
+
+namespace
+{
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			auto str = Strings::InplaceString<char, 8>{};
+			str.Overwrite([](std::span<char, 8> buffer) { buffer[0] = 'h'; buffer[1] = 'i'; return std::size_t{ 2 }; });
+			if (str != "hi" or str.Data()[2] != '\0')
+				throw std::exception{ "Expected an overwritten string to be null terminated" };
+			str.Overwrite([](std::span<char, 8>) { return std::size_t{ 100 }; });
+			if (str.Size() != 8)
+				throw std::exception{ "Expected an overwritten string to be clamped to its capacity" };
+			str.Clear();
+			if (not str.Empty() or str.Data()[0] != '\0')
+				throw std::exception{ "Expected a cleared string to be empty" };
+		}
+	};
+}
@@ -0,0 +1,248 @@
+export module shared:strings.intern;
+import std;
+
+export namespace Strings
+{
+	// A string interned in an InternPool. Ids from the same pool are equal exactly when
+	// their strings are, so they compare and hash as integers. 0 is always the empty string.
+	enum class InternId : std::uint32_t
+	{
+		Empty = 0
+	};
+
+	namespace Detail
+	{
+		struct InternPageIndex
+		{
+			std::size_t Page = 0;
+			std::size_t Offset = 0;
+		};
+
+		// Entries live in pages that double in size, the first holding 2^VFirstPageBits,
+		// so that pages never move once allocated and all 2^32 ids fit in a few dozen of them.
+		template<std::size_t VFirstPageBits>
+		constexpr auto FindInternPage(std::uint32_t id) noexcept -> InternPageIndex
+		{
+			auto index = static_cast<std::uint64_t>(id) + (std::uint64_t{ 1 } << VFirstPageBits);
+			auto page = static_cast<std::size_t>(std::bit_width(index)) - VFirstPageBits - 1;
+			return { page, static_cast<std::size_t>(index - (std::uint64_t{ 1 } << (page + VFirstPageBits))) };
+		}
+
+		static_assert(FindInternPage<10>(0).Page == 0 and FindInternPage<10>(0).Offset == 0);
+		static_assert(FindInternPage<10>(1023).Page == 0 and FindInternPage<10>(1023).Offset == 1023);
+		static_assert(FindInternPage<10>(1024).Page == 1 and FindInternPage<10>(1024).Offset == 0);
+		static_assert(FindInternPage<10>(3071).Page == 1 and FindInternPage<10>(3071).Offset == 2047);
+		static_assert(FindInternPage<10>(3072).Page == 2 and FindInternPage<10>(3072).Offset == 0);
+		static_assert(FindInternPage<10>(std::numeric_limits<std::uint32_t>::max()).Page == 22);
+	}
+
+	// Stores each distinct string once, null terminated, in arena blocks that are never
+	// freed or moved, and hands out a compact id for it.
+	//
+	// Interning a string that's already in the pool takes a shared lock on one of
+	// ShardCount shards, picked by the string's hash, so threads interning different
+	// names rarely touch the same lock and never block each other on hits. Only new
+	// strings take a shard's exclusive lock. Turning an id back into a view takes no
+	// lock at all: it's an atomic load of the page and an index into it.
+	//
+	// Views are valid for as long as the pool is. An id must reach the thread that views
+	// it through some synchronisation of its own, such as the queue it was sent on, as
+	// is the case for any other data.
+	//
+	// VMaxSize bounds Size(); it's only ever lowered to test a full pool.
+	template<typename TChar, std::uint32_t VMaxSize = std::numeric_limits<std::uint32_t>::max()>
+	class InternPool
+	{
+	public:
+		using View = std::basic_string_view<TChar>;
+
+		static constexpr std::size_t ShardCount = 16;
+		static constexpr std::size_t FirstPageBits = 10;
+		static constexpr std::size_t PageCount = 33 - FirstPageBits;
+		// Strings longer than this get a block of their own.
+		static constexpr std::size_t BlockSize = 16 * 1024;
+
+		InternPool()
+		{
+			EnsurePage(0)[0] = Entry{ EmptyString, 0 };
+		}
+
+		~InternPool()
+		{
+			for (auto& page : pages)
+				delete[] page.load(std::memory_order_relaxed);
+		}
+
+		InternPool(const InternPool&) = delete;
+		auto operator=(const InternPool&) -> InternPool& = delete;
+
+		auto Intern(this InternPool& self, View str) -> InternId
+		{
+			if (str.empty())
+				return InternId::Empty;
+
+			auto hash = std::hash<View>{}(str);
+			auto& shard = self.shards[(hash >> 7) % ShardCount];
+			{
+				auto lock = std::shared_lock{ shard.Mutex };
+				if (auto entry = shard.Ids.find(str); entry != shard.Ids.end())
+					return entry->second;
+			}
+
+			auto lock = std::unique_lock{ shard.Mutex };
+			if (auto entry = shard.Ids.find(str); entry != shard.Ids.end())
+				return entry->second;
+
+			// Everything that can throw happens before the id is reserved, so that a failure
+			// never leaves a hole in the ids. The map entry is added as a placeholder, which
+			// no one else can see under the exclusive lock, and removed again on failure. The
+			// characters stored for a refused string stay in the arena.
+			auto stored = shard.Store(str);
+			auto node = shard.Ids.try_emplace(View{ stored, str.size() }).first;
+			auto id = self.nextId.load(std::memory_order_relaxed);
+			auto* entry = static_cast<Entry*>(nullptr);
+			try
+			{
+				// The page for the id about to be reserved is allocated first. Losing the race
+				// for that id to another shard only means trying again with the next one.
+				do
+				{
+					if (id == VMaxSize)
+						throw std::length_error{ "The intern pool is out of ids" };
+					auto [page, offset] = Detail::FindInternPage<FirstPageBits>(id);
+					entry = self.EnsurePage(page) + offset;
+				} while (not self.nextId.compare_exchange_weak(id, id + 1, std::memory_order_relaxed));
+			}
+			catch (...)
+			{
+				shard.Ids.erase(node);
+				throw;
+			}
+
+			*entry = Entry{ stored, static_cast<std::uint32_t>(str.size()) };
+			node->second = static_cast<InternId>(id);
+			return node->second;
+		}
+
+		// The id of str if it's already been interned.
+		auto Find(this const InternPool& self, View str) -> std::optional<InternId>
+		{
+			if (str.empty())
+				return InternId::Empty;
+			auto hash = std::hash<View>{}(str);
+			auto& shard = self.shards[(hash >> 7) % ShardCount];
+			auto lock = std::shared_lock{ shard.Mutex };
+			if (auto entry = shard.Ids.find(str); entry != shard.Ids.end())
+				return entry->second;
+			return std::nullopt;
+		}
+
+		// The interned string, null terminated. id must have come from this pool.
+		[[nodiscard]]
+		auto ToView(this const InternPool& self, InternId id) noexcept -> View
+		{
+			auto [page, offset] = Detail::FindInternPage<FirstPageBits>(static_cast<std::uint32_t>(id));
+			const auto& entry = self.pages[page].load(std::memory_order_acquire)[offset];
+			return { entry.Data, entry.Size };
+		}
+
+		// How many distinct strings are in the pool, counting the empty string.
+		auto Size(this const InternPool& self) noexcept -> std::size_t
+		{
+			return self.nextId.load(std::memory_order_relaxed);
+		}
+
+		// The characters reserved for string storage, including the unused tails of blocks.
+		auto Capacity(this const InternPool& self) -> std::size_t
+		{
+			auto capacity = std::size_t{ 0 };
+			for (auto& shard : self.shards)
+			{
+				auto lock = std::shared_lock{ shard.Mutex };
+				capacity += shard.Capacity;
+			}
+			return capacity;
+		}
+
+	private:
+		struct Entry
+		{
+			const TChar* Data = nullptr;
+			std::uint32_t Size = 0;
+		};
+
+		struct Shard
+		{
+			mutable std::shared_mutex Mutex;
+			std::unordered_map<View, InternId> Ids;
+			std::vector<std::unique_ptr<TChar[]>> Blocks;
+			TChar* Next = nullptr;
+			std::size_t Remaining = 0;
+			std::size_t Capacity = 0;
+
+			auto Store(this Shard& self, View str) -> const TChar*
+			{
+				auto size = str.size() + 1;
+				auto destination = static_cast<TChar*>(nullptr);
+				if (size > BlockSize)
+				{
+					destination = self.Blocks.emplace_back(std::make_unique_for_overwrite<TChar[]>(size)).get();
+					self.Capacity += size;
+				}
+				else
+				{
+					if (size > self.Remaining)
+					{
+						self.Next = self.Blocks.emplace_back(std::make_unique_for_overwrite<TChar[]>(BlockSize)).get();
+						self.Remaining = BlockSize;
+						self.Capacity += BlockSize;
+					}
+					destination = self.Next;
+					self.Next += size;
+					self.Remaining -= size;
+				}
+				std::ranges::copy(str, destination);
+				destination[str.size()] = TChar{};
+				return destination;
+			}
+		};
+
+		static constexpr TChar EmptyString[1]{};
+
+		// Pages are allocated by whichever thread first needs them; the losers of a race
+		// to allocate the same page throw theirs away.
+		auto EnsurePage(this InternPool& self, std::size_t page) -> Entry*
+		{
+			auto& slot = self.pages[page];
+			if (auto existing = slot.load(std::memory_order_acquire))
+				return existing;
+			auto allocated = new Entry[std::size_t{ 1 } << (page + FirstPageBits)]{};
+			auto expected = static_cast<Entry*>(nullptr);
+			if (slot.compare_exchange_strong(expected, allocated, std::memory_order_acq_rel))
+				return allocated;
+			delete[] allocated;
+			return expected;
+		}
+
+		std::array<Shard, ShardCount> shards;
+		std::array<std::atomic<Entry*>, PageCount> pages{};
+		std::atomic<std::uint32_t> nextId = 1;
+	};
+
+	namespace Detail
+	{
+		inline auto Names = InternPool<char>{};
+	}
+
+	// Interns a resource, shader or debug name, or an asset path, in the process wide pool.
+	inline auto Intern(std::string_view name) -> InternId
+	{
+		return Detail::Names.Intern(name);
+	}
+
+	// The name for an id from Intern().
+	inline auto NameOf(InternId id) noexcept -> std::string_view
+	{
+		return Detail::Names.ToView(id);
+	}
+}
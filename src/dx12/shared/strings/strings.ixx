@@ -1,3 +1,7 @@
 export module shared:strings;
 export import :strings.conversion;
 export import :strings.fixed;
+export import :strings.inplace;
+export import :strings.intern;
+export import :strings.table;
+export import :strings.utf;
@@ -0,0 +1,140 @@
+export module shared:strings.table;
+import std;
+import :strings.fixed;
+import :util;
+import :util.perfecthash;
+
+export namespace Strings
+{
+	// Maps a fixed set of strings, known at compile time, to the ids 0 to Size - 1 in
+	// the order they're given. The keys are hashed with FNV-1a at compile time and laid
+	// out in a perfect hash table, so finding a runtime string costs one pass over it to
+	// hash it, one probe and one string compare, and never allocates.
+	template<FixedString...VKeys>
+	class FixedStringTable
+	{
+	public:
+		using CharType = std::common_type_t<typename decltype(VKeys)::CharType...>;
+		using View = std::basic_string_view<CharType>;
+		static_assert(sizeof...(VKeys) > 0, "A FixedStringTable needs at least one key");
+		static_assert((std::same_as<typename decltype(VKeys)::CharType, CharType> and ...), "FixedStringTable keys must all have the same character type");
+
+		static constexpr std::size_t Size = sizeof...(VKeys);
+		// Returned by Find() for strings that aren't keys.
+		static constexpr std::size_t NotFound = Size;
+
+		static constexpr auto Keys = std::array<View, Size>{ VKeys.ToView()... };
+		static constexpr auto Hashes = std::array<std::uint64_t, Size>{ VKeys.Hash()... };
+
+		using Table = Util::PerfectHashTable<Hashes, Util::Mix64>;
+
+		// The id of key, or NotFound.
+		[[nodiscard]]
+		static constexpr auto Find(View key) noexcept -> std::size_t
+		{
+			auto slot = Table::Find(Fnv1a(key));
+			if (slot == Table::SlotCount)
+				return NotFound;
+			// A hash match alone could be a collision with a string outside the set.
+			auto id = Ids[slot];
+			return Keys[id] == key ? id : NotFound;
+		}
+
+		[[nodiscard]]
+		static constexpr auto Contains(View key) noexcept -> bool
+		{
+			return Find(key) != NotFound;
+		}
+
+		// The id of a key known at compile time; naming a string that isn't a key won't compile.
+		template<FixedString VKey>
+		[[nodiscard]]
+		static consteval auto IdOf() noexcept -> std::size_t
+		{
+			constexpr auto id = Find(VKey.ToView());
+			static_assert(id != NotFound, "The string isn't one of the table's keys");
+			return id;
+		}
+
+	private:
+		static constexpr auto Ids = []
+		{
+			auto ids = std::array<std::size_t, Table::SlotCount>{};
+			for (std::size_t id = 0; id < Size; ++id)
+				ids[Table::Slot(Hashes[id])] = id;
+			return ids;
+		}();
+	};
+
+	// A FixedStringTable with a value for each key, for lookups by names such as shader
+	// entry points, command line switches or config keys. Keys known at compile time are
+	// resolved to the value's index with no hashing at runtime at all.
+	template<typename TValue, FixedString...VKeys>
+	class FixedStringMap
+	{
+	public:
+		using Keys = FixedStringTable<VKeys...>;
+		using View = typename Keys::View;
+
+		constexpr FixedStringMap() = default;
+
+		constexpr FixedStringMap(std::array<TValue, Keys::Size> values)
+			: values(std::move(values))
+		{ }
+
+		template<FixedString VKey>
+		[[nodiscard]]
+		constexpr auto Get(this auto& self) noexcept -> auto&
+		{
+			return self.values[Keys::template IdOf<VKey>()];
+		}
+
+		// nullptr if key isn't one of the map's keys.
+		[[nodiscard]]
+		constexpr auto Find(this auto& self, View key) noexcept -> auto*
+		{
+			auto id = Keys::Find(key);
+			return id != Keys::NotFound ? &self.values[id] : nullptr;
+		}
+
+		[[nodiscard]]
+		constexpr auto Values(this auto& self) noexcept -> auto&
+		{
+			return self.values;
+		}
+
+	private:
+		std::array<TValue, Keys::Size> values{};
+	};
+}
+
+namespace
+{
+	using TestTable = Strings::FixedStringTable<"VSMain", "PSMain", "CSMain", "GSMain", "HSMain", "DSMain">;
+	static_assert(TestTable::Find("VSMain") == 0);
+	static_assert(TestTable::Find("DSMain") == 5);
+	static_assert(TestTable::Find("MSMain") == TestTable::NotFound);
+	static_assert(TestTable::Find("") == TestTable::NotFound);
+	static_assert(TestTable::IdOf<"CSMain">() == 2);
+	static_assert(Strings::FixedStringTable<L"a", L"b">::Find(L"b") == 1);
+
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			using Table = TestTable;
+			for (std::size_t id = 0; id < Table::Size; ++id)
+				if (Table::Find(Table::Keys[id]) != id)
+					throw std::exception{ "Expected every key to be found with its own id" };
+			// Same length and prefix as a key, and a key with a trailing null.
+			if (Table::Contains("VSMaim") or Table::Contains(std::string_view{ "VSMain", 7 }))
+				throw std::exception{ "Expected strings that aren't keys not to be found" };
+		},
+		[] {
+			auto map = Strings::FixedStringMap<int, "width", "height">{ { 1280, 720 } };
+			map.Get<"height">() = 1080;
+			if (map.Get<"width">() != 1280 or *map.Find("height") != 1080)
+				throw std::exception{ "Expected the map to find its values" };
+			if (map.Find("depth") != nullptr)
+				throw std::exception{ "Expected the map not to find a missing key" };
+		}
+	};
+}
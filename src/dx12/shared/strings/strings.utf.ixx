@@ -0,0 +1,561 @@
+module;
+
+// Define SHARED_UTF_SCALAR to build the ASCII fast paths without SIMD.
+#if not defined(SHARED_UTF_SCALAR)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SHARED_UTF_AVX2
+#define SHARED_UTF_SSE2
+#elif defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SHARED_UTF_SSE2
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SHARED_UTF_NEON
+#endif
+#endif
+
+export module shared:strings.utf;
+import std;
+import :util;
+
+export namespace Strings::Utf
+{
+	enum class Simd
+	{
+		Scalar,
+		Sse2,
+		Avx2,
+		Neon
+	};
+
+	// The instruction set the ASCII fast paths were built for.
+	constexpr auto SimdLevel =
+#if defined(SHARED_UTF_AVX2)
+		Simd::Avx2;
+#elif defined(SHARED_UTF_SSE2)
+		Simd::Sse2;
+#elif defined(SHARED_UTF_NEON)
+		Simd::Neon;
+#else
+		Simd::Scalar;
+#endif
+
+	// char16_t, and wchar_t where it's UTF-16.
+	template<typename TChar>
+	concept Utf16CodeUnit = std::integral<TChar> and sizeof(TChar) == 2;
+
+	enum class Status : std::uint8_t
+	{
+		Ok,
+		// The input has an ill-formed sequence starting at Read.
+		Invalid,
+		// The input ends partway through a sequence starting at Read.
+		Incomplete,
+		// The output filled up. Read and Written only ever cover whole characters.
+		OutputTooSmall
+	};
+
+	enum class OnInvalid : std::uint8_t
+	{
+		Fail,
+		// Each maximal ill-formed subsequence becomes U+FFFD, as it does with
+		// MultiByteToWideChar() and WideCharToMultiByte().
+		Replace
+	};
+
+	struct TranscodeResult
+	{
+		Status Code = Status::Ok;
+		std::size_t Read = 0;
+		std::size_t Written = 0;
+
+		constexpr explicit operator bool() const noexcept
+		{
+			return Code == Status::Ok;
+		}
+	};
+
+	constexpr auto ReplacementCharacter = char32_t{ 0xFFFD };
+
+	// Worst case output sizes, so that a conversion into a buffer this big never runs
+	// out of room. Both are reached: every UTF-8 byte can be ASCII, and every UTF-16
+	// unit can be a BMP character, or a lone surrogate replaced, taking three bytes.
+	constexpr auto MaxUtf16Length(std::size_t utf8Length) noexcept -> std::size_t
+	{
+		return utf8Length;
+	}
+
+	constexpr auto MaxUtf8Length(std::size_t utf16Length) noexcept -> std::size_t
+	{
+		return utf16Length * 3;
+	}
+
+	namespace Detail
+	{
+		struct Decoded
+		{
+			char32_t CodePoint = 0;
+			// The units the character, or the maximal ill-formed subsequence, spans.
+			std::uint8_t Length = 0;
+			Status Code = Status::Ok;
+		};
+
+		// Validates against the well-formed byte sequences in table 3-7 of the Unicode
+		// standard, which rules out overlong forms, surrogates and anything past U+10FFFF.
+		constexpr auto DecodeUtf8(std::string_view in, std::size_t at) noexcept -> Decoded
+		{
+			auto lead = static_cast<std::uint8_t>(in[at]);
+			if (lead < 0x80)
+				return { lead, 1 };
+
+			auto length = std::uint8_t{};
+			auto codePoint = char32_t{};
+			auto low = std::uint8_t{ 0x80 };
+			auto high = std::uint8_t{ 0xBF };
+			if (lead >= 0xC2 and lead <= 0xDF)
+			{
+				length = 2;
+				codePoint = lead & 0x1F;
+			}
+			else if (lead >= 0xE0 and lead <= 0xEF)
+			{
+				length = 3;
+				codePoint = lead & 0x0F;
+				if (lead == 0xE0)
+					low = 0xA0;
+				else if (lead == 0xED)
+					high = 0x9F;
+			}
+			else if (lead >= 0xF0 and lead <= 0xF4)
+			{
+				length = 4;
+				codePoint = lead & 0x07;
+				if (lead == 0xF0)
+					low = 0x90;
+				else if (lead == 0xF4)
+					high = 0x8F;
+			}
+			else
+			{
+				return { 0, 1, Status::Invalid };
+			}
+
+			for (std::uint8_t i = 1; i < length; ++i)
+			{
+				if (at + i == in.size())
+					return { 0, i, Status::Incomplete };
+				auto next = static_cast<std::uint8_t>(in[at + i]);
+				if (next < low or next > high)
+					return { 0, i, Status::Invalid };
+				codePoint = codePoint << 6 | (next & 0x3F);
+				low = 0x80;
+				high = 0xBF;
+			}
+			return { codePoint, length };
+		}
+
+		template<Utf16CodeUnit TChar>
+		constexpr auto DecodeUtf16(std::basic_string_view<TChar> in, std::size_t at) noexcept -> Decoded
+		{
+			auto unit = static_cast<char16_t>(in[at]);
+			if (unit < 0xD800 or unit > 0xDFFF)
+				return { unit, 1 };
+			if (unit > 0xDBFF)
+				return { 0, 1, Status::Invalid };
+			if (at + 1 == in.size())
+				return { 0, 1, Status::Incomplete };
+			auto trail = static_cast<char16_t>(in[at + 1]);
+			if (trail < 0xDC00 or trail > 0xDFFF)
+				return { 0, 1, Status::Invalid };
+			return { 0x10000 + ((char32_t{ unit } - 0xD800) << 10 | (char32_t{ trail } - 0xDC00)), 2 };
+		}
+
+		constexpr auto Utf8Length(char32_t codePoint) noexcept -> std::size_t
+		{
+			return codePoint < 0x80 ? 1 : codePoint < 0x800 ? 2 : codePoint < 0x10000 ? 3 : 4;
+		}
+
+		constexpr auto Utf16Length(char32_t codePoint) noexcept -> std::size_t
+		{
+			return codePoint < 0x10000 ? 1 : 2;
+		}
+
+		constexpr void EncodeUtf8(char32_t codePoint, char* out) noexcept
+		{
+			switch (Utf8Length(codePoint))
+			{
+				case 1:
+					out[0] = static_cast<char>(codePoint);
+					break;
+				case 2:
+					out[0] = static_cast<char>(0xC0 | codePoint >> 6);
+					out[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+					break;
+				case 3:
+					out[0] = static_cast<char>(0xE0 | codePoint >> 12);
+					out[1] = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+					out[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+					break;
+				default:
+					out[0] = static_cast<char>(0xF0 | codePoint >> 18);
+					out[1] = static_cast<char>(0x80 | (codePoint >> 12 & 0x3F));
+					out[2] = static_cast<char>(0x80 | (codePoint >> 6 & 0x3F));
+					out[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+					break;
+			}
+		}
+
+		template<Utf16CodeUnit TChar>
+		constexpr void EncodeUtf16(char32_t codePoint, TChar* out) noexcept
+		{
+			if (codePoint < 0x10000)
+			{
+				out[0] = static_cast<TChar>(codePoint);
+				return;
+			}
+			codePoint -= 0x10000;
+			out[0] = static_cast<TChar>(0xD800 | codePoint >> 10);
+			out[1] = static_cast<TChar>(0xDC00 | (codePoint & 0x3FF));
+		}
+
+		// Copies the leading run of ASCII from in to out, widening each byte, and returns
+		// its length. Whole blocks are stored even when they end in other characters, so
+		// out may be written past the returned length, though never past room.
+		template<Utf16CodeUnit TChar>
+		auto WidenAscii(const char* in, std::size_t size, TChar* out, std::size_t room) noexcept -> std::size_t
+		{
+			auto count = std::min(size, room);
+			auto done = std::size_t{};
+#if defined(SHARED_UTF_AVX2)
+			for (; count - done >= 32; done += 32)
+			{
+				auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + done));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + done), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(block)));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + done + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(block, 1)));
+				if (auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(block)))
+					return done + std::countr_zero(mask);
+			}
+#endif
+#if defined(SHARED_UTF_SSE2)
+			for (; count - done >= 16; done += 16)
+			{
+				auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + done), _mm_unpacklo_epi8(block, _mm_setzero_si128()));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + done + 8), _mm_unpackhi_epi8(block, _mm_setzero_si128()));
+				if (auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(block)))
+					return done + std::countr_zero(mask);
+			}
+#elif defined(SHARED_UTF_NEON)
+			for (; count - done >= 16; done += 16)
+			{
+				auto block = vld1q_u8(reinterpret_cast<const std::uint8_t*>(in + done));
+				if (vmaxvq_u8(block) >= 0x80)
+					break;
+				vst1q_u16(reinterpret_cast<std::uint16_t*>(out + done), vmovl_u8(vget_low_u8(block)));
+				vst1q_u16(reinterpret_cast<std::uint16_t*>(out + done + 8), vmovl_u8(vget_high_u8(block)));
+			}
+#endif
+			for (; done < count and static_cast<std::uint8_t>(in[done]) < 0x80; ++done)
+				out[done] = static_cast<TChar>(in[done]);
+			return done;
+		}
+
+		// Copies the leading run of ASCII from in to out, narrowing each unit, and returns
+		// its length.
+		template<Utf16CodeUnit TChar>
+		auto NarrowAscii(const TChar* in, std::size_t size, char* out, std::size_t room) noexcept -> std::size_t
+		{
+			auto count = std::min(size, room);
+			auto done = std::size_t{};
+#if defined(SHARED_UTF_AVX2)
+			for (; count - done >= 32; done += 32)
+			{
+				auto first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + done));
+				auto second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + done + 16));
+				if (not _mm256_testz_si256(_mm256_or_si256(first, second), _mm256_set1_epi16(static_cast<short>(0xFF80))))
+					break;
+				// Packing works within 128-bit lanes, so the middle quarters come out swapped.
+				auto packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), 0b11'01'10'00);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + done), packed);
+			}
+#endif
+#if defined(SHARED_UTF_SSE2)
+			for (; count - done >= 16; done += 16)
+			{
+				auto first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done));
+				auto second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + done + 8));
+				auto high = _mm_and_si128(_mm_or_si128(first, second), _mm_set1_epi16(static_cast<short>(0xFF80)));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF)
+					break;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + done), _mm_packus_epi16(first, second));
+			}
+#elif defined(SHARED_UTF_NEON)
+			for (; count - done >= 16; done += 16)
+			{
+				auto first = vld1q_u16(reinterpret_cast<const std::uint16_t*>(in + done));
+				auto second = vld1q_u16(reinterpret_cast<const std::uint16_t*>(in + done + 8));
+				if (vmaxvq_u16(vorrq_u16(first, second)) >= 0x80)
+					break;
+				vst1q_u8(reinterpret_cast<std::uint8_t*>(out + done), vcombine_u8(vmovn_u16(first), vmovn_u16(second)));
+			}
+#endif
+			for (; done < count and static_cast<char16_t>(in[done]) < 0x80; ++done)
+				out[done] = static_cast<char>(in[done]);
+			return done;
+		}
+	}
+
+	// Converts in a single pass, with runs of ASCII handled a SIMD block at a time and
+	// everything else decoded and validated a character at a time. Stops at the first
+	// ill-formed sequence unless told to replace them. The output past Written may have
+	// been overwritten. If in isn't the end of the input, a character cut off by the end
+	// of in is always left unread and reported as Incomplete, so that it can be finished
+	// by the next chunk.
+	template<Utf16CodeUnit TChar>
+	constexpr auto Utf8ToUtf16(std::string_view in, std::span<TChar> out, OnInvalid onInvalid = OnInvalid::Fail, bool endOfInput = true) noexcept -> TranscodeResult
+	{
+		auto read = std::size_t{};
+		auto written = std::size_t{};
+		while (read < in.size())
+		{
+			if (not std::is_constant_evaluated())
+			{
+				auto ascii = Detail::WidenAscii(in.data() + read, in.size() - read, out.data() + written, out.size() - written);
+				read += ascii;
+				written += ascii;
+				if (read == in.size())
+					break;
+			}
+
+			auto decoded = Detail::DecodeUtf8(in, read);
+			if (decoded.Code != Status::Ok)
+			{
+				if (onInvalid == OnInvalid::Fail or (decoded.Code == Status::Incomplete and not endOfInput))
+					return { decoded.Code, read, written };
+				decoded.CodePoint = ReplacementCharacter;
+			}
+			if (out.size() - written < Detail::Utf16Length(decoded.CodePoint))
+				return { Status::OutputTooSmall, read, written };
+			Detail::EncodeUtf16(decoded.CodePoint, out.data() + written);
+			read += decoded.Length;
+			written += Detail::Utf16Length(decoded.CodePoint);
+		}
+		return { Status::Ok, read, written };
+	}
+
+	template<Utf16CodeUnit TChar>
+	constexpr auto Utf16ToUtf8(std::basic_string_view<TChar> in, std::span<char> out, OnInvalid onInvalid = OnInvalid::Fail, bool endOfInput = true) noexcept -> TranscodeResult
+	{
+		auto read = std::size_t{};
+		auto written = std::size_t{};
+		while (read < in.size())
+		{
+			if (not std::is_constant_evaluated())
+			{
+				auto ascii = Detail::NarrowAscii(in.data() + read, in.size() - read, out.data() + written, out.size() - written);
+				read += ascii;
+				written += ascii;
+				if (read == in.size())
+					break;
+			}
+
+			auto decoded = Detail::DecodeUtf16(in, read);
+			if (decoded.Code != Status::Ok)
+			{
+				if (onInvalid == OnInvalid::Fail or (decoded.Code == Status::Incomplete and not endOfInput))
+					return { decoded.Code, read, written };
+				decoded.CodePoint = ReplacementCharacter;
+			}
+			if (out.size() - written < Detail::Utf8Length(decoded.CodePoint))
+				return { Status::OutputTooSmall, read, written };
+			Detail::EncodeUtf8(decoded.CodePoint, out.data() + written);
+			read += decoded.Length;
+			written += Detail::Utf8Length(decoded.CodePoint);
+		}
+		return { Status::Ok, read, written };
+	}
+
+	namespace Detail
+	{
+		template<typename TFrom, typename TTo>
+		concept TranscodablePair = (std::same_as<TFrom, char> and Utf16CodeUnit<TTo>) or (Utf16CodeUnit<TFrom> and std::same_as<TTo, char>);
+
+		template<typename TFrom, typename TTo>
+			requires TranscodablePair<TFrom, TTo>
+		constexpr auto MaxLength(std::size_t length) noexcept -> std::size_t
+		{
+			if constexpr (std::same_as<TFrom, char>)
+				return MaxUtf16Length(length);
+			else
+				return MaxUtf8Length(length);
+		}
+
+		template<typename TFrom, typename TTo>
+			requires TranscodablePair<TFrom, TTo>
+		constexpr auto Transcode(
+			std::basic_string_view<TFrom> in,
+			std::span<TTo> out,
+			OnInvalid onInvalid,
+			bool endOfInput = true
+		) noexcept -> TranscodeResult
+		{
+			if constexpr (std::same_as<TFrom, char>)
+				return Utf8ToUtf16(in, out, onInvalid, endOfInput);
+			else
+				return Utf16ToUtf8(in, out, onInvalid, endOfInput);
+		}
+	}
+
+	// Converts input that arrives in chunks, such as from a file or a pipe, replacing
+	// ill-formed sequences. A character split between chunks is held back until the next
+	// chunk finishes it, so the output is the same however the input is split up.
+	template<typename TFrom, typename TTo>
+		requires Detail::TranscodablePair<TFrom, TTo>
+	class StreamTranscoder
+	{
+	public:
+		// Converts chunk until it's used up or out is full. On OutputTooSmall, call again
+		// with the rest of chunk, from Read on, once there's room.
+		constexpr auto Convert(this StreamTranscoder& self, std::basic_string_view<TFrom> chunk, std::span<TTo> out) noexcept -> TranscodeResult
+		{
+			auto read = std::size_t{};
+			auto written = std::size_t{};
+			if (self.pendingSize > 0 and not chunk.empty())
+			{
+				// The held back units are a valid start to a character, so decoding them
+				// with the start of this chunk either finishes that character or fails
+				// somewhere past them.
+				auto joined = self.pending;
+				auto taken = std::min(chunk.size(), joined.size() - self.pendingSize);
+				std::copy_n(chunk.data(), taken, joined.data() + self.pendingSize);
+				auto result = Detail::Transcode(
+					std::basic_string_view<TFrom>{ joined.data(), self.pendingSize + taken },
+					out.first(std::min<std::size_t>(out.size(), joined.size())),
+					OnInvalid::Replace,
+					false);
+				if (result.Code == Status::Incomplete and result.Read == 0)
+				{
+					self.pending = joined;
+					self.pendingSize += taken;
+					return { Status::Ok, chunk.size(), 0 };
+				}
+				if (result.Read == 0)
+					return { Status::OutputTooSmall, 0, 0 };
+				read = result.Read - self.pendingSize;
+				written = result.Written;
+				self.pendingSize = 0;
+			}
+
+			auto result = Detail::Transcode(chunk.substr(read), out.subspan(written), OnInvalid::Replace, false);
+			if (result.Code == Status::Incomplete)
+			{
+				auto rest = chunk.substr(read + result.Read);
+				std::ranges::copy(rest, self.pending.begin());
+				self.pendingSize = rest.size();
+				return { Status::Ok, chunk.size(), written + result.Written };
+			}
+			return { result.Code, read + result.Read, written + result.Written };
+		}
+
+		// Call once the input has ended. A character still held back was cut off, and is
+		// replaced.
+		constexpr auto Finish(this StreamTranscoder& self, std::span<TTo> out) noexcept -> TranscodeResult
+		{
+			if (self.pendingSize == 0)
+				return {};
+			auto result = Detail::Transcode(std::basic_string_view<TFrom>{ self.pending.data(), self.pendingSize }, out, OnInvalid::Replace);
+			if (result)
+				self.pendingSize = 0;
+			return { result.Code, 0, result.Written };
+		}
+
+	private:
+		std::array<TFrom, 4> pending{};
+		std::size_t pendingSize = 0;
+	};
+
+	template<Utf16CodeUnit TChar>
+	using Utf8ToUtf16Stream = StreamTranscoder<char, TChar>;
+
+	template<Utf16CodeUnit TChar>
+	using Utf16ToUtf8Stream = StreamTranscoder<TChar, char>;
+}
+
+namespace
+{
+	constexpr auto Tests = Util::Overloaded{
+		[] {
+			auto out = std::array<char16_t, 8>{};
+			auto result = Strings::Utf::Utf8ToUtf16("a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80", std::span<char16_t>{ out });
+			if (not result or result.Read != 10 or std::u16string_view{ out.data(), result.Written } != u"a\u00E9\u20AC\U0001F600")
+				throw std::exception{ "Expected one to four byte sequences to be widened" };
+
+			auto narrow = std::array<char, 16>{};
+			result = Strings::Utf::Utf16ToUtf8(std::u16string_view{ u"a\u00E9\u20AC\U0001F600" }, std::span<char>{ narrow });
+			if (not result or std::string_view{ narrow.data(), result.Written } != "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80")
+				throw std::exception{ "Expected one to four byte sequences to be narrowed" };
+		},
+		[] {
+			auto out = std::array<char16_t, 8>{};
+			// An overlong NUL, an encoded surrogate and a code point past U+10FFFF.
+			for (auto invalid : { std::string_view{ "ab\xC0\x80" }, std::string_view{ "ab\xED\xA0\x80" }, std::string_view{ "ab\xF4\x90\x80\x80" } })
+			{
+				auto result = Strings::Utf::Utf8ToUtf16(invalid, std::span<char16_t>{ out });
+				if (result.Code != Strings::Utf::Status::Invalid or result.Read != 2 or result.Written != 2)
+					throw std::exception{ "Expected ill-formed UTF-8 to be rejected where it starts" };
+			}
+			if (Strings::Utf::Utf8ToUtf16("ab\xE2\x82", std::span<char16_t>{ out }).Code != Strings::Utf::Status::Incomplete)
+				throw std::exception{ "Expected a truncated sequence to be incomplete" };
+			if (Strings::Utf::Utf8ToUtf16("a\xF0\x9F\x98\x80", std::span<char16_t>{ out }.first(2)).Code != Strings::Utf::Status::OutputTooSmall)
+				throw std::exception{ "Expected a surrogate pair not to be split when the output is full" };
+		},
+		[] {
+			// Each maximal ill-formed subsequence is replaced on its own.
+			auto out = std::array<char16_t, 8>{};
+			auto result = Strings::Utf::Utf8ToUtf16("\xED\xA0\x80z\xE2\x82", std::span<char16_t>{ out }, Strings::Utf::OnInvalid::Replace);
+			if (not result or std::u16string_view{ out.data(), result.Written } != u"\uFFFD\uFFFD\uFFFDz\uFFFD")
+				throw std::exception{ "Expected ill-formed UTF-8 to be replaced" };
+
+			auto narrow = std::array<char, 8>{};
+			auto lone = std::array<char16_t, 2>{ 0xDC00, u'z' };
+			result = Strings::Utf::Utf16ToUtf8(std::u16string_view{ lone.data(), lone.size() }, std::span<char>{ narrow }, Strings::Utf::OnInvalid::Replace);
+			if (not result or std::string_view{ narrow.data(), result.Written } != "\xEF\xBF\xBDz")
+				throw std::exception{ "Expected a lone surrogate to be replaced" };
+			if (Strings::Utf::Utf16ToUtf8(std::u16string_view{ lone.data(), lone.size() }, std::span<char>{ narrow }).Code != Strings::Utf::Status::Invalid)
+				throw std::exception{ "Expected a lone surrogate to be rejected" };
+		},
+		[] {
+			// However the input is split, the output is the same as converting it in one go.
+			constexpr auto text = std::string_view{ "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xFFz\xE2\x82" };
+			for (std::size_t split = 0; split <= text.size(); ++split)
+			{
+				auto stream = Strings::Utf::Utf8ToUtf16Stream<char16_t>{};
+				auto out = std::array<char16_t, 16>{};
+				auto written = std::size_t{};
+				for (auto chunk : { text.substr(0, split), text.substr(split) })
+				{
+					auto result = stream.Convert(chunk, std::span<char16_t>{ out }.subspan(written));
+					if (not result or result.Read != chunk.size())
+						throw std::exception{ "Expected each chunk to be used up" };
+					written += result.Written;
+				}
+				written += stream.Finish(std::span<char16_t>{ out }.subspan(written)).Written;
+				if (std::u16string_view{ out.data(), written } != u"a\u00E9\u20AC\U0001F600\uFFFDz\uFFFD")
+					throw std::exception{ "Expected a split stream to convert as if it were whole" };
+			}
+		},
+		[] {
+			auto stream = Strings::Utf::Utf16ToUtf8Stream<char16_t>{};
+			auto pair = std::u16string_view{ u"\U0001F600" };
+			auto out = std::array<char, 8>{};
+			auto first = stream.Convert(pair.substr(0, 1), std::span<char>{ out });
+			// Too little room for the finished character, so it stays held back.
+			auto full = stream.Convert(pair.substr(1), std::span<char>{ out }.first(3));
+			auto second = stream.Convert(pair.substr(1), std::span<char>{ out });
+			if (first.Written != 0 or full.Code != Strings::Utf::Status::OutputTooSmall or not second or second.Read != 1
+				or std::string_view{ out.data(), second.Written } != "\xF0\x9F\x98\x80")
+				throw std::exception{ "Expected a surrogate pair split between chunks to be joined" };
+		}
+	};
+}
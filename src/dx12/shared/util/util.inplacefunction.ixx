@@ -0,0 +1,289 @@
+export module shared:util.inplacefunction;
+import std;
+import :error;
+
+export namespace Util
+{
+	template<typename TSignature, std::size_t VCapacity = 4 * sizeof(void*)>
+	class InplaceFunction;
+
+	// A move-only std::function replacement that stores its callable inline and never
+	// allocates. Callables that don't fit in VCapacity are rejected at compile time rather
+	// than spilling to the heap. Dispatch goes through a static table of function
+	// pointers per callable type, so no RTTI is needed.
+	template<typename TReturn, typename...TArgs, std::size_t VCapacity>
+	class InplaceFunction<TReturn(TArgs...), VCapacity>
+	{
+	public:
+		static constexpr std::size_t Capacity = VCapacity;
+
+		// Whether a callable of type T can be stored. Checked in the constraints, so that
+		// std::constructible_from and friends see oversized callables as unsupported.
+		template<typename T>
+		static constexpr bool Fits = sizeof(T) <= VCapacity
+			and alignof(T) <= alignof(std::max_align_t)
+			and std::is_nothrow_move_constructible_v<T>;
+
+		~InplaceFunction()
+		{
+			reset();
+		}
+
+		InplaceFunction() noexcept = default;
+
+		InplaceFunction(std::nullptr_t) noexcept { }
+
+		template<typename TFn>
+			requires (not std::same_as<std::remove_cvref_t<TFn>, InplaceFunction> and std::is_invocable_r_v<TReturn, std::decay_t<TFn>&, TArgs...> and Fits<std::decay_t<TFn>>)
+		InplaceFunction(TFn&& fn)
+		{
+			Emplace(std::forward<TFn>(fn));
+		}
+
+		InplaceFunction(const InplaceFunction&) = delete;
+		auto operator=(const InplaceFunction&) -> InplaceFunction& = delete;
+
+		InplaceFunction(InplaceFunction&& other) noexcept
+		{
+			MoveFrom(other);
+		}
+
+		auto operator=(this InplaceFunction& self, InplaceFunction&& other) noexcept -> InplaceFunction&
+		{
+			if (&self != &other)
+			{
+				self.reset();
+				self.MoveFrom(other);
+			}
+			return self;
+		}
+
+		template<typename TFn>
+			requires (not std::same_as<std::remove_cvref_t<TFn>, InplaceFunction> and std::is_invocable_r_v<TReturn, std::decay_t<TFn>&, TArgs...> and Fits<std::decay_t<TFn>>)
+		auto operator=(this InplaceFunction& self, TFn&& fn) -> InplaceFunction&
+		{
+			self.reset();
+			self.Emplace(std::forward<TFn>(fn));
+			return self;
+		}
+
+		auto operator=(this InplaceFunction& self, std::nullptr_t) noexcept -> InplaceFunction&
+		{
+			self.reset();
+			return self;
+		}
+
+		// Like std::function, the stored callable is invoked as non-const.
+		auto operator()(this const InplaceFunction& self, TArgs... args) -> TReturn
+		{
+			if (not self.vtable)
+				throw std::bad_function_call{};
+			return self.vtable->Invoke(self.storage, std::forward<TArgs>(args)...);
+		}
+
+		explicit operator bool(this const InplaceFunction& self) noexcept
+		{
+			return self.vtable != nullptr;
+		}
+
+		void reset(this InplaceFunction& self) noexcept
+		{
+			if (self.vtable)
+				std::exchange(self.vtable, nullptr)->Destroy(self.storage);
+		}
+
+	private:
+		struct VTable
+		{
+			TReturn(*Invoke)(void*, TArgs&&...);
+			void(*MoveTo)(void* from, void* to) noexcept;
+			void(*Destroy)(void*) noexcept;
+		};
+
+		template<typename T>
+		static constexpr VTable VTableFor{
+			.Invoke = [](void* target, TArgs&&...args) -> TReturn
+				{
+					return std::invoke_r<TReturn>(*static_cast<T*>(target), std::forward<TArgs>(args)...);
+				},
+			.MoveTo = [](void* from, void* to) noexcept
+				{
+					::new (to) T(std::move(*static_cast<T*>(from)));
+					static_cast<T*>(from)->~T();
+				},
+			.Destroy = [](void* target) noexcept
+				{
+					static_cast<T*>(target)->~T();
+				}
+		};
+
+		template<typename TFn>
+		void Emplace(this InplaceFunction& self, TFn&& fn)
+		{
+			using T = std::decay_t<TFn>;
+			::new (static_cast<void*>(self.storage)) T(std::forward<TFn>(fn));
+			self.vtable = &VTableFor<T>;
+		}
+
+		void MoveFrom(this InplaceFunction& self, InplaceFunction& other) noexcept
+		{
+			if (not other.vtable)
+				return;
+			other.vtable->MoveTo(other.storage, self.storage);
+			self.vtable = std::exchange(other.vtable, nullptr);
+		}
+
+		const VTable* vtable = nullptr;
+		alignas(std::max_align_t) mutable std::byte storage[VCapacity];
+	};
+
+	// A fixed number of subscribers, each held in an InplaceFunction, invoked in the order
+	// of the slots they occupy. Subscribing and notifying never allocate.
+	//
+	// Handlers may subscribe and unsubscribe while they're being notified. A notification
+	// calls the handlers that were subscribed when it started and haven't been unsubscribed
+	// since. Unsubscribed handlers are destroyed once the outermost notification returns,
+	// as they might still be running.
+	template<typename TSignature, std::size_t VMaxHandlers = 8, std::size_t VCapacity = 4 * sizeof(void*)>
+	class HandlerList;
+
+	template<typename...TArgs, std::size_t VMaxHandlers, std::size_t VCapacity>
+	class HandlerList<void(TArgs...), VMaxHandlers, VCapacity>
+	{
+		// Slots are tracked as bits of a mask.
+		static_assert(VMaxHandlers <= 64, "HandlerList is limited to 64 handlers");
+		using SlotMask = std::uint64_t;
+
+	public:
+		using Handler = InplaceFunction<void(TArgs...), VCapacity>;
+		using SubscriptionId = std::size_t;
+
+		template<typename TFn>
+			requires std::constructible_from<Handler, TFn>
+		auto Subscribe(this HandlerList& self, TFn&& fn) -> SubscriptionId
+		{
+			// Slots waiting to be cleared after a notification aren't free yet.
+			auto free = ~(self.live | self.removed) & AllSlots;
+			if (free == 0)
+				throw Error::RuntimeError{ std::format("HandlerList is limited to {} handlers", VMaxHandlers) };
+			auto id = static_cast<SubscriptionId>(std::countr_zero(free));
+			self.handlers[id] = std::forward<TFn>(fn);
+			self.live |= Slot(id);
+			return id;
+		}
+
+		void Unsubscribe(this HandlerList& self, SubscriptionId id) noexcept
+		{
+			if (id >= VMaxHandlers or not (self.live & Slot(id)))
+				return;
+			self.live &= ~Slot(id);
+			if (self.notifying > 0)
+				self.removed |= Slot(id);
+			else
+				self.handlers[id].reset();
+		}
+
+		void operator()(this HandlerList& self, TArgs... args)
+		{
+			auto scope = NotifyScope{ self };
+			// Walks the slots that were live when notifying started, skipping any that have
+			// been unsubscribed since.
+			for (auto pending = self.live; pending != 0; pending &= pending - 1)
+			{
+				auto id = static_cast<std::size_t>(std::countr_zero(pending));
+				if (not (self.live & Slot(id)))
+					continue;
+				// Arguments are passed as lvalues, so that every handler sees them unmoved.
+				self.handlers[id](args...);
+			}
+		}
+
+		auto Size(this const HandlerList& self) noexcept -> std::size_t
+		{
+			return static_cast<std::size_t>(std::popcount(self.live));
+		}
+
+		auto Empty(this const HandlerList& self) noexcept -> bool
+		{
+			return self.live == 0;
+		}
+
+	private:
+		static constexpr SlotMask AllSlots = VMaxHandlers == 64 ? ~SlotMask{} : (SlotMask{ 1 } << VMaxHandlers) - 1;
+
+		static constexpr auto Slot(std::size_t id) noexcept -> SlotMask
+		{
+			return SlotMask{ 1 } << id;
+		}
+
+		// Counts nested notifications, and destroys the handlers unsubscribed during them
+		// once the outermost one finishes, even if a handler threw.
+		struct NotifyScope
+		{
+			NotifyScope(HandlerList& list) noexcept
+				: list(list)
+			{
+				list.notifying++;
+			}
+
+			~NotifyScope()
+			{
+				if (--list.notifying > 0)
+					return;
+				for (auto removed = std::exchange(list.removed, 0); removed != 0; removed &= removed - 1)
+					list.handlers[static_cast<std::size_t>(std::countr_zero(removed))].reset();
+			}
+
+			NotifyScope(const NotifyScope&) = delete;
+			auto operator=(const NotifyScope&) -> NotifyScope& = delete;
+
+			HandlerList& list;
+		};
+
+		std::array<Handler, VMaxHandlers> handlers{};
+		// Slots holding a subscribed handler.
+		SlotMask live = 0;
+		// Slots unsubscribed during a notification, whose handlers are still to be destroyed.
+		SlotMask removed = 0;
+		std::uint32_t notifying = 0;
+	};
+}
+
+// Calling and notifying go through placement new and void pointer casts, which can't be
+// evaluated at compile time, so their tests run in the benchmarks' startup checks.
+namespace
+{
+	using TestFunction = Util::InplaceFunction<int(int), 16>;
+
+	struct TooLarge
+	{
+		auto operator()(int x) const -> int { return x; }
+		std::array<std::byte, 17> Bytes{};
+	};
+
+	struct alignas(2 * alignof(std::max_align_t)) TooAligned
+	{
+		auto operator()(int x) const -> int { return x; }
+	};
+
+	struct ThrowingMove
+	{
+		ThrowingMove() = default;
+		ThrowingMove(ThrowingMove&&) noexcept(false) { }
+		auto operator()(int x) const -> int { return x; }
+	};
+
+	struct Fitting
+	{
+		auto operator()(int x) const -> int { return x; }
+		std::array<std::byte, 16> Bytes{};
+	};
+
+	static_assert(std::constructible_from<TestFunction, Fitting> and std::is_assignable_v<TestFunction&, Fitting>);
+	static_assert(not std::constructible_from<TestFunction, TooLarge> and not std::is_assignable_v<TestFunction&, TooLarge>);
+	static_assert(not std::constructible_from<TestFunction, TooAligned>);
+	static_assert(not std::constructible_from<TestFunction, ThrowingMove>);
+	static_assert(not std::copy_constructible<TestFunction> and std::is_nothrow_move_constructible_v<TestFunction>);
+	static_assert(std::constructible_from<Util::HandlerList<void(int), 8, 16>::Handler, Fitting>);
+	static_assert(not std::constructible_from<Util::HandlerList<void(int), 8, 16>::Handler, TooLarge>);
+}
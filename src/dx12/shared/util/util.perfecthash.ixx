@@ -0,0 +1,145 @@
+export module shared:util.perfecthash;
+import std;
+
+export namespace Util
+{
+	// The murmur3 32-bit finaliser, salted with a seed.
+	constexpr auto Mix32(std::uint32_t key, std::uint32_t seed) noexcept -> std::uint32_t
+	{
+		auto hash = key ^ (seed * 0x9E3779B9u);
+		hash ^= hash >> 16;
+		hash *= 0x85EBCA6Bu;
+		hash ^= hash >> 13;
+		hash *= 0xC2B2AE35u;
+		hash ^= hash >> 16;
+		return hash;
+	}
+
+	// The murmur3 64-bit finaliser, salted with a seed.
+	constexpr auto Mix64(std::uint64_t key, std::uint32_t seed) noexcept -> std::uint64_t
+	{
+		auto hash = key ^ (seed * 0x9E3779B97F4A7C15ull);
+		hash ^= hash >> 33;
+		hash *= 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 33;
+		hash *= 0xC4CEB9FE1A85EC53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	namespace Detail
+	{
+		template<typename TKey, std::size_t VBucketCount, std::size_t VSlotCount>
+		struct PerfectHashLayout
+		{
+			std::array<std::uint32_t, VBucketCount> Seeds{};
+			std::array<TKey, VSlotCount> Keys{};
+		};
+
+		// Bounds the seed search for each bucket, well inside MSVC's default constexpr step
+		// limit. A bucket that runs out of seeds means the table is too full.
+		constexpr std::uint32_t MaxPerfectHashSeeds = 1 << 10;
+
+		// Hash and displace: keys are grouped into buckets by one hash, then each bucket,
+		// largest first, is given the first seed for which a second hash puts all of its
+		// keys into free slots.
+		template<auto VKeys, auto VMix, std::size_t VBucketCount, std::size_t VSlotCount, auto VEmptyKey>
+		constexpr auto BuildPerfectHash() -> PerfectHashLayout<decltype(VEmptyKey), VBucketCount, VSlotCount>
+		{
+			using TKey = decltype(VEmptyKey);
+			constexpr auto keyCount = VKeys.size();
+			auto layout = PerfectHashLayout<TKey, VBucketCount, VSlotCount>{};
+			layout.Keys.fill(VEmptyKey);
+
+			auto keys = std::array<TKey, keyCount>{};
+			for (std::size_t i = 0; i < keyCount; ++i)
+			{
+				keys[i] = static_cast<TKey>(VKeys[i]);
+				if (keys[i] == VEmptyKey)
+					throw std::exception{ "Keys must not be the empty key" };
+			}
+
+			auto bucketOf = [](TKey key) { return static_cast<std::size_t>(VMix(key, 0) & (VBucketCount - 1)); };
+			auto bucketSizes = std::array<std::size_t, VBucketCount>{};
+			for (auto key : keys)
+				bucketSizes[bucketOf(key)]++;
+			std::ranges::sort(
+				keys,
+				[&](TKey a, TKey b)
+				{
+					auto bucketA = bucketOf(a);
+					auto bucketB = bucketOf(b);
+					return bucketSizes[bucketA] != bucketSizes[bucketB]
+						? bucketSizes[bucketA] > bucketSizes[bucketB]
+						: bucketA < bucketB;
+				});
+
+			auto slots = std::array<std::size_t, keyCount>{};
+			for (std::size_t begin = 0; begin < keyCount;)
+			{
+				auto bucket = bucketOf(keys[begin]);
+				auto end = begin + bucketSizes[bucket];
+				// Equal keys always share a bucket, so this is enough to catch duplicates.
+				for (std::size_t i = begin; i < end; ++i)
+					if (std::find(keys.begin() + begin, keys.begin() + i, keys[i]) != keys.begin() + i)
+						throw std::exception{ "Keys must be unique" };
+				for (std::uint32_t seed = 1;; ++seed)
+				{
+					if (seed == MaxPerfectHashSeeds)
+						throw std::exception{ "Failed to find a perfect hash for the keys, increase VSlotsPerKey to grow the table" };
+					auto placed = true;
+					for (std::size_t i = begin; i < end and placed; ++i)
+					{
+						slots[i] = static_cast<std::size_t>(VMix(keys[i], seed) & (VSlotCount - 1));
+						placed = layout.Keys[slots[i]] == VEmptyKey
+							and std::find(slots.begin() + begin, slots.begin() + i, slots[i]) == slots.begin() + i;
+					}
+					if (not placed)
+						continue;
+					for (std::size_t i = begin; i < end; ++i)
+						layout.Keys[slots[i]] = keys[i];
+					layout.Seeds[bucket] = seed;
+					break;
+				}
+				begin = end;
+			}
+			return layout;
+		}
+	}
+
+	// Perfect hash over a fixed set of integer keys, built at compile time. Finding a key
+	// is two hashes, two loads and a compare, however many keys are in the set. VMix is
+	// a seeded hash such as Mix32() or Mix64(). VSlotsPerKey trades memory for an easier
+	// build, should the keys not fit at the default load.
+	template<auto VKeys, auto VMix, std::size_t VSlotsPerKey = 2>
+	class PerfectHashTable
+	{
+	public:
+		using Key = std::remove_cvref_t<decltype(VKeys[0])>;
+		static_assert(std::unsigned_integral<Key>, "PerfectHashTable keys must be unsigned integers");
+
+		static constexpr std::size_t KeyCount = VKeys.size();
+		static constexpr std::size_t BucketCount = std::bit_ceil(std::max<std::size_t>(KeyCount / 2, 1));
+		static constexpr std::size_t SlotCount = std::bit_ceil(std::max<std::size_t>(KeyCount * VSlotsPerKey, 2));
+		static constexpr Key EmptyKey = std::numeric_limits<Key>::max();
+
+		static constexpr auto Slot(Key key) noexcept -> std::size_t
+		{
+			auto bucket = static_cast<std::size_t>(VMix(key, 0) & (BucketCount - 1));
+			return static_cast<std::size_t>(VMix(key, Layout.Seeds[bucket]) & (SlotCount - 1));
+		}
+
+		// The slot for key, or SlotCount if key isn't in the set.
+		static constexpr auto Find(Key key) noexcept -> std::size_t
+		{
+			// Free slots hold EmptyKey, so it would otherwise be found in one.
+			if (key == EmptyKey)
+				return SlotCount;
+			auto slot = Slot(key);
+			return Layout.Keys[slot] == key ? slot : SlotCount;
+		}
+
+	private:
+		static constexpr auto Layout = Detail::BuildPerfectHash<VKeys, VMix, BucketCount, SlotCount, EmptyKey>();
+	};
+}
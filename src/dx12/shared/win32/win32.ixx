@@ -60,6 +60,7 @@ export namespace Win32
 		::HRESULT,
 		::PWSTR,
 		::RECT,
+		::LARGE_INTEGER,
 		::WideCharToMultiByte,
 		::MultiByteToWideChar,
 		::OpenEventW,
@@ -67,12 +68,16 @@ export namespace Win32
 		::UnregisterClassW,
 		::CreateEventExW,
 		::WaitForSingleObject,
+		::MsgWaitForMultipleObjectsEx,
+		::CreateWaitableTimerExW,
+		::SetWaitableTimer,
 		::CloseHandle,
 		::ResetEvent,
 		::SetEvent,
 		::FormatMessageA,
 		::LocalFree,
 		::PostQuitMessage,
+		::PostMessageW,
 		::PeekMessageW,
 		::CreateEventW,
 		::GetMessageW,
@@ -121,7 +126,11 @@ export namespace Win32
 			MouseLeave = WM_MOUSELEAVE,
 			MouseMove = WM_MOUSEMOVE,
 			EraseBackground = WM_ERASEBKGND,
-			NonClientDestroy = WM_NCDESTROY
+			NonClientDestroy = WM_NCDESTROY,
+			KeyFirst = WM_KEYFIRST,
+			KeyLast = WM_KEYLAST,
+			MouseFirst = WM_MOUSEFIRST,
+			MouseLast = WM_MOUSELAST
 		};
 	}
 
@@ -163,6 +172,32 @@ export namespace Win32
 	constexpr auto SpiGetNonClientMetrics = SPI_GETNONCLIENTMETRICS;
 	constexpr auto DefaultCharset = DEFAULT_CHARSET;
 	constexpr auto Infinite = INFINITE;
+	constexpr auto MaximumWaitObjects = MAXIMUM_WAIT_OBJECTS;
+
+	namespace QueueStatus
+	{
+		enum : Win32::DWORD
+		{
+			AllInput = QS_ALLINPUT
+		};
+	}
+
+	namespace MsgWaitOptions
+	{
+		enum : Win32::DWORD
+		{
+			InputAvailable = MWMO_INPUTAVAILABLE
+		};
+	}
+
+	namespace WaitableTimerOptions
+	{
+		enum : Win32::DWORD
+		{
+			HighResolution = CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+			AllAccess = TIMER_ALL_ACCESS
+		};
+	}
 
 	namespace EventAccess
 	{
@@ -244,6 +279,13 @@ export namespace Win32
 		return SUCCEEDED(hr);
 	}
 
+	constexpr auto HrOk = HRESULT{ S_OK };
+
+	inline auto HResultFromWin32(DWORD errorCode) noexcept -> HRESULT
+	{
+		return HRESULT_FROM_WIN32(errorCode);
+	}
+
 	constexpr auto LoWord(auto dw) noexcept -> WORD
 	{
 		return LOWORD(dw);
@@ -310,6 +352,13 @@ export namespace D3D12
 		::D3D_FEATURE_LEVEL,
 		::D3D12_FEATURE_DATA_MULTISAMPLE_QUALITY_LEVELS,
 		::D3D12_MULTISAMPLE_QUALITY_LEVEL_FLAGS,
+		::ID3D12QueryHeap,
+		::D3D12_QUERY_HEAP_DESC,
+		::D3D12_QUERY_HEAP_TYPE,
+		::D3D12_QUERY_TYPE,
+		::D3D12_QUERY_DATA_PIPELINE_STATISTICS,
+		::D3D12_RANGE,
+		::CD3DX12_RESOURCE_DESC,
 		::CD3DX12_HEAP_PROPERTIES
 		;
 }
@@ -321,6 +370,7 @@ export namespace DXGI
 		::CreateDXGIFactory1,
 		::CreateDXGIFactory2,
 		::IDXGISwapChain,
+		::IDXGISwapChain2,
 		::IDXGIFactory,
 		::IDXGIFactory1,
 		::IDXGIFactory4,
@@ -341,7 +391,18 @@ export namespace DXGI
 	{
 		enum 
 		{
-			NotFound = DXGI_ERROR_NOT_FOUND
+			NotFound = DXGI_ERROR_NOT_FOUND,
+			DeviceRemoved = DXGI_ERROR_DEVICE_REMOVED,
+			DeviceReset = DXGI_ERROR_DEVICE_RESET,
+			DeviceHung = DXGI_ERROR_DEVICE_HUNG
+		};
+	}
+
+	namespace Status
+	{
+		enum
+		{
+			Occluded = DXGI_STATUS_OCCLUDED
 		};
 	}
 }